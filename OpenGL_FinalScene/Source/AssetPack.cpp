@@ -0,0 +1,303 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetpack.cpp
+// ============
+// read scene assets from a single memory-mapped pack file
+///////////////////////////////////////////////////////////////////////////////
+
+#include "AssetPack.h"
+
+#include "stb_image.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+// declaration of the pack file layout
+namespace
+{
+	const uint32_t PACK_MAGIC = 0x4B505341; // "ASPK"
+	// bump when the layout of the header or the entries changes
+	const uint32_t PACK_VERSION = 1;
+	// blobs start on a page boundary of the mapping
+	const uint64_t PACK_ALIGNMENT = 4096;
+
+	struct PACK_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t entrySize;
+	};
+}
+
+/***********************************************************
+ *  AssetPack()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+AssetPack::AssetPack()
+{
+	m_pEntries = NULL;
+}
+
+/***********************************************************
+ *  ~AssetPack()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+AssetPack::~AssetPack()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a pack file into memory
+ *  and checking its index.  Returns false when the file is
+ *  missing or is not a pack of this version.
+ ***********************************************************/
+bool AssetPack::Open(const char* path)
+{
+	Close();
+
+	if (m_mappedFile.Open(path) == false)
+	{
+		return(false);
+	}
+
+	const unsigned char* pMapped = m_mappedFile.GetData();
+	const size_t mappedBytes = m_mappedFile.GetSize();
+
+	// check the header and that every blob lies within the file
+	const PACK_HEADER* pHeader = (const PACK_HEADER*)pMapped;
+	if ((mappedBytes < sizeof(PACK_HEADER)) ||
+		(pHeader->magic != PACK_MAGIC) ||
+		(pHeader->version != PACK_VERSION) ||
+		(pHeader->entrySize != sizeof(PACK_ENTRY)) ||
+		(sizeof(PACK_HEADER) + (uint64_t)pHeader->entryCount * sizeof(PACK_ENTRY) > mappedBytes))
+	{
+		std::cout << "Not a valid asset pack:" << path << std::endl;
+		Close();
+		return(false);
+	}
+
+	m_pEntries = (const PACK_ENTRY*)(pMapped + sizeof(PACK_HEADER));
+	for (int i = 0; i < (int)pHeader->entryCount; i++)
+	{
+		const PACK_ENTRY& entry = m_pEntries[i];
+		if ((entry.offset > mappedBytes) || (entry.size > mappedBytes - entry.offset) ||
+			(entry.mipLevels < 1) || (entry.mipLevels > TextureDecoder::MAX_MIP_LEVELS))
+		{
+			std::cout << "Not a valid asset pack:" << path << std::endl;
+			Close();
+			return(false);
+		}
+		m_entryIndices.insert(std::make_pair(entry.tagHash, i));
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the pack file.  Pixels
+ *  handed out by GetImage() must no longer be in use.
+ ***********************************************************/
+void AssetPack::Close()
+{
+	m_mappedFile.Close();
+	m_pEntries = NULL;
+	m_entryIndices.clear();
+}
+
+/***********************************************************
+ *  FindEntry()
+ *
+ *  This method is used for finding an asset in the index by
+ *  the hash of its tag.
+ ***********************************************************/
+const AssetPack::PACK_ENTRY* AssetPack::FindEntry(ResourceTag tag) const
+{
+	std::unordered_map<uint32_t, int>::const_iterator found = m_entryIndices.find(tag.GetHash());
+	if (found == m_entryIndices.end())
+	{
+		return(NULL);
+	}
+	return(&m_pEntries[found->second]);
+}
+
+/***********************************************************
+ *  GetImage()
+ *
+ *  This method is used for describing a packed texture as a
+ *  decoded image.  The pixels point into the mapping, so they
+ *  are valid until the pack is closed and are never freed.
+ ***********************************************************/
+bool AssetPack::GetImage(ResourceTag tag, TextureDecoder::DECODED_IMAGE& image) const
+{
+	const PACK_ENTRY* pEntry = FindEntry(tag);
+	if ((NULL == pEntry) || (pEntry->type != ASSET_TEXTURE))
+	{
+		return(false);
+	}
+
+	image.tag = pEntry->tag;
+	image.width = pEntry->width;
+	image.height = pEntry->height;
+	image.colorChannels = 4;
+	image.pixels = (unsigned char*)(m_mappedFile.GetData() + pEntry->offset);
+	image.bStbiPixels = false;
+	image.bMappedPixels = true;
+	image.mipLevels = pEntry->mipLevels;
+	for (int level = 0; level < pEntry->mipLevels; level++)
+	{
+		image.mipOffsets[level] = (size_t)pEntry->mipOffsets[level];
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  WriteTexturePack()
+ *
+ *  This method is used for decoding image files, computing
+ *  their RGBA mip chains, and writing them to a pack file with
+ *  each blob on a page boundary.  The pack is written to a
+ *  temporary file first and then renamed into place.
+ ***********************************************************/
+bool AssetPack::WriteTexturePack(const char* path, const std::vector<std::string>& filenames, const std::vector<std::string>& tags)
+{
+	std::vector<PACK_ENTRY> entries(filenames.size(), PACK_ENTRY());
+	std::string temporaryPath = std::string(path) + ".tmp";
+	const char padding[PACK_ALIGNMENT] = { 0 };
+
+	std::ofstream file(temporaryPath.c_str(), std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not write asset pack:" << path << std::endl;
+		return(false);
+	}
+
+	PACK_HEADER header;
+	header.magic = PACK_MAGIC;
+	header.version = PACK_VERSION;
+	header.entryCount = (uint32_t)entries.size();
+	header.entrySize = sizeof(PACK_ENTRY);
+
+	// leave room for the index, which is rewritten once the
+	// blob offsets are known
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(PACK_ENTRY)));
+	uint64_t offset = sizeof(PACK_HEADER) + entries.size() * sizeof(PACK_ENTRY);
+
+	// images are flipped vertically, as when loading loose files
+	stbi_set_flip_vertically_on_load(true);
+
+	bool bReturn = true;
+	for (size_t i = 0; i < filenames.size(); i++)
+	{
+		TextureDecoder::DECODED_IMAGE image;
+		PACK_ENTRY& entry = entries[i];
+
+		// only a complete RGBA mip chain can be uploaded as is
+		if ((tags[i].size() >= MAX_TAG_LENGTH) ||
+			(TextureDecoder::DecodeImage(filenames[i].c_str(), image, NULL, true) == false) ||
+			(image.colorChannels != 4) ||
+			(TextureDecoder::MipDimension(image.width, image.mipLevels - 1) != 1) ||
+			(TextureDecoder::MipDimension(image.height, image.mipLevels - 1) != 1))
+		{
+			std::cout << "Could not pack image:" << filenames[i] << std::endl;
+			TextureDecoder::FreeImage(image);
+			bReturn = false;
+			break;
+		}
+
+		// pad the blob out to the next page boundary
+		const uint64_t alignedOffset = (offset + PACK_ALIGNMENT - 1) / PACK_ALIGNMENT * PACK_ALIGNMENT;
+		file.write(padding, (std::streamsize)(alignedOffset - offset));
+		offset = alignedOffset;
+
+		const int lastLevel = image.mipLevels - 1;
+		entry.tagHash = ResourceTag(tags[i]).GetHash();
+		entry.type = ASSET_TEXTURE;
+		memcpy(entry.tag, tags[i].c_str(), tags[i].size());
+		entry.offset = offset;
+		entry.size = image.mipOffsets[lastLevel] + (uint64_t)4 *
+			TextureDecoder::MipDimension(image.width, lastLevel) *
+			TextureDecoder::MipDimension(image.height, lastLevel);
+		entry.width = image.width;
+		entry.height = image.height;
+		entry.mipLevels = image.mipLevels;
+		for (int level = 0; level < image.mipLevels; level++)
+		{
+			entry.mipOffsets[level] = image.mipOffsets[level];
+		}
+
+		file.write((const char*)image.pixels, (std::streamsize)entry.size);
+		offset += entry.size;
+
+		std::cout << "Packed image:" << filenames[i] << ", width:" << image.width << ", height:" << image.height << ", mip levels:" << image.mipLevels << std::endl;
+		TextureDecoder::FreeImage(image);
+	}
+
+	if (bReturn == true)
+	{
+		file.seekp(sizeof(PACK_HEADER));
+		file.write((const char*)entries.data(), (std::streamsize)(entries.size() * sizeof(PACK_ENTRY)));
+	}
+	file.close();
+	bReturn = bReturn && !file.fail();
+
+	if (bReturn == true)
+	{
+		// rename does not replace an existing file on Windows
+		remove(path);
+		bReturn = (rename(temporaryPath.c_str(), path) == 0);
+	}
+	if (bReturn == false)
+	{
+		remove(temporaryPath.c_str());
+	}
+
+	return(bReturn);
+}
+
+/***********************************************************
+ *  GetResidentMemoryBytes()
+ *
+ *  This method is used for getting how much physical memory
+ *  the process holds, including the touched pages of mapped
+ *  files.  Returns 0 when it cannot be read.
+ ***********************************************************/
+size_t AssetPack::GetResidentMemoryBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) == FALSE)
+	{
+		return(0);
+	}
+	return((size_t)counters.WorkingSetSize);
+#else
+	std::ifstream statm("/proc/self/statm");
+	size_t totalPages = 0;
+	size_t residentPages = 0;
+	if (!(statm >> totalPages >> residentPages))
+	{
+		return(0);
+	}
+	return(residentPages * (size_t)sysconf(_SC_PAGESIZE));
+#endif
+}
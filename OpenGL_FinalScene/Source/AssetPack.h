@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// assetpack.h
+// ============
+// read scene assets from a single memory-mapped pack file
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureDecoder.h"
+#include "ResourceTag.h"
+#include "MappedFile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+/***********************************************************
+ *  AssetPack
+ *
+ *  This class maps a pack file into memory and finds assets in
+ *  it by tag.  The pack is an index followed by page-aligned
+ *  blobs; a texture blob is its full RGBA8 mip chain, so the
+ *  pixels handed out point straight into the mapping and reach
+ *  OpenGL with no decoding and no intermediate copy.  Pages of
+ *  the mapping are only read from disk when first touched.
+ ***********************************************************/
+class AssetPack
+{
+public:
+	// constructor
+	AssetPack();
+	// destructor
+	~AssetPack();
+
+	// longest tag stored in the index, with its terminator
+	static const int MAX_TAG_LENGTH = 64;
+
+	enum ASSET_TYPE
+	{
+		// RGBA8 image with its full mip chain
+		ASSET_TEXTURE = 1
+	};
+
+	struct PACK_ENTRY
+	{
+		// hash of the tag, then the tag itself
+		uint32_t tagHash;
+		uint32_t type;
+		char tag[MAX_TAG_LENGTH];
+		// byte range of the blob within the pack
+		uint64_t offset;
+		uint64_t size;
+		// texture size and mip chain layout within the blob
+		int32_t width;
+		int32_t height;
+		int32_t mipLevels;
+		int32_t reserved;
+		uint64_t mipOffsets[TextureDecoder::MAX_MIP_LEVELS];
+	};
+
+	// map a pack file into memory
+	bool Open(const char* path);
+	// unmap the pack file
+	void Close();
+	// true while a pack file is mapped
+	bool IsOpen() const { return(m_mappedFile.IsOpen()); }
+	// bytes of the pack file that are mapped
+	size_t GetMappedBytes() const { return(m_mappedFile.GetSize()); }
+
+	// find an asset by tag, NULL when it is not in the pack
+	const PACK_ENTRY* FindEntry(ResourceTag tag) const;
+	// describe a packed texture, with the pixels in the mapping
+	bool GetImage(ResourceTag tag, TextureDecoder::DECODED_IMAGE& image) const;
+
+	// decode image files and write them to a pack file
+	static bool WriteTexturePack(const char* path, const std::vector<std::string>& filenames, const std::vector<std::string>& tags);
+	// resident memory of the process, for comparing load paths
+	static size_t GetResidentMemoryBytes();
+
+private:
+	// the mapped pack file
+	MappedFile m_mappedFile;
+	// index entries within the mapping
+	const PACK_ENTRY* m_pEntries;
+	// index of each entry by the hash of its tag
+	std::unordered_map<uint32_t, int> m_entryIndices;
+};
@@ -0,0 +1,257 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawsort.cpp
+// ============
+// order draws by a 64-bit state key with an LSD radix sort
+///////////////////////////////////////////////////////////////////////////////
+
+#include "DrawSort.h"
+
+#include <cstring>
+
+// declaration of global variables
+namespace
+{
+	// the bits of each field, with the state fields packed
+	// together in the order they are sorted by
+	const int PASS_SHIFT = 62;
+	const int TRANSPARENT_SHIFT = 61;
+	const int VARIANT_BITS = 8;
+	const int TEXTURE_BITS = 12;
+	const int MESH_BITS = 5;
+	const int MATERIAL_BITS = 12;
+	const int DEPTH_BITS = 24;
+
+	const int MATERIAL_SHIFT = 0;
+	const int MESH_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+	const int TEXTURE_SHIFT = MESH_SHIFT + MESH_BITS;
+	const int VARIANT_SHIFT = TEXTURE_SHIFT + TEXTURE_BITS;
+	const int STATE_BITS = VARIANT_SHIFT + VARIANT_BITS;
+
+	const uint64_t STATE_MASK = (1ULL << STATE_BITS) - 1;
+	const uint64_t DEPTH_MASK = (1ULL << DEPTH_BITS) - 1;
+
+	// the keys are sorted 8 bits at a time
+	const int KEY_BYTES = 8;
+	const int RADIX = 256;
+
+	/***********************************************************
+	 *  Field()
+	 *
+	 *  This function is used for masking a value to the bits of
+	 *  its field.
+	 ***********************************************************/
+	uint64_t Field(int value, int bits)
+	{
+		return((uint64_t)value & ((1ULL << bits) - 1));
+	}
+
+	/***********************************************************
+	 *  DepthBits()
+	 *
+	 *  This function is used for turning a depth into the top 24
+	 *  bits of its float, which sort in the same order as the
+	 *  depths do, since a float that is not negative compares
+	 *  like an integer.
+	 ***********************************************************/
+	uint64_t DepthBits(float depth)
+	{
+		if (!(depth > 0.0f))
+		{
+			depth = 0.0f;
+		}
+
+		uint32_t bits = 0;
+		memcpy(&bits, &depth, sizeof(bits));
+
+		return((bits >> 7) & DEPTH_MASK);
+	}
+
+	/***********************************************************
+	 *  StateBits()
+	 *
+	 *  This function is used for finding the state fields in a
+	 *  key, wherever the blending bit put them.
+	 ***********************************************************/
+	uint64_t StateBits(uint64_t key)
+	{
+		if (((key >> TRANSPARENT_SHIFT) & 1) != 0)
+		{
+			return(key & STATE_MASK);
+		}
+
+		return((key >> DEPTH_BITS) & STATE_MASK);
+	}
+}
+
+/***********************************************************
+ *  DrawSort()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+DrawSort::DrawSort()
+{
+}
+
+/***********************************************************
+ *  ~DrawSort()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+DrawSort::~DrawSort()
+{
+}
+
+/***********************************************************
+ *  MakeKey()
+ *
+ *  This method is used for packing the state of a draw into
+ *  its key.  An opaque draw sorts by its state and then near
+ *  to far, so the depth test discards the most; a blended
+ *  draw sorts far to near and then by its state.
+ ***********************************************************/
+uint64_t DrawSort::MakeKey(const DRAW_KEY& fields)
+{
+	const uint64_t state =
+		(Field(fields.variant, VARIANT_BITS) << VARIANT_SHIFT) |
+		(Field(fields.texture, TEXTURE_BITS) << TEXTURE_SHIFT) |
+		(Field(fields.mesh, MESH_BITS) << MESH_SHIFT) |
+		(Field(fields.material, MATERIAL_BITS) << MATERIAL_SHIFT);
+	const uint64_t depth = DepthBits(fields.depth);
+
+	uint64_t key = Field(fields.pass, 2) << PASS_SHIFT;
+	if (fields.bTransparent == true)
+	{
+		key |= 1ULL << TRANSPARENT_SHIFT;
+		key |= (DEPTH_MASK - depth) << STATE_BITS;
+		key |= state;
+	}
+	else
+	{
+		key |= state << DEPTH_BITS;
+		key |= depth;
+	}
+
+	return(key);
+}
+
+/***********************************************************
+ *  Sort()
+ *
+ *  This method is used for sorting the keys a byte at a time,
+ *  lowest first, writing the index of each key into the order
+ *  it should be drawn in.  Each byte is scattered stably by a
+ *  count of its values, and the counts of every byte come from
+ *  one read of the keys.  A byte every key shares, like the
+ *  pass of a scene with one pass, is skipped.
+ ***********************************************************/
+void DrawSort::Sort(const std::vector<uint64_t>& keys, std::vector<int>& order)
+{
+	const size_t count = keys.size();
+
+	m_keys.assign(keys.begin(), keys.end());
+	m_scratchKeys.resize(count);
+	m_scratchOrder.resize(count);
+	order.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		order[i] = (int)i;
+	}
+	if (count < 2)
+	{
+		return;
+	}
+
+	size_t counts[KEY_BYTES][RADIX];
+	memset(counts, 0, sizeof(counts));
+	for (size_t i = 0; i < count; i++)
+	{
+		const uint64_t key = m_keys[i];
+		for (int byte = 0; byte < KEY_BYTES; byte++)
+		{
+			counts[byte][(key >> (byte * 8)) & 0xFF]++;
+		}
+	}
+
+	for (int byte = 0; byte < KEY_BYTES; byte++)
+	{
+		size_t* byteCounts = counts[byte];
+		const int shift = byte * 8;
+		if (byteCounts[(m_keys[0] >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+
+		// turn the counts into where each value starts
+		size_t offset = 0;
+		for (int value = 0; value < RADIX; value++)
+		{
+			const size_t valueCount = byteCounts[value];
+			byteCounts[value] = offset;
+			offset += valueCount;
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const size_t destination = byteCounts[(m_keys[i] >> shift) & 0xFF]++;
+			m_scratchKeys[destination] = m_keys[i];
+			m_scratchOrder[destination] = order[i];
+		}
+
+		m_keys.swap(m_scratchKeys);
+		order.swap(m_scratchOrder);
+	}
+}
+
+/***********************************************************
+ *  CountStateChanges()
+ *
+ *  This method is used for counting how often the blending,
+ *  shader variant, texture, shape and material change when
+ *  the keys are drawn in an order.
+ ***********************************************************/
+DrawSort::STATE_CHANGES DrawSort::CountStateChanges(const std::vector<uint64_t>& keys, const std::vector<int>& order)
+{
+	STATE_CHANGES changes;
+	memset(&changes, 0, sizeof(changes));
+
+	for (size_t i = 1; i < order.size(); i++)
+	{
+		const uint64_t previousKey = keys[order[i - 1]];
+		const uint64_t key = keys[order[i]];
+		const uint64_t previousState = StateBits(previousKey);
+		const uint64_t state = StateBits(key);
+
+		if ((((previousKey ^ key) >> TRANSPARENT_SHIFT) & 1) != 0)
+		{
+			changes.blend++;
+		}
+		if (((previousState ^ state) >> VARIANT_SHIFT) != 0)
+		{
+			changes.shader++;
+		}
+		if ((((previousState ^ state) >> TEXTURE_SHIFT) & ((1ULL << TEXTURE_BITS) - 1)) != 0)
+		{
+			changes.texture++;
+		}
+		if ((((previousState ^ state) >> MESH_SHIFT) & ((1ULL << MESH_BITS) - 1)) != 0)
+		{
+			changes.mesh++;
+		}
+		if ((((previousState ^ state) >> MATERIAL_SHIFT) & ((1ULL << MATERIAL_BITS) - 1)) != 0)
+		{
+			changes.material++;
+		}
+	}
+
+	return(changes);
+}
+
+/***********************************************************
+ *  TotalStateChanges()
+ *
+ *  This method is used for adding up the state changes.
+ ***********************************************************/
+int DrawSort::TotalStateChanges(const STATE_CHANGES& changes)
+{
+	return(changes.blend + changes.shader + changes.texture + changes.mesh + changes.material);
+}
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////
+// drawsort.h
+// ============
+// order draws by a 64-bit state key with an LSD radix sort
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/***********************************************************
+ *  DrawSort
+ *
+ *  This class orders draws so the ones sharing a state are
+ *  submitted side by side.  The state of each draw is packed
+ *  into a 64-bit key, most costly change first - the pass,
+ *  blending, shader variant, texture, shape and material -
+ *  with the depth in the lowest bits, near to far.  A blended
+ *  draw puts its depth, far to near, right after the blending
+ *  bit, since it has to be drawn in that order whatever its
+ *  state.  The keys are sorted a byte at a time with a stable
+ *  LSD radix sort, skipping the bytes every key shares.
+ ***********************************************************/
+class DrawSort
+{
+public:
+	// constructor
+	DrawSort();
+	// destructor
+	~DrawSort();
+
+	// state of one draw, before it is packed into a key
+	struct DRAW_KEY
+	{
+		int pass;
+		bool bTransparent;
+		int variant;
+		int texture;
+		int mesh;
+		int material;
+		// distance from the camera, not negative
+		float depth;
+	};
+
+	// number of times each state changes between draws
+	struct STATE_CHANGES
+	{
+		int blend;
+		int shader;
+		int texture;
+		int mesh;
+		int material;
+	};
+
+	// pack the state of a draw into its key
+	static uint64_t MakeKey(const DRAW_KEY& fields);
+	// sort the keys, writing the index of each key into the
+	// order it should be drawn in
+	void Sort(const std::vector<uint64_t>& keys, std::vector<int>& order);
+	// count the state changes of drawing the keys in an order
+	static STATE_CHANGES CountStateChanges(const std::vector<uint64_t>& keys, const std::vector<int>& order);
+	// total of the state changes
+	static int TotalStateChanges(const STATE_CHANGES& changes);
+
+private:
+	// keys and indexes being sorted, and the buffers each byte
+	// is scattered into, kept between frames
+	std::vector<uint64_t> m_keys;
+	std::vector<uint64_t> m_scratchKeys;
+	std::vector<int> m_scratchOrder;
+};
@@ -0,0 +1,225 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.cpp
+// ============
+// report changed files in watched directories without blocking
+///////////////////////////////////////////////////////////////////////////////
+
+#include "FileWatcher.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/inotify.h>
+#endif
+
+// declaration of the polling interval
+namespace
+{
+	// directories are listed at most this often when polled
+	const int POLL_INTERVAL_MILLISECONDS = 500;
+}
+
+/***********************************************************
+ *  FileWatcher()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+FileWatcher::FileWatcher()
+{
+	m_inotify = -1;
+#ifdef __linux__
+	m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+	m_lastPoll = std::chrono::steady_clock::now();
+}
+
+/***********************************************************
+ *  ~FileWatcher()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (m_inotify >= 0)
+	{
+		close(m_inotify);
+		m_inotify = -1;
+	}
+#endif
+}
+
+/***********************************************************
+ *  WatchDirectory()
+ *
+ *  This method is used for starting to watch the files in a
+ *  directory.  Subdirectories are not watched.  Returns false
+ *  when the directory cannot be watched.
+ ***********************************************************/
+bool FileWatcher::WatchDirectory(const char* directory)
+{
+	WATCHED_DIRECTORY watched;
+	watched.path = directory;
+	watched.watch = -1;
+
+#ifdef __linux__
+	if (m_inotify >= 0)
+	{
+		// a finished write, or an editor renaming its temporary
+		// file over the original
+		watched.watch = inotify_add_watch(m_inotify, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (watched.watch < 0)
+		{
+			return(false);
+		}
+		m_directories.push_back(watched);
+		return(true);
+	}
+#endif
+
+	if (ListDirectory(watched.path, watched.fileTimes) == false)
+	{
+		return(false);
+	}
+	m_directories.push_back(watched);
+	return(true);
+}
+
+/***********************************************************
+ *  Poll()
+ *
+ *  This method is used for collecting the files that changed
+ *  since the last call.  It never waits for a change, so it
+ *  can be called once per frame.
+ ***********************************************************/
+void FileWatcher::Poll(std::vector<std::string>& changedFiles)
+{
+	changedFiles.clear();
+
+#ifdef __linux__
+	if (m_inotify >= 0)
+	{
+		// events are aligned for the inotify_event header
+		alignas(struct inotify_event) char buffer[4096];
+		ssize_t bytesRead = 0;
+		while ((bytesRead = read(m_inotify, buffer, sizeof(buffer))) > 0)
+		{
+			for (ssize_t offset = 0; offset < bytesRead; )
+			{
+				const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+				offset += sizeof(struct inotify_event) + event->len;
+
+				if ((event->len == 0) || (event->mask & IN_ISDIR))
+				{
+					continue;
+				}
+				for (size_t i = 0; i < m_directories.size(); i++)
+				{
+					if (m_directories[i].watch == event->wd)
+					{
+						AddChangedFile(changedFiles, m_directories[i].path + "/" + event->name);
+					}
+				}
+			}
+		}
+		return;
+	}
+#endif
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (now - m_lastPoll < std::chrono::milliseconds(POLL_INTERVAL_MILLISECONDS))
+	{
+		return;
+	}
+	m_lastPoll = now;
+
+	for (size_t i = 0; i < m_directories.size(); i++)
+	{
+		FILE_TIMES fileTimes;
+		if (ListDirectory(m_directories[i].path, fileTimes) == false)
+		{
+			continue;
+		}
+
+		// a new file or a new modification time is a change
+		for (FILE_TIMES::const_iterator file = fileTimes.begin(); file != fileTimes.end(); ++file)
+		{
+			FILE_TIMES::const_iterator seen = m_directories[i].fileTimes.find(file->first);
+			if ((seen == m_directories[i].fileTimes.end()) || (seen->second != file->second))
+			{
+				AddChangedFile(changedFiles, m_directories[i].path + "/" + file->first);
+			}
+		}
+		m_directories[i].fileTimes.swap(fileTimes);
+	}
+}
+
+/***********************************************************
+ *  ListDirectory()
+ *
+ *  This method is used for listing the regular files in a
+ *  directory with their modification times.
+ ***********************************************************/
+bool FileWatcher::ListDirectory(const std::string& directory, FILE_TIMES& fileTimes)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA((directory + "/*").c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE)
+	{
+		return(false);
+	}
+	do
+	{
+		if ((findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0)
+		{
+			fileTimes[findData.cFileName] =
+				((long long)findData.ftLastWriteTime.dwHighDateTime << 32) | findData.ftLastWriteTime.dwLowDateTime;
+		}
+	} while (FindNextFileA(find, &findData) != FALSE);
+	FindClose(find);
+#else
+	DIR* pDirectory = opendir(directory.c_str());
+	if (NULL == pDirectory)
+	{
+		return(false);
+	}
+	struct dirent* pEntry = NULL;
+	while ((pEntry = readdir(pDirectory)) != NULL)
+	{
+		struct stat fileStatus;
+		std::string path = directory + "/" + pEntry->d_name;
+		if ((stat(path.c_str(), &fileStatus) == 0) && (S_ISREG(fileStatus.st_mode)))
+		{
+			fileTimes[pEntry->d_name] = (long long)fileStatus.st_mtime;
+		}
+	}
+	closedir(pDirectory);
+#endif
+
+	return(true);
+}
+
+/***********************************************************
+ *  AddChangedFile()
+ *
+ *  This method is used for adding a changed path to the list,
+ *  since one save can report the same file several times.
+ ***********************************************************/
+void FileWatcher::AddChangedFile(std::vector<std::string>& changedFiles, const std::string& path)
+{
+	if (std::find(changedFiles.begin(), changedFiles.end(), path) == changedFiles.end())
+	{
+		changedFiles.push_back(path);
+	}
+}
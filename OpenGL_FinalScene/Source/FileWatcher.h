@@ -0,0 +1,62 @@
+///////////////////////////////////////////////////////////////////////////////
+// filewatcher.h
+// ============
+// report changed files in watched directories without blocking
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  FileWatcher
+ *
+ *  This class reports the files that were written or moved
+ *  into a set of watched directories.  On Linux the kernel
+ *  reports the changes through inotify, so Poll() costs one
+ *  non-blocking read.  Elsewhere the directories are listed
+ *  and the file modification times compared, at most a couple
+ *  of times per second.
+ ***********************************************************/
+class FileWatcher
+{
+public:
+	// constructor
+	FileWatcher();
+	// destructor
+	~FileWatcher();
+
+	// watch the files directly in a directory
+	bool WatchDirectory(const char* directory);
+	// collect the paths of the files changed since the last
+	// call, each once, without blocking
+	void Poll(std::vector<std::string>& changedFiles);
+
+private:
+	// modification time of each file in a directory by name
+	typedef std::map<std::string, long long> FILE_TIMES;
+
+	struct WATCHED_DIRECTORY
+	{
+		std::string path;
+		// inotify watch descriptor, or -1 when polled
+		int watch;
+		// file times seen at the last poll
+		FILE_TIMES fileTimes;
+	};
+
+	// the watched directories
+	std::vector<WATCHED_DIRECTORY> m_directories;
+	// inotify instance, or -1 when the directories are polled
+	int m_inotify;
+	// time of the last directory listing
+	std::chrono::steady_clock::time_point m_lastPoll;
+
+	// list the files in a directory with their modification times
+	static bool ListDirectory(const std::string& directory, FILE_TIMES& fileTimes);
+	// add a changed path unless it is already listed
+	static void AddChangedFile(std::vector<std::string>& changedFiles, const std::string& path);
+};
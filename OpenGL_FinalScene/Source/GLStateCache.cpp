@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.cpp
+// ============
+// shadow the fixed-function OpenGL state and drop redundant changes
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GLStateCache.h"
+
+/***********************************************************
+ *  GLStateCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+GLStateCache::GLStateCache()
+{
+	m_bFiltering = true;
+	m_frameStats.issued = 0;
+	m_frameStats.elided = 0;
+	m_lastFrameStats = m_frameStats;
+	m_totalStats = m_frameStats;
+	m_frameCount = 0;
+
+	m_blendSource = GL_ONE;
+	m_blendDestination = GL_ZERO;
+	m_bDepthWrite = true;
+	m_clearColor = glm::vec4(0.0f);
+	Invalidate();
+}
+
+/***********************************************************
+ *  ~GLStateCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+GLStateCache::~GLStateCache()
+{
+}
+
+/***********************************************************
+ *  CountChange()
+ *
+ *  This method is used for counting a state change that is
+ *  passed to the driver or dropped.  With filtering off every
+ *  change is passed on.  Returns true when it is passed on.
+ ***********************************************************/
+bool GLStateCache::CountChange(bool bChanged)
+{
+	if ((bChanged == false) && (m_bFiltering == true))
+	{
+		m_frameStats.elided++;
+		return(false);
+	}
+
+	m_frameStats.issued++;
+	return(true);
+}
+
+/***********************************************************
+ *  SetCapability()
+ *
+ *  This method is used for enabling or disabling a capability
+ *  unless it is already known to have that state.
+ ***********************************************************/
+void GLStateCache::SetCapability(GLenum capability, bool bEnabled)
+{
+	std::unordered_map<GLenum, bool>::iterator found = m_capabilities.find(capability);
+	const bool bChanged = (found == m_capabilities.end()) || (found->second != bEnabled);
+
+	if (CountChange(bChanged) == true)
+	{
+		if (bEnabled == true)
+		{
+			glEnable(capability);
+		}
+		else
+		{
+			glDisable(capability);
+		}
+		m_capabilities[capability] = bEnabled;
+	}
+}
+
+/***********************************************************
+ *  Enable()
+ *
+ *  This method is used for enabling a capability.
+ ***********************************************************/
+void GLStateCache::Enable(GLenum capability)
+{
+	SetCapability(capability, true);
+}
+
+/***********************************************************
+ *  Disable()
+ *
+ *  This method is used for disabling a capability.
+ ***********************************************************/
+void GLStateCache::Disable(GLenum capability)
+{
+	SetCapability(capability, false);
+}
+
+/***********************************************************
+ *  BlendFunc()
+ *
+ *  This method is used for setting the blend factors.
+ ***********************************************************/
+void GLStateCache::BlendFunc(GLenum sourceFactor, GLenum destinationFactor)
+{
+	const bool bChanged = (m_bBlendFuncKnown == false) ||
+		(m_blendSource != sourceFactor) || (m_blendDestination != destinationFactor);
+
+	if (CountChange(bChanged) == true)
+	{
+		glBlendFunc(sourceFactor, destinationFactor);
+		m_bBlendFuncKnown = true;
+		m_blendSource = sourceFactor;
+		m_blendDestination = destinationFactor;
+	}
+}
+
+/***********************************************************
+ *  DepthMask()
+ *
+ *  This method is used for turning depth buffer writes on or
+ *  off.
+ ***********************************************************/
+void GLStateCache::DepthMask(bool bWrite)
+{
+	const bool bChanged = (m_bDepthMaskKnown == false) || (m_bDepthWrite != bWrite);
+
+	if (CountChange(bChanged) == true)
+	{
+		glDepthMask(bWrite ? GL_TRUE : GL_FALSE);
+		m_bDepthMaskKnown = true;
+		m_bDepthWrite = bWrite;
+	}
+}
+
+/***********************************************************
+ *  ClearColor()
+ *
+ *  This method is used for setting the clear color.
+ ***********************************************************/
+void GLStateCache::ClearColor(const glm::vec4& color)
+{
+	const bool bChanged = (m_bClearColorKnown == false) || (m_clearColor != color);
+
+	if (CountChange(bChanged) == true)
+	{
+		glClearColor(color.r, color.g, color.b, color.a);
+		m_bClearColorKnown = true;
+		m_clearColor = color;
+	}
+}
+
+/***********************************************************
+ *  SetFilteringEnabled()
+ *
+ *  This method is used for turning the dropping of changes
+ *  that change nothing on or off, to measure what it saves.
+ *  The changes are still counted when it is off.
+ ***********************************************************/
+void GLStateCache::SetFilteringEnabled(bool bEnabled)
+{
+	m_bFiltering = bEnabled;
+}
+
+/***********************************************************
+ *  Invalidate()
+ *
+ *  This method is used for forgetting every known state, so
+ *  the next change of each reaches the driver.
+ ***********************************************************/
+void GLStateCache::Invalidate()
+{
+	m_capabilities.clear();
+	m_bBlendFuncKnown = false;
+	m_bDepthMaskKnown = false;
+	m_bClearColorKnown = false;
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for keeping the counts of the frame
+ *  that just finished and adding them to the totals.
+ ***********************************************************/
+void GLStateCache::EndFrame()
+{
+	m_lastFrameStats = m_frameStats;
+	m_totalStats.issued += m_frameStats.issued;
+	m_totalStats.elided += m_frameStats.elided;
+	m_frameStats.issued = 0;
+	m_frameStats.elided = 0;
+	m_frameCount++;
+}
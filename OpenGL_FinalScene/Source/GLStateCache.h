@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// glstatecache.h
+// ============
+// shadow the fixed-function OpenGL state and drop redundant changes
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <unordered_map>
+
+/***********************************************************
+ *  GLStateCache
+ *
+ *  This class keeps the last value of each piece of OpenGL
+ *  state that is set through it - enabled capabilities, the
+ *  blend function, the depth writes and the clear color - and
+ *  drops a change that would not change anything before it
+ *  reaches the driver.  State that has not been set through
+ *  the class yet is unknown, so its first change always goes
+ *  through.  State changed without the class must be followed
+ *  by Invalidate().
+ ***********************************************************/
+class GLStateCache
+{
+public:
+	// constructor
+	GLStateCache();
+	// destructor
+	~GLStateCache();
+
+	// state changes passed to the driver and dropped as redundant
+	struct CALL_STATS
+	{
+		long long issued;
+		long long elided;
+	};
+
+	// enable or disable a capability, such as GL_DEPTH_TEST
+	void Enable(GLenum capability);
+	void Disable(GLenum capability);
+	// set the blend factors
+	void BlendFunc(GLenum sourceFactor, GLenum destinationFactor);
+	// turn writing to the depth buffer on or off
+	void DepthMask(bool bWrite);
+	// set the color the color buffer is cleared to
+	void ClearColor(const glm::vec4& color);
+
+	// turn dropping the changes that change nothing on or off
+	void SetFilteringEnabled(bool bEnabled);
+	// forget every known state
+	void Invalidate();
+	// fold the calls of the frame into the totals
+	void EndFrame();
+	// calls in the last finished frame and in all frames
+	CALL_STATS GetFrameStats() const { return(m_lastFrameStats); }
+	CALL_STATS GetTotalStats() const { return(m_totalStats); }
+	// number of frames folded into the totals
+	long long GetFrameCount() const { return(m_frameCount); }
+
+private:
+	// known state of each capability that has been set
+	std::unordered_map<GLenum, bool> m_capabilities;
+	// blend factors, when known
+	bool m_bBlendFuncKnown;
+	GLenum m_blendSource;
+	GLenum m_blendDestination;
+	// depth writes, when known
+	bool m_bDepthMaskKnown;
+	bool m_bDepthWrite;
+	// clear color, when known
+	bool m_bClearColorKnown;
+	glm::vec4 m_clearColor;
+	// true when the changes that change nothing are dropped
+	bool m_bFiltering;
+	// calls in the current frame, the last frame and all frames
+	CALL_STATS m_frameStats;
+	CALL_STATS m_lastFrameStats;
+	CALL_STATS m_totalStats;
+	long long m_frameCount;
+
+	// set a capability unless it already has the state
+	void SetCapability(GLenum capability, bool bEnabled);
+	// count a change that was passed on or dropped
+	bool CountChange(bool bChanged);
+};
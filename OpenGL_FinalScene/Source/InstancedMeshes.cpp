@@ -0,0 +1,341 @@
+///////////////////////////////////////////////////////////////////////////////
+// instancedmeshes.cpp
+// ============
+// draw many copies of the basic shapes from one merged geometry buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#include "InstancedMeshes.h"
+
+#include <cstddef>
+
+// declaration of global variables
+namespace
+{
+	static_assert(sizeof(InstancedMeshes::INSTANCE) == 80, "an instance is 80 bytes");
+	static_assert(sizeof(InstancedMeshes::BATCH_DATA) == 64, "std430 BatchData is 64 bytes");
+	static_assert(sizeof(InstancedMeshes::DRAW_COMMAND) == 20, "a draw command is 5 integers");
+}
+
+/***********************************************************
+ *  InstancedMeshes()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+InstancedMeshes::InstancedMeshes()
+{
+	m_vertexArray = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	for (int i = 0; i < ShapeGeometry::SHAPE_COUNT; i++)
+	{
+		m_ranges[i].firstIndex = 0;
+		m_ranges[i].indexCount = 0;
+		m_ranges[i].baseVertex = 0;
+	}
+	m_instanceBuffer = 0;
+	m_instanceCapacity = 0;
+	m_commandBuffer = 0;
+	m_batchBuffer = 0;
+}
+
+/***********************************************************
+ *  ~InstancedMeshes()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+InstancedMeshes::~InstancedMeshes()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for building every shape and
+ *  appending it to the merged vertex and index buffers.  The
+ *  indices of each shape stay relative to its own first
+ *  vertex, which the draws pass as the base vertex.  The
+ *  instance attributes read from the one instance buffer,
+ *  advancing once per instance.
+ ***********************************************************/
+void InstancedMeshes::Create()
+{
+	Destroy();
+
+	std::vector<ShapeGeometry::VERTEX> vertices;
+	std::vector<GLuint> indices;
+	ShapeGeometry::MESH_DATA data;
+	for (int shape = 0; shape < ShapeGeometry::SHAPE_COUNT; shape++)
+	{
+		ShapeGeometry::Build((ShapeGeometry::SHAPE)shape, data);
+
+		m_ranges[shape].firstIndex = (GLuint)indices.size();
+		m_ranges[shape].indexCount = (GLsizei)data.indices.size();
+		m_ranges[shape].baseVertex = (GLint)vertices.size();
+		vertices.insert(vertices.end(), data.vertices.begin(), data.vertices.end());
+		indices.insert(indices.end(), data.indices.begin(), data.indices.end());
+	}
+
+	glGenVertexArrays(1, &m_vertexArray);
+	glBindVertexArray(m_vertexArray);
+
+	glGenBuffers(1, &m_vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(ShapeGeometry::VERTEX), vertices.data(), GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_indexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+
+	const GLsizei stride = sizeof(ShapeGeometry::VERTEX);
+	glEnableVertexAttribArray(ShapeGeometry::LOCATION_POSITION);
+	glVertexAttribPointer(ShapeGeometry::LOCATION_POSITION, 3, GL_FLOAT, GL_FALSE, stride,
+		(void*)offsetof(ShapeGeometry::VERTEX, position));
+	glEnableVertexAttribArray(ShapeGeometry::LOCATION_NORMAL);
+	glVertexAttribPointer(ShapeGeometry::LOCATION_NORMAL, 3, GL_FLOAT, GL_FALSE, stride,
+		(void*)offsetof(ShapeGeometry::VERTEX, normal));
+	glEnableVertexAttribArray(ShapeGeometry::LOCATION_TEXTURE_COORDINATE);
+	glVertexAttribPointer(ShapeGeometry::LOCATION_TEXTURE_COORDINATE, 2, GL_FLOAT, GL_FALSE, stride,
+		(void*)offsetof(ShapeGeometry::VERTEX, textureCoordinate));
+
+	glGenBuffers(1, &m_instanceBuffer);
+	for (int column = 0; column < 4; column++)
+	{
+		glEnableVertexAttribArray(LOCATION_INSTANCE_MODEL + column);
+		glVertexAttribDivisor(LOCATION_INSTANCE_MODEL + column, 1);
+	}
+	glEnableVertexAttribArray(LOCATION_INSTANCE_MATERIAL);
+	glVertexAttribDivisor(LOCATION_INSTANCE_MATERIAL, 1);
+	glEnableVertexAttribArray(LOCATION_INSTANCE_BATCH);
+	glVertexAttribDivisor(LOCATION_INSTANCE_BATCH, 1);
+	PointInstanceAttributes(0);
+
+	glBindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (IsIndirectSupported() == true)
+	{
+		glGenBuffers(1, &m_commandBuffer);
+		glGenBuffers(1, &m_batchBuffer);
+	}
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for deleting the vertex array and
+ *  every buffer.
+ ***********************************************************/
+void InstancedMeshes::Destroy()
+{
+	if (m_vertexArray != 0)
+	{
+		glDeleteVertexArrays(1, &m_vertexArray);
+		glDeleteBuffers(1, &m_vertexBuffer);
+		glDeleteBuffers(1, &m_indexBuffer);
+		glDeleteBuffers(1, &m_instanceBuffer);
+	}
+	if (m_commandBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_commandBuffer);
+		glDeleteBuffers(1, &m_batchBuffer);
+	}
+
+	m_vertexArray = 0;
+	m_vertexBuffer = 0;
+	m_indexBuffer = 0;
+	m_instanceBuffer = 0;
+	m_instanceCapacity = 0;
+	m_commandBuffer = 0;
+	m_batchBuffer = 0;
+}
+
+/***********************************************************
+ *  SetInstances()
+ *
+ *  This method is used for uploading the instance values.
+ *  The buffer is only reallocated when it needs to grow.
+ ***********************************************************/
+void InstancedMeshes::SetInstances(const std::vector<INSTANCE>& instances)
+{
+	if ((m_instanceBuffer == 0) || (instances.size() == 0))
+	{
+		return;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	if (instances.size() > m_instanceCapacity)
+	{
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(INSTANCE), instances.data(), GL_STATIC_DRAW);
+		m_instanceCapacity = instances.size();
+	}
+	else
+	{
+		glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(INSTANCE), instances.data());
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+/***********************************************************
+ *  Bind()
+ *
+ *  This method is used for binding the vertex array of the
+ *  merged shapes, once for any number of draws.
+ ***********************************************************/
+void InstancedMeshes::Bind() const
+{
+	glBindVertexArray(m_vertexArray);
+}
+
+/***********************************************************
+ *  PointInstanceAttributes()
+ *
+ *  This method is used for pointing the instance attributes
+ *  of the bound vertex array at an instance of the buffer.
+ ***********************************************************/
+void InstancedMeshes::PointInstanceAttributes(int firstInstance) const
+{
+	const GLsizei stride = sizeof(INSTANCE);
+	const size_t offset = (size_t)firstInstance * sizeof(INSTANCE);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	for (int column = 0; column < 4; column++)
+	{
+		glVertexAttribPointer(LOCATION_INSTANCE_MODEL + column, 4, GL_FLOAT, GL_FALSE, stride,
+			(void*)(offset + offsetof(INSTANCE, modelMatrix) + column * sizeof(glm::vec4)));
+	}
+	glVertexAttribIPointer(LOCATION_INSTANCE_MATERIAL, 1, GL_INT, stride,
+		(void*)(offset + offsetof(INSTANCE, materialIndex)));
+	glVertexAttribIPointer(LOCATION_INSTANCE_BATCH, 1, GL_INT, stride,
+		(void*)(offset + offsetof(INSTANCE, batchIndex)));
+}
+
+/***********************************************************
+ *  DrawInstances()
+ *
+ *  This method is used for drawing a range of the instances
+ *  with a shape, from the bound vertex array.  With
+ *  ARB_base_instance the range starts at its base instance,
+ *  otherwise the instance attributes are pointed at the first
+ *  instance of the range before the draw.
+ ***********************************************************/
+void InstancedMeshes::DrawInstances(ShapeGeometry::SHAPE shape, int firstInstance, int instanceCount) const
+{
+	if ((m_vertexArray == 0) || (instanceCount <= 0))
+	{
+		return;
+	}
+
+	const MESH_RANGE& range = m_ranges[shape];
+	void* pIndices = (void*)(range.firstIndex * sizeof(GLuint));
+
+	if (GLEW_ARB_base_instance)
+	{
+		glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+			pIndices, instanceCount, range.baseVertex, (GLuint)firstInstance);
+	}
+	else
+	{
+		PointInstanceAttributes(firstInstance);
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+			pIndices, instanceCount, range.baseVertex);
+	}
+}
+
+/***********************************************************
+ *  IsIndirectSupported()
+ *
+ *  This method is used for checking the driver for the
+ *  extensions the indirect draws need - multi-draw indirect,
+ *  base instances for the instance ranges of the commands,
+ *  and storage buffers with explicit bindings for the batch
+ *  values.
+ ***********************************************************/
+bool InstancedMeshes::IsIndirectSupported()
+{
+	return(GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance &&
+		GLEW_ARB_shader_storage_buffer_object && GLEW_ARB_shading_language_420pack);
+}
+
+/***********************************************************
+ *  MakeCommand()
+ *
+ *  This method is used for making the draw command of a range
+ *  of the instances with a shape.
+ ***********************************************************/
+InstancedMeshes::DRAW_COMMAND InstancedMeshes::MakeCommand(ShapeGeometry::SHAPE shape, int firstInstance, int instanceCount) const
+{
+	DRAW_COMMAND command;
+	command.count = (GLuint)m_ranges[shape].indexCount;
+	command.instanceCount = (GLuint)instanceCount;
+	command.firstIndex = m_ranges[shape].firstIndex;
+	command.baseVertex = m_ranges[shape].baseVertex;
+	command.baseInstance = (GLuint)firstInstance;
+
+	return(command);
+}
+
+/***********************************************************
+ *  SetIndirectDraws()
+ *
+ *  This method is used for uploading the draw commands and
+ *  the values of their batches.
+ ***********************************************************/
+void InstancedMeshes::SetIndirectDraws(const std::vector<DRAW_COMMAND>& commands, const std::vector<BATCH_DATA>& batches)
+{
+	if ((m_commandBuffer == 0) || (commands.size() == 0))
+	{
+		return;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DRAW_COMMAND), commands.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_batchBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, batches.size() * sizeof(BATCH_DATA), batches.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  SetBatchData()
+ *
+ *  This method is used for uploading new values of the
+ *  batches, the same number as when the commands were set,
+ *  such as when a texture handle changed.
+ ***********************************************************/
+void InstancedMeshes::SetBatchData(const std::vector<BATCH_DATA>& batches)
+{
+	if ((m_batchBuffer == 0) || (batches.size() == 0))
+	{
+		return;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_batchBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, batches.size() * sizeof(BATCH_DATA), batches.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+/***********************************************************
+ *  DrawIndirect()
+ *
+ *  This method is used for drawing a range of the commands
+ *  with one call, from the bound vertex array.  Each command
+ *  draws its instances from its base instance, and the batch
+ *  index of those instances picks the batch values, so the
+ *  base instance does the work of gl_DrawID without needing
+ *  ARB_shader_draw_parameters.
+ ***********************************************************/
+void InstancedMeshes::DrawIndirect(int firstCommand, int commandCount) const
+{
+	if ((m_commandBuffer == 0) || (commandCount <= 0))
+	{
+		return;
+	}
+
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING_BATCH_DATA, m_batchBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+		(void*)(firstCommand * sizeof(DRAW_COMMAND)), commandCount, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,140 @@
+///////////////////////////////////////////////////////////////////////////////
+// instancedmeshes.h
+// ============
+// draw many copies of the basic shapes from one merged geometry buffer
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShapeGeometry.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  InstancedMeshes
+ *
+ *  This class uploads every basic shape into one shared
+ *  vertex buffer and index buffer, with a table of where each
+ *  shape starts, so every draw uses the same vertex array.
+ *  The vertex array also reads an instance buffer, so a run
+ *  of objects sharing a shape and shader state is drawn with
+ *  one instanced draw.  Each instance carries its model
+ *  matrix, material index and batch index, which the
+ *  instanced shader variants read as vertex attributes
+ *  advancing once per instance.  Where the driver supports
+ *  multi-draw indirect, the batches can instead be drawn from
+ *  a buffer of draw commands with a single call, reading the
+ *  values of each batch from a storage buffer.
+ ***********************************************************/
+class InstancedMeshes
+{
+public:
+	// constructor
+	InstancedMeshes();
+	// destructor
+	~InstancedMeshes();
+
+	// attribute locations of the instance values - the matrix
+	// takes a location for each of its 4 columns
+	enum INSTANCE_LOCATION
+	{
+		LOCATION_INSTANCE_MODEL = 3,
+		LOCATION_INSTANCE_MATERIAL = 7,
+		LOCATION_INSTANCE_BATCH = 8
+	};
+
+	// storage buffer binding of the batch values
+	enum STORAGE_BINDING
+	{
+		BINDING_BATCH_DATA = 0
+	};
+
+	// values of one instance, padded to a multiple of 16 bytes
+	struct INSTANCE
+	{
+		glm::mat4 modelMatrix;
+		GLint materialIndex;
+		// index of the batch values of an indirect draw
+		GLint batchIndex;
+		GLint padding[2];
+	};
+
+	// values shared by the instances of a batch in an indirect
+	// draw, laid out as BatchData in the fragment shader (std430)
+	struct BATCH_DATA
+	{
+		glm::vec4 color;
+		// UV offset (xy) and scale (zw) of a texture in an atlas
+		glm::vec4 textureRect;
+		glm::vec2 UVscale;
+		GLint bUseTextureAtlas;
+		GLint padding0;
+		// bindless texture handle, split into its two halves
+		GLuint textureHandle[2];
+		GLuint padding1[2];
+	};
+
+	// one command of the draw command buffer, as OpenGL reads it
+	struct DRAW_COMMAND
+	{
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
+	};
+
+	// upload the shapes and create the instance buffer
+	void Create();
+	// delete the vertex array and buffers
+	void Destroy();
+	// replace the contents of the instance buffer
+	void SetInstances(const std::vector<INSTANCE>& instances);
+	// bind the vertex array the shapes are drawn from
+	void Bind() const;
+	// draw a range of the instances with a shape, once bound
+	void DrawInstances(ShapeGeometry::SHAPE shape, int firstInstance, int instanceCount) const;
+	// true once Create() has uploaded the shapes
+	bool IsCreated() const { return(m_vertexArray != 0); }
+
+	// true when the driver can draw the command buffer in one
+	// call, with the instances of each command read from their
+	// base instance and the batch values from a storage buffer
+	static bool IsIndirectSupported();
+	// command drawing a range of the instances with a shape
+	DRAW_COMMAND MakeCommand(ShapeGeometry::SHAPE shape, int firstInstance, int instanceCount) const;
+	// replace the draw commands and the values of their batches
+	void SetIndirectDraws(const std::vector<DRAW_COMMAND>& commands, const std::vector<BATCH_DATA>& batches);
+	// replace the values of the batches, keeping the commands
+	void SetBatchData(const std::vector<BATCH_DATA>& batches);
+	// draw a range of the commands with one call, once bound
+	void DrawIndirect(int firstCommand, int commandCount) const;
+
+private:
+	// where a shape starts in the merged buffers
+	struct MESH_RANGE
+	{
+		GLuint firstIndex;
+		GLsizei indexCount;
+		GLint baseVertex;
+	};
+
+	// vertex array and merged buffers of every shape
+	GLuint m_vertexArray;
+	GLuint m_vertexBuffer;
+	GLuint m_indexBuffer;
+	MESH_RANGE m_ranges[ShapeGeometry::SHAPE_COUNT];
+	// instance values shared by every shape
+	GLuint m_instanceBuffer;
+	// instances the buffer has room for
+	size_t m_instanceCapacity;
+	// draw commands and batch values of the indirect draws
+	GLuint m_commandBuffer;
+	GLuint m_batchBuffer;
+
+	// point the instance attributes at an instance
+	void PointInstanceAttributes(int firstInstance) const;
+};
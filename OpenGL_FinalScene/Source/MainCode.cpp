@@ -9,6 +9,8 @@
 
 #include <iostream>         // error handling and output
 #include <cstdlib>          // EXIT_FAILURE
+#include <cstring>          // strcmp
+#include <chrono>           // first frame timing
 
 #include <GL/glew.h>        // GLEW library
 #include "GLFW/glfw3.h"     // GLFW library
@@ -22,6 +24,13 @@
 #include "ViewManager.h"
 #include "ShapeMeshes.h"
 #include "ShaderManager.h"
+#include "ShaderUniforms.h"
+#include "GLStateCache.h"
+#include "UniformBlocks.h"
+#include "ProgramCache.h"
+#include "ShaderCompiler.h"
+#include "ShaderVariants.h"
+#include "FileWatcher.h"
 
 // Namespace for declaring global variables
 namespace
@@ -29,6 +38,16 @@ namespace
 	// Macro for window title
 	const char* const WINDOW_TITLE = "7-1 FinalProject and Milestones"; 
 
+	// GLSL source files of the scene shaders
+	const char* const VERTEX_SHADER_FILE = "shaders/vertexShader.glsl";
+	const char* const FRAGMENT_SHADER_FILE = "shaders/fragmentShader.glsl";
+	// SPIR-V modules compiled from them by the build
+	const char* const VERTEX_SPIRV_FILE = "shaders/spirv/vertexShader.spv";
+	const char* const FRAGMENT_SPIRV_FILE = "shaders/spirv/fragmentShader.spv";
+
+	// color every frame is cleared to, shared with the warm-up draw
+	const glm::vec4 CLEAR_COLOR(0.0f, 0.0f, 0.0f, 1.0f);
+
 	// Main GLFW window
 	GLFWwindow* g_Window = nullptr;
 
@@ -36,14 +55,33 @@ namespace
 	SceneManager* g_SceneManager = nullptr;
 	// shader manager object for dynamic interaction with the shader code
 	ShaderManager* g_ShaderManager = nullptr;
+	// active uniforms of the shader program, as typed handles
+	ShaderUniforms* g_ShaderUniforms = nullptr;
+	// last OpenGL state set, so unchanged state is not set again
+	GLStateCache* g_StateCache = nullptr;
+	// frame and light uniform blocks shared by the programs
+	UniformBlocks* g_UniformBlocks = nullptr;
+	// linked shader program binaries kept between launches
+	ProgramCache* g_ProgramCache = nullptr;
+	// builds shader programs in the background
+	ShaderCompiler* g_ShaderCompiler = nullptr;
+	// scene shaders specialized for the features of each draw
+	ShaderVariants* g_ShaderVariants = nullptr;
 	// view manager object for managing the 3D view setup and projection to 2D
 	ViewManager* g_ViewManager = nullptr;
+	// file watcher reporting edited textures and shaders, or NULL
+	FileWatcher* g_FileWatcher = nullptr;
 }
 
 // Function declarations - all functions that are called manually
 // need to be pre-declared at the beginning of the source code.
 bool InitializeGLFW();
 bool InitializeGLEW();
+void ReloadChangedFiles();
+GLuint LoadSpirvProgram();
+bool LoadShaderProgram(bool bSpirv);
+bool ReloadShaders();
+void PrintStateStats();
 
 
 /***********************************************************
@@ -54,6 +92,167 @@ bool InitializeGLEW();
  ***********************************************************/
 int main(int argc, char* argv[])
 {
+	// check the command line for a startup benchmark request
+	// and for the texture mode to use for the scene
+	bool bBenchmarkTextures = false;
+	bool bBenchmarkTextureCache = false;
+	bool bBenchmarkAssetPack = false;
+	bool bBenchmarkUniforms = false;
+	bool bBenchmarkShaderVariants = false;
+	bool bBenchmarkDrawList = false;
+	bool bBenchmarkTransforms = false;
+	bool bBenchmarkInstancing = false;
+	bool bBenchmarkDrawSort = false;
+	bool bBuildAssetPack = false;
+	bool bCompileMaterials = false;
+	bool bAssetPack = true;
+	bool bTextureCache = true;
+	bool bTextureAtlas = true;
+	bool bHotReload = true;
+	bool bProgramCache = true;
+	bool bShaderVariants = true;
+	bool bAsyncShaderCompile = true;
+	bool bSpirv = true;
+	bool bShaderWarmup = true;
+	bool bDrawList = true;
+	bool bDrawSort = true;
+	bool bInstancing = false;
+	bool bIndirectDraws = false;
+	bool bStateFilter = true;
+	bool bStreamTextures = false;
+	int textureBudgetMegabytes = 0;
+	SceneManager::TEXTURE_MODE textureMode = SceneManager::TEXTURE_MODE_BINDLESS;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "--benchmark-textures") == 0)
+		{
+			bBenchmarkTextures = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-texture-cache") == 0)
+		{
+			bBenchmarkTextureCache = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-asset-pack") == 0)
+		{
+			bBenchmarkAssetPack = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-uniforms") == 0)
+		{
+			bBenchmarkUniforms = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-shader-variants") == 0)
+		{
+			bBenchmarkShaderVariants = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-draw-list") == 0)
+		{
+			bBenchmarkDrawList = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-transforms") == 0)
+		{
+			bBenchmarkTransforms = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-instancing") == 0)
+		{
+			bBenchmarkInstancing = true;
+		}
+		else if (strcmp(argv[i], "--benchmark-draw-sort") == 0)
+		{
+			bBenchmarkDrawSort = true;
+		}
+		else if (strcmp(argv[i], "--pack") == 0)
+		{
+			bBuildAssetPack = true;
+		}
+		else if (strcmp(argv[i], "--compile-materials") == 0)
+		{
+			bCompileMaterials = true;
+		}
+		else if (strcmp(argv[i], "--no-asset-pack") == 0)
+		{
+			bAssetPack = false;
+		}
+		else if (strcmp(argv[i], "--no-texture-cache") == 0)
+		{
+			bTextureCache = false;
+		}
+		else if (strcmp(argv[i], "--no-texture-atlas") == 0)
+		{
+			bTextureAtlas = false;
+		}
+		else if (strcmp(argv[i], "--no-hot-reload") == 0)
+		{
+			bHotReload = false;
+		}
+		else if (strcmp(argv[i], "--no-program-cache") == 0)
+		{
+			bProgramCache = false;
+		}
+		else if (strcmp(argv[i], "--no-shader-variants") == 0)
+		{
+			bShaderVariants = false;
+		}
+		else if (strcmp(argv[i], "--no-draw-list") == 0)
+		{
+			bDrawList = false;
+		}
+		else if (strcmp(argv[i], "--no-draw-sort") == 0)
+		{
+			bDrawSort = false;
+		}
+		else if (strcmp(argv[i], "--instancing") == 0)
+		{
+			bInstancing = true;
+		}
+		else if (strcmp(argv[i], "--indirect") == 0)
+		{
+			bIndirectDraws = true;
+		}
+		else if (strcmp(argv[i], "--no-shader-warmup") == 0)
+		{
+			bShaderWarmup = false;
+		}
+		else if (strcmp(argv[i], "--no-spirv") == 0)
+		{
+			bSpirv = false;
+		}
+		else if (strcmp(argv[i], "--serial-shader-compile") == 0)
+		{
+			bAsyncShaderCompile = false;
+		}
+		else if (strcmp(argv[i], "--no-state-filter") == 0)
+		{
+			bStateFilter = false;
+		}
+		else if (strcmp(argv[i], "--stream-textures") == 0)
+		{
+			bStreamTextures = true;
+		}
+		else if (strncmp(argv[i], "--texture-budget-mb=", 20) == 0)
+		{
+			textureBudgetMegabytes = atoi(argv[i] + 20);
+		}
+		else if (strcmp(argv[i], "--texture-mode=slots") == 0)
+		{
+			textureMode = SceneManager::TEXTURE_MODE_SLOTS;
+		}
+		else if (strcmp(argv[i], "--texture-mode=arrays") == 0)
+		{
+			textureMode = SceneManager::TEXTURE_MODE_ARRAYS;
+		}
+		else if (strcmp(argv[i], "--texture-mode=bindless") == 0)
+		{
+			textureMode = SceneManager::TEXTURE_MODE_BINDLESS;
+		}
+	}
+
+	// the material library is compiled without a window, as
+	// a build step - a failure fails the build
+	if (bCompileMaterials == true)
+	{
+		return(SceneManager::CompileMaterialLibrary() ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
 	// if GLFW fails initialization, then terminate the application
 	if (InitializeGLFW() == false)
 	{
@@ -62,9 +261,18 @@ int main(int argc, char* argv[])
 
 	// try to create a new shader manager object
 	g_ShaderManager = new ShaderManager();
+	g_ShaderUniforms = new ShaderUniforms();
+	g_ShaderUniforms->SetFilteringEnabled(bStateFilter);
+	g_StateCache = new GLStateCache();
+	g_StateCache->SetFilteringEnabled(bStateFilter);
+	g_UniformBlocks = new UniformBlocks();
+	g_ProgramCache = new ProgramCache("shader_cache");
+	g_ProgramCache->SetReadEnabled(bProgramCache);
+	g_ShaderCompiler = new ShaderCompiler(g_ProgramCache);
 	// try to create a new view manager object
 	g_ViewManager = new ViewManager(
-		g_ShaderManager);
+		g_ShaderManager,
+		g_UniformBlocks);
 
 	// try to create the main display window
 	g_Window = g_ViewManager->CreateDisplayWindow(WINDOW_TITLE);
@@ -75,52 +283,229 @@ int main(int argc, char* argv[])
 		return(EXIT_FAILURE);
 	}
 
-	// load the shader code from the external GLSL files
-	g_ShaderManager->LoadShaders(
-		"shaders/vertexShader.glsl",
-		"shaders/fragmentShader.glsl");
-	g_ShaderManager->use();
+	// the block buffers need the OpenGL functions from GLEW
+	g_UniformBlocks->Create();
+	// the variants are compiled while the scene loads, on the
+	// driver threads or on a worker thread with a shared context
+	g_ShaderCompiler->Start(g_Window, bAsyncShaderCompile);
+
+	// load the shader program, from the SPIR-V the build wrote
+	// or from the GLSL files, through the program cache
+	LoadShaderProgram(bSpirv);
+
+	// read the active uniforms of the program once, so they are
+	// set through handles instead of by name
+	GLint shaderProgram = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &shaderProgram);
+	g_ShaderUniforms->Reflect((GLuint)shaderProgram);
+	UniformBlocks::BindProgram((GLuint)shaderProgram);
 
 	// try to create a new scene manager object and prepare the 3D scene
-	g_SceneManager = new SceneManager(g_ShaderManager);
-	g_SceneManager->PrepareScene();
+	g_SceneManager = new SceneManager(g_ShaderManager, g_ShaderUniforms, g_UniformBlocks, g_StateCache);
+	g_SceneManager->SetTextureMode(textureMode);
+	g_SceneManager->SetTextureCacheEnabled(bTextureCache);
+	g_SceneManager->SetTextureAtlasEnabled(bTextureAtlas);
+	g_SceneManager->SetAssetPackEnabled(bAssetPack);
+	g_SceneManager->SetTextureStreamingEnabled(bStreamTextures);
+	g_SceneManager->SetShaderWarmupEnabled(bShaderWarmup);
+	g_SceneManager->SetShaderWarmupView(g_ViewManager->MakeFrameData(), CLEAR_COLOR);
+	g_SceneManager->SetDrawListEnabled(bDrawList);
+	g_SceneManager->SetDrawSortEnabled(bDrawSort);
+	g_SceneManager->SetInstancingEnabled(bInstancing);
+	g_SceneManager->SetIndirectDrawsEnabled(bIndirectDraws);
+	if (bShaderVariants == true)
+	{
+		g_ShaderVariants = new ShaderVariants(g_ShaderCompiler, VERTEX_SHADER_FILE, FRAGMENT_SHADER_FILE);
+		g_SceneManager->SetShaderVariants(g_ShaderVariants);
+	}
+	if (textureBudgetMegabytes > 0)
+	{
+		g_SceneManager->SetTextureMemoryBudget((size_t)textureBudgetMegabytes * 1024 * 1024);
+	}
+
+	// compare the serial and parallel texture loading, then exit
+	if (bBenchmarkTextures == true)
+	{
+		g_SceneManager->BenchmarkTextureLoading();
+		glfwSetWindowShouldClose(g_Window, true);
+	}
+	// compare the cold and warm texture cache startup, then exit
+	else if (bBenchmarkTextureCache == true)
+	{
+		g_SceneManager->BenchmarkTextureCache();
+		glfwSetWindowShouldClose(g_Window, true);
+	}
+	// compare the asset pack and loose file startup, then exit
+	else if (bBenchmarkAssetPack == true)
+	{
+		g_SceneManager->BenchmarkAssetPack();
+		glfwSetWindowShouldClose(g_Window, true);
+	}
+	// compare setting uniforms by name and by handle, then exit
+	else if (bBenchmarkUniforms == true)
+	{
+		g_SceneManager->BenchmarkUniforms();
+		glfwSetWindowShouldClose(g_Window, true);
+	}
+	// compare the GPU time with and without shader variants, then exit
+	else if (bBenchmarkShaderVariants == true)
+	{
+		g_SceneManager->PrepareScene();
+		g_ViewManager->PrepareSceneView();
+		g_SceneManager->BenchmarkShaderVariants(g_ViewManager->GetFrameData());
+		glfwSetWindowShouldClose(g_Window, true);
+	}
+	// compare the CPU time with and without the draw list, then exit
+	else if (bBenchmarkDrawList == true)
+	{
+		g_SceneManager->PrepareScene();
+		g_ViewManager->PrepareSceneView();
+		g_SceneManager->BenchmarkDrawList(g_ViewManager->GetFrameData());
+		glfwSetWindowShouldClose(g_Window, true);
+	}
+	// compare the glm and SIMD transform composition, then exit
+	else if (bBenchmarkTransforms == true)
+	{
+		g_ViewManager->PrepareSceneView();
+		g_SceneManager->BenchmarkTransforms(g_ViewManager->GetFrameData());
+		glfwSetWindowShouldClose(g_Window, true);
+	}
+	// compare drawing copies of the scene by record and by batch,
+	// then exit
+	else if (bBenchmarkInstancing == true)
+	{
+		g_SceneManager->PrepareScene();
+		g_ViewManager->PrepareSceneView();
+		g_SceneManager->BenchmarkInstancing(g_ViewManager->GetFrameData());
+		glfwSetWindowShouldClose(g_Window, true);
+	}
+	// compare the state changes and sort times of the draw keys,
+	// then exit
+	else if (bBenchmarkDrawSort == true)
+	{
+		g_SceneManager->PrepareScene();
+		g_ViewManager->PrepareSceneView();
+		g_SceneManager->BenchmarkDrawSort(g_ViewManager->GetFrameData());
+		glfwSetWindowShouldClose(g_Window, true);
+	}
+	// write the scene textures to the asset pack, then exit
+	else if (bBuildAssetPack == true)
+	{
+		g_SceneManager->BuildAssetPack();
+		glfwSetWindowShouldClose(g_Window, true);
+	}
+	else
+	{
+		g_SceneManager->PrepareScene();
+
+		// watch the textures and shaders for edits while running
+		if (bHotReload == true)
+		{
+			g_FileWatcher = new FileWatcher();
+			g_FileWatcher->WatchDirectory("textures");
+			g_FileWatcher->WatchDirectory("shaders");
+		}
+	}
+
+	// the first frame is timed, to show whether it still hitches
+	// on programs and state the driver builds at their first draw
+	bool bFirstFrame = true;
+	std::chrono::steady_clock::time_point firstFrameStart = std::chrono::steady_clock::now();
 
 	// loop will keep running until the application is closed 
 	// or until an error has occurred
 	while (!glfwWindowShouldClose(g_Window))
 	{
 		// Enable z-depth
-		glEnable(GL_DEPTH_TEST);
+		g_StateCache->Enable(GL_DEPTH_TEST);
 
 		// Clear the frame and z buffers
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+		g_StateCache->ClearColor(CLEAR_COLOR);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		// convert from 3D object space to 2D view
 		g_ViewManager->PrepareSceneView();
 
+		// pick up edited textures and shaders between frames
+		ReloadChangedFiles();
+
+		// stream, restore and evict textures for this frame
+		g_SceneManager->UpdateTextures();
+
 		// refresh the 3D scene
 		g_SceneManager->RenderScene();
 
 
+		// count the uniform and state calls of the frame
+		g_ShaderUniforms->EndFrame();
+		g_StateCache->EndFrame();
+		// fence the uniform block ranges the frame reads
+		g_UniformBlocks->EndFrame();
+
 		// Flips the the back buffer with the front buffer every frame.
 		glfwSwapBuffers(g_Window);
 
+		if (bFirstFrame == true)
+		{
+			glFinish();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - firstFrameStart;
+			std::cout << "INFO: first frame took " << elapsed.count() << " ms" << std::endl;
+			bFirstFrame = false;
+		}
+
 		// query the latest GLFW events
 		glfwPollEvents();
 	}
 
 	// clear the allocated manager objects from memory
+	if (NULL != g_FileWatcher)
+	{
+		delete g_FileWatcher;
+		g_FileWatcher = NULL;
+	}
 	if (NULL != g_SceneManager)
 	{
+		g_SceneManager->PrintTextureResidencyStats();
+		g_SceneManager->PrintTextureUploadStats();
 		delete g_SceneManager;
 		g_SceneManager = NULL;
 	}
+	if (NULL != g_ShaderVariants)
+	{
+		delete g_ShaderVariants;
+		g_ShaderVariants = NULL;
+	}
+	if (NULL != g_ShaderCompiler)
+	{
+		delete g_ShaderCompiler;
+		g_ShaderCompiler = NULL;
+	}
 	if (NULL != g_ViewManager)
 	{
 		delete g_ViewManager;
 		g_ViewManager = NULL;
 	}
+	if (NULL != g_ProgramCache)
+	{
+		delete g_ProgramCache;
+		g_ProgramCache = NULL;
+	}
+	if (NULL != g_UniformBlocks)
+	{
+		delete g_UniformBlocks;
+		g_UniformBlocks = NULL;
+	}
+	if (NULL != g_StateCache)
+	{
+		PrintStateStats();
+		delete g_StateCache;
+		g_StateCache = NULL;
+	}
+	if (NULL != g_ShaderUniforms)
+	{
+		delete g_ShaderUniforms;
+		g_ShaderUniforms = NULL;
+	}
 	if (NULL != g_ShaderManager)
 	{
 		delete g_ShaderManager;
@@ -183,4 +568,215 @@ bool InitializeGLEW()
 	std::cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << "\n" << std::endl;
 
 	return(true);
-}
\ No newline at end of file
+}
+
+/***********************************************************
+ *	LoadSpirvProgram()
+ *
+ *  This function is used to load the scene shaders from the
+ *  SPIR-V modules the build compiled, so the driver parses no
+ *  GLSL.  The modules are skipped when the driver cannot take
+ *  SPIR-V or they are older than the GLSL, as after an edit.
+ *  Some drivers do not keep the uniform names of a SPIR-V
+ *  program, which the uniform handles are found by, and the
+ *  program is not used on those.  Returns 0 when the GLSL
+ *  files should be loaded instead.
+ ***********************************************************/
+GLuint LoadSpirvProgram()
+{
+	if (ProgramCache::IsSpirvSupported() == false)
+	{
+		std::cout << "INFO: SPIR-V shaders are not supported, loading the GLSL shaders" << std::endl;
+		return(0);
+	}
+	if ((ProgramCache::IsBuildCurrent(VERTEX_SPIRV_FILE, VERTEX_SHADER_FILE) == false) ||
+		(ProgramCache::IsBuildCurrent(FRAGMENT_SPIRV_FILE, FRAGMENT_SHADER_FILE) == false))
+	{
+		std::cout << "INFO: SPIR-V shaders are missing or older than the GLSL, loading the GLSL shaders" << std::endl;
+		return(0);
+	}
+
+	GLuint program = g_ProgramCache->LoadSpirvProgram(
+		VERTEX_SPIRV_FILE,
+		FRAGMENT_SPIRV_FILE);
+	if ((program != 0) && (glGetUniformLocation(program, "model") < 0))
+	{
+		std::cout << "INFO: SPIR-V shader program has no uniform names, loading the GLSL shaders" << std::endl;
+		glDeleteProgram(program);
+		program = 0;
+	}
+
+	return(program);
+}
+
+/***********************************************************
+ *	LoadShaderProgram()
+ *
+ *  This function is used to load the scene shaders at startup
+ *  and print how long that took.  The SPIR-V modules are
+ *  tried first, then the GLSL files.  A binary from the
+ *  program cache skips compiling and linking, and the time
+ *  that saves is reported against the build from source that
+ *  wrote it.
+ ***********************************************************/
+bool LoadShaderProgram(bool bSpirv)
+{
+	GLuint program = 0;
+	const char* programSource = "GLSL";
+
+	if (bSpirv == true)
+	{
+		program = LoadSpirvProgram();
+		programSource = "SPIR-V";
+	}
+	if (program == 0)
+	{
+		program = g_ProgramCache->LoadProgram(
+			VERTEX_SHADER_FILE,
+			FRAGMENT_SHADER_FILE);
+		programSource = "GLSL";
+	}
+	if (program == 0)
+	{
+		// let the shader manager build and report the program
+		g_ShaderManager->LoadShaders(
+			VERTEX_SHADER_FILE,
+			FRAGMENT_SHADER_FILE);
+		g_ShaderManager->use();
+		return(false);
+	}
+
+	g_ShaderManager->m_programID = program;
+	g_ShaderManager->use();
+
+	const double loadMilliseconds = g_ProgramCache->GetLastLoadMilliseconds();
+	if (g_ProgramCache->WasLastLoadCached() == true)
+	{
+		const double sourceMilliseconds = g_ProgramCache->GetLastSourceMilliseconds();
+		std::cout << "INFO: " << programSource << " shader program loaded from the program cache in " << loadMilliseconds
+			<< " ms, " << sourceMilliseconds - loadMilliseconds << " ms faster than building it from source ("
+			<< sourceMilliseconds << " ms)" << std::endl;
+	}
+	else
+	{
+		std::cout << "INFO: " << programSource << " shader program built from source in " << loadMilliseconds << " ms";
+		if (ProgramCache::IsSupported() == false)
+		{
+			std::cout << ", program binaries are not supported";
+		}
+		std::cout << std::endl;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *	PrintStateStats()
+ *
+ *  This function is used to print how many uniform sets and
+ *  OpenGL state changes reached the driver each frame, and
+ *  how many were dropped because they changed nothing.
+ ***********************************************************/
+void PrintStateStats()
+{
+	const long long frameCount = g_StateCache->GetFrameCount();
+	if (frameCount == 0)
+	{
+		return;
+	}
+
+	const ShaderUniforms::CALL_STATS lastUniforms = g_ShaderUniforms->GetFrameStats();
+	const ShaderUniforms::CALL_STATS totalUniforms = g_ShaderUniforms->GetTotalStats();
+	const GLStateCache::CALL_STATS lastState = g_StateCache->GetFrameStats();
+	const GLStateCache::CALL_STATS totalState = g_StateCache->GetTotalStats();
+
+	std::cout << "INFO: uniform sets per frame: " << (double)totalUniforms.issued / frameCount << " issued, "
+		<< (double)totalUniforms.elided / frameCount << " elided (last frame " << lastUniforms.issued
+		<< " issued, " << lastUniforms.elided << " elided)" << std::endl;
+	std::cout << "INFO: state changes per frame: " << (double)totalState.issued / frameCount << " issued, "
+		<< (double)totalState.elided / frameCount << " elided (last frame " << lastState.issued
+		<< " issued, " << lastState.elided << " elided)" << std::endl;
+}
+
+/***********************************************************
+ *	ReloadChangedFiles()
+ *
+ *  This function is used to hand the texture and shader files
+ *  edited since the last frame to the scene.  Textures are
+ *  decoded again on the worker threads and swapped in at the
+ *  start of a later frame, while shaders are compiled here,
+ *  between frames.
+ ***********************************************************/
+void ReloadChangedFiles()
+{
+	std::vector<std::string> changedFiles;
+
+	if (NULL == g_FileWatcher)
+	{
+		return;
+	}
+
+	g_FileWatcher->Poll(changedFiles);
+
+	bool bShadersChanged = false;
+	for (size_t i = 0; i < changedFiles.size(); i++)
+	{
+		if ((changedFiles[i] == VERTEX_SHADER_FILE) || (changedFiles[i] == FRAGMENT_SHADER_FILE))
+		{
+			bShadersChanged = true;
+		}
+		else
+		{
+			g_SceneManager->ReloadTextureFile(changedFiles[i]);
+		}
+	}
+
+	// both shaders are linked into one program, so an edit to
+	// either of them reloads the pair once
+	if (bShadersChanged == true)
+	{
+		ReloadShaders();
+	}
+}
+
+/***********************************************************
+ *	ReloadShaders()
+ *
+ *  This function is used to load the edited shaders into a
+ *  new program.  The new program is built before the current
+ *  one is touched, so a shader that does not compile leaves
+ *  the scene drawing with the program it already has.
+ ***********************************************************/
+bool ReloadShaders()
+{
+	GLint previousProgram = 0;
+
+	GLuint program = g_ProgramCache->LoadProgram(
+		VERTEX_SHADER_FILE,
+		FRAGMENT_SHADER_FILE);
+	if (program == 0)
+	{
+		std::cout << "Shaders not reloaded, keeping the current program" << std::endl;
+		return(false);
+	}
+
+	// swap in the new program and free the one it replaces - the
+	// program in use may be a shader variant, which the scene
+	// frees itself
+	previousProgram = (GLint)g_ShaderManager->m_programID;
+	g_ShaderManager->m_programID = program;
+	g_ShaderManager->use();
+	if ((previousProgram != 0) && ((GLuint)previousProgram != program))
+	{
+		g_ShaderUniforms->Forget((GLuint)previousProgram);
+		glDeleteProgram(previousProgram);
+	}
+
+	// the new program has its own uniform locations, and starts
+	// with default uniform values and unbound uniform blocks
+	g_ShaderUniforms->Reflect(program);
+	g_SceneManager->ApplyShaderSettings();
+
+	std::cout << "Reloaded shaders" << std::endl;
+	return(true);
+}
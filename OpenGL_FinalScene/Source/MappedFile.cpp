@@ -0,0 +1,144 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.cpp
+// ============
+// map a whole file read-only into memory
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/***********************************************************
+ *  MappedFile()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MappedFile::MappedFile()
+{
+	m_pData = NULL;
+	m_size = 0;
+#ifdef _WIN32
+	m_file = INVALID_HANDLE_VALUE;
+	m_fileMapping = NULL;
+#endif
+}
+
+/***********************************************************
+ *  ~MappedFile()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a whole file read-only
+ *  into memory.  Returns false when the file is missing,
+ *  empty, or cannot be mapped.
+ ***********************************************************/
+bool MappedFile::Open(const char* path)
+{
+	Close();
+
+#ifdef _WIN32
+	m_file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+	{
+		return(false);
+	}
+
+	LARGE_INTEGER fileSize;
+	if ((GetFileSizeEx(m_file, &fileSize) == FALSE) || (fileSize.QuadPart == 0))
+	{
+		Close();
+		return(false);
+	}
+
+	m_fileMapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (NULL == m_fileMapping)
+	{
+		Close();
+		return(false);
+	}
+
+	m_pData = (const unsigned char*)MapViewOfFile(m_fileMapping, FILE_MAP_READ, 0, 0, 0);
+	m_size = (size_t)fileSize.QuadPart;
+#else
+	int file = open(path, O_RDONLY);
+	if (file < 0)
+	{
+		return(false);
+	}
+
+	struct stat fileStatus;
+	if ((fstat(file, &fileStatus) != 0) || (fileStatus.st_size == 0))
+	{
+		close(file);
+		return(false);
+	}
+
+	// the mapping stays valid after the file is closed
+	void* pMapped = mmap(NULL, (size_t)fileStatus.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (pMapped != MAP_FAILED)
+	{
+		m_pData = (const unsigned char*)pMapped;
+		m_size = (size_t)fileStatus.st_size;
+	}
+#endif
+
+	if (NULL == m_pData)
+	{
+		Close();
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the file.  Pointers into
+ *  the mapping must no longer be in use.
+ ***********************************************************/
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (NULL != m_pData)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+	if (NULL != m_fileMapping)
+	{
+		CloseHandle(m_fileMapping);
+		m_fileMapping = NULL;
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (NULL != m_pData)
+	{
+		munmap((void*)m_pData, m_size);
+	}
+#endif
+
+	m_pData = NULL;
+	m_size = 0;
+}
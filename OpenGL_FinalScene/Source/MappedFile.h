@@ -0,0 +1,50 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedfile.h
+// ============
+// map a whole file read-only into memory
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+
+/***********************************************************
+ *  MappedFile
+ *
+ *  This class maps a file read-only into the address space of
+ *  the process.  Pages are only read from disk when they are
+ *  first touched, and are shared with the file system cache.
+ ***********************************************************/
+class MappedFile
+{
+public:
+	// constructor
+	MappedFile();
+	// destructor
+	~MappedFile();
+
+	// map a file into memory, false when it is missing or empty
+	bool Open(const char* path);
+	// unmap the file
+	void Close();
+	// true while a file is mapped
+	bool IsOpen() const { return(NULL != m_pData); }
+	// start of the mapping
+	const unsigned char* GetData() const { return(m_pData); }
+	// bytes of the file that are mapped
+	size_t GetSize() const { return(m_size); }
+
+private:
+	// start of the mapping and its size
+	const unsigned char* m_pData;
+	size_t m_size;
+#ifdef _WIN32
+	// file and file mapping handles
+	void* m_file;
+	void* m_fileMapping;
+#endif
+
+	// the mapping is owned, so it is never copied
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
@@ -0,0 +1,282 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedringbuffer.cpp
+// ============
+// persistently mapped OpenGL buffer handed out as a fenced ring
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MappedRingBuffer.h"
+
+#include <chrono>
+
+// declaration of global variables
+namespace
+{
+	// nanoseconds a single fence wait may block before retrying
+	const GLuint64 FENCE_WAIT_TIMEOUT = 1000000000;
+}
+
+/***********************************************************
+ *  MappedRingBuffer()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MappedRingBuffer::MappedRingBuffer()
+{
+	m_buffer = 0;
+	m_target = GL_PIXEL_UNPACK_BUFFER;
+	m_size = 0;
+	m_pMapped = NULL;
+	m_head = 0;
+	m_pendingBegin = 0;
+	ResetStats();
+}
+
+/***********************************************************
+ *  ~MappedRingBuffer()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MappedRingBuffer::~MappedRingBuffer()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking that the driver supports
+ *  persistently mapped buffers.
+ ***********************************************************/
+bool MappedRingBuffer::IsSupported()
+{
+	return(GLEW_ARB_buffer_storage ? true : false);
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating the buffer with immutable
+ *  storage and mapping it for writing.  The mapping is
+ *  coherent, so written data needs no explicit flush.
+ ***********************************************************/
+bool MappedRingBuffer::Create(GLenum target, size_t size)
+{
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	Destroy();
+
+	if (IsSupported() == false)
+	{
+		return(false);
+	}
+
+	m_target = target;
+	m_size = size;
+
+	glGenBuffers(1, &m_buffer);
+	glBindBuffer(m_target, m_buffer);
+	glBufferStorage(m_target, (GLsizeiptr)m_size, NULL, flags);
+	m_pMapped = (unsigned char*)glMapBufferRange(m_target, 0, (GLsizeiptr)m_size, flags);
+	glBindBuffer(m_target, 0);
+
+	if (NULL == m_pMapped)
+	{
+		Destroy();
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for unmapping and freeing the buffer
+ *  along with any fences still waiting.
+ ***********************************************************/
+void MappedRingBuffer::Destroy()
+{
+	while (m_fencedRanges.size() > 0)
+	{
+		GLsync fence = m_fencedRanges.front().fence;
+		m_fencedRanges.pop_front();
+		if ((m_fencedRanges.size() == 0) || (m_fencedRanges.front().fence != fence))
+		{
+			glDeleteSync(fence);
+		}
+	}
+	m_pendingRanges.clear();
+
+	if (m_buffer != 0)
+	{
+		if (NULL != m_pMapped)
+		{
+			glBindBuffer(m_target, m_buffer);
+			glUnmapBuffer(m_target);
+			glBindBuffer(m_target, 0);
+		}
+		glDeleteBuffers(1, &m_buffer);
+	}
+
+	m_buffer = 0;
+	m_size = 0;
+	m_pMapped = NULL;
+	m_head = 0;
+	m_pendingBegin = 0;
+}
+
+/***********************************************************
+ *  ClosePendingRange()
+ *
+ *  This method is used for closing off the bytes allocated
+ *  since the last fence, when the ring wraps or is fenced.
+ ***********************************************************/
+void MappedRingBuffer::ClosePendingRange()
+{
+	if (m_head > m_pendingBegin)
+	{
+		FENCED_RANGE range;
+		range.fence = 0;
+		range.begin = m_pendingBegin;
+		range.end = m_head;
+		m_pendingRanges.push_back(range);
+	}
+	m_pendingBegin = m_head;
+}
+
+/***********************************************************
+ *  WaitForRange()
+ *
+ *  This method is used for making sure the GPU has finished
+ *  reading every earlier use of a range.  Fences signal in
+ *  order, so waiting on the newest fence that covers the range
+ *  also retires every older fence.
+ ***********************************************************/
+void MappedRingBuffer::WaitForRange(size_t begin, size_t end)
+{
+	// bytes from this frame have no fence yet - fence them now,
+	// since the commands reading them were already issued
+	for (size_t i = 0; i < m_pendingRanges.size(); i++)
+	{
+		if ((m_pendingRanges[i].begin < end) && (begin < m_pendingRanges[i].end))
+		{
+			Fence();
+			break;
+		}
+	}
+
+	int newest = -1;
+	for (int i = 0; i < (int)m_fencedRanges.size(); i++)
+	{
+		if ((m_fencedRanges[i].begin < end) && (begin < m_fencedRanges[i].end))
+		{
+			newest = i;
+		}
+	}
+	if (newest < 0)
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	bool bWaited = false;
+	GLenum result = GL_TIMEOUT_EXPIRED;
+	while (result == GL_TIMEOUT_EXPIRED)
+	{
+		result = glClientWaitSync(m_fencedRanges[newest].fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_TIMEOUT);
+		if (result != GL_ALREADY_SIGNALED)
+		{
+			bWaited = true;
+		}
+	}
+	if (bWaited == true)
+	{
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		m_stats.waits++;
+		m_stats.waitMilliseconds += elapsed.count();
+	}
+
+	for (int i = 0; i <= newest; i++)
+	{
+		GLsync fence = m_fencedRanges.front().fence;
+		m_fencedRanges.pop_front();
+		if ((m_fencedRanges.size() == 0) || (m_fencedRanges.front().fence != fence))
+		{
+			glDeleteSync(fence);
+		}
+	}
+}
+
+/***********************************************************
+ *  Allocate()
+ *
+ *  This method is used for reserving bytes of the buffer for
+ *  writing.  The returned pointer is into the mapping, and the
+ *  offset is where the bytes sit within the buffer.  Returns
+ *  NULL when the request is larger than the whole buffer.
+ ***********************************************************/
+unsigned char* MappedRingBuffer::Allocate(size_t bytes, size_t alignment, size_t& offset)
+{
+	if ((NULL == m_pMapped) || (bytes == 0) || (bytes > m_size))
+	{
+		return(NULL);
+	}
+
+	size_t start = (m_head + alignment - 1) / alignment * alignment;
+	if (start + bytes > m_size)
+	{
+		// wrap around to the start of the buffer
+		ClosePendingRange();
+		m_head = 0;
+		m_pendingBegin = 0;
+		start = 0;
+	}
+
+	WaitForRange(start, start + bytes);
+
+	m_head = start + bytes;
+	offset = start;
+
+	m_stats.allocations++;
+	m_stats.allocatedBytes += bytes;
+
+	return(m_pMapped + start);
+}
+
+/***********************************************************
+ *  Fence()
+ *
+ *  This method is used for fencing every range allocated
+ *  since the last fence.  It is called once the commands that
+ *  read those ranges have been issued, normally once a frame.
+ ***********************************************************/
+void MappedRingBuffer::Fence()
+{
+	ClosePendingRange();
+	if (m_pendingRanges.size() == 0)
+	{
+		return;
+	}
+
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	for (size_t i = 0; i < m_pendingRanges.size(); i++)
+	{
+		m_pendingRanges[i].fence = fence;
+		m_fencedRanges.push_back(m_pendingRanges[i]);
+	}
+	m_pendingRanges.clear();
+}
+
+/***********************************************************
+ *  ResetStats()
+ *
+ *  This method is used for zeroing the statistics, normally
+ *  at the start of a frame.
+ ***********************************************************/
+void MappedRingBuffer::ResetStats()
+{
+	m_stats.allocations = 0;
+	m_stats.allocatedBytes = 0;
+	m_stats.waits = 0;
+	m_stats.waitMilliseconds = 0.0;
+}
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////
+// mappedringbuffer.h
+// ============
+// persistently mapped OpenGL buffer handed out as a fenced ring
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+/***********************************************************
+ *  MappedRingBuffer
+ *
+ *  This class keeps an OpenGL buffer mapped for writing for
+ *  its whole lifetime (ARB_buffer_storage) and hands out
+ *  ranges of it in ring order.  Data is written straight into
+ *  the mapping, so the driver never has to copy it out of
+ *  application memory.  The commands that read a range must
+ *  be issued before the next range is allocated; Fence() is
+ *  then called once a frame, and a range is only handed out
+ *  again after the GPU has passed the fence covering its
+ *  previous use.
+ ***********************************************************/
+class MappedRingBuffer
+{
+public:
+	// constructor
+	MappedRingBuffer();
+	// destructor
+	~MappedRingBuffer();
+
+	struct RING_STATS
+	{
+		// ranges handed out and their total bytes
+		int allocations;
+		size_t allocatedBytes;
+		// times an allocation waited on the GPU, and for how long
+		int waits;
+		double waitMilliseconds;
+	};
+
+	// true when the driver supports persistently mapped buffers
+	static bool IsSupported();
+
+	// create and map the buffer
+	bool Create(GLenum target, size_t size);
+	// unmap and free the buffer
+	void Destroy();
+	// reserve bytes for writing, NULL when they can never fit
+	unsigned char* Allocate(size_t bytes, size_t alignment, size_t& offset);
+	// fence the ranges allocated since the last fence
+	void Fence();
+
+	// the OpenGL buffer and its binding target
+	GLuint GetBuffer() const { return(m_buffer); }
+	GLenum GetTarget() const { return(m_target); }
+
+	// statistics since the last reset
+	RING_STATS GetStats() const { return(m_stats); }
+	void ResetStats();
+
+private:
+	struct FENCED_RANGE
+	{
+		GLsync fence;
+		size_t begin;
+		size_t end;
+	};
+
+	// OpenGL buffer, its target, size and mapping
+	GLuint m_buffer;
+	GLenum m_target;
+	size_t m_size;
+	unsigned char* m_pMapped;
+	// next free byte, and the start of the unfenced bytes
+	size_t m_head;
+	size_t m_pendingBegin;
+	// unfenced ranges closed off when the ring wrapped
+	std::vector<FENCED_RANGE> m_pendingRanges;
+	// fenced ranges, oldest first
+	std::deque<FENCED_RANGE> m_fencedRanges;
+	// statistics since the last reset
+	RING_STATS m_stats;
+
+	// close off the unfenced bytes up to the head
+	void ClosePendingRange();
+	// wait for the GPU to be done with a range before reuse
+	void WaitForRange(size_t begin, size_t end);
+};
@@ -0,0 +1,365 @@
+///////////////////////////////////////////////////////////////////////////////
+// materiallibrary.cpp
+// ============
+// compile and map the data-driven library of object materials
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MaterialLibrary.h"
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// declaration of the compiled library layout
+namespace
+{
+	const uint32_t LIBRARY_MAGIC = 0x424C544D; // "MTLB"
+	// bump when the layout of the header or the records changes
+	const uint32_t LIBRARY_VERSION = 1;
+
+	struct LIBRARY_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t materialCount;
+		uint32_t recordSize;
+		uint32_t nameSize;
+		uint32_t reserved;
+		// hash of the text source, to find a stale library
+		uint64_t sourceHash;
+	};
+
+	static_assert(sizeof(MaterialLibrary::MATERIAL_RECORD) == 32, "std140 Material is 32 bytes");
+	static_assert(sizeof(LIBRARY_HEADER) % 16 == 0, "records start on 16 bytes");
+
+	// order material names by hash for the binary search
+	bool CompareNames(const MaterialLibrary::MATERIAL_NAME& first, const MaterialLibrary::MATERIAL_NAME& second)
+	{
+		return(first.tagHash < second.tagHash);
+	}
+}
+
+/***********************************************************
+ *  MaterialLibrary()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+MaterialLibrary::MaterialLibrary()
+{
+	m_materialCount = 0;
+	m_pMaterials = NULL;
+	m_pNames = NULL;
+	m_sourceHash = 0;
+}
+
+/***********************************************************
+ *  ~MaterialLibrary()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+MaterialLibrary::~MaterialLibrary()
+{
+	Close();
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for mapping the compiled library.  The
+ *  source is only hashed, not parsed, to check that the
+ *  library is current - when it is missing or stale, as while
+ *  editing without a build, the source is compiled first.
+ *  Without a valid source, the compiled library is used as
+ *  it is.
+ ***********************************************************/
+bool MaterialLibrary::Load(const char* sourcePath, const char* binaryPath)
+{
+	uint64_t sourceHash = 0;
+	const bool bSource = TextureCache::HashFile(sourcePath, sourceHash);
+
+	if ((Open(binaryPath) == true) && ((bSource == false) || (m_sourceHash == sourceHash)))
+	{
+		return(true);
+	}
+	if (bSource == false)
+	{
+		return(false);
+	}
+
+	// the mapping is closed first, since Windows does not
+	// replace a mapped file
+	Close();
+	std::cout << "Compiling material library:" << sourcePath << std::endl;
+
+	// an invalid source leaves the last compiled library in
+	// place, which is still better than no materials
+	Compile(sourcePath, binaryPath);
+
+	return(Open(binaryPath));
+}
+
+/***********************************************************
+ *  Open()
+ *
+ *  This method is used for mapping a compiled library and
+ *  checking its layout.  Returns false when the file is
+ *  missing or is not a library of this version.
+ ***********************************************************/
+bool MaterialLibrary::Open(const char* binaryPath)
+{
+	Close();
+
+	if (m_mappedFile.Open(binaryPath) == false)
+	{
+		return(false);
+	}
+
+	const unsigned char* pMapped = m_mappedFile.GetData();
+	const size_t mappedBytes = m_mappedFile.GetSize();
+
+	// check the header and that the tables fill the file
+	const LIBRARY_HEADER* pHeader = (const LIBRARY_HEADER*)pMapped;
+	if ((mappedBytes < sizeof(LIBRARY_HEADER)) ||
+		(pHeader->magic != LIBRARY_MAGIC) ||
+		(pHeader->version != LIBRARY_VERSION) ||
+		(pHeader->recordSize != sizeof(MATERIAL_RECORD)) ||
+		(pHeader->nameSize != sizeof(MATERIAL_NAME)) ||
+		(sizeof(LIBRARY_HEADER) + (uint64_t)pHeader->materialCount * (sizeof(MATERIAL_RECORD) + sizeof(MATERIAL_NAME)) != mappedBytes))
+	{
+		std::cout << "Not a valid material library:" << binaryPath << std::endl;
+		Close();
+		return(false);
+	}
+
+	const int materialCount = (int)pHeader->materialCount;
+	const MATERIAL_NAME* pNames = (const MATERIAL_NAME*)(pMapped + sizeof(LIBRARY_HEADER) + materialCount * sizeof(MATERIAL_RECORD));
+
+	// the binary search needs strictly increasing hashes
+	for (int i = 0; i < materialCount; i++)
+	{
+		if ((pNames[i].materialIndex >= (uint32_t)materialCount) ||
+			(pNames[i].tag[MAX_TAG_LENGTH - 1] != 0) ||
+			((i > 0) && (pNames[i].tagHash <= pNames[i - 1].tagHash)))
+		{
+			std::cout << "Not a valid material library:" << binaryPath << std::endl;
+			Close();
+			return(false);
+		}
+	}
+
+	m_materialCount = materialCount;
+	m_pMaterials = (const MATERIAL_RECORD*)(pMapped + sizeof(LIBRARY_HEADER));
+	m_pNames = pNames;
+	m_sourceHash = pHeader->sourceHash;
+
+	return(true);
+}
+
+/***********************************************************
+ *  Close()
+ *
+ *  This method is used for unmapping the compiled library.
+ ***********************************************************/
+void MaterialLibrary::Close()
+{
+	m_mappedFile.Close();
+
+	m_materialCount = 0;
+	m_pMaterials = NULL;
+	m_pNames = NULL;
+	m_sourceHash = 0;
+}
+
+/***********************************************************
+ *  FindMaterial()
+ *
+ *  This method is used for getting the index of a material by
+ *  a binary search of the tag hashes, or -1.
+ ***********************************************************/
+int MaterialLibrary::FindMaterial(ResourceTag tag) const
+{
+	const uint32_t tagHash = tag.GetHash();
+	int first = 0;
+	int last = m_materialCount - 1;
+
+	while (first <= last)
+	{
+		const int middle = first + (last - first) / 2;
+		if (m_pNames[middle].tagHash == tagHash)
+		{
+			return((int)m_pNames[middle].materialIndex);
+		}
+		if (m_pNames[middle].tagHash < tagHash)
+		{
+			first = middle + 1;
+		}
+		else
+		{
+			last = middle - 1;
+		}
+	}
+
+	return(-1);
+}
+
+/***********************************************************
+ *  Compile()
+ *
+ *  This method is used for parsing a library source and
+ *  writing its compiled form.  Each line of the source holds
+ *  a tag, the diffuse and specular colors, and the shininess,
+ *  and # starts a comment.  Every error is reported with its
+ *  line in the compiler format, and nothing is written unless
+ *  the whole source is valid.  The library is written to a
+ *  temporary file first and then renamed into place.
+ ***********************************************************/
+bool MaterialLibrary::Compile(const char* sourcePath, const char* binaryPath)
+{
+	std::ifstream source(sourcePath);
+	uint64_t sourceHash = 0;
+	if ((!source) || (TextureCache::HashFile(sourcePath, sourceHash) == false))
+	{
+		std::cout << sourcePath << ": error: could not read the material library" << std::endl;
+		return(false);
+	}
+
+	std::vector<MATERIAL_RECORD> records;
+	std::vector<MATERIAL_NAME> names;
+	std::vector<int> lineNumbers;
+	std::string line;
+	int lineNumber = 0;
+	int errorCount = 0;
+
+	while (std::getline(source, line))
+	{
+		lineNumber++;
+
+		const size_t comment = line.find('#');
+		if (comment != std::string::npos)
+		{
+			line.erase(comment);
+		}
+
+		std::istringstream fields(line);
+		std::string tag;
+		if (!(fields >> tag))
+		{
+			continue;
+		}
+
+		MATERIAL_RECORD record;
+		std::string extra;
+		record.padding = 0.0f;
+		if ((!(fields >> record.diffuseColor.r >> record.diffuseColor.g >> record.diffuseColor.b)) ||
+			(!(fields >> record.specularColor.r >> record.specularColor.g >> record.specularColor.b)) ||
+			(!(fields >> record.shininess)) ||
+			(fields >> extra))
+		{
+			std::cout << sourcePath << "(" << lineNumber << "): error: expected a tag, 3 diffuse, 3 specular and 1 shininess values" << std::endl;
+			errorCount++;
+			continue;
+		}
+		if (tag.size() >= MAX_TAG_LENGTH)
+		{
+			std::cout << sourcePath << "(" << lineNumber << "): error: tag " << tag << " is longer than " << (MAX_TAG_LENGTH - 1) << " characters" << std::endl;
+			errorCount++;
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			if ((record.diffuseColor[i] < 0.0f) || (record.diffuseColor[i] > 1.0f) ||
+				(record.specularColor[i] < 0.0f) || (record.specularColor[i] > 1.0f))
+			{
+				std::cout << sourcePath << "(" << lineNumber << "): error: colors of " << tag << " must be between 0 and 1" << std::endl;
+				errorCount++;
+				break;
+			}
+		}
+		if (!(record.shininess >= 0.0f))
+		{
+			std::cout << sourcePath << "(" << lineNumber << "): error: shininess of " << tag << " must not be negative" << std::endl;
+			errorCount++;
+		}
+
+		MATERIAL_NAME name;
+		memset(&name, 0, sizeof(name));
+		name.tagHash = ResourceTag(tag).GetHash();
+		name.materialIndex = (uint32_t)records.size();
+		memcpy(name.tag, tag.c_str(), std::min(tag.size(), (size_t)MAX_TAG_LENGTH - 1));
+
+		records.push_back(record);
+		names.push_back(name);
+		lineNumbers.push_back(lineNumber);
+	}
+
+	// tags are looked up by hash, so a repeated hash is an
+	// error whether or not the tags themselves are the same
+	std::stable_sort(names.begin(), names.end(), CompareNames);
+	for (size_t i = 1; i < names.size(); i++)
+	{
+		if (names[i].tagHash == names[i - 1].tagHash)
+		{
+			const int secondLine = lineNumbers[names[i].materialIndex];
+			const int firstLine = lineNumbers[names[i - 1].materialIndex];
+			if (strcmp(names[i].tag, names[i - 1].tag) == 0)
+			{
+				std::cout << sourcePath << "(" << secondLine << "): error: material " << names[i].tag << " is already defined on line " << firstLine << std::endl;
+			}
+			else
+			{
+				std::cout << sourcePath << "(" << secondLine << "): error: tag " << names[i].tag << " has the same hash as " << names[i - 1].tag << " on line " << firstLine << std::endl;
+			}
+			errorCount++;
+		}
+	}
+
+	if (errorCount > 0)
+	{
+		std::cout << sourcePath << ": " << errorCount << " error(s), the material library was not written" << std::endl;
+		return(false);
+	}
+
+	LIBRARY_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = LIBRARY_MAGIC;
+	header.version = LIBRARY_VERSION;
+	header.materialCount = (uint32_t)records.size();
+	header.recordSize = sizeof(MATERIAL_RECORD);
+	header.nameSize = sizeof(MATERIAL_NAME);
+	header.sourceHash = sourceHash;
+
+	std::string temporaryPath = std::string(binaryPath) + ".tmp";
+	std::ofstream file(temporaryPath.c_str(), std::ios::binary);
+	if (!file)
+	{
+		std::cout << binaryPath << ": error: could not write the material library" << std::endl;
+		return(false);
+	}
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)records.data(), (std::streamsize)(records.size() * sizeof(MATERIAL_RECORD)));
+	file.write((const char*)names.data(), (std::streamsize)(names.size() * sizeof(MATERIAL_NAME)));
+	file.close();
+	bool bReturn = !file.fail();
+
+	if (bReturn == true)
+	{
+		// rename does not replace an existing file on Windows
+		remove(binaryPath);
+		bReturn = (rename(temporaryPath.c_str(), binaryPath) == 0);
+	}
+	if (bReturn == false)
+	{
+		std::cout << binaryPath << ": error: could not write the material library" << std::endl;
+		remove(temporaryPath.c_str());
+		return(false);
+	}
+
+	std::cout << "Compiled " << records.size() << " materials:" << binaryPath << std::endl;
+	return(true);
+}
@@ -0,0 +1,88 @@
+///////////////////////////////////////////////////////////////////////////////
+// materiallibrary.h
+// ============
+// compile and map the data-driven library of object materials
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedFile.h"
+#include "ResourceTag.h"
+
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+/***********************************************************
+ *  MaterialLibrary
+ *
+ *  This class loads the object materials from a compiled
+ *  library file.  The library is written as readable text,
+ *  one material per line, and compiled into a binary form
+ *  that holds the materials in the std140 layout of the
+ *  shader material block, followed by a table of their tags
+ *  sorted by hash.  The binary is mapped into memory, so
+ *  loading it allocates nothing per material and the records
+ *  can be uploaded to the material buffer as they are.
+ ***********************************************************/
+class MaterialLibrary
+{
+public:
+	// constructor
+	MaterialLibrary();
+	// destructor
+	~MaterialLibrary();
+
+	// longest tag stored in the library, with its terminator
+	static const int MAX_TAG_LENGTH = 56;
+
+	// one material laid out by the std140 rules - each vec3
+	// starts on 16 bytes and the float packs in after the second
+	struct MATERIAL_RECORD
+	{
+		glm::vec3 diffuseColor;
+		float padding;
+		glm::vec3 specularColor;
+		float shininess;
+	};
+
+	// tag of a material and the index of its record
+	struct MATERIAL_NAME
+	{
+		uint32_t tagHash;
+		uint32_t materialIndex;
+		char tag[MAX_TAG_LENGTH];
+	};
+
+	// map the compiled library, compiling it first when it is
+	// missing or older than its text source
+	bool Load(const char* sourcePath, const char* binaryPath);
+	// map a compiled library file and check its layout
+	bool Open(const char* binaryPath);
+	// unmap the compiled library
+	void Close();
+	// true while a compiled library is mapped
+	bool IsOpen() const { return(m_mappedFile.IsOpen()); }
+
+	// number of materials in the library
+	int GetMaterialCount() const { return(m_materialCount); }
+	// material records in the mapping, in library order
+	const MATERIAL_RECORD* GetMaterials() const { return(m_pMaterials); }
+	// index of a material by tag, or -1
+	int FindMaterial(ResourceTag tag) const;
+
+	// parse and validate a library source and write its
+	// compiled form, reporting every error with its line
+	static bool Compile(const char* sourcePath, const char* binaryPath);
+
+private:
+	// the mapped compiled library
+	MappedFile m_mappedFile;
+	// number of materials and their records in the mapping
+	int m_materialCount;
+	const MATERIAL_RECORD* m_pMaterials;
+	// material tags in the mapping, sorted by hash
+	const MATERIAL_NAME* m_pNames;
+	// hash of the source the library was compiled from
+	uint64_t m_sourceHash;
+};
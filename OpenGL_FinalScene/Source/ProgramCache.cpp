@@ -0,0 +1,695 @@
+///////////////////////////////////////////////////////////////////////////////
+// programcache.cpp
+// ============
+// on-disk cache of linked shader program binaries
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ProgramCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+// declaration of the cache file layout
+namespace
+{
+	const uint32_t PROGRAM_CACHE_MAGIC = 0x42475250; // "PRGB"
+	const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+	// written before the binary in each cache entry
+	struct PROGRAM_HEADER
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t programKey;
+		uint32_t binaryFormat;
+		uint32_t binaryLength;
+		// time building the program from source took
+		double sourceMilliseconds;
+	};
+
+	// fold bytes into a 64-bit FNV-1a hash
+	void HashBytes(uint64_t& hash, const void* pData, size_t bytes)
+	{
+		const unsigned char* pBytes = (const unsigned char*)pData;
+		for (size_t i = 0; i < bytes; i++)
+		{
+			hash ^= pBytes[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	// fold a string and its terminator into the hash, so the
+	// boundary between two strings is part of the key
+	void HashString(uint64_t& hash, const char* pString)
+	{
+		if (NULL == pString)
+		{
+			pString = "";
+		}
+		HashBytes(hash, pString, strlen(pString) + 1);
+	}
+}
+
+/***********************************************************
+ *  ProgramCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ProgramCache::ProgramCache(const char* directory)
+{
+	m_directory = directory;
+	m_bReadEnabled = true;
+	m_bLastLoadCached = false;
+	m_lastLoadMilliseconds = 0.0;
+	m_lastSourceMilliseconds = 0.0;
+}
+
+/***********************************************************
+ *  ~ProgramCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ProgramCache::~ProgramCache()
+{
+}
+
+/***********************************************************
+ *  SetReadEnabled()
+ *
+ *  This method is used for turning the reading of cached
+ *  binaries on or off.  Built programs are still written to
+ *  the cache when reading is off.
+ ***********************************************************/
+void ProgramCache::SetReadEnabled(bool bReadEnabled)
+{
+	m_bReadEnabled = bReadEnabled;
+}
+
+/***********************************************************
+ *  IsSupported()
+ *
+ *  This method is used for checking that the driver can
+ *  return program binaries - some report the extension with
+ *  no binary formats at all.
+ ***********************************************************/
+bool ProgramCache::IsSupported()
+{
+	GLint formatCount = 0;
+
+	if (!GLEW_ARB_get_program_binary)
+	{
+		return(false);
+	}
+
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	return(formatCount > 0);
+}
+
+/***********************************************************
+ *  ProgramKey()
+ *
+ *  This method is used for hashing both shader sources with
+ *  the vendor, renderer and version strings of the driver,
+ *  since a binary is only valid for the driver that wrote it.
+ ***********************************************************/
+uint64_t ProgramCache::ProgramKey(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	uint64_t hash = 14695981039346656037ULL;
+
+	HashString(hash, vertexSource.c_str());
+	HashString(hash, fragmentSource.c_str());
+	HashString(hash, (const char*)glGetString(GL_VENDOR));
+	HashString(hash, (const char*)glGetString(GL_RENDERER));
+	HashString(hash, (const char*)glGetString(GL_VERSION));
+
+	return(hash);
+}
+
+/***********************************************************
+ *  ReadSourceFile()
+ *
+ *  This method is used for reading a whole shader source
+ *  file into a string.
+ ***********************************************************/
+bool ProgramCache::ReadSourceFile(const char* filename, std::string& source)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not read shader:" << filename << std::endl;
+		return(false);
+	}
+
+	std::stringstream sourceStream;
+	sourceStream << file.rdbuf();
+	source = sourceStream.str();
+
+	return(true);
+}
+
+/***********************************************************
+ *  InsertDefines()
+ *
+ *  This method is used for adding #define lines to a shader
+ *  source.  GLSL wants #version before anything else, so the
+ *  lines go right after it, and a #line directive keeps the
+ *  compile log line numbers matching the file.
+ ***********************************************************/
+void ProgramCache::InsertDefines(std::string& source, const std::string& defines)
+{
+	if (defines.empty() == true)
+	{
+		return;
+	}
+
+	size_t insertAt = 0;
+	if (source.compare(0, 8, "#version") == 0)
+	{
+		insertAt = source.find('\n');
+		insertAt = (insertAt == std::string::npos) ? source.size() : insertAt + 1;
+	}
+
+	const int nextLine = (insertAt > 0) ? 2 : 1;
+	std::ostringstream inserted;
+	inserted << defines << "#line " << nextLine << "\n";
+	source.insert(insertAt, inserted.str());
+}
+
+/***********************************************************
+ *  IssueBuild()
+ *
+ *  This method is used for handing the driver the compile of
+ *  both shaders and the link of the program, asking it to
+ *  keep the binary retrievable.  No status is read back, so
+ *  with parallel compilation on the calls return before the
+ *  driver has finished with them.
+ ***********************************************************/
+void ProgramCache::IssueBuild(PROGRAM_BUILD& build)
+{
+	const char* pVertexSource = build.vertexSource.c_str();
+	const char* pFragmentSource = build.fragmentSource.c_str();
+
+	build.vertexShader = glCreateShader(GL_VERTEX_SHADER);
+	glShaderSource(build.vertexShader, 1, &pVertexSource, NULL);
+	glCompileShader(build.vertexShader);
+
+	build.fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(build.fragmentShader, 1, &pFragmentSource, NULL);
+	glCompileShader(build.fragmentShader);
+
+	build.program = glCreateProgram();
+	if (IsSupported() == true)
+	{
+		glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glAttachShader(build.program, build.vertexShader);
+	glAttachShader(build.program, build.fragmentShader);
+	glLinkProgram(build.program);
+}
+
+/***********************************************************
+ *  IssueSpirvShader()
+ *
+ *  This method is used for handing the driver a SPIR-V
+ *  module and specializing it at its main entry point, which
+ *  takes the place of compiling a GLSL source.
+ ***********************************************************/
+void ProgramCache::IssueSpirvShader(const std::string& module, GLenum shaderType, GLuint& shader)
+{
+	shader = glCreateShader(shaderType);
+	glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB, module.data(), (GLsizei)module.size());
+	glSpecializeShaderARB(shader, "main", 0, NULL, NULL);
+}
+
+/***********************************************************
+ *  CheckShader()
+ *
+ *  This method is used for checking that a shader compiled
+ *  and printing the compile log when it did not.
+ ***********************************************************/
+bool ProgramCache::CheckShader(const std::string& filename, GLuint shader)
+{
+	GLint compileStatus = GL_FALSE;
+
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
+	if (compileStatus == GL_FALSE)
+	{
+		char infoLog[1024];
+		glGetShaderInfoLog(shader, sizeof(infoLog), NULL, infoLog);
+		std::cout << "Shader compile failed:" << filename << std::endl << infoLog << std::endl;
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  CheckBuild()
+ *
+ *  This method is used for checking the compile and link of
+ *  an issued build, waiting for the driver if it has not
+ *  finished, and releasing the shader objects the linked
+ *  program no longer needs.  The program is deleted and 0 is
+ *  left in the build when either step failed.
+ ***********************************************************/
+bool ProgramCache::CheckBuild(PROGRAM_BUILD& build)
+{
+	bool bCompiled = CheckShader(build.vertexShaderFile, build.vertexShader);
+	bCompiled = CheckShader(build.fragmentShaderFile, build.fragmentShader) && bCompiled;
+
+	GLint linkStatus = GL_FALSE;
+	if (bCompiled == true)
+	{
+		glGetProgramiv(build.program, GL_LINK_STATUS, &linkStatus);
+		if (linkStatus == GL_FALSE)
+		{
+			char infoLog[1024];
+			glGetProgramInfoLog(build.program, sizeof(infoLog), NULL, infoLog);
+			std::cout << "Shader link failed:" << std::endl << infoLog << std::endl;
+		}
+	}
+
+	glDetachShader(build.program, build.vertexShader);
+	glDetachShader(build.program, build.fragmentShader);
+	glDeleteShader(build.vertexShader);
+	glDeleteShader(build.fragmentShader);
+	build.vertexShader = 0;
+	build.fragmentShader = 0;
+
+	if (linkStatus == GL_FALSE)
+	{
+		glDeleteProgram(build.program);
+		build.program = 0;
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  EntryPath()
+ *
+ *  This method is used for getting the path of the cache
+ *  entry for a program key.
+ ***********************************************************/
+std::string ProgramCache::EntryPath(uint64_t programKey)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)programKey);
+	return(m_directory + "/" + name);
+}
+
+/***********************************************************
+ *  LoadBinary()
+ *
+ *  This method is used for creating a program from the cached
+ *  binary of a program key.  Returns 0 when there is no valid
+ *  entry, and removes an entry the driver will not take.
+ ***********************************************************/
+GLuint ProgramCache::LoadBinary(uint64_t programKey, double& sourceMilliseconds)
+{
+	std::string path = EntryPath(programKey);
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file)
+	{
+		return(0);
+	}
+
+	PROGRAM_HEADER header;
+	if ((!file.read((char*)&header, sizeof(header))) ||
+		(header.magic != PROGRAM_CACHE_MAGIC) ||
+		(header.version != PROGRAM_CACHE_VERSION) ||
+		(header.programKey != programKey) ||
+		(header.binaryLength == 0))
+	{
+		return(0);
+	}
+
+	std::vector<char> binary(header.binaryLength);
+	if (!file.read(binary.data(), binary.size()))
+	{
+		return(0);
+	}
+	file.close();
+
+	GLint linkStatus = GL_FALSE;
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, (GLenum)header.binaryFormat, binary.data(), (GLsizei)binary.size());
+	glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+	if (linkStatus == GL_FALSE)
+	{
+		// a driver update can turn down binaries it wrote before
+		glDeleteProgram(program);
+		remove(path.c_str());
+		std::cout << "Cached shader program was rejected, building from source:" << path << std::endl;
+		return(0);
+	}
+
+	sourceMilliseconds = header.sourceMilliseconds;
+	return(program);
+}
+
+/***********************************************************
+ *  StoreBinary()
+ *
+ *  This method is used for writing the binary of a linked
+ *  program to the cache.  The entry is written to a temporary
+ *  file first and then renamed, so a launch never reads a
+ *  partly written entry.
+ ***********************************************************/
+bool ProgramCache::StoreBinary(uint64_t programKey, GLuint program, double sourceMilliseconds)
+{
+	GLint binaryLength = 0;
+
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0)
+	{
+		return(false);
+	}
+
+	std::vector<char> binary((size_t)binaryLength);
+	GLenum binaryFormat = 0;
+	GLsizei writtenLength = 0;
+	glGetProgramBinary(program, binaryLength, &writtenLength, &binaryFormat, binary.data());
+	if (writtenLength <= 0)
+	{
+		return(false);
+	}
+
+	// create the cache directory the first time it is needed
+#ifdef _WIN32
+	_mkdir(m_directory.c_str());
+#else
+	mkdir(m_directory.c_str(), 0755);
+#endif
+
+	PROGRAM_HEADER header;
+	header.magic = PROGRAM_CACHE_MAGIC;
+	header.version = PROGRAM_CACHE_VERSION;
+	header.programKey = programKey;
+	header.binaryFormat = (uint32_t)binaryFormat;
+	header.binaryLength = (uint32_t)writtenLength;
+	header.sourceMilliseconds = sourceMilliseconds;
+
+	std::string path = EntryPath(programKey);
+	// a program can be stored from more than one thread
+	std::ostringstream temporaryPath;
+	temporaryPath << path << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+
+	std::ofstream file(temporaryPath.str().c_str(), std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not write shader program cache entry:" << path << std::endl;
+		return(false);
+	}
+
+	file.write((const char*)&header, sizeof(header));
+	file.write(binary.data(), writtenLength);
+	file.close();
+	bool bReturn = !file.fail();
+
+	if (bReturn == true)
+	{
+		// rename does not replace an existing file on Windows
+		remove(path.c_str());
+		bReturn = (rename(temporaryPath.str().c_str(), path.c_str()) == 0);
+	}
+	if (bReturn == false)
+	{
+		remove(temporaryPath.str().c_str());
+	}
+
+	return(bReturn);
+}
+
+/***********************************************************
+ *  BeginProgram()
+ *
+ *  This method is used for starting a program from a vertex
+ *  and fragment shader file.  The cached binary is used when
+ *  there is a current one, otherwise the compile and link are
+ *  handed to the driver and the build must be passed to
+ *  FinishProgram() to get the program.  The defines are part
+ *  of the hashed source, so each set of them has its own
+ *  cache entry.  Returns false when a source cannot be read.
+ ***********************************************************/
+bool ProgramCache::BeginProgram(const char* vertexShaderFile, const char* fragmentShaderFile,
+	const std::string& defines, PROGRAM_BUILD& build)
+{
+	build.start = std::chrono::steady_clock::now();
+	build.bComplete = false;
+	build.bCached = false;
+	build.vertexShaderFile = vertexShaderFile;
+	build.fragmentShaderFile = fragmentShaderFile;
+	build.vertexShader = 0;
+	build.fragmentShader = 0;
+	build.program = 0;
+	build.buildMilliseconds = 0.0;
+	build.sourceMilliseconds = 0.0;
+
+	if ((ReadSourceFile(vertexShaderFile, build.vertexSource) == false) ||
+		(ReadSourceFile(fragmentShaderFile, build.fragmentSource) == false))
+	{
+		return(false);
+	}
+	InsertDefines(build.vertexSource, defines);
+	InsertDefines(build.fragmentSource, defines);
+
+	build.programKey = ProgramKey(build.vertexSource, build.fragmentSource);
+
+	if ((IsSupported() == true) && (m_bReadEnabled == true))
+	{
+		build.program = LoadBinary(build.programKey, build.sourceMilliseconds);
+		build.bCached = (build.program != 0);
+	}
+
+	if (build.bCached == true)
+	{
+		build.bComplete = true;
+		build.completeTime = std::chrono::steady_clock::now();
+	}
+	else
+	{
+		IssueBuild(build);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  IsBuildComplete()
+ *
+ *  This method is used for asking whether the driver has
+ *  finished a build without waiting for it.  Only a driver
+ *  with parallel compilation can answer early - otherwise the
+ *  build is reported complete, and finishing it waits for the
+ *  compile and link as before.
+ ***********************************************************/
+bool ProgramCache::IsBuildComplete(PROGRAM_BUILD& build)
+{
+	if (build.bComplete == true)
+	{
+		return(true);
+	}
+
+	GLint completionStatus = GL_TRUE;
+	if ((GLEW_KHR_parallel_shader_compile) && (build.program != 0))
+	{
+		glGetProgramiv(build.program, GL_COMPLETION_STATUS_KHR, &completionStatus);
+	}
+	if (completionStatus == GL_TRUE)
+	{
+		build.bComplete = true;
+		build.completeTime = std::chrono::steady_clock::now();
+	}
+
+	return(build.bComplete);
+}
+
+/***********************************************************
+ *  FinishProgram()
+ *
+ *  This method is used for finishing a started build and
+ *  returning its program.  A program built from source is
+ *  checked, waiting for the driver when it is still busy, and
+ *  its binary is cached for the next launch.  The time the
+ *  build took runs to the first time it was seen complete.
+ *  Returns 0 when the sources do not compile or link.
+ ***********************************************************/
+GLuint ProgramCache::FinishProgram(PROGRAM_BUILD& build)
+{
+	if ((build.bCached == false) && (build.program != 0))
+	{
+		if (CheckBuild(build) == true)
+		{
+			IsBuildComplete(build);
+		}
+	}
+	if (build.bComplete == false)
+	{
+		build.bComplete = true;
+		build.completeTime = std::chrono::steady_clock::now();
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = build.completeTime - build.start;
+	build.buildMilliseconds = elapsed.count();
+
+	if ((build.program != 0) && (build.bCached == false))
+	{
+		build.sourceMilliseconds = build.buildMilliseconds;
+		if (IsSupported() == true)
+		{
+			StoreBinary(build.programKey, build.program, build.sourceMilliseconds);
+		}
+	}
+
+	return(build.program);
+}
+
+/***********************************************************
+ *  LoadProgram()
+ *
+ *  This method is used for building a program from a vertex
+ *  and fragment shader file, waiting for it to finish.  The
+ *  cached binary is used when there is a current one.
+ *  Returns 0 when the sources do not compile or link.
+ ***********************************************************/
+GLuint ProgramCache::LoadProgram(const char* vertexShaderFile, const char* fragmentShaderFile,
+	const std::string& defines)
+{
+	PROGRAM_BUILD build;
+
+	m_bLastLoadCached = false;
+	m_lastLoadMilliseconds = 0.0;
+	m_lastSourceMilliseconds = 0.0;
+
+	if (BeginProgram(vertexShaderFile, fragmentShaderFile, defines, build) == false)
+	{
+		return(0);
+	}
+	GLuint program = FinishProgram(build);
+
+	m_bLastLoadCached = build.bCached;
+	m_lastLoadMilliseconds = build.buildMilliseconds;
+	m_lastSourceMilliseconds = build.sourceMilliseconds;
+
+	return(program);
+}
+
+/***********************************************************
+ *  IsSpirvSupported()
+ *
+ *  This method is used for checking that the driver can take
+ *  shader modules in SPIR-V.
+ ***********************************************************/
+bool ProgramCache::IsSpirvSupported()
+{
+	return(GLEW_ARB_gl_spirv ? true : false);
+}
+
+/***********************************************************
+ *  IsBuildCurrent()
+ *
+ *  This method is used for checking that a file built from a
+ *  source, such as a SPIR-V module, exists and was written no
+ *  earlier than the source was last edited.
+ ***********************************************************/
+bool ProgramCache::IsBuildCurrent(const char* builtFile, const char* sourceFile)
+{
+	struct stat builtStatus;
+	struct stat sourceStatus;
+
+	if (stat(builtFile, &builtStatus) != 0)
+	{
+		return(false);
+	}
+	if (stat(sourceFile, &sourceStatus) != 0)
+	{
+		return(true);
+	}
+
+	return(builtStatus.st_mtime >= sourceStatus.st_mtime);
+}
+
+/***********************************************************
+ *  LoadSpirvProgram()
+ *
+ *  This method is used for building a program from a vertex
+ *  and fragment SPIR-V module.  The modules are hashed like
+ *  GLSL sources, so the linked binary is cached the same way
+ *  and a later launch skips even the specialization.  Returns
+ *  0 when the driver takes no SPIR-V, a module cannot be read
+ *  or is turned down, or the program does not link.
+ ***********************************************************/
+GLuint ProgramCache::LoadSpirvProgram(const char* vertexSpirvFile, const char* fragmentSpirvFile)
+{
+	PROGRAM_BUILD build;
+
+	m_bLastLoadCached = false;
+	m_lastLoadMilliseconds = 0.0;
+	m_lastSourceMilliseconds = 0.0;
+
+	if (IsSpirvSupported() == false)
+	{
+		return(0);
+	}
+
+	build.start = std::chrono::steady_clock::now();
+	build.bCached = false;
+	build.bComplete = false;
+	build.vertexShaderFile = vertexSpirvFile;
+	build.fragmentShaderFile = fragmentSpirvFile;
+	build.vertexShader = 0;
+	build.fragmentShader = 0;
+	build.program = 0;
+	build.buildMilliseconds = 0.0;
+	build.sourceMilliseconds = 0.0;
+
+	if ((ReadSourceFile(vertexSpirvFile, build.vertexSource) == false) ||
+		(ReadSourceFile(fragmentSpirvFile, build.fragmentSource) == false))
+	{
+		return(0);
+	}
+
+	build.programKey = ProgramKey(build.vertexSource, build.fragmentSource);
+	if ((IsSupported() == true) && (m_bReadEnabled == true))
+	{
+		build.program = LoadBinary(build.programKey, build.sourceMilliseconds);
+		build.bCached = (build.program != 0);
+	}
+
+	if (build.bCached == false)
+	{
+		IssueSpirvShader(build.vertexSource, GL_VERTEX_SHADER, build.vertexShader);
+		IssueSpirvShader(build.fragmentSource, GL_FRAGMENT_SHADER, build.fragmentShader);
+
+		build.program = glCreateProgram();
+		if (IsSupported() == true)
+		{
+			glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+		}
+		glAttachShader(build.program, build.vertexShader);
+		glAttachShader(build.program, build.fragmentShader);
+		glLinkProgram(build.program);
+	}
+
+	GLuint program = FinishProgram(build);
+
+	m_bLastLoadCached = build.bCached;
+	m_lastLoadMilliseconds = build.buildMilliseconds;
+	m_lastSourceMilliseconds = build.sourceMilliseconds;
+
+	return(program);
+}
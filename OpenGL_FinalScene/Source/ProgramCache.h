@@ -0,0 +1,132 @@
+///////////////////////////////////////////////////////////////////////////////
+// programcache.h
+// ============
+// on-disk cache of linked shader program binaries
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  ProgramCache
+ *
+ *  This class builds shader programs from their GLSL source
+ *  files and keeps the linked binaries in a cache directory,
+ *  so a later launch can hand the driver the binary instead
+ *  of compiling and linking again.  An entry is named after a
+ *  hash of both sources and the vendor, renderer and version
+ *  strings of the driver, so an edited shader or a changed
+ *  driver simply misses the cache.  A binary the driver turns
+ *  down is removed and the program is built from source.
+ *  A build can be started and finished apart, so the driver
+ *  compiles while the caller does other work.  Programs can
+ *  also be built from SPIR-V modules compiled at build time,
+ *  which the driver takes without parsing any GLSL.
+ ***********************************************************/
+class ProgramCache
+{
+public:
+	// constructor
+	ProgramCache(const char* directory);
+	// destructor
+	~ProgramCache();
+
+	// allow cached binaries to be read - when off, every program
+	// is built from source and its cache entry is rewritten
+	void SetReadEnabled(bool bReadEnabled);
+
+	// a program being built, from BeginProgram() to FinishProgram()
+	struct PROGRAM_BUILD
+	{
+		std::string vertexShaderFile;
+		std::string fragmentShaderFile;
+		std::string vertexSource;
+		std::string fragmentSource;
+		uint64_t programKey;
+		GLuint vertexShader;
+		GLuint fragmentShader;
+		GLuint program;
+		// true when the program came from the cache
+		bool bCached;
+		// true once the build was seen finished by the driver
+		bool bComplete;
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::time_point completeTime;
+		// time the build took, and the time building the same
+		// program from source took when its binary was cached
+		double buildMilliseconds;
+		double sourceMilliseconds;
+	};
+
+	// true when the driver can hand out program binaries
+	static bool IsSupported();
+
+	// start a program from a vertex and fragment shader file,
+	// with #define lines added after the #version line of both -
+	// returns false when a source cannot be read
+	bool BeginProgram(const char* vertexShaderFile, const char* fragmentShaderFile,
+		const std::string& defines, PROGRAM_BUILD& build);
+	// true when the driver has finished the build, without
+	// waiting for it
+	static bool IsBuildComplete(PROGRAM_BUILD& build);
+	// finish a started build, waiting for the driver if needed,
+	// returning 0 when the sources do not compile or link
+	GLuint FinishProgram(PROGRAM_BUILD& build);
+
+	// start and finish a program in one call
+	GLuint LoadProgram(const char* vertexShaderFile, const char* fragmentShaderFile,
+		const std::string& defines = std::string());
+
+	// true when the driver can take SPIR-V shader modules
+	static bool IsSpirvSupported();
+	// true when a built file exists and is not older than the
+	// source it was built from
+	static bool IsBuildCurrent(const char* builtFile, const char* sourceFile);
+	// build a program from a vertex and fragment SPIR-V module,
+	// returning 0 when they are not accepted or do not link
+	GLuint LoadSpirvProgram(const char* vertexSpirvFile, const char* fragmentSpirvFile);
+
+	// true when the last program came from the cache
+	bool WasLastLoadCached() const { return(m_bLastLoadCached); }
+	// time the last load took, and the time building the same
+	// program from source took when its binary was cached
+	double GetLastLoadMilliseconds() const { return(m_lastLoadMilliseconds); }
+	double GetLastSourceMilliseconds() const { return(m_lastSourceMilliseconds); }
+
+private:
+	// directory holding the cache entries
+	std::string m_directory;
+	// false when cached binaries should be ignored
+	bool m_bReadEnabled;
+	// how the last program was loaded
+	bool m_bLastLoadCached;
+	double m_lastLoadMilliseconds;
+	double m_lastSourceMilliseconds;
+
+	// hash the sources together with the driver strings
+	static uint64_t ProgramKey(const std::string& vertexSource, const std::string& fragmentSource);
+	// read a whole source file
+	static bool ReadSourceFile(const char* filename, std::string& source);
+	// add #define lines to a source after its #version line
+	static void InsertDefines(std::string& source, const std::string& defines);
+	// hand the driver the compile and link of a build
+	static void IssueBuild(PROGRAM_BUILD& build);
+	// create a shader from a SPIR-V module, specialized at main
+	static void IssueSpirvShader(const std::string& module, GLenum shaderType, GLuint& shader);
+	// check a compiled shader and print the log when it failed
+	static bool CheckShader(const std::string& filename, GLuint shader);
+	// check the compile and link of a build and free its shaders
+	static bool CheckBuild(PROGRAM_BUILD& build);
+
+	// path of the cache entry for a program key
+	std::string EntryPath(uint64_t programKey);
+	// create a program from the cached binary of a program key
+	GLuint LoadBinary(uint64_t programKey, double& sourceMilliseconds);
+	// write the binary of a linked program
+	bool StoreBinary(uint64_t programKey, GLuint program, double sourceMilliseconds);
+};
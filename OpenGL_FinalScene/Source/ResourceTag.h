@@ -0,0 +1,43 @@
+///////////////////////////////////////////////////////////////////////////////
+// resourcetag.h
+// ============
+// integer handles for texture and material tags, hashed from their names
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  ResourceTag
+ *
+ *  This class turns a texture or material tag name into a
+ *  32-bit FNV-1a hash.  The hash of a string literal is a
+ *  constant expression, so a draw that names its texture or
+ *  material with a literal costs no allocation or string
+ *  compare - the tag is looked up by its integer value.
+ ***********************************************************/
+class ResourceTag
+{
+public:
+	// hash a tag name, folded at compile time for literals
+	constexpr ResourceTag(const char* name) : m_hash(Hash(name, FNV_OFFSET_BASIS)) {}
+	// hash a tag name held in a string
+	ResourceTag(const std::string& name) : m_hash(Hash(name.c_str(), FNV_OFFSET_BASIS)) {}
+
+	// integer value of the tag
+	constexpr uint32_t GetHash() const { return(m_hash); }
+
+private:
+	static const uint32_t FNV_OFFSET_BASIS = 2166136261u;
+	static const uint32_t FNV_PRIME = 16777619u;
+
+	uint32_t m_hash;
+
+	// one byte at a time, recursively so it is a constant expression
+	static constexpr uint32_t Hash(const char* name, uint32_t hash)
+	{
+		return((*name == 0) ? hash : Hash(name + 1, (hash ^ (unsigned char)*name) * FNV_PRIME));
+	}
+};
@@ -16,14 +16,175 @@
 
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+
 // declaration of global variables
 namespace
 {
 	const char* g_ModelName = "model";
 	const char* g_ColorValueName = "objectColor";
 	const char* g_TextureValueName = "objectTexture";
+	const char* g_TextureArrayValueName = "objectTextureArray";
+	const char* g_TextureLayerName = "objectTextureLayer";
+	const char* g_UseTextureArrayName = "bUseTextureArray";
+	const char* g_UseTextureAtlasName = "bUseTextureAtlas";
+	const char* g_TextureRectName = "objectTextureRect";
+	const char* g_MaterialIndexName = "materialIndex";
+
+	// size of the material block array - MAX_MATERIALS in the
+	// shader, which fills the 16 KB every OpenGL driver allows
+	// for a block
+	const int MAX_MATERIALS = 512;
+
+	// material library source, and its compiled form that is
+	// written at build time by --compile-materials
+	const char* g_MaterialSourceName = "materials/scene.materials";
+	const char* g_MaterialLibraryName = "materials/scene.materialbin";
 	const char* g_UseTextureName = "bUseTexture";
 	const char* g_UseLightingName = "bUseLighting";
+	const char* g_UVScaleName = "UVscale";
+
+	// number of timed runs for each texture loading benchmark path
+	const int TEXTURE_BENCHMARK_RUNS = 3;
+
+	// draws timed in each run of the uniform benchmark, and the
+	// number of uniforms each of them sets
+	const int UNIFORM_BENCHMARK_DRAWS = 100000;
+	const int UNIFORM_BENCHMARK_UNIFORMS = 5;
+
+	// frames drawn before the shader variant benchmark starts
+	// timing, which also builds the variants, and frames timed
+	const int SHADER_BENCHMARK_WARMUP_FRAMES = 10;
+	const int SHADER_BENCHMARK_FRAMES = 200;
+
+	// frames drawn in each pass of the draw list benchmark
+	const int DRAW_LIST_BENCHMARK_FRAMES = 500;
+
+	// object counts of the transform benchmark, from the objects
+	// of the scene up to a million, and the transforms composed
+	// at each count, so small batches are timed over many runs
+	const int TRANSFORM_BENCHMARK_COUNTS[] = { 60, 1000, 10000, 100000, 1000000 };
+	const int TRANSFORM_BENCHMARK_OBJECTS = 4000000;
+
+	// copies of the scene in the instancing benchmark shelf, set
+	// out in rows of INSTANCING_BENCHMARK_ROW copies, the space
+	// between them, and the frames drawn in each pass
+	const int INSTANCING_BENCHMARK_COPIES = 100;
+	const int INSTANCING_BENCHMARK_ROW = 10;
+	const float INSTANCING_BENCHMARK_SPACING = 30.0f;
+	const int INSTANCING_BENCHMARK_FRAMES = 200;
+
+	// key counts of the draw sort benchmark, from the draws of
+	// the scene up to a million, and the keys sorted at each
+	// count, so small lists are timed over many runs
+	const int DRAW_SORT_BENCHMARK_COUNTS[] = { 60, 1000, 10000, 100000, 1000000 };
+	const int DRAW_SORT_BENCHMARK_KEYS = 4000000;
+
+	// width and height of the offscreen target the shader warm-up
+	// draws the scene into
+	const int SHADER_WARMUP_TARGET_SIZE = 64;
+
+	// bytes of streamed mip levels uploaded per frame - a
+	// 512 x 512 RGBA level, so a frame never stalls for long
+	const size_t TEXTURE_STREAMING_FRAME_BUDGET = 1024 * 1024;
+
+	// largest width or height an evicted texture keeps
+	const int EVICTED_TEXTURE_SIZE = 64;
+
+	// size of the persistently mapped texture upload ring, and
+	// the alignment of each mip level within it
+	const size_t TEXTURE_UPLOAD_RING_SIZE = 32 * 1024 * 1024;
+	const size_t TEXTURE_UPLOAD_ALIGNMENT = 256;
+
+	// width and height of each texture atlas - a power of two,
+	// so every mip level halves exactly
+	const int TEXTURE_ATLAS_SIZE = 2048;
+
+	// asset pack of GPU-ready textures, written by --pack
+	const char* g_AssetPackName = "scene.pack";
+
+	// image files and tags of the scene textures, loaded by
+	// LoadSceneTextures() and written to the asset pack
+	struct SCENE_TEXTURE
+	{
+		const char* filename;
+		const char* tag;
+	};
+	const SCENE_TEXTURE g_SceneTextures[] =
+	{
+		{ "textures/cork.jpg", "bottle-cork" },
+		{ "textures/draught-living-death.jpg", "draught-potion" },
+		{ "textures/twine-black.png", "black-twine" },
+		{ "textures/wood-seamless.jpg", "table" },
+		{ "textures/twine-brown.png", "brown-twine" },
+		{ "textures/wall.jpg", "background" },
+		{ "textures/amortentia.jpg", "love-potion" },
+		{ "textures/felix.jpg", "lucky-potion" },
+		{ "textures/thunderbrew.jpg", "stun-potion" },
+	};
+	const int SCENE_TEXTURE_COUNT = sizeof(g_SceneTextures) / sizeof(g_SceneTextures[0]);
+
+	// number of mip levels in a full chain down to 1 x 1
+	int MipLevelCount(int width, int height)
+	{
+		int mipLevels = 1;
+		while ((width > 1) || (height > 1))
+		{
+			width = (width > 1) ? width / 2 : 1;
+			height = (height > 1) ? height / 2 : 1;
+			mipLevels++;
+		}
+		return(mipLevels);
+	}
+
+	// zeroed texture upload statistics
+	SceneManager::TEXTURE_UPLOAD_STATS NoTextureUploads()
+	{
+		SceneManager::TEXTURE_UPLOAD_STATS stats;
+		stats.frames = 0;
+		stats.levels = 0;
+		stats.bytes = 0;
+		stats.milliseconds = 0.0;
+		stats.worstFrameMilliseconds = 0.0;
+		stats.ringWaits = 0;
+		stats.ringWaitMilliseconds = 0.0;
+		return(stats);
+	}
+
+	// video memory bytes of a texture's mip chain from a level
+	// down to 1 x 1, counting every texel as RGBA since drivers
+	// pad RGB textures to four bytes anyway
+	size_t TextureBytes(int width, int height, int firstLevel)
+	{
+		size_t bytes = 0;
+		for (int level = firstLevel; ; level++)
+		{
+			const int mipWidth = TextureDecoder::MipDimension(width, level);
+			const int mipHeight = TextureDecoder::MipDimension(height, level);
+			bytes += (size_t)mipWidth * mipHeight * 4;
+			if ((mipWidth == 1) && (mipHeight == 1))
+			{
+				break;
+			}
+		}
+		return(bytes);
+	}
+
+	// first mip level that an evicted texture keeps
+	int EvictedMipLevel(int width, int height)
+	{
+		int level = 0;
+		while ((TextureDecoder::MipDimension(width, level) > EVICTED_TEXTURE_SIZE) ||
+			(TextureDecoder::MipDimension(height, level) > EVICTED_TEXTURE_SIZE))
+		{
+			level++;
+		}
+		return(level);
+	}
 }
 
 /***********************************************************
@@ -31,18 +192,88 @@ namespace
  *
  *  The constructor for the class
  ***********************************************************/
-SceneManager::SceneManager(ShaderManager *pShaderManager)
+SceneManager::SceneManager(ShaderManager *pShaderManager, ShaderUniforms* pShaderUniforms, UniformBlocks* pUniformBlocks, GLStateCache* pStateCache)
 {
 	m_pShaderManager = pShaderManager;
+	m_pShaderUniforms = pShaderUniforms;
+	m_pUniformBlocks = pUniformBlocks;
+	m_pStateCache = pStateCache;
+	m_lightData = UniformBlocks::LIGHT_DATA();
+	m_bUseLighting = false;
+	m_activePointLights = 0;
+
+	// every draw uses the loaded program until variants are set
+	m_pShaderVariants = NULL;
+	m_bShaderWarmup = true;
+	m_warmupFrameData = UniformBlocks::FRAME_DATA();
+	m_warmupFrameData.view = glm::mat4(1.0f);
+	m_warmupFrameData.projection = glm::mat4(1.0f);
+	m_warmupClearColor = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	m_bUseShaderVariants = false;
+	m_baseProgram = (NULL != pShaderUniforms) ? pShaderUniforms->GetProgram() : 0;
+	m_currentProgram = m_baseProgram;
+	m_modelMatrix = glm::mat4(1.0f);
 	m_basicMeshes = new ShapeMeshes();
 
-	// initialize the texture collection
-	for (int i = 0; i < 16; i++)
-	{
-		m_textureIDs[i].tag = "/0";
-		m_textureIDs[i].ID = -1;
-	}
-	m_loadedTextures = 0;
+	// the draw list is recorded when the scene is prepared
+	m_bRecordingDraws = false;
+	m_bUseDrawList = true;
+	m_bSortDraws = true;
+	m_bDrawOrderReady = false;
+	m_firstBlendedDraw = 0;
+	m_sortViewPosition = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_bDrawSortReported = false;
+
+	// the instanced shapes are uploaded when the scene is
+	// prepared with instancing on, and draw the list only then
+	m_pInstancedMeshes = new InstancedMeshes();
+	m_bUseInstancing = false;
+	m_firstTexturedBatch = 0;
+	m_firstBlendedBatch = 0;
+	m_bUseIndirectDraws = false;
+	m_bIndirectReady = false;
+
+	// texture image files are decoded on worker threads by default
+	m_pTextureDecoder = NULL;
+	m_bParallelTextureLoading = true;
+
+	// decoded images and their mip chains are cached on disk
+	m_pTextureCache = new TextureCache("texture_cache");
+
+	// textures are loaded in full before the first frame
+	m_bStreamTextures = false;
+	m_streamingFrameBudget = TEXTURE_STREAMING_FRAME_BUDGET;
+	m_placeholderTextureID = 0;
+
+	// texture memory is tracked, with no budget until one is set
+	m_pTextureResidency = new TextureResidency();
+
+	// the upload ring is created with the first textures
+	m_pUploadRing = NULL;
+	m_frameUploadStats = NoTextureUploads();
+	m_textureUploadStats = NoTextureUploads();
+
+	// the asset pack is mapped when the scene is prepared
+	m_pAssetPack = new AssetPack();
+	m_bUseAssetPack = true;
+
+	// bindless handles are used when the driver supports them,
+	// otherwise the textures are packed into texture arrays
+	m_textureMode = TEXTURE_MODE_BINDLESS;
+	m_maxTextureUnits = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &m_maxTextureUnits);
+
+	// small textures share atlases unless turned off
+	m_bUseTextureAtlas = true;
+
+	// the material library is mapped when the materials are defined
+	m_pMaterialLibrary = new MaterialLibrary();
+
+	// the material buffer is created once the materials are defined
+	m_materialBufferID = 0;
+
+	// the uniforms were reflected when the shaders were loaded
+	ResolveShaderUniforms();
 }
 
 /***********************************************************
@@ -55,7 +286,48 @@ SceneManager::~SceneManager()
 	m_pShaderManager = NULL;
 	delete m_basicMeshes;
 	m_basicMeshes = NULL;
+	if (NULL != m_pInstancedMeshes)
+	{
+		delete m_pInstancedMeshes;
+		m_pInstancedMeshes = NULL;
+	}
+	if (NULL != m_pTextureDecoder)
+	{
+		delete m_pTextureDecoder;
+		m_pTextureDecoder = NULL;
+	}
+	if (NULL != m_pTextureCache)
+	{
+		delete m_pTextureCache;
+		m_pTextureCache = NULL;
+	}
 	DestroyGLTextures();
+	if (NULL != m_pTextureResidency)
+	{
+		delete m_pTextureResidency;
+		m_pTextureResidency = NULL;
+	}
+	if (NULL != m_pUploadRing)
+	{
+		delete m_pUploadRing;
+		m_pUploadRing = NULL;
+	}
+	// unmapped only once no texture image points into it
+	if (NULL != m_pAssetPack)
+	{
+		delete m_pAssetPack;
+		m_pAssetPack = NULL;
+	}
+	if (m_materialBufferID != 0)
+	{
+		glDeleteBuffers(1, &m_materialBufferID);
+		m_materialBufferID = 0;
+	}
+	if (NULL != m_pMaterialLibrary)
+	{
+		delete m_pMaterialLibrary;
+		m_pMaterialLibrary = NULL;
+	}
 }
 
 /***********************************************************
@@ -64,30 +336,51 @@ SceneManager::~SceneManager()
  *  This method is used for loading textures from image files,
  *  configuring the texture mapping parameters in OpenGL,
  *  generating the mipmaps, and loading the read texture into
- *  the next available texture slot in memory.
+ *  the next available texture slot in memory.  The image is
+ *  decoded on the calling thread.
  ***********************************************************/
 bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 {
-	int width = 0;
-	int height = 0;
-	int colorChannels = 0;
-	GLuint textureID = 0;
+	TextureDecoder::DECODED_IMAGE image;
+	bool bReturn = false;
 
 	// indicate to always flip images vertically when loaded
 	stbi_set_flip_vertically_on_load(true);
 
 	// try to parse the image data from the specified image file
-	unsigned char* image = stbi_load(
-		filename,
-		&width,
-		&height,
-		&colorChannels,
-		0);
+	TextureDecoder::DecodeImage(filename, image, m_pTextureCache, m_bStreamTextures);
+	image.tag = tag;
+
+	bReturn = AddDecodedImage(image);
+
+	return(bReturn);
+}
+
+/***********************************************************
+ *  UploadGLTexture()
+ *
+ *  This method is used for converting decoded image data into
+ *  an OpenGL texture, configuring the texture mapping
+ *  parameters, generating the mipmaps, and loading the texture
+ *  into the next available texture slot in memory, or into the
+ *  given slot when an evicted texture is loaded again.  It must
+ *  be called on the thread that owns the OpenGL context.
+ ***********************************************************/
+bool SceneManager::UploadGLTexture(const TextureDecoder::DECODED_IMAGE& image, int textureSlot)
+{
+	GLuint textureID = 0;
 
 	// if the image was successfully read from the image file
-	if (image)
+	if (image.pixels)
 	{
-		std::cout << "Successfully loaded image:" << filename << ", width:" << width << ", height:" << height << ", channels:" << colorChannels << std::endl;
+		// the decoder pads RGB images, so every image is RGBA
+		if (image.colorChannels != 4)
+		{
+			std::cout << "Not implemented to handle image with " << image.colorChannels << " channels" << std::endl;
+			return false;
+		}
+
+		std::cout << "Successfully loaded image:" << image.filename << ", width:" << image.width << ", height:" << image.height << ", channels:" << image.colorChannels << std::endl;
 
 		glGenTextures(1, &textureID);
 		glBindTexture(GL_TEXTURE_2D, textureID);
@@ -99,437 +392,3777 @@ bool SceneManager::CreateGLTexture(const char* filename, std::string tag)
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		// if the loaded image is in RGB format
-		if (colorChannels == 3)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-		// if the loaded image is in RGBA format - it supports transparency
-		else if (colorChannels == 4)
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-		else
+		// allocate the full mip chain, then upload the levels the
+		// image came with - just the first one unless the chain
+		// was precomputed
+		AllocateTextureStorage(GL_TEXTURE_2D, MipLevelCount(image.width, image.height), image.width, image.height, 0);
+		for (int level = 0; level < image.mipLevels; level++)
 		{
-			std::cout << "Not implemented to handle image with " << colorChannels << " channels" << std::endl;
-			return false;
+			UploadTextureLevel(GL_TEXTURE_2D, level, 0,
+				TextureDecoder::MipDimension(image.width, level),
+				TextureDecoder::MipDimension(image.height, level),
+				image.pixels + image.mipOffsets[level]);
 		}
 
 		// generate the texture mipmaps for mapping textures to lower resolutions
-		glGenerateMipmap(GL_TEXTURE_2D);
+		if (image.mipLevels == 1)
+		{
+			glGenerateMipmap(GL_TEXTURE_2D);
+		}
 
-		// free the image data from local memory
-		stbi_image_free(image);
 		glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
 
-		// register the loaded texture and associate it with the special tag string
-		m_textureIDs[m_loadedTextures].ID = textureID;
-		m_textureIDs[m_loadedTextures].tag = tag;
-		m_loadedTextures++;
+		if (textureSlot < 0)
+		{
+			// register the loaded texture and associate it with the special tag string
+			TEXTURE_INFO texture;
+			texture.ID = 0;
+			texture.tag = image.tag;
+			texture.filename = image.filename;
+			texture.width = image.width;
+			texture.height = image.height;
+			texture.arrayIndex = -1;
+			texture.layer = 0;
+			texture.handle = 0;
+			texture.atlasSlot = -1;
+			texture.atlasRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+			textureSlot = RegisterTexture(texture);
+		}
+
+		ReplaceGLTexture(textureSlot, textureID);
+
+		// keep the levels an eviction falls back to
+		const int evictedLevel = EvictedMipLevel(image.width, image.height);
+		const bool bEvictable = TextureDecoder::CopyMipTail(image, evictedLevel, m_textureIDs[textureSlot].evictedPixels);
+		m_pTextureResidency->SetTexture(textureSlot,
+			TextureBytes(image.width, image.height, 0),
+			TextureBytes(image.width, image.height, evictedLevel),
+			bEvictable);
 
 		return true;
 	}
 
-	std::cout << "Could not load image:" << filename << std::endl;
+	std::cout << "Could not load image:" << image.filename << std::endl;
 
 	// Error loading the image
 	return false;
 }
 
 /***********************************************************
- *  BindGLTextures()
+ *  AllocateTextureStorage()
  *
- *  This method is used for binding the loaded textures to
- *  OpenGL texture memory slots.  There are up to 16 slots.
+ *  This method is used for allocating every RGBA8 mip level of
+ *  the bound 2D texture or texture array at once.  Immutable
+ *  storage is used when the driver supports it, so the levels
+ *  can never be respecified and need no completeness checks.
  ***********************************************************/
-void SceneManager::BindGLTextures()
+void SceneManager::AllocateTextureStorage(GLenum target, int mipLevels, int width, int height, int layers)
 {
-	for (int i = 0; i < m_loadedTextures; i++)
+	if (GLEW_ARB_texture_storage)
 	{
-		// bind textures on corresponding texture units
-		glActiveTexture(GL_TEXTURE0 + i);
-		glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		if (target == GL_TEXTURE_2D_ARRAY)
+			glTexStorage3D(target, mipLevels, GL_RGBA8, width, height, layers);
+		else
+			glTexStorage2D(target, mipLevels, GL_RGBA8, width, height);
+	}
+	else
+	{
+		for (int level = 0; level < mipLevels; level++)
+		{
+			const int mipWidth = TextureDecoder::MipDimension(width, level);
+			const int mipHeight = TextureDecoder::MipDimension(height, level);
+			if (target == GL_TEXTURE_2D_ARRAY)
+				glTexImage3D(target, level, GL_RGBA8, mipWidth, mipHeight, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			else
+				glTexImage2D(target, level, GL_RGBA8, mipWidth, mipHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		}
 	}
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, mipLevels - 1);
 }
 
 /***********************************************************
- *  DestroyGLTextures()
+ *  UploadTextureLevel()
  *
- *  This method is used for freeing the memory in all the
- *  used texture memory slots.
+ *  This method is used for uploading one RGBA mip level of the
+ *  bound 2D texture, or one layer of it for a texture array.
+ *  The pixels are copied into the persistently mapped upload
+ *  ring and the driver reads them from there on the GPU's
+ *  timeline, so the call returns without a driver-side copy.
+ *  Without the ring, or for a level larger than the ring, the
+ *  level is uploaded straight from the pixels.
  ***********************************************************/
-void SceneManager::DestroyGLTextures()
+void SceneManager::UploadTextureLevel(GLenum target, int level, int layer, int width, int height, const unsigned char* pixels)
 {
-	for (int i = 0; i < m_loadedTextures; i++)
-	{
-		glGenTextures(1, &m_textureIDs[i].ID);
-	}
+	UploadTextureRegion(target, level, layer, 0, 0, width, height, pixels);
 }
 
 /***********************************************************
- *  FindTextureID()
+ *  UploadTextureRegion()
  *
- *  This method is used for getting an ID for the previously
- *  loaded texture bitmap associated with the passed in tag.
+ *  This method is used for uploading a rectangle of one RGBA
+ *  mip level of the bound 2D texture or texture array layer,
+ *  through the upload ring the same way as a whole level.
  ***********************************************************/
-int SceneManager::FindTextureID(std::string tag)
+void SceneManager::UploadTextureRegion(GLenum target, int level, int layer, int x, int y, int width, int height, const unsigned char* pixels)
 {
-	int textureID = -1;
-	int index = 0;
-	bool bFound = false;
+	const size_t bytes = (size_t)width * height * 4;
+	const void* source = pixels;
+	unsigned char* staging = NULL;
+	size_t offset = 0;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	if (NULL != m_pUploadRing)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureID = m_textureIDs[index].ID;
-			bFound = true;
-		}
-		else
-			index++;
+		staging = m_pUploadRing->Allocate(bytes, TEXTURE_UPLOAD_ALIGNMENT, offset);
+	}
+	if (NULL != staging)
+	{
+		memcpy(staging, pixels, bytes);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pUploadRing->GetBuffer());
+		// with a pixel buffer bound, the pointer is an offset
+		source = (const void*)offset;
 	}
 
-	return(textureID);
-}
-
-/***********************************************************
- *  FindTextureSlot()
- *
- *  This method is used for getting a slot index for the previously
- *  loaded texture bitmap associated with the passed in tag.
- ***********************************************************/
-int SceneManager::FindTextureSlot(std::string tag)
-{
-	int textureSlot = -1;
-	int index = 0;
-	bool bFound = false;
+	if (target == GL_TEXTURE_2D_ARRAY)
+		glTexSubImage3D(target, level, x, y, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, source);
+	else
+		glTexSubImage2D(target, level, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, source);
 
-	while ((index < m_loadedTextures) && (bFound == false))
+	// a bound pixel buffer would capture every later upload
+	if (NULL != staging)
 	{
-		if (m_textureIDs[index].tag.compare(tag) == 0)
-		{
-			textureSlot = index;
-			bFound = true;
-		}
-		else
-			index++;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 	}
 
-	return(textureSlot);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	m_frameUploadStats.levels++;
+	m_frameUploadStats.bytes += bytes;
+	m_frameUploadStats.milliseconds += elapsed.count();
 }
 
 /***********************************************************
- *  FindMaterial()
+ *  EndTextureUploadFrame()
  *
- *  This method is used for getting a material from the previously
- *  defined materials list that is associated with the passed in tag.
+ *  This method is used for fencing the upload ring once the
+ *  frame's uploads are issued, and for adding the frame's
+ *  upload cost to the running statistics.
  ***********************************************************/
-bool SceneManager::FindMaterial(std::string tag, OBJECT_MATERIAL& material)
+void SceneManager::EndTextureUploadFrame()
 {
-	if (m_objectMaterials.size() == 0)
+	if (NULL != m_pUploadRing)
 	{
-		return(false);
+		MappedRingBuffer::RING_STATS ringStats = m_pUploadRing->GetStats();
+		m_pUploadRing->Fence();
+		m_pUploadRing->ResetStats();
+		m_frameUploadStats.ringWaits += ringStats.waits;
+		m_frameUploadStats.ringWaitMilliseconds += ringStats.waitMilliseconds;
 	}
 
-	int index = 0;
-	bool bFound = false;
-	while ((index < m_objectMaterials.size()) && (bFound == false))
+	if (m_frameUploadStats.levels > 0)
 	{
-		if (m_objectMaterials[index].tag.compare(tag) == 0)
-		{
-			bFound = true;
-			material.diffuseColor = m_objectMaterials[index].diffuseColor;
-			material.specularColor = m_objectMaterials[index].specularColor;
-			material.shininess = m_objectMaterials[index].shininess;
-		}
-		else
+		m_textureUploadStats.frames++;
+		m_textureUploadStats.levels += m_frameUploadStats.levels;
+		m_textureUploadStats.bytes += m_frameUploadStats.bytes;
+		m_textureUploadStats.milliseconds += m_frameUploadStats.milliseconds;
+		m_textureUploadStats.ringWaits += m_frameUploadStats.ringWaits;
+		m_textureUploadStats.ringWaitMilliseconds += m_frameUploadStats.ringWaitMilliseconds;
+		if (m_frameUploadStats.milliseconds > m_textureUploadStats.worstFrameMilliseconds)
 		{
-			index++;
+			m_textureUploadStats.worstFrameMilliseconds = m_frameUploadStats.milliseconds;
 		}
 	}
 
-	return(true);
+	m_frameUploadStats = NoTextureUploads();
 }
 
 /***********************************************************
- *  SetTransformations()
+ *  RegisterTexture()
  *
- *  This method is used for setting the transform buffer
- *  using the passed in transformation values.
+ *  This method is used for adding a loaded texture to the next
+ *  texture slot and indexing the slot by the hash of the tag,
+ *  so the texture is found without comparing strings.
  ***********************************************************/
-void SceneManager::SetTransformations(
-	glm::vec3 scaleXYZ,
-	float XrotationDegrees,
-	float YrotationDegrees,
-	float ZrotationDegrees,
-	glm::vec3 positionXYZ)
+int SceneManager::RegisterTexture(const TEXTURE_INFO& texture)
 {
-	// variables for this method
-	glm::mat4 modelView;
-	glm::mat4 scale;
-	glm::mat4 rotationX;
-	glm::mat4 rotationY;
-	glm::mat4 rotationZ;
-	glm::mat4 translation;
-
-	// set the scale value in the transform buffer
-	scale = glm::scale(scaleXYZ);
-	// set the rotation values in the transform buffer
-	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
-	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
-	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
-	// set the translation value in the transform buffer
-	translation = glm::translate(positionXYZ);
+	const int textureSlot = (int)m_textureIDs.size();
 
-	modelView = translation * rotationZ * rotationY * rotationX * scale;
+	m_textureIDs.push_back(texture);
 
-	if (NULL != m_pShaderManager)
+	// the first texture with a tag keeps it, as with a search
+	std::pair<std::unordered_map<uint32_t, int>::iterator, bool> result =
+		m_textureSlots.insert(std::make_pair(ResourceTag(texture.tag).GetHash(), textureSlot));
+	if ((result.second == false) && (m_textureIDs[result.first->second].tag != texture.tag))
 	{
-		m_pShaderManager->setMat4Value(g_ModelName, modelView);
+		std::cout << "Texture tag " << texture.tag << " has the same hash as " << m_textureIDs[result.first->second].tag << std::endl;
 	}
+
+	return(textureSlot);
 }
 
 /***********************************************************
- *  SetShaderColor()
+ *  ReplaceGLTexture()
  *
- *  This method is used for setting the passed in color
- *  into the shader for the next draw command
+ *  This method is used for putting a new OpenGL texture into
+ *  a texture slot, freeing the texture that was there before.
+ *  A bindless handle is made for the new texture, or it is
+ *  bound to the slot's texture unit.
  ***********************************************************/
-void SceneManager::SetShaderColor(
-	float redColorValue,
-	float greenColorValue,
-	float blueColorValue,
-	float alphaValue)
+void SceneManager::ReplaceGLTexture(int textureSlot, uint32_t textureID)
 {
-	// variables for this method
-	glm::vec4 currentColor;
+	TEXTURE_INFO& texture = m_textureIDs[textureSlot];
 
-	currentColor.r = redColorValue;
-	currentColor.g = greenColorValue;
-	currentColor.b = blueColorValue;
-	currentColor.a = alphaValue;
+	if (texture.handle != 0)
+	{
+		glMakeTextureHandleNonResidentARB(texture.handle);
+		texture.handle = 0;
+	}
+	if ((texture.ID != 0) && (texture.ID != m_placeholderTextureID))
+	{
+		glDeleteTextures(1, &texture.ID);
+	}
+	texture.ID = textureID;
 
-	if (NULL != m_pShaderManager)
+	// the texture parameters are frozen once a handle is created,
+	// so the handle is only made after the texture is complete
+	if (m_textureMode == TEXTURE_MODE_BINDLESS)
+	{
+		texture.handle = glGetTextureHandleARB(textureID);
+		glMakeTextureHandleResidentARB(texture.handle);
+	}
+	else if (m_textureMode == TEXTURE_MODE_SLOTS)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, false);
-		m_pShaderManager->setVec4Value(g_ColorValueName, currentColor);
+		glActiveTexture(GL_TEXTURE0 + textureSlot);
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		glActiveTexture(GL_TEXTURE0);
+
+		// textures are created on unit 0, so put slot 0 back
+		glBindTexture(GL_TEXTURE_2D, m_textureIDs[0].ID);
 	}
 }
 
 /***********************************************************
- *  SetShaderTexture()
+ *  StartTextureDecoder()
  *
- *  This method is used for setting the texture data
- *  associated with the passed in ID into the shader.
+ *  This method is used for creating the worker threads that
+ *  decode the texture image files, the first time they are
+ *  needed.
  ***********************************************************/
-void SceneManager::SetShaderTexture(
-	std::string textureTag)
+void SceneManager::StartTextureDecoder()
 {
-	if (NULL != m_pShaderManager)
+	if (NULL == m_pTextureDecoder)
 	{
-		m_pShaderManager->setIntValue(g_UseTextureName, true);
-
-		int textureID = -1;
-		textureID = FindTextureSlot(textureTag);
-		m_pShaderManager->setSampler2DValue(g_TextureValueName, textureID);
+		m_pTextureDecoder = new TextureDecoder();
+		m_pTextureDecoder->SetTextureCache(m_pTextureCache);
+		m_pTextureDecoder->SetBuildMipChains(m_bStreamTextures);
+		m_pTextureDecoder->Start();
 	}
 }
 
 /***********************************************************
- *  SetTextureUVScale()
+ *  QueueGLTexture()
  *
- *  This method is used for setting the texture UV scale
- *  values into the shader.
+ *  This method is used for queueing a texture image file to
+ *  be decoded on the worker threads.  Decoding starts right
+ *  away, and the texture is created once CreateQueuedGLTextures()
+ *  is called.  When parallel loading is off, the texture is
+ *  loaded immediately on the calling thread.
  ***********************************************************/
-void SceneManager::SetTextureUVScale(float u, float v)
+void SceneManager::QueueGLTexture(const char* filename, std::string tag)
 {
-	if (NULL != m_pShaderManager)
+	// a streamed texture takes its slot right away and shows
+	// the placeholder until its first mip level is uploaded
+	if (m_bStreamTextures == true)
+	{
+		TEXTURE_INFO texture;
+		texture.ID = m_placeholderTextureID;
+		texture.tag = tag;
+		texture.filename = filename;
+		texture.width = 0;
+		texture.height = 0;
+		texture.arrayIndex = -1;
+		texture.layer = 0;
+		texture.handle = 0;
+		texture.atlasSlot = -1;
+		texture.atlasRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		RegisterTexture(texture);
+	}
+
+	// a packed texture needs no decoding at all
+	if (LoadPackedTexture(filename, tag))
+	{
+		return;
+	}
+
+	if (m_bParallelTextureLoading == false)
 	{
-		m_pShaderManager->setVec2Value("UVscale", glm::vec2(u, v));
+		CreateGLTexture(filename, tag);
+		return;
 	}
+
+	StartTextureDecoder();
+	m_pTextureDecoder->QueueImage(filename, tag);
 }
 
 /***********************************************************
- *  SetShaderMaterial()
+ *  CreateQueuedGLTextures()
  *
- *  This method is used for passing the material values
- *  into the shader.
+ *  This method is used for creating the OpenGL textures for
+ *  all of the queued texture images.  Each texture is uploaded
+ *  as soon as its image comes out of the decoded queue, while
+ *  the worker threads keep decoding the remaining images.
+ *  Streamed textures are not waited on here, they are picked
+ *  up by UpdateTextureStreaming() as the frames are drawn.
  ***********************************************************/
-void SceneManager::SetShaderMaterial(
-	std::string materialTag)
+void SceneManager::CreateQueuedGLTextures()
 {
-	if (m_objectMaterials.size() > 0)
+	if (m_bStreamTextures == true)
 	{
-		OBJECT_MATERIAL material;
-		bool bReturn = false;
+		return;
+	}
 
-		bReturn = FindMaterial(materialTag, material);
-		if (bReturn == true)
+	if (NULL != m_pTextureDecoder)
+	{
+		TextureDecoder::DECODED_IMAGE image;
+		while (m_pTextureDecoder->WaitForImage(image))
 		{
-			m_pShaderManager->setVec3Value("material.diffuseColor", material.diffuseColor);
-			m_pShaderManager->setVec3Value("material.specularColor", material.specularColor);
-			m_pShaderManager->setFloatValue("material.shininess", material.shininess);
+			AddDecodedImage(image);
 		}
 	}
-}
 
-/**************************************************************/
-/*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
-/*** preparing and rendering their own 3D replicated scenes.***/
-/*** Please refer to the code in the OpenGL sample project  ***/
-/*** for assistance.                                        ***/
-/**************************************************************/
+	// the texture arrays can only be sized once every image is in
+	if (m_arrayImages.size() > 0)
+	{
+		BuildGLTextureArrays();
+	}
+
+	// nor can the atlases be packed
+	if (m_atlasImages.size() > 0)
+	{
+		BuildGLTextureAtlases();
+	}
+
+	// the whole load counts as one frame of uploads
+	EndTextureUploadFrame();
+}
 
 /***********************************************************
- *  LoadSceneTextures()
+ *  AddDecodedImage()
  *
- *  This method is used for preparing the 3D scene by loading
- *  the shapes, textures in memory to support the 3D scene
- *  rendering
+ *  This method is used for handing a decoded image to OpenGL.
+ *  A small image is held until all of the images are decoded
+ *  and can be packed into atlases, in array mode the image is
+ *  held until they can be packed by size, and in streaming
+ *  mode it is held until all of its mip levels are streamed
+ *  in, otherwise it is uploaded right away.  An image loaded
+ *  again for an evicted texture, or for a changed image file,
+ *  replaces the texture already loaded for its tag.  The image
+ *  data is freed either way.
  ***********************************************************/
-void SceneManager::LoadSceneTextures()
+bool SceneManager::AddDecodedImage(TextureDecoder::DECODED_IMAGE& image)
 {
 	bool bReturn = false;
+	int textureSlot = -1;
 
-	bReturn = CreateGLTexture(
-		"textures/cork.jpg",
-		"bottle-cork");
-
-	bReturn = CreateGLTexture(
-		"textures/draught-living-death.jpg",
-		"draught-potion");
-
-	bReturn = CreateGLTexture(
-		"textures/twine-black.png",
-		"black-twine");
-
-	bReturn = CreateGLTexture(
-		"textures/wood-seamless.jpg",
-		"table");
+	if (m_bStreamTextures == true)
+	{
+		return(StartTextureStreaming(image));
+	}
 
-	bReturn = CreateGLTexture(
-		"textures/twine-brown.png",
-		"brown-twine");
+	textureSlot = FindTextureSlot(image.tag);
+	if (textureSlot >= 0)
+	{
+		bReturn = ReloadGLTexture(image, textureSlot);
+		TextureDecoder::FreeImage(image);
+		return(bReturn);
+	}
 
-	bReturn = CreateGLTexture(
-		"textures/wall.jpg",
-		"background");
+	// a small image is held until every image is in, so the
+	// atlases can be packed tallest image first
+	if ((m_bUseTextureAtlas == true) && (textureSlot < 0) && (NULL != image.pixels) &&
+		(image.width <= TextureAtlas::MAX_IMAGE_SIZE) && (image.height <= TextureAtlas::MAX_IMAGE_SIZE))
+	{
+		if (image.mipLevels == 1)
+		{
+			TextureDecoder::BuildMipChain(image);
+		}
+		if (TextureAtlas::Accepts(image))
+		{
+			// the held image is freed after it is packed
+			m_atlasImages.push_back(image);
+			image.pixels = NULL;
+			image.bMappedPixels = false;
+			return(true);
+		}
+	}
 
-	bReturn = CreateGLTexture(
-		"textures/amortentia.jpg",
-		"love-potion");
+	if ((m_textureMode == TEXTURE_MODE_ARRAYS) && (NULL != image.pixels))
+	{
+		// the held image is freed after it is packed
+		m_arrayImages.push_back(image);
+		image.pixels = NULL;
+		return(true);
+	}
 
-	bReturn = CreateGLTexture(
-		"textures/felix.jpg",
-		"lucky-potion");
+	bReturn = UploadGLTexture(image);
 
-	bReturn = CreateGLTexture(
-		"textures/thunderbrew.jpg",
-		"stun-potion");
+	// free the image data from local memory
+	TextureDecoder::FreeImage(image);
 
-	// after the texture image data is loaded into memory, the
-	// loaded textures need to be bound to texture slots - there
-	// are a total of 16 available slots for scene textures
-	BindGLTextures();
+	return(bReturn);
 }
 
-void SceneManager::DefineObjectMaterials()
+/***********************************************************
+ *  BuildGLTextureArrays()
+ *
+ *  This method is used for packing the held images into
+ *  texture arrays.  Images with the same width and height
+ *  share one GL_TEXTURE_2D_ARRAY, one layer per image, so the
+ *  whole scene needs only one texture unit per image size.
+ ***********************************************************/
+void SceneManager::BuildGLTextureArrays()
 {
+	std::vector<bool> bPacked(m_arrayImages.size(), false);
 
-	OBJECT_MATERIAL woodMaterial;
-	woodMaterial.diffuseColor = glm::vec3(0.2f, 0.2f, 0.3f);
-	woodMaterial.specularColor = glm::vec3(0.0f, 0.0f, 0.0f);
-	woodMaterial.shininess = 0.1;
-	woodMaterial.tag = "wood";
-
-	m_objectMaterials.push_back(woodMaterial);
-
-	OBJECT_MATERIAL glassMaterial;
-	glassMaterial.diffuseColor = glm::vec3(0.478f, 0.478f, 0.478f);
-	glassMaterial.specularColor = glm::vec3(1.0f, 1.0f, 1.0f);
-	glassMaterial.shininess = 98.0;
-	glassMaterial.tag = "glass";
-
-	m_objectMaterials.push_back(glassMaterial);
-
-	OBJECT_MATERIAL wallMaterial;
-	wallMaterial.diffuseColor = glm::vec3(0.8f, 0.8f, 0.9f);
-	wallMaterial.specularColor = glm::vec3(0.0f, 0.0f, 0.0f);
-	wallMaterial.shininess = 2.0;
-	wallMaterial.tag = "wall";
-
-	m_objectMaterials.push_back(wallMaterial);
+	for (size_t i = 0; i < m_arrayImages.size(); i++)
+	{
+		if (bPacked[i] == true)
+		{
+			continue;
+		}
 
-	OBJECT_MATERIAL twineMaterial;
-	twineMaterial.diffuseColor = glm::vec3(0.1f, 0.1f, 0.1f);
-	twineMaterial.specularColor = glm::vec3(0.1f, 0.1f, 0.1f);
-	twineMaterial.shininess = 0.2;
-	twineMaterial.tag = "twine";
+		// gather every image with the same size as this one
+		std::vector<size_t> layerImages;
+		for (size_t j = i; j < m_arrayImages.size(); j++)
+		{
+			if ((bPacked[j] == false) &&
+				(m_arrayImages[j].width == m_arrayImages[i].width) &&
+				(m_arrayImages[j].height == m_arrayImages[i].height) &&
+				(m_arrayImages[j].mipLevels == m_arrayImages[i].mipLevels))
+			{
+				layerImages.push_back(j);
+				bPacked[j] = true;
+			}
+		}
 
-	m_objectMaterials.push_back(twineMaterial);
+		TEXTURE_ARRAY textureArray;
+		textureArray.width = m_arrayImages[i].width;
+		textureArray.height = m_arrayImages[i].height;
+		textureArray.layers = (int)layerImages.size();
+		const int mipLevels = MipLevelCount(textureArray.width, textureArray.height);
+		const int imageMipLevels = m_arrayImages[i].mipLevels;
 
-	OBJECT_MATERIAL liquidMaterial;
-	liquidMaterial.diffuseColor = glm::vec3(0.329f, 0.212f, 0.4f);
-	liquidMaterial.specularColor = glm::vec3(0.1f, 0.05f, 0.1f);
-	liquidMaterial.shininess = 0.50;
-	liquidMaterial.tag = "liquid";
+		glGenTextures(1, &textureArray.ID);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
 
-	m_objectMaterials.push_back(liquidMaterial);
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	OBJECT_MATERIAL GlowingFMaterial;
-	GlowingFMaterial.diffuseColor = glm::vec3(0.929f, 0.961f, 0.424f);
-	GlowingFMaterial.specularColor = glm::vec3(0.1f, 0.1f, 0.1f);
-	GlowingFMaterial.shininess = 0.70;
-	GlowingFMaterial.tag = "felixGlow";
+		// RGB images are padded to RGBA by the decoder so that
+		// images with and without transparency can share an array
+		AllocateTextureStorage(GL_TEXTURE_2D_ARRAY, mipLevels, textureArray.width, textureArray.height, textureArray.layers);
 
-	m_objectMaterials.push_back(GlowingFMaterial);
+		for (int layer = 0; layer < textureArray.layers; layer++)
+		{
+			TextureDecoder::DECODED_IMAGE& image = m_arrayImages[layerImages[layer]];
+
+			std::cout << "Successfully loaded image:" << image.filename << ", width:" << image.width << ", height:" << image.height << ", channels:" << image.colorChannels << ", array:" << m_textureArrays.size() << ", layer:" << layer << std::endl;
+
+			if (image.colorChannels != 4)
+			{
+				std::cout << "Not implemented to handle image with " << image.colorChannels << " channels" << std::endl;
+				continue;
+			}
+
+			// upload the levels the image came with - just the first
+			// one unless the chain was precomputed
+			for (int level = 0; level < imageMipLevels; level++)
+			{
+				UploadTextureLevel(GL_TEXTURE_2D_ARRAY, level, layer,
+					TextureDecoder::MipDimension(image.width, level),
+					TextureDecoder::MipDimension(image.height, level),
+					image.pixels + image.mipOffsets[level]);
+			}
+
+			// register the layer and associate it with the special tag string
+			TEXTURE_INFO texture;
+			texture.ID = textureArray.ID;
+			texture.tag = image.tag;
+			texture.filename = image.filename;
+			texture.width = image.width;
+			texture.height = image.height;
+			texture.arrayIndex = (int)m_textureArrays.size();
+			texture.layer = layer;
+			texture.handle = 0;
+			texture.atlasSlot = -1;
+			texture.atlasRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+			const int textureSlot = RegisterTexture(texture);
+
+			// a layer shares its array, so it is never evicted
+			m_pTextureResidency->SetTexture(textureSlot,
+				TextureBytes(image.width, image.height, 0), 0, false);
+		}
 
-	OBJECT_MATERIAL GlowingLMaterial;
-	GlowingLMaterial.diffuseColor = glm::vec3(0.922f, 0.435f, 0.773f);
-	GlowingLMaterial.specularColor = glm::vec3(0.1f, 0.1f, 0.1f);
-	GlowingLMaterial.shininess = 0.70;
-	GlowingLMaterial.tag = "loveGlow";
+		// generate the texture mipmaps for every layer at once
+		if (imageMipLevels == 1)
+		{
+			glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		}
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
-	m_objectMaterials.push_back(GlowingLMaterial);
+		m_textureArrays.push_back(textureArray);
+	}
 
+	// free the image data from local memory
+	for (size_t i = 0; i < m_arrayImages.size(); i++)
+	{
+		TextureDecoder::FreeImage(m_arrayImages[i]);
+	}
+	m_arrayImages.clear();
 }
 
-void SceneManager::SetupSceneLights()
+/***********************************************************
+ *  BuildGLTextureAtlases()
+ *
+ *  This method is used for packing the held small images into
+ *  shared atlases, tallest image first, and loading each atlas
+ *  like any other image - as its own texture, texture array
+ *  layer or bindless handle.  Every packed image gets a slot
+ *  that points at its atlas slot with the UV offset and scale
+ *  of its rectangle, so consecutive draws of different small
+ *  textures need no texture state changes.
+ ***********************************************************/
+void SceneManager::BuildGLTextureAtlases()
 {
-	m_pShaderManager->setBoolValue(g_UseLightingName, true);
+	std::vector<TextureAtlas> atlases;
 
-	// directional light to emulate sunlight coming into scene
-	m_pShaderManager->setVec3Value("directionalLight.direction", -0.05f, -0.3f, -0.1f);
-	m_pShaderManager->setVec3Value("directionalLight.ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("directionalLight.diffuse", 0.6f, 0.6f, 0.6f);
-	m_pShaderManager->setVec3Value("directionalLight.specular", 0.0f, 0.0f, 0.0f);
-	m_pShaderManager->setBoolValue("directionalLight.bActive", true);
+	std::sort(m_atlasImages.begin(), m_atlasImages.end(),
+		[](const TextureDecoder::DECODED_IMAGE& a, const TextureDecoder::DECODED_IMAGE& b)
+		{
+			return(a.height > b.height);
+		});
 
-	// point light 1
-	m_pShaderManager->setVec3Value("pointLights[0].position", -4.0f, 8.0f, 0.0f);
-	m_pShaderManager->setVec3Value("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[0].diffuse", 0.3f, 0.3f, 0.3f);
-	m_pShaderManager->setVec3Value("pointLights[0].specular", 0.1f, 0.1f, 0.1f);
-	m_pShaderManager->setBoolValue("pointLights[0].bActive", true);
-	// point light 2
-	m_pShaderManager->setVec3Value("pointLights[1].position", 4.0f, 8.0f, 0.0f);
-	m_pShaderManager->setVec3Value("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[1].diffuse", 0.3f, 0.3f, 0.3f);
-	m_pShaderManager->setVec3Value("pointLights[1].specular", 0.1f, 0.1f, 0.1f);
-	m_pShaderManager->setBoolValue("pointLights[1].bActive", true);
-	// point light 3
-	m_pShaderManager->setVec3Value("pointLights[2].position", 3.8f, 5.5f, 4.0f);
-	m_pShaderManager->setVec3Value("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[2].diffuse", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setVec3Value("pointLights[2].specular", 0.8f, 0.8f, 0.8f);
-	m_pShaderManager->setBoolValue("pointLights[2].bActive", true);
-	// point light 4
-	m_pShaderManager->setVec3Value("pointLights[3].position", 5.0f, 6.5f, 6.0f);
-	m_pShaderManager->setVec3Value("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-	m_pShaderManager->setVec3Value("pointLights[3].diffuse", 0.2f, 0.2f, 0.2f);
-	m_pShaderManager->setVec3Value("pointLights[3].specular", 0.8f, 0.8f, 0.8f);
-	m_pShaderManager->setBoolValue("pointLights[3].bActive", true);
+	for (size_t i = 0; i < m_atlasImages.size(); i++)
+	{
+		if ((atlases.size() == 0) || (atlases.back().Add(m_atlasImages[i]) == false))
+		{
+			atlases.push_back(TextureAtlas(TEXTURE_ATLAS_SIZE));
+			atlases.back().Add(m_atlasImages[i]);
+		}
+	}
 
+	for (size_t i = 0; i < atlases.size(); i++)
+	{
+		TextureDecoder::DECODED_IMAGE atlasImage;
+		atlasImage.tag = "texture-atlas-" + std::to_string(i);
+		atlasImage.filename = atlasImage.tag;
+		if (atlases[i].Build(atlasImage) == false)
+		{
+			std::cout << "Could not build texture atlas:" << atlasImage.tag << std::endl;
+			continue;
+		}
 
-}
+		std::string atlasTag = atlasImage.tag;
+		AddDecodedImage(atlasImage);
+		if (m_arrayImages.size() > 0)
+		{
+			BuildGLTextureArrays();
+		}
 
-/***********************************************************
+		const int atlasSlot = FindTextureSlot(atlasTag);
+		if (atlasSlot < 0)
+		{
+			continue;
+		}
+
+		// an atlas has no image file to be loaded again from, so
+		// it is never evicted
+		m_pTextureResidency->SetTexture(atlasSlot,
+			TextureBytes(TEXTURE_ATLAS_SIZE, TEXTURE_ATLAS_SIZE, 0), 0, false);
+
+		// register the packed images and associate them with
+		// their special tag strings
+		const std::vector<TextureAtlas::ATLAS_ENTRY>& entries = atlases[i].GetEntries();
+		for (size_t j = 0; j < entries.size(); j++)
+		{
+			std::cout << "Packed image:" << entries[j].filename << " into texture atlas:" << atlasTag << std::endl;
+
+			TEXTURE_INFO texture;
+			texture.ID = m_textureIDs[atlasSlot].ID;
+			texture.tag = entries[j].tag;
+			texture.filename = entries[j].filename;
+			texture.width = entries[j].width;
+			texture.height = entries[j].height;
+			texture.arrayIndex = m_textureIDs[atlasSlot].arrayIndex;
+			texture.layer = m_textureIDs[atlasSlot].layer;
+			texture.handle = 0;
+			texture.atlasSlot = atlasSlot;
+			texture.atlasRect = entries[j].rect;
+			RegisterTexture(texture);
+		}
+	}
+
+	// free the image data from local memory
+	for (size_t i = 0; i < m_atlasImages.size(); i++)
+	{
+		TextureDecoder::FreeImage(m_atlasImages[i]);
+	}
+	m_atlasImages.clear();
+}
+
+/***********************************************************
+ *  CreatePlaceholderTexture()
+ *
+ *  This method is used for creating the single grey pixel
+ *  texture that is drawn in the slot of a streamed texture
+ *  until the first of its mip levels has been uploaded.
+ ***********************************************************/
+void SceneManager::CreatePlaceholderTexture()
+{
+	const unsigned char greyPixel[4] = { 128, 128, 128, 255 };
+
+	if (m_placeholderTextureID != 0)
+	{
+		return;
+	}
+
+	glGenTextures(1, &m_placeholderTextureID);
+	glBindTexture(GL_TEXTURE_2D, m_placeholderTextureID);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, greyPixel);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+/***********************************************************
+ *  StartTextureStreaming()
+ *
+ *  This method is used for holding a decoded image until its
+ *  mip levels have been streamed into the texture slot that
+ *  was reserved for its tag.  Images without a precomputed
+ *  mip chain have one computed here.  A slot with no texture
+ *  unit of its own, at or past the unit the unused sampler is
+ *  parked on, cannot be streamed into and fails the texture.
+ ***********************************************************/
+bool SceneManager::StartTextureStreaming(TextureDecoder::DECODED_IMAGE& image)
+{
+	const int textureSlot = FindTextureSlot(image.tag);
+
+	if ((NULL == image.pixels) || (textureSlot < 0))
+	{
+		std::cout << "Could not load image:" << image.filename << std::endl;
+		TextureDecoder::FreeImage(image);
+		return(false);
+	}
+
+	// the streamed levels are uploaded on the unit of the slot
+	if (textureSlot >= m_maxTextureUnits - 1)
+	{
+		std::cout << "No texture slot available for texture:" << m_textureIDs[textureSlot].tag << std::endl;
+		TextureDecoder::FreeImage(image);
+		return(false);
+	}
+
+	if ((image.mipLevels == 1) && (TextureDecoder::BuildMipChain(image) == false))
+	{
+		std::cout << "Not implemented to handle image with " << image.colorChannels << " channels" << std::endl;
+		TextureDecoder::FreeImage(image);
+		return(false);
+	}
+
+	std::cout << "Successfully loaded image:" << image.filename << ", width:" << image.width << ", height:" << image.height << ", channels:" << image.colorChannels << ", streaming " << image.mipLevels << " mip levels" << std::endl;
+
+	// an image file changed while its texture is still streaming
+	// starts the streaming over with the new image
+	for (size_t i = 0; i < m_streamingTextures.size(); i++)
+	{
+		if (m_streamingTextures[i].slot == textureSlot)
+		{
+			TextureDecoder::FreeImage(m_streamingTextures[i].image);
+			m_streamingTextures.erase(m_streamingTextures.begin() + i);
+			break;
+		}
+	}
+
+	// the held image is freed once its last level is uploaded
+	STREAMING_TEXTURE streaming;
+	streaming.slot = textureSlot;
+	streaming.ID = 0;
+	streaming.image = image;
+	streaming.nextLevel = image.mipLevels - 1;
+	m_streamingTextures.push_back(streaming);
+	image.pixels = NULL;
+
+	return(true);
+}
+
+/***********************************************************
+ *  StreamNextMipLevel()
+ *
+ *  This method is used for uploading the next mip level of a
+ *  streamed texture, one step finer than the levels uploaded
+ *  so far.  GL_TEXTURE_BASE_LEVEL is clamped to the finest
+ *  uploaded level, so the shader never samples a level that
+ *  has not arrived yet.  The texture is uploaded on its own
+ *  texture unit, where it stays bound for rendering - the
+ *  slot was checked to have one when streaming started.
+ ***********************************************************/
+void SceneManager::StreamNextMipLevel(STREAMING_TEXTURE& streaming)
+{
+	const TextureDecoder::DECODED_IMAGE& image = streaming.image;
+	const int level = streaming.nextLevel;
+
+	glActiveTexture(GL_TEXTURE0 + streaming.slot);
+
+	if (streaming.ID == 0)
+	{
+		glGenTextures(1, &streaming.ID);
+		glBindTexture(GL_TEXTURE_2D, streaming.ID);
+
+		// set the texture wrapping parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		// set texture filtering parameters
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		// allocate every level up front, so the later levels
+		// only fill in storage that already exists
+		AllocateTextureStorage(GL_TEXTURE_2D, image.mipLevels, image.width, image.height, 0);
+
+		// the slot draws the streamed texture from now on, and the
+		// storage counts in full even though it is still filling
+		m_textureIDs[streaming.slot].width = image.width;
+		m_textureIDs[streaming.slot].height = image.height;
+		ReplaceGLTexture(streaming.slot, streaming.ID);
+		m_pTextureResidency->SetTexture(streaming.slot,
+			TextureBytes(image.width, image.height, 0), 0, false);
+
+		glActiveTexture(GL_TEXTURE0 + streaming.slot);
+	}
+	else
+	{
+		glBindTexture(GL_TEXTURE_2D, streaming.ID);
+	}
+
+	UploadTextureLevel(GL_TEXTURE_2D, level, 0,
+		TextureDecoder::MipDimension(image.width, level),
+		TextureDecoder::MipDimension(image.height, level),
+		image.pixels + image.mipOffsets[level]);
+
+	// let the shader sample down to the level just uploaded
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+
+	glActiveTexture(GL_TEXTURE0);
+
+	streaming.nextLevel--;
+}
+
+/***********************************************************
+ *  EvictGLTexture()
+ *
+ *  This method is used for freeing most of the video memory a
+ *  texture holds.  Its low mip levels, no larger than 64 x 64,
+ *  are put in a new texture in the same slot from the copy
+ *  kept when it was loaded, so the objects drawn with it only
+ *  lose detail and nothing is read back from video memory.
+ *  The full image is loaded again when the texture is next
+ *  drawn.
+ ***********************************************************/
+void SceneManager::EvictGLTexture(int textureSlot)
+{
+	const TEXTURE_INFO& texture = m_textureIDs[textureSlot];
+	const int firstLevel = EvictedMipLevel(texture.width, texture.height);
+	const std::vector<unsigned char>& pixels = texture.evictedPixels;
+	GLuint textureID = 0;
+	size_t offset = 0;
+
+	// count the levels from the first kept one down to 1 x 1
+	int mipLevels = 0;
+	for (int level = firstLevel; ; level++)
+	{
+		mipLevels++;
+		if ((TextureDecoder::MipDimension(texture.width, level) == 1) &&
+			(TextureDecoder::MipDimension(texture.height, level) == 1))
+		{
+			break;
+		}
+	}
+
+	glGenTextures(1, &textureID);
+	glBindTexture(GL_TEXTURE_2D, textureID);
+
+	// set the texture wrapping parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	// set texture filtering parameters
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	AllocateTextureStorage(GL_TEXTURE_2D, mipLevels,
+		TextureDecoder::MipDimension(texture.width, firstLevel),
+		TextureDecoder::MipDimension(texture.height, firstLevel), 0);
+
+	for (int level = 0; level < mipLevels; level++)
+	{
+		const int mipWidth = TextureDecoder::MipDimension(texture.width, firstLevel + level);
+		const int mipHeight = TextureDecoder::MipDimension(texture.height, firstLevel + level);
+		UploadTextureLevel(GL_TEXTURE_2D, level, 0, mipWidth, mipHeight, &pixels[offset]);
+		offset += (size_t)mipWidth * mipHeight * 4;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	std::cout << "Evicted texture:" << texture.tag << " to "
+		<< TextureDecoder::MipDimension(texture.width, firstLevel) << "x"
+		<< TextureDecoder::MipDimension(texture.height, firstLevel) << std::endl;
+
+	ReplaceGLTexture(textureSlot, textureID);
+	m_pTextureResidency->SetEvicted(textureSlot);
+}
+
+/***********************************************************
+ *  RestoreGLTexture()
+ *
+ *  This method is used for loading the full image of an
+ *  evicted texture again.  A packed texture is put back into
+ *  its slot right away, straight from the mapped asset pack.
+ *  Otherwise the image is decoded on the worker threads,
+ *  through the texture cache, and put back into the texture's
+ *  slot when it is collected at the next frame.
+ ***********************************************************/
+void SceneManager::RestoreGLTexture(int textureSlot)
+{
+	const TEXTURE_INFO& texture = m_textureIDs[textureSlot];
+
+	m_pTextureResidency->SetRestoring(textureSlot);
+
+	if (LoadPackedTexture(texture.filename.c_str(), texture.tag))
+	{
+		return;
+	}
+
+	if (m_bParallelTextureLoading == false)
+	{
+		CreateGLTexture(texture.filename.c_str(), texture.tag);
+		return;
+	}
+
+	StartTextureDecoder();
+	m_pTextureDecoder->QueueImage(texture.filename.c_str(), texture.tag);
+}
+
+/***********************************************************
+ *  OpenAssetPack()
+ *
+ *  This method is used for mapping the asset pack into memory
+ *  when it has been built with --pack.  Without a pack, the
+ *  textures are loaded from the loose image files.
+ ***********************************************************/
+void SceneManager::OpenAssetPack()
+{
+	if ((m_bUseAssetPack == false) || (m_pAssetPack->IsOpen()))
+	{
+		return;
+	}
+
+	if (m_pAssetPack->Open(g_AssetPackName))
+	{
+		std::cout << "Loading textures from asset pack:" << g_AssetPackName << std::endl;
+	}
+}
+
+/***********************************************************
+ *  LoadPackedTexture()
+ *
+ *  This method is used for loading a texture from the mapped
+ *  asset pack.  The packed mip chain is handed to OpenGL
+ *  straight from the mapping, with no decoding and no copy
+ *  into local memory.  Returns false when the texture is not
+ *  in the pack, so it can be loaded from its image file.
+ ***********************************************************/
+bool SceneManager::LoadPackedTexture(const char* filename, std::string tag)
+{
+	TextureDecoder::DECODED_IMAGE image;
+
+	// an image file edited since the pack was built is newer
+	if ((m_bUseAssetPack == false) ||
+		(m_stalePackedTextures.count(ResourceTag(tag).GetHash()) > 0) ||
+		(m_pAssetPack->GetImage(tag, image) == false))
+	{
+		return(false);
+	}
+
+	image.filename = filename;
+	AddDecodedImage(image);
+
+	return(true);
+}
+
+/***********************************************************
+ *  ReloadGLTexture()
+ *
+ *  This method is used for putting an image in place of the
+ *  texture already loaded for its tag - an evicted texture
+ *  being restored, or a texture whose image file changed.  A
+ *  texture gets a new OpenGL texture, while a texture array
+ *  layer or an atlas cell is overwritten in place, which only
+ *  works while the image keeps its size.
+ ***********************************************************/
+bool SceneManager::ReloadGLTexture(TextureDecoder::DECODED_IMAGE& image, int textureSlot)
+{
+	TEXTURE_INFO& texture = m_textureIDs[textureSlot];
+
+	if ((NULL == image.pixels) || (image.colorChannels != 4))
+	{
+		std::cout << "Could not load image:" << image.filename << std::endl;
+		return(false);
+	}
+
+	if (texture.atlasSlot >= 0)
+	{
+		return(ReloadAtlasTexture(image, textureSlot));
+	}
+
+	if (texture.arrayIndex < 0)
+	{
+		texture.width = image.width;
+		texture.height = image.height;
+		return(UploadGLTexture(image, textureSlot));
+	}
+
+	const TEXTURE_ARRAY& textureArray = m_textureArrays[texture.arrayIndex];
+	if ((image.width != textureArray.width) || (image.height != textureArray.height))
+	{
+		std::cout << "Could not reload image:" << image.filename << ", its size changed - restart to load it" << std::endl;
+		return(false);
+	}
+
+	// upload on the array's own unit, so the bindings stay as
+	// they are
+	glActiveTexture(GL_TEXTURE0 + texture.arrayIndex);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray.ID);
+	for (int level = 0; level < image.mipLevels; level++)
+	{
+		UploadTextureLevel(GL_TEXTURE_2D_ARRAY, level, texture.layer,
+			TextureDecoder::MipDimension(image.width, level),
+			TextureDecoder::MipDimension(image.height, level),
+			image.pixels + image.mipOffsets[level]);
+	}
+	if (image.mipLevels == 1)
+	{
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	std::cout << "Reloaded image:" << image.filename << ", array:" << texture.arrayIndex << ", layer:" << texture.layer << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  ReloadAtlasTexture()
+ *
+ *  This method is used for putting an image into its cell of
+ *  a texture atlas.  The mip levels with exact cells are
+ *  rewritten from the image's own mip chain, border and all,
+ *  while the smaller levels, which blend whole cells together,
+ *  keep the old image until the atlas is built again.
+ ***********************************************************/
+bool SceneManager::ReloadAtlasTexture(TextureDecoder::DECODED_IMAGE& image, int textureSlot)
+{
+	const TEXTURE_INFO& texture = m_textureIDs[textureSlot];
+	const TEXTURE_INFO& atlas = m_textureIDs[texture.atlasSlot];
+
+	if ((image.width != texture.width) || (image.height != texture.height))
+	{
+		std::cout << "Could not reload image:" << image.filename << ", its size changed - restart to load it" << std::endl;
+		return(false);
+	}
+	if ((image.mipLevels == 1) && (TextureDecoder::BuildMipChain(image) == false))
+	{
+		std::cout << "Could not reload image:" << image.filename << std::endl;
+		return(false);
+	}
+
+	// upload on the atlas's own unit, so the bindings stay as
+	// they are - bindless textures are not bound to a unit
+	GLenum target = GL_TEXTURE_2D;
+	GLuint atlasID = atlas.ID;
+	int unit = 0;
+	if (atlas.arrayIndex >= 0)
+	{
+		target = GL_TEXTURE_2D_ARRAY;
+		atlasID = m_textureArrays[atlas.arrayIndex].ID;
+		unit = atlas.arrayIndex;
+	}
+	else if (m_textureMode == TEXTURE_MODE_SLOTS)
+	{
+		unit = texture.atlasSlot;
+	}
+	glActiveTexture(GL_TEXTURE0 + unit);
+	glBindTexture(target, atlasID);
+
+	const int x = (int)(texture.atlasRect.x * TEXTURE_ATLAS_SIZE + 0.5f);
+	const int y = (int)(texture.atlasRect.y * TEXTURE_ATLAS_SIZE + 0.5f);
+	std::vector<unsigned char> cell;
+	for (int level = 0; level < TextureAtlas::ExactMipLevels(); level++)
+	{
+		const int border = TextureAtlas::BORDER >> level;
+		const int cellWidth = TextureDecoder::MipDimension(image.width, level) + border * 2;
+		const int cellHeight = TextureDecoder::MipDimension(image.height, level) + border * 2;
+
+		cell.resize((size_t)cellWidth * cellHeight * 4);
+		TextureAtlas::ComposeCell(image, level, cell.data(), cellWidth);
+		UploadTextureRegion(target, level, atlas.layer,
+			(x >> level) - border, (y >> level) - border, cellWidth, cellHeight, cell.data());
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	std::cout << "Reloaded image:" << image.filename << ", texture atlas:" << atlas.tag << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  BindGLTextures()
+ *
+ *  This method is used for binding the loaded textures to
+ *  OpenGL texture memory slots.  In slot mode each texture
+ *  takes a slot, in array mode each texture array takes a
+ *  slot, and in bindless mode no slots are needed at all.
+ ***********************************************************/
+void SceneManager::BindGLTextures()
+{
+	// two sampler types cannot point at the same texture unit
+	// in one draw, so the sampler that is not in use is parked
+	// on the last texture unit
+	const int spareUnit = m_maxTextureUnits - 1;
+
+	if (m_textureMode == TEXTURE_MODE_ARRAYS)
+	{
+		for (int i = 0; i < (int)m_textureArrays.size(); i++)
+		{
+			// bind texture arrays on corresponding texture units
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D_ARRAY, m_textureArrays[i].ID);
+		}
+	}
+	else if (m_textureMode == TEXTURE_MODE_SLOTS)
+	{
+		for (int i = 0; i < (int)m_textureIDs.size(); i++)
+		{
+			if (i >= spareUnit)
+			{
+				std::cout << "No texture slot available for texture:" << m_textureIDs[i].tag << std::endl;
+				break;
+			}
+
+			// textures in an atlas are drawn from the atlas unit
+			if (m_textureIDs[i].atlasSlot >= 0)
+			{
+				continue;
+			}
+
+			// bind textures on corresponding texture units
+			glActiveTexture(GL_TEXTURE0 + i);
+			glBindTexture(GL_TEXTURE_2D, m_textureIDs[i].ID);
+		}
+	}
+	glActiveTexture(GL_TEXTURE0);
+
+	SetTextureSamplers();
+}
+
+/***********************************************************
+ *  SetTextureSamplers()
+ *
+ *  This method is used for telling the current program which
+ *  sampler the texture mode draws with.  The other sampler is
+ *  parked on the last texture unit.
+ ***********************************************************/
+void SceneManager::SetTextureSamplers()
+{
+	const int spareUnit = m_maxTextureUnits - 1;
+
+	if (m_textureMode == TEXTURE_MODE_ARRAYS)
+	{
+		m_pShaderUniforms->Set(m_uniforms.useTextureArray, true);
+		m_pShaderUniforms->Set(m_uniforms.objectTexture, spareUnit);
+	}
+	else
+	{
+		m_pShaderUniforms->Set(m_uniforms.useTextureArray, false);
+		m_pShaderUniforms->Set(m_uniforms.objectTextureArray, spareUnit);
+	}
+}
+
+/***********************************************************
+ *  DestroyGLTextures()
+ *
+ *  This method is used for freeing the memory in all the
+ *  used texture memory slots.
+ ***********************************************************/
+void SceneManager::DestroyGLTextures()
+{
+	for (int i = 0; i < (int)m_textureIDs.size(); i++)
+	{
+		// textures in an array are freed with the array, and
+		// textures in an atlas with the atlas
+		if ((m_textureIDs[i].arrayIndex >= 0) || (m_textureIDs[i].atlasSlot >= 0))
+		{
+			continue;
+		}
+
+		// the placeholder is shared by the streamed textures
+		if (m_textureIDs[i].ID == m_placeholderTextureID)
+		{
+			continue;
+		}
+
+		if (m_textureIDs[i].handle != 0)
+		{
+			glMakeTextureHandleNonResidentARB(m_textureIDs[i].handle);
+		}
+		glDeleteTextures(1, &m_textureIDs[i].ID);
+	}
+	m_textureIDs.clear();
+	m_textureSlots.clear();
+
+	if (NULL != m_pTextureResidency)
+	{
+		m_pTextureResidency->Clear();
+	}
+
+	for (int i = 0; i < (int)m_streamingTextures.size(); i++)
+	{
+		TextureDecoder::FreeImage(m_streamingTextures[i].image);
+	}
+	m_streamingTextures.clear();
+
+	if (m_placeholderTextureID != 0)
+	{
+		glDeleteTextures(1, &m_placeholderTextureID);
+		m_placeholderTextureID = 0;
+	}
+
+	for (int i = 0; i < (int)m_textureArrays.size(); i++)
+	{
+		glDeleteTextures(1, &m_textureArrays[i].ID);
+	}
+	m_textureArrays.clear();
+}
+
+/***********************************************************
+ *  FindTextureID()
+ *
+ *  This method is used for getting an ID for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureID(ResourceTag tag)
+{
+	int textureID = -1;
+	int textureSlot = FindTextureSlot(tag);
+
+	if (textureSlot >= 0)
+	{
+		textureID = m_textureIDs[textureSlot].ID;
+	}
+
+	return(textureID);
+}
+
+/***********************************************************
+ *  FindTextureSlot()
+ *
+ *  This method is used for getting a slot index for the previously
+ *  loaded texture bitmap associated with the passed in tag.
+ ***********************************************************/
+int SceneManager::FindTextureSlot(ResourceTag tag)
+{
+	int textureSlot = -1;
+
+	std::unordered_map<uint32_t, int>::const_iterator found = m_textureSlots.find(tag.GetHash());
+	if (found != m_textureSlots.end())
+	{
+		textureSlot = found->second;
+	}
+
+	return(textureSlot);
+}
+
+/***********************************************************
+ *  AddObjectMaterial()
+ *
+ *  This method is used for adding a material defined in code
+ *  and indexing it by the hash of its tag.  These materials
+ *  follow the materials of the library.
+ ***********************************************************/
+void SceneManager::AddObjectMaterial(const OBJECT_MATERIAL& material)
+{
+	const int index = (int)m_objectMaterials.size();
+
+	m_objectMaterials.push_back(material);
+
+	// the first material with a tag keeps it, as with a search
+	std::pair<std::unordered_map<uint32_t, int>::iterator, bool> result =
+		m_materialIndices.insert(std::make_pair(ResourceTag(material.tag).GetHash(), index));
+	if ((result.second == false) && (m_objectMaterials[result.first->second].tag != material.tag))
+	{
+		std::cout << "Material tag " << material.tag << " has the same hash as " << m_objectMaterials[result.first->second].tag << std::endl;
+	}
+}
+
+/***********************************************************
+ *  FindMaterialIndex()
+ *
+ *  This method is used for getting the index of the material
+ *  from the previously defined materials list that is
+ *  associated with the passed in tag, or -1.
+ ***********************************************************/
+int SceneManager::FindMaterialIndex(ResourceTag tag)
+{
+	int materialIndex = m_pMaterialLibrary->FindMaterial(tag);
+
+	if (materialIndex < 0)
+	{
+		std::unordered_map<uint32_t, int>::const_iterator found = m_materialIndices.find(tag.GetHash());
+		if (found != m_materialIndices.end())
+		{
+			materialIndex = m_pMaterialLibrary->GetMaterialCount() + found->second;
+		}
+	}
+
+	return(materialIndex);
+}
+
+/***********************************************************
+ *  CreateMaterialBuffer()
+ *
+ *  This method is used for uploading every defined material
+ *  into a std140 uniform buffer once, so each draw selects
+ *  its material with a single integer index instead of
+ *  setting the material values.
+ ***********************************************************/
+void SceneManager::CreateMaterialBuffer()
+{
+	const int libraryCount = std::min(m_pMaterialLibrary->GetMaterialCount(), MAX_MATERIALS);
+	const size_t materialCount = m_pMaterialLibrary->GetMaterialCount() + m_objectMaterials.size();
+	if (materialCount > (size_t)MAX_MATERIALS)
+	{
+		std::cout << "Only the first " << MAX_MATERIALS << " of " << materialCount << " materials fit the material buffer" << std::endl;
+	}
+
+	// the library records are already in the std140 layout
+	std::vector<MaterialLibrary::MATERIAL_RECORD> materials;
+	for (size_t i = 0; (i < m_objectMaterials.size()) && (libraryCount + i < (size_t)MAX_MATERIALS); i++)
+	{
+		MaterialLibrary::MATERIAL_RECORD material;
+		material.diffuseColor = m_objectMaterials[i].diffuseColor;
+		material.padding = 0.0f;
+		material.specularColor = m_objectMaterials[i].specularColor;
+		material.shininess = m_objectMaterials[i].shininess;
+		materials.push_back(material);
+	}
+
+	if (m_materialBufferID == 0)
+	{
+		glGenBuffers(1, &m_materialBufferID);
+	}
+
+	// the block is sized for MAX_MATERIALS, so the whole array
+	// is backed even though only the defined ones are set, and
+	// the library records go straight from the mapping
+	glBindBuffer(GL_UNIFORM_BUFFER, m_materialBufferID);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialLibrary::MATERIAL_RECORD) * MAX_MATERIALS, NULL, GL_STATIC_DRAW);
+	if (libraryCount > 0)
+	{
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(MaterialLibrary::MATERIAL_RECORD) * libraryCount, m_pMaterialLibrary->GetMaterials());
+	}
+	if (materials.size() > 0)
+	{
+		glBufferSubData(GL_UNIFORM_BUFFER, sizeof(MaterialLibrary::MATERIAL_RECORD) * libraryCount,
+			sizeof(MaterialLibrary::MATERIAL_RECORD) * materials.size(), materials.data());
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, UniformBlocks::MATERIAL_BINDING, m_materialBufferID);
+
+	BindUniformBlocks();
+}
+
+/***********************************************************
+ *  BindUniformBlocks()
+ *
+ *  This method is used for pointing the material, frame and
+ *  light blocks of the current program at their bindings.
+ ***********************************************************/
+void SceneManager::BindUniformBlocks()
+{
+	GLint currentProgram = 0;
+
+	glGetIntegerv(GL_CURRENT_PROGRAM, &currentProgram);
+
+	UniformBlocks::BindProgram((GLuint)currentProgram);
+}
+
+/***********************************************************
+ *  ResolveShaderUniforms()
+ *
+ *  This method is used for finding the handles of the scene
+ *  uniforms in the reflected program once, so the per-draw
+ *  sets need no location lookup.  It is called again after
+ *  the shaders are reloaded.
+ ***********************************************************/
+void SceneManager::ResolveShaderUniforms()
+{
+	m_uniforms = SCENE_UNIFORMS();
+	if (NULL == m_pShaderUniforms)
+	{
+		return;
+	}
+
+	m_uniforms.model = m_pShaderUniforms->Find<glm::mat4>(g_ModelName);
+	m_uniforms.objectColor = m_pShaderUniforms->Find<glm::vec4>(g_ColorValueName);
+	m_uniforms.useTexture = m_pShaderUniforms->Find<bool>(g_UseTextureName);
+	m_uniforms.useTextureArray = m_pShaderUniforms->Find<bool>(g_UseTextureArrayName);
+	m_uniforms.useTextureAtlas = m_pShaderUniforms->Find<bool>(g_UseTextureAtlasName);
+	m_uniforms.objectTexture = m_pShaderUniforms->Find<int>(g_TextureValueName);
+	m_uniforms.objectTextureHandle = m_pShaderUniforms->Find<GLuint64>(g_TextureValueName);
+	m_uniforms.objectTextureArray = m_pShaderUniforms->Find<int>(g_TextureArrayValueName);
+	m_uniforms.objectTextureLayer = m_pShaderUniforms->Find<int>(g_TextureLayerName);
+	m_uniforms.objectTextureRect = m_pShaderUniforms->Find<glm::vec4>(g_TextureRectName);
+	m_uniforms.UVscale = m_pShaderUniforms->Find<glm::vec2>(g_UVScaleName);
+	m_uniforms.materialIndex = m_pShaderUniforms->Find<int>(g_MaterialIndexName);
+	m_uniforms.useLighting = m_pShaderUniforms->Find<bool>(g_UseLightingName);
+
+	m_programUniforms[m_pShaderUniforms->GetProgram()] = m_uniforms;
+}
+
+/***********************************************************
+ *  SetShaderVariants()
+ *
+ *  This method is used for setting the shader variants the
+ *  draws switch between.  With NULL every object is drawn
+ *  with the program loaded by the shader manager.
+ ***********************************************************/
+void SceneManager::SetShaderVariants(ShaderVariants* pShaderVariants)
+{
+	ReleaseShaderVariants();
+	m_pShaderVariants = pShaderVariants;
+	SetShaderVariantsEnabled(NULL != pShaderVariants);
+}
+
+/***********************************************************
+ *  SetShaderVariantsEnabled()
+ *
+ *  This method is used for switching between drawing with the
+ *  shader variants and with the program that branches at
+ *  runtime, to measure what the variants save.
+ ***********************************************************/
+void SceneManager::SetShaderVariantsEnabled(bool bEnabled)
+{
+	m_bUseShaderVariants = bEnabled && (NULL != m_pShaderVariants);
+	if (m_bUseShaderVariants == false)
+	{
+		UseProgram(m_baseProgram);
+	}
+}
+
+/***********************************************************
+ *  MakeVariantKey()
+ *
+ *  This method is used for describing the variant a draw
+ *  needs - its texturing, whether it is instanced or drawn
+ *  indirectly, and the lighting and lights of the scene.  An
+ *  indirect draw is always instanced.
+ ***********************************************************/
+ShaderVariants::VARIANT_KEY SceneManager::MakeVariantKey(bool bTexture, bool bInstanced, bool bIndirect) const
+{
+	ShaderVariants::VARIANT_KEY key;
+	key.bTexture = bTexture;
+	key.bLighting = m_bUseLighting;
+	key.bDirectionalLight = (m_lightData.directionalLight.bActive != 0);
+	key.bSpotLight = (m_lightData.spotLight.bActive != 0);
+	key.pointLights = m_activePointLights;
+	key.bInstanced = bInstanced || bIndirect;
+	key.bIndirect = bIndirect;
+
+	return(key);
+}
+
+/***********************************************************
+ *  PrefetchShaderVariants()
+ *
+ *  This method is used for starting the builds of the
+ *  variants the scene draws with, textured and not, once the
+ *  lights are set up.  They compile in the background while
+ *  the textures and meshes load, and the first draw collects
+ *  them.
+ ***********************************************************/
+void SceneManager::PrefetchShaderVariants()
+{
+	if (m_bUseShaderVariants == false)
+	{
+		return;
+	}
+
+	m_pShaderVariants->Prefetch(MakeVariantKey(false));
+	m_pShaderVariants->Prefetch(MakeVariantKey(true));
+	if (m_bUseInstancing == true)
+	{
+		m_pShaderVariants->Prefetch(MakeVariantKey(false, true));
+		m_pShaderVariants->Prefetch(MakeVariantKey(true, true));
+	}
+	if (m_bUseIndirectDraws == true)
+	{
+		m_pShaderVariants->Prefetch(MakeVariantKey(false, true, true));
+		m_pShaderVariants->Prefetch(MakeVariantKey(true, true, true));
+	}
+}
+
+/***********************************************************
+ *  SetShaderWarmupEnabled()
+ *
+ *  This method is used for turning the warm-up draw at the
+ *  end of PrepareScene() on or off, to measure the first
+ *  frame without it.
+ ***********************************************************/
+void SceneManager::SetShaderWarmupEnabled(bool bEnabled)
+{
+	m_bShaderWarmup = bEnabled;
+}
+
+/***********************************************************
+ *  SetShaderWarmupView()
+ *
+ *  This method is used for setting the view the warm-up draw
+ *  sees the scene from, which is the view of the starting
+ *  camera, and the color the frame loop clears to, so the
+ *  warm-up draws what the first frame draws.
+ ***********************************************************/
+void SceneManager::SetShaderWarmupView(const UniformBlocks::FRAME_DATA& frameData, const glm::vec4& clearColor)
+{
+	m_warmupFrameData = frameData;
+	m_warmupClearColor = clearColor;
+}
+
+/***********************************************************
+ *  WarmUpShaders()
+ *
+ *  This method is used for drawing the whole scene once into
+ *  a small offscreen target before the first frame.  Drivers
+ *  finish building a program, and the state it is drawn with,
+ *  at its first draw, so that cost lands here instead of on
+ *  the first visible frame.  The draw goes through
+ *  RenderScene(), so it uses exactly the variants, meshes,
+ *  textures and state of a real frame, seen from the starting
+ *  camera so every draw reaches the fragment shader.  The
+ *  driver is waited on before the time is reported.
+ ***********************************************************/
+void SceneManager::WarmUpShaders()
+{
+	if ((m_bShaderWarmup == false) || (NULL == m_pUniformBlocks))
+	{
+		return;
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	const int variantsBefore = (NULL != m_pShaderVariants) ? m_pShaderVariants->GetVariantCount() : 0;
+
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+
+	// color and depth formats match the default framebuffer
+	GLuint renderbuffers[2];
+	glGenRenderbuffers(2, renderbuffers);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, SHADER_WARMUP_TARGET_SIZE, SHADER_WARMUP_TARGET_SIZE);
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, SHADER_WARMUP_TARGET_SIZE, SHADER_WARMUP_TARGET_SIZE);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	GLuint framebuffer = 0;
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+
+	const bool bComplete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	if (bComplete == true)
+	{
+		glViewport(0, 0, SHADER_WARMUP_TARGET_SIZE, SHADER_WARMUP_TARGET_SIZE);
+		EnableDepthTest();
+		ClearFrame();
+
+		m_pUniformBlocks->SetFrameData(m_warmupFrameData);
+		RenderScene();
+		m_pUniformBlocks->EndFrame();
+		glFinish();
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(2, renderbuffers);
+	glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+	if (bComplete == false)
+	{
+		std::cout << "Could not create the shader warm-up target" << std::endl;
+		return;
+	}
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	const int variantsBuilt = ((NULL != m_pShaderVariants) ? m_pShaderVariants->GetVariantCount() : 0) - variantsBefore;
+	std::cout << "INFO: shader warm-up drew the scene offscreen in " << elapsed.count() << " ms, collecting "
+		<< variantsBuilt << " shader variants" << std::endl;
+}
+
+/***********************************************************
+ *  SelectShaderVariant()
+ *
+ *  This method is used for switching to the variant that is
+ *  specialized for the next draw - its texturing, whether it
+ *  is instanced or indirect, and the lighting and lights of
+ *  the scene.  A variant is built the first time a draw needs
+ *  it, and a variant that does not build leaves the draw on
+ *  the program that branches, which returns false.
+ ***********************************************************/
+bool SceneManager::SelectShaderVariant(bool bTexture, bool bInstanced, bool bIndirect)
+{
+	if (m_bUseShaderVariants == false)
+	{
+		return(false);
+	}
+
+	bool bBuilt = false;
+	GLuint program = m_pShaderVariants->GetProgram(MakeVariantKey(bTexture, bInstanced, bIndirect), bBuilt);
+	if (program == 0)
+	{
+		UseProgram(m_baseProgram);
+		return(false);
+	}
+
+	if (bBuilt == true)
+	{
+		PrepareVariantProgram(program);
+	}
+	UseProgram(program);
+
+	return(true);
+}
+
+/***********************************************************
+ *  PrepareVariantProgram()
+ *
+ *  This method is used for reading the uniforms of a newly
+ *  built variant and setting the ones that stay the same for
+ *  every draw - the block bindings and the texture samplers.
+ ***********************************************************/
+void SceneManager::PrepareVariantProgram(GLuint program)
+{
+	glUseProgram(program);
+	m_currentProgram = program;
+
+	m_pShaderUniforms->Reflect(program);
+	UniformBlocks::BindProgram(program);
+	ResolveShaderUniforms();
+	SetTextureSamplers();
+}
+
+/***********************************************************
+ *  UseProgram()
+ *
+ *  This method is used for putting a program in use for the
+ *  next draw, along with its uniform handles.  The model
+ *  matrix is set before the draw picks its variant, so it is
+ *  set again on the program that is switched to.
+ ***********************************************************/
+void SceneManager::UseProgram(GLuint program)
+{
+	if ((program == 0) || (NULL == m_pShaderUniforms))
+	{
+		return;
+	}
+
+	if (program != m_currentProgram)
+	{
+		glUseProgram(program);
+		m_pShaderUniforms->Select(program);
+		m_currentProgram = program;
+
+		std::unordered_map<GLuint, SCENE_UNIFORMS>::const_iterator found = m_programUniforms.find(program);
+		if (found != m_programUniforms.end())
+		{
+			m_uniforms = found->second;
+		}
+	}
+
+	m_pShaderUniforms->Set(m_uniforms.model, m_modelMatrix);
+}
+
+/***********************************************************
+ *  ReleaseShaderVariants()
+ *
+ *  This method is used for deleting the variant programs,
+ *  along with their uniform tables and handles, so they are
+ *  built again from the current shader sources.
+ ***********************************************************/
+void SceneManager::ReleaseShaderVariants()
+{
+	if (NULL == m_pShaderVariants)
+	{
+		return;
+	}
+
+	std::vector<GLuint> programs;
+	m_pShaderVariants->GetPrograms(programs);
+	for (size_t i = 0; i < programs.size(); i++)
+	{
+		if (NULL != m_pShaderUniforms)
+		{
+			m_pShaderUniforms->Forget(programs[i]);
+		}
+		m_programUniforms.erase(programs[i]);
+	}
+	m_pShaderVariants->Destroy();
+}
+
+/***********************************************************
+ *  EnableDepthTest()
+ *
+ *  This method is used for turning the depth test on through
+ *  the state cache, so the cache knows the state the frame
+ *  loop finds afterwards.
+ ***********************************************************/
+void SceneManager::EnableDepthTest()
+{
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->Enable(GL_DEPTH_TEST);
+		return;
+	}
+
+	glEnable(GL_DEPTH_TEST);
+}
+
+/***********************************************************
+ *  ClearFrame()
+ *
+ *  This method is used for clearing the color and depth of
+ *  the bound framebuffer to the color the frame loop clears
+ *  to, setting the clear color through the state cache.
+ ***********************************************************/
+void SceneManager::ClearFrame()
+{
+	if (NULL != m_pStateCache)
+	{
+		m_pStateCache->ClearColor(m_warmupClearColor);
+	}
+	else
+	{
+		glClearColor(m_warmupClearColor.x, m_warmupClearColor.y, m_warmupClearColor.z, m_warmupClearColor.w);
+	}
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+/***********************************************************
+ *  SetTransformations()
+ *
+ *  This method is used for setting the transform buffer
+ *  using the passed in transformation values.
+ ***********************************************************/
+void SceneManager::SetTransformations(
+	glm::vec3 scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	glm::vec3 positionXYZ)
+{
+	// while the draw list is recorded, the transform joins the
+	// batch that is composed when the list is done
+	if (m_bRecordingDraws == true)
+	{
+		m_pendingDraw.transformIndex = m_drawTransforms.Add(
+			scaleXYZ, XrotationDegrees, YrotationDegrees, ZrotationDegrees, positionXYZ);
+		return;
+	}
+
+	// variables for this method
+	glm::mat4 modelView;
+	glm::mat4 scale;
+	glm::mat4 rotationX;
+	glm::mat4 rotationY;
+	glm::mat4 rotationZ;
+	glm::mat4 translation;
+
+	// set the scale value in the transform buffer
+	scale = glm::scale(scaleXYZ);
+	// set the rotation values in the transform buffer
+	rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+	rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+	rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
+	// set the translation value in the transform buffer
+	translation = glm::translate(positionXYZ);
+
+	modelView = translation * rotationZ * rotationY * rotationX * scale;
+
+	m_modelMatrix = modelView;
+	m_pShaderUniforms->Set(m_uniforms.model, modelView);
+}
+
+/***********************************************************
+ *  SetShaderColor()
+ *
+ *  This method is used for setting the passed in color
+ *  into the shader for the next draw command
+ ***********************************************************/
+void SceneManager::SetShaderColor(
+	float redColorValue,
+	float greenColorValue,
+	float blueColorValue,
+	float alphaValue)
+{
+	// variables for this method
+	glm::vec4 currentColor;
+
+	currentColor.r = redColorValue;
+	currentColor.g = greenColorValue;
+	currentColor.b = blueColorValue;
+	currentColor.a = alphaValue;
+
+	if (m_bRecordingDraws == true)
+	{
+		m_pendingDraw.bTexture = false;
+		m_pendingDraw.color = currentColor;
+		return;
+	}
+
+	SelectShaderVariant(false);
+	m_pShaderUniforms->Set(m_uniforms.useTexture, false);
+	m_pShaderUniforms->Set(m_uniforms.objectColor, currentColor);
+}
+
+/***********************************************************
+ *  SetShaderTexture()
+ *
+ *  This method is used for setting the texture data
+ *  associated with the passed in ID into the shader.
+ ***********************************************************/
+void SceneManager::SetShaderTexture(
+	ResourceTag textureTag)
+{
+	if (m_bRecordingDraws == true)
+	{
+		m_pendingDraw.bTexture = true;
+		m_pendingDraw.textureSlot = FindTextureSlot(textureTag);
+		return;
+	}
+
+	SelectShaderVariant(true);
+	m_pShaderUniforms->Set(m_uniforms.useTexture, true);
+
+	const int textureSlot = FindTextureSlot(textureTag);
+	if (textureSlot >= 0)
+	{
+		BindTextureSlot(textureSlot);
+	}
+}
+
+/***********************************************************
+ *  BindTextureSlot()
+ *
+ *  This method is used for setting the uniforms that draw
+ *  from a loaded texture, in the current texture mode.  The
+ *  texture is marked used, and restored when it was evicted.
+ ***********************************************************/
+void SceneManager::BindTextureSlot(int textureSlot)
+{
+	// a texture in an atlas draws from the atlas, with its
+	// texture coordinates moved into its rectangle
+	const int atlasSlot = m_textureIDs[textureSlot].atlasSlot;
+	m_pShaderUniforms->Set(m_uniforms.useTextureAtlas, atlasSlot >= 0);
+	if (atlasSlot >= 0)
+	{
+		m_pShaderUniforms->Set(m_uniforms.objectTextureRect, m_textureIDs[textureSlot].atlasRect);
+		textureSlot = atlasSlot;
+	}
+
+	// an evicted texture draws with its low mip levels until
+	// the full image is loaded again
+	m_pTextureResidency->MarkUsed(textureSlot);
+	if (m_pTextureResidency->GetState(textureSlot) == TextureResidency::RESIDENCY_EVICTED)
+	{
+		RestoreGLTexture(textureSlot);
+	}
+
+	const TEXTURE_INFO& texture = m_textureIDs[textureSlot];
+	if (m_textureMode == TEXTURE_MODE_ARRAYS)
+	{
+		// only the texture array unit and the layer are passed
+		m_pShaderUniforms->Set(m_uniforms.objectTextureArray, texture.arrayIndex);
+		m_pShaderUniforms->Set(m_uniforms.objectTextureLayer, texture.layer);
+	}
+	else if (m_textureMode == TEXTURE_MODE_BINDLESS)
+	{
+		m_pShaderUniforms->Set(m_uniforms.objectTextureHandle, texture.handle);
+	}
+	else
+	{
+		m_pShaderUniforms->Set(m_uniforms.objectTexture, textureSlot);
+	}
+}
+
+/***********************************************************
+ *  SetTextureUVScale()
+ *
+ *  This method is used for setting the texture UV scale
+ *  values into the shader.
+ ***********************************************************/
+void SceneManager::SetTextureUVScale(float u, float v)
+{
+	if (m_bRecordingDraws == true)
+	{
+		m_pendingDraw.UVscale = glm::vec2(u, v);
+		return;
+	}
+
+	m_pShaderUniforms->Set(m_uniforms.UVscale, glm::vec2(u, v));
+}
+
+/***********************************************************
+ *  SetShaderMaterial()
+ *
+ *  This method is used for passing the index of the material
+ *  into the shader, which reads the material values from the
+ *  material buffer.
+ ***********************************************************/
+void SceneManager::SetShaderMaterial(
+	ResourceTag materialTag)
+{
+	const int materialIndex = FindMaterialIndex(materialTag);
+	if ((materialIndex < 0) || (materialIndex >= MAX_MATERIALS))
+	{
+		return;
+	}
+
+	if (m_bRecordingDraws == true)
+	{
+		m_pendingDraw.materialIndex = materialIndex;
+		return;
+	}
+
+	m_pShaderUniforms->Set(m_uniforms.materialIndex, materialIndex);
+}
+
+/***********************************************************
+ *  DrawShape()
+ *
+ *  This method is used for drawing a shape mesh with the
+ *  values set for it.  While the draw list is recorded, the
+ *  values are kept in a new record instead, and they carry
+ *  over to the next record the way uniforms stay set.
+ ***********************************************************/
+void SceneManager::DrawShape(SHAPE_MESH mesh)
+{
+	if (m_bRecordingDraws == true)
+	{
+		m_pendingDraw.mesh = mesh;
+		m_drawList.push_back(m_pendingDraw);
+		return;
+	}
+
+	DrawShapeMesh(mesh);
+}
+
+/***********************************************************
+ *  DrawShapeMesh()
+ *
+ *  This method is used for issuing the draw of a shape mesh.
+ ***********************************************************/
+void SceneManager::DrawShapeMesh(SHAPE_MESH mesh)
+{
+	switch (mesh)
+	{
+	case SHAPE_BOX:
+		m_basicMeshes->DrawBoxMesh();
+		break;
+	case SHAPE_PLANE:
+		m_basicMeshes->DrawPlaneMesh();
+		break;
+	case SHAPE_CYLINDER:
+		m_basicMeshes->DrawCylinderMesh();
+		break;
+	case SHAPE_TAPERED_CYLINDER:
+		m_basicMeshes->DrawTaperedCylinderMesh();
+		break;
+	case SHAPE_TORUS:
+		m_basicMeshes->DrawTorusMesh();
+		break;
+	case SHAPE_SPHERE:
+		m_basicMeshes->DrawSphereMesh();
+		break;
+	case SHAPE_HALF_SPHERE:
+		m_basicMeshes->DrawHalfSphereMesh();
+		break;
+	}
+}
+
+/***********************************************************
+ *  BuildDrawList()
+ *
+ *  This method is used for recording the draws of the static
+ *  scene once, by running the RenderXxx() methods with the
+ *  setters filling in records instead of setting uniforms.
+ *  The matrices, material indexes and texture slots are all
+ *  worked out here, so a frame only submits the records.  The
+ *  model matrices are composed together once every transform
+ *  is recorded, with the widest SIMD kernel the processor has.
+ ***********************************************************/
+void SceneManager::BuildDrawList()
+{
+	m_pendingDraw.mesh = SHAPE_BOX;
+	m_pendingDraw.modelMatrix = glm::mat4(1.0f);
+	m_pendingDraw.transformIndex = -1;
+	m_pendingDraw.materialIndex = -1;
+	m_pendingDraw.bTexture = false;
+	m_pendingDraw.textureSlot = -1;
+	m_pendingDraw.color = glm::vec4(1.0f);
+	m_pendingDraw.UVscale = glm::vec2(1.0f, 1.0f);
+
+	m_drawList.clear();
+	m_drawTransforms.Clear();
+	m_bDrawOrderReady = false;
+	m_bRecordingDraws = true;
+	RenderSceneObjects();
+	m_bRecordingDraws = false;
+
+	// the submit paths only read the model matrices - the shader
+	// works out its normals and view from the frame data - so no
+	// normal or MVP matrices are composed
+	m_drawTransforms.Compose(TransformBatch::BestKernel(), false, NULL);
+	const glm::mat4* pModelMatrices = m_drawTransforms.GetModelMatrices();
+	for (size_t i = 0; i < m_drawList.size(); i++)
+	{
+		if (m_drawList[i].transformIndex >= 0)
+		{
+			m_drawList[i].modelMatrix = pModelMatrices[m_drawList[i].transformIndex];
+		}
+	}
+
+	BuildInstanceBatches();
+}
+
+/***********************************************************
+ *  SubmitDrawList()
+ *
+ *  This method is used for drawing the recorded draw list,
+ *  a record at a time, in the order of their state keys when
+ *  the list is sorted.
+ ***********************************************************/
+void SceneManager::SubmitDrawList()
+{
+	// the state changes are reported once, from the camera of
+	// the first frame drawn
+	if (m_bDrawSortReported == false)
+	{
+		ReportDrawSort();
+		m_bDrawSortReported = true;
+	}
+
+	if (m_bSortDraws == true)
+	{
+		SortDrawList();
+		for (size_t i = 0; i < m_drawOrder.size(); i++)
+		{
+			SubmitDraw(m_drawList[m_drawOrder[i]]);
+		}
+		return;
+	}
+
+	for (size_t i = 0; i < m_drawList.size(); i++)
+	{
+		SubmitDraw(m_drawList[i]);
+	}
+}
+
+/***********************************************************
+ *  MakeDrawKey()
+ *
+ *  This method is used for packing the state of a record into
+ *  its key - its variant, the texture it binds, which is the
+ *  atlas for a texture in one, its shape and material, and
+ *  its distance from the view position.  A blended record is
+ *  keyed as blended, so it sorts after the opaque ones, far
+ *  to near.  The scene draws in one pass.
+ ***********************************************************/
+uint64_t SceneManager::MakeDrawKey(const DRAW_RECORD& draw, const glm::vec3& viewPosition)
+{
+	int textureSlot = -1;
+	if ((draw.bTexture == true) && (draw.textureSlot >= 0))
+	{
+		textureSlot = draw.textureSlot;
+		if (m_textureIDs[textureSlot].atlasSlot >= 0)
+		{
+			textureSlot = m_textureIDs[textureSlot].atlasSlot;
+		}
+	}
+
+	const glm::vec4& position = draw.modelMatrix[3];
+	const float x = position.x - viewPosition.x;
+	const float y = position.y - viewPosition.y;
+	const float z = position.z - viewPosition.z;
+
+	DrawSort::DRAW_KEY fields;
+	fields.pass = 0;
+	fields.bTransparent = IsBlendedDraw(draw);
+	fields.variant = draw.bTexture ? 1 : 0;
+	fields.texture = textureSlot + 1;
+	fields.mesh = draw.mesh;
+	fields.material = draw.materialIndex + 1;
+	fields.depth = sqrtf(x * x + y * y + z * z);
+
+	return(DrawSort::MakeKey(fields));
+}
+
+/***********************************************************
+ *  MakeDrawKeys()
+ *
+ *  This method is used for packing the state of each record,
+ *  seen from the view position, into its key.
+ ***********************************************************/
+void SceneManager::MakeDrawKeys(const glm::vec3& viewPosition)
+{
+	m_drawKeys.resize(m_drawList.size());
+	for (size_t i = 0; i < m_drawList.size(); i++)
+	{
+		m_drawKeys[i] = MakeDrawKey(m_drawList[i], viewPosition);
+	}
+}
+
+/***********************************************************
+ *  SortDrawList()
+ *
+ *  This method is used for keying the draw list from the
+ *  camera of the frame and sorting it, so the records that
+ *  share a state are drawn side by side.  The whole list is
+ *  sorted once, and the opaque records keep that order - it
+ *  is decided by their state, and the depth only orders the
+ *  records of one state.  The blended records sort after the
+ *  opaque ones, far to near, so only their range is keyed and
+ *  sorted again, when the camera has moved.
+ ***********************************************************/
+void SceneManager::SortDrawList()
+{
+	glm::vec3 viewPosition(0.0f, 0.0f, 0.0f);
+	if (NULL != m_pUniformBlocks)
+	{
+		viewPosition = m_pUniformBlocks->GetFrameData().viewPosition;
+	}
+
+	if (m_bDrawOrderReady == false)
+	{
+		MakeDrawKeys(viewPosition);
+		m_drawSort.Sort(m_drawKeys, m_drawOrder);
+
+		m_firstBlendedDraw = (int)m_drawOrder.size();
+		while ((m_firstBlendedDraw > 0) && (IsBlendedDraw(m_drawList[m_drawOrder[m_firstBlendedDraw - 1]]) == true))
+		{
+			m_firstBlendedDraw--;
+		}
+		// kept in list order, so records at the same depth sort
+		// again the way the whole list does
+		m_blendedDraws.assign(m_drawOrder.begin() + m_firstBlendedDraw, m_drawOrder.end());
+		std::sort(m_blendedDraws.begin(), m_blendedDraws.end());
+		m_blendedKeys.resize(m_blendedDraws.size());
+
+		m_sortViewPosition = viewPosition;
+		m_bDrawOrderReady = true;
+		return;
+	}
+
+	if ((m_blendedDraws.size() == 0) || (viewPosition == m_sortViewPosition))
+	{
+		return;
+	}
+	m_sortViewPosition = viewPosition;
+
+	for (size_t i = 0; i < m_blendedDraws.size(); i++)
+	{
+		const int draw = m_blendedDraws[i];
+		m_drawKeys[draw] = MakeDrawKey(m_drawList[draw], viewPosition);
+		m_blendedKeys[i] = m_drawKeys[draw];
+	}
+	m_drawSort.Sort(m_blendedKeys, m_blendedOrder);
+	for (size_t i = 0; i < m_blendedOrder.size(); i++)
+	{
+		m_drawOrder[m_firstBlendedDraw + i] = m_blendedDraws[m_blendedOrder[i]];
+	}
+}
+
+/***********************************************************
+ *  ReportDrawSort()
+ *
+ *  This method is used for printing how often the state
+ *  changes when the draw list is drawn in the order it was
+ *  recorded, and in the order of its keys.
+ ***********************************************************/
+void SceneManager::ReportDrawSort()
+{
+	if (m_drawList.size() == 0)
+	{
+		return;
+	}
+
+	std::vector<int> recordedOrder(m_drawList.size());
+	for (size_t i = 0; i < recordedOrder.size(); i++)
+	{
+		recordedOrder[i] = (int)i;
+	}
+	SortDrawList();
+
+	const DrawSort::STATE_CHANGES changes[2] = {
+		DrawSort::CountStateChanges(m_drawKeys, recordedOrder),
+		DrawSort::CountStateChanges(m_drawKeys, m_drawOrder) };
+	const char* orderNames[2] = { "recorded", "sorted" };
+
+	for (int i = 0; i < 2; i++)
+	{
+		std::cout << "INFO: " << m_drawList.size() << " draws in " << orderNames[i] << " order: "
+			<< DrawSort::TotalStateChanges(changes[i]) << " state changes (blend " << changes[i].blend
+			<< ", shader " << changes[i].shader << ", texture " << changes[i].texture
+			<< ", shape " << changes[i].mesh << ", material " << changes[i].material << ")" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  SubmitDraw()
+ *
+ *  This method is used for drawing one record of the draw
+ *  list.  The record picks its variant and sets its values
+ *  through the uniform handles, which drop the values that
+ *  did not change since the last draw.
+ ***********************************************************/
+void SceneManager::SubmitDraw(const DRAW_RECORD& draw)
+{
+	m_modelMatrix = draw.modelMatrix;
+	SelectShaderVariant(draw.bTexture);
+
+	m_pShaderUniforms->Set(m_uniforms.model, draw.modelMatrix);
+	m_pShaderUniforms->Set(m_uniforms.objectColor, draw.color);
+	m_pShaderUniforms->Set(m_uniforms.useTexture, draw.bTexture);
+	if ((draw.bTexture == true) && (draw.textureSlot >= 0))
+	{
+		BindTextureSlot(draw.textureSlot);
+	}
+	m_pShaderUniforms->Set(m_uniforms.UVscale, draw.UVscale);
+	// a draw made before any material was set uses the first
+	// material, as an instance does, and not the material of
+	// whichever draw came before it
+	m_pShaderUniforms->Set(m_uniforms.materialIndex, std::max(0, draw.materialIndex));
+
+	DrawShapeMesh(draw.mesh);
+}
+
+/***********************************************************
+ *  IsBlendedDraw()
+ *
+ *  This method is used for telling whether a record is drawn
+ *  blended.  Only an untextured record draws its color, so
+ *  only an untextured record whose color is not opaque is
+ *  blended - a textured one takes its alpha from the texture
+ *  and draws over the scene like an opaque one.
+ ***********************************************************/
+bool SceneManager::IsBlendedDraw(const DRAW_RECORD& draw)
+{
+	return((draw.bTexture == false) && (draw.color.w < 1.0f));
+}
+
+/***********************************************************
+ *  BuildInstanceBatches()
+ *
+ *  This method is used for grouping the records of the draw
+ *  list that share a shape, texture, color and UV scale into
+ *  batches, and uploading the model matrix and material of
+ *  each record as an instance, with the instances of a batch
+ *  side by side.  The color of a textured record is not
+ *  drawn, so it does not split the batches.  The opaque
+ *  untextured batches come first and the textured ones next,
+ *  so an indirect frame draws each of the two variants with
+ *  one call.  The blended records come last, in list order,
+ *  with only the ones next to each other in the list sharing
+ *  a batch, since blending depends on the order they are
+ *  drawn in.
+ ***********************************************************/
+void SceneManager::BuildInstanceBatches()
+{
+	m_instanceBatches.clear();
+	m_instanceDraws.clear();
+	m_firstTexturedBatch = 0;
+	m_firstBlendedBatch = 0;
+	m_bIndirectReady = false;
+	if ((NULL == m_pInstancedMeshes) || (m_pInstancedMeshes->IsCreated() == false))
+	{
+		return;
+	}
+
+	// find the batch of each record, counting its instances,
+	// with the opaque untextured records in the first pass, the
+	// textured ones in the second and the blended ones in the
+	// third
+	std::vector<int> drawBatches(m_drawList.size());
+	for (int pass = 0; pass < 3; pass++)
+	{
+		const bool bTexturePass = (pass == 1);
+		const bool bBlendPass = (pass == 2);
+		size_t firstBatch = 0;
+		if (bTexturePass == true)
+		{
+			m_firstTexturedBatch = (int)m_instanceBatches.size();
+			firstBatch = m_firstTexturedBatch;
+		}
+		else if (bBlendPass == true)
+		{
+			m_firstBlendedBatch = (int)m_instanceBatches.size();
+			firstBatch = m_firstBlendedBatch;
+		}
+
+		for (size_t i = 0; i < m_drawList.size(); i++)
+		{
+			const DRAW_RECORD& draw = m_drawList[i];
+			if ((draw.bTexture != bTexturePass) || (IsBlendedDraw(draw) != bBlendPass))
+			{
+				continue;
+			}
+			const int textureSlot = draw.bTexture ? draw.textureSlot : -1;
+			const glm::vec4 color = draw.bTexture ? glm::vec4(1.0f) : draw.color;
+
+			// a blended record can only join the batch of the
+			// blended record before it
+			size_t batch = firstBatch;
+			if ((bBlendPass == true) && (m_instanceBatches.size() > firstBatch))
+			{
+				batch = m_instanceBatches.size() - 1;
+			}
+			while ((batch < m_instanceBatches.size()) &&
+				((m_instanceBatches[batch].mesh != draw.mesh) ||
+				(m_instanceBatches[batch].textureSlot != textureSlot) ||
+				(m_instanceBatches[batch].color != color) ||
+				(m_instanceBatches[batch].UVscale != draw.UVscale)))
+			{
+				batch++;
+			}
+
+			if (batch == m_instanceBatches.size())
+			{
+				INSTANCE_BATCH newBatch;
+				newBatch.mesh = draw.mesh;
+				newBatch.bTexture = draw.bTexture;
+				newBatch.textureSlot = textureSlot;
+				newBatch.color = color;
+				newBatch.UVscale = draw.UVscale;
+				newBatch.firstInstance = 0;
+				newBatch.instanceCount = 0;
+				m_instanceBatches.push_back(newBatch);
+			}
+
+			drawBatches[i] = (int)batch;
+			m_instanceBatches[batch].instanceCount++;
+		}
+	}
+
+	// give each batch its range of the instances
+	int firstInstance = 0;
+	for (size_t batch = 0; batch < m_instanceBatches.size(); batch++)
+	{
+		m_instanceBatches[batch].firstInstance = firstInstance;
+		firstInstance += m_instanceBatches[batch].instanceCount;
+		m_instanceBatches[batch].instanceCount = 0;
+	}
+
+	std::vector<InstancedMeshes::INSTANCE> instances(m_drawList.size());
+	m_instanceDraws.resize(m_drawList.size());
+	for (size_t i = 0; i < m_drawList.size(); i++)
+	{
+		INSTANCE_BATCH& batch = m_instanceBatches[drawBatches[i]];
+		const int instance = batch.firstInstance + batch.instanceCount;
+		batch.instanceCount++;
+
+		// a draw made before any material was set uses the
+		// first material, the default of the shader
+		instances[instance].modelMatrix = m_drawList[i].modelMatrix;
+		instances[instance].materialIndex = std::max(0, m_drawList[i].materialIndex);
+		instances[instance].batchIndex = drawBatches[i];
+		instances[instance].padding[0] = 0;
+		instances[instance].padding[1] = 0;
+		m_instanceDraws[instance] = (int)i;
+	}
+
+	m_pInstancedMeshes->SetInstances(instances);
+
+	BuildIndirectDraws();
+}
+
+/***********************************************************
+ *  BuildIndirectDraws()
+ *
+ *  This method is used for uploading a draw command and the
+ *  values of each batch, for drawing the batches from the
+ *  command buffer.  Each instance carries the index of its
+ *  batch, so the shaders find the batch values without
+ *  gl_DrawID.  A textured batch is drawn indirectly only with
+ *  bindless textures, since one call cannot bind a texture
+ *  for each command.
+ ***********************************************************/
+void SceneManager::BuildIndirectDraws()
+{
+	m_batchData.clear();
+	if ((InstancedMeshes::IsIndirectSupported() == false) || (m_instanceBatches.size() == 0))
+	{
+		return;
+	}
+	if ((m_firstTexturedBatch < m_firstBlendedBatch) &&
+		(m_textureMode != TEXTURE_MODE_BINDLESS))
+	{
+		return;
+	}
+
+	std::vector<InstancedMeshes::DRAW_COMMAND> commands(m_instanceBatches.size());
+	m_batchData.resize(m_instanceBatches.size());
+	for (size_t i = 0; i < m_instanceBatches.size(); i++)
+	{
+		const INSTANCE_BATCH& batch = m_instanceBatches[i];
+		commands[i] = m_pInstancedMeshes->MakeCommand(
+			(ShapeGeometry::SHAPE)batch.mesh, batch.firstInstance, batch.instanceCount);
+
+		InstancedMeshes::BATCH_DATA& data = m_batchData[i];
+		data.color = batch.color;
+		data.textureRect = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+		data.UVscale = batch.UVscale;
+		data.bUseTextureAtlas = 0;
+		data.padding0 = 0;
+		data.textureHandle[0] = 0;
+		data.textureHandle[1] = 0;
+		data.padding1[0] = 0;
+		data.padding1[1] = 0;
+		ResolveBatchTexture(batch, data);
+	}
+
+	m_pInstancedMeshes->SetIndirectDraws(commands, m_batchData);
+	m_bIndirectReady = true;
+}
+
+/***********************************************************
+ *  ResolveBatchTexture()
+ *
+ *  This method is used for filling in the texture of a batch
+ *  in its batch values, the way BindTextureSlot() sets it for
+ *  a draw - the atlas and rectangle of a texture in an atlas,
+ *  and the bindless handle.  The texture is marked used, and
+ *  restored when it was evicted.
+ ***********************************************************/
+void SceneManager::ResolveBatchTexture(const INSTANCE_BATCH& batch, InstancedMeshes::BATCH_DATA& data)
+{
+	if ((batch.bTexture == false) || (batch.textureSlot < 0))
+	{
+		return;
+	}
+
+	int textureSlot = batch.textureSlot;
+	const int atlasSlot = m_textureIDs[textureSlot].atlasSlot;
+	data.bUseTextureAtlas = (atlasSlot >= 0) ? 1 : 0;
+	if (atlasSlot >= 0)
+	{
+		data.textureRect = m_textureIDs[textureSlot].atlasRect;
+		textureSlot = atlasSlot;
+	}
+
+	m_pTextureResidency->MarkUsed(textureSlot);
+	if (m_pTextureResidency->GetState(textureSlot) == TextureResidency::RESIDENCY_EVICTED)
+	{
+		RestoreGLTexture(textureSlot);
+	}
+
+	const GLuint64 handle = m_textureIDs[textureSlot].handle;
+	data.textureHandle[0] = (GLuint)(handle & 0xFFFFFFFF);
+	data.textureHandle[1] = (GLuint)(handle >> 32);
+}
+
+/***********************************************************
+ *  UpdateIndirectTextures()
+ *
+ *  This method is used for keeping the textures of the
+ *  batches resident before an indirect frame.  A texture that
+ *  is restored gets a new handle, so the batch values are
+ *  uploaded again when any handle changed.  Returns false
+ *  when a textured batch has no texture to draw from.
+ ***********************************************************/
+bool SceneManager::UpdateIndirectTextures()
+{
+	if ((m_firstTexturedBatch < m_firstBlendedBatch) &&
+		(m_textureMode != TEXTURE_MODE_BINDLESS))
+	{
+		return(false);
+	}
+
+	bool bChanged = false;
+	bool bComplete = true;
+	for (int i = m_firstTexturedBatch; i < m_firstBlendedBatch; i++)
+	{
+		InstancedMeshes::BATCH_DATA& data = m_batchData[i];
+		const GLuint previous[2] = { data.textureHandle[0], data.textureHandle[1] };
+
+		ResolveBatchTexture(m_instanceBatches[i], data);
+		if ((data.textureHandle[0] != previous[0]) || (data.textureHandle[1] != previous[1]))
+		{
+			bChanged = true;
+		}
+		if ((data.textureHandle[0] == 0) && (data.textureHandle[1] == 0))
+		{
+			bComplete = false;
+		}
+	}
+
+	if (bChanged == true)
+	{
+		m_pInstancedMeshes->SetBatchData(m_batchData);
+	}
+
+	return(bComplete);
+}
+
+/***********************************************************
+ *  SubmitInstanceBatches()
+ *
+ *  This method is used for drawing each batch of the draw
+ *  list with one instanced draw, after setting the values it
+ *  shares.
+ ***********************************************************/
+void SceneManager::SubmitInstanceBatches()
+{
+	m_pInstancedMeshes->Bind();
+	for (size_t i = 0; i < m_instanceBatches.size(); i++)
+	{
+		SubmitInstanceBatch(m_instanceBatches[i]);
+	}
+
+	// other code may expect no vertex array bound
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  SubmitInstanceBatch()
+ *
+ *  This method is used for drawing one batch with an
+ *  instanced draw, once the merged shapes are bound.  A batch
+ *  whose instanced variant does not build is drawn a record
+ *  at a time instead, and the merged shapes bound again,
+ *  since the shape meshes bind their own vertex arrays.
+ ***********************************************************/
+void SceneManager::SubmitInstanceBatch(const INSTANCE_BATCH& batch)
+{
+	if (SelectShaderVariant(batch.bTexture, true) == false)
+	{
+		for (int instance = batch.firstInstance; instance < batch.firstInstance + batch.instanceCount; instance++)
+		{
+			SubmitDraw(m_drawList[m_instanceDraws[instance]]);
+		}
+		m_pInstancedMeshes->Bind();
+		return;
+	}
+
+	m_pShaderUniforms->Set(m_uniforms.objectColor, batch.color);
+	m_pShaderUniforms->Set(m_uniforms.useTexture, batch.bTexture);
+	if ((batch.bTexture == true) && (batch.textureSlot >= 0))
+	{
+		BindTextureSlot(batch.textureSlot);
+	}
+	m_pShaderUniforms->Set(m_uniforms.UVscale, batch.UVscale);
+
+	m_pInstancedMeshes->DrawInstances((ShapeGeometry::SHAPE)batch.mesh, batch.firstInstance, batch.instanceCount);
+}
+
+/***********************************************************
+ *  SubmitIndirectDraws()
+ *
+ *  This method is used for drawing every batch from the draw
+ *  command buffer - the opaque untextured batches with one
+ *  call, the textured ones with another, each with its own
+ *  variant, and the blended ones last with a third, which
+ *  draws its commands in list order.
+ *  A variant that does not build has its batches drawn one
+ *  at a time instead, and a textured batch without a texture
+ *  sends the whole frame down the instanced path.
+ ***********************************************************/
+void SceneManager::SubmitIndirectDraws()
+{
+	if (UpdateIndirectTextures() == false)
+	{
+		SubmitInstanceBatches();
+		return;
+	}
+
+	m_pInstancedMeshes->Bind();
+	const int batchCount = (int)m_instanceBatches.size();
+	const int passBatches[4] = { 0, m_firstTexturedBatch, m_firstBlendedBatch, batchCount };
+	for (int pass = 0; pass < 3; pass++)
+	{
+		const bool bTexturePass = (pass == 1);
+		const int firstBatch = passBatches[pass];
+		const int endBatch = passBatches[pass + 1];
+		if (firstBatch == endBatch)
+		{
+			continue;
+		}
+
+		if (SelectShaderVariant(bTexturePass, true, true) == true)
+		{
+			m_pInstancedMeshes->DrawIndirect(firstBatch, endBatch - firstBatch);
+		}
+		else
+		{
+			for (int i = firstBatch; i < endBatch; i++)
+			{
+				SubmitInstanceBatch(m_instanceBatches[i]);
+			}
+		}
+	}
+
+	// other code may expect no vertex array bound
+	glBindVertexArray(0);
+}
+
+/***********************************************************
+ *  SetDrawListEnabled()
+ *
+ *  This method is used for switching between submitting the
+ *  retained draw list and running the RenderXxx() methods
+ *  every frame, to measure what the list saves.
+ ***********************************************************/
+void SceneManager::SetDrawListEnabled(bool bEnabled)
+{
+	m_bUseDrawList = bEnabled;
+}
+
+/***********************************************************
+ *  SetInstancingEnabled()
+ *
+ *  This method is used for switching between drawing the
+ *  draw list a batch at a time with instanced draws and a
+ *  record at a time.  Instanced draws need the shader
+ *  variants, so without them the list is drawn by record.
+ ***********************************************************/
+void SceneManager::SetInstancingEnabled(bool bEnabled)
+{
+	m_bUseInstancing = bEnabled;
+}
+
+/***********************************************************
+ *  SetIndirectDrawsEnabled()
+ *
+ *  This method is used for switching between drawing the
+ *  batches of the draw list from the draw command buffer,
+ *  in one call for each variant, and drawing them another
+ *  way.  The indirect draws need the shader variants and a
+ *  driver with multi-draw indirect, base instances and
+ *  storage buffers, and bindless textures for the textured
+ *  batches.
+ ***********************************************************/
+void SceneManager::SetIndirectDrawsEnabled(bool bEnabled)
+{
+	m_bUseIndirectDraws = bEnabled;
+}
+
+/***********************************************************
+ *  SetDrawSortEnabled()
+ *
+ *  This method is used for switching between drawing the
+ *  records of the draw list in the order of their state keys,
+ *  with the blended ones sorted again when the camera moves,
+ *  and in the order they were recorded.
+ ***********************************************************/
+void SceneManager::SetDrawSortEnabled(bool bEnabled)
+{
+	m_bSortDraws = bEnabled;
+}
+
+/***********************************************************
+ *  SetTextureMode()
+ *
+ *  This method is used for selecting how the loaded textures
+ *  are handed to the shader.  It must be called before the
+ *  scene textures are loaded.
+ ***********************************************************/
+void SceneManager::SetTextureMode(TEXTURE_MODE textureMode)
+{
+	m_textureMode = textureMode;
+}
+
+/***********************************************************
+ *  SetTextureCacheEnabled()
+ *
+ *  This method is used for turning the on-disk texture cache
+ *  on or off.  It must be called while no textures are
+ *  loading, since the decoder threads read through it.
+ ***********************************************************/
+void SceneManager::SetTextureCacheEnabled(bool bEnabled)
+{
+	if ((bEnabled == false) && (NULL != m_pTextureCache))
+	{
+		delete m_pTextureCache;
+		m_pTextureCache = NULL;
+	}
+	else if ((bEnabled == true) && (NULL == m_pTextureCache))
+	{
+		m_pTextureCache = new TextureCache("texture_cache");
+	}
+
+	if (NULL != m_pTextureDecoder)
+	{
+		m_pTextureDecoder->SetTextureCache(m_pTextureCache);
+	}
+}
+
+/***********************************************************
+ *  SetTextureAtlasEnabled()
+ *
+ *  This method is used for turning packing the small textures
+ *  into shared atlases on or off.  It must be called before
+ *  the scene textures are loaded.
+ ***********************************************************/
+void SceneManager::SetTextureAtlasEnabled(bool bEnabled)
+{
+	m_bUseTextureAtlas = bEnabled;
+}
+
+/***********************************************************
+ *  SetTextureStreamingEnabled()
+ *
+ *  This method is used for turning the progressive mip
+ *  streaming on or off.  When it is on, the scene textures
+ *  start out as a placeholder and sharpen over the first
+ *  frames, coarsest mip level first, instead of the first
+ *  frame waiting for every texture at full resolution.  It
+ *  must be called before the scene textures are loaded.
+ ***********************************************************/
+void SceneManager::SetTextureStreamingEnabled(bool bEnabled)
+{
+	m_bStreamTextures = bEnabled;
+}
+
+/***********************************************************
+ *  SetAssetPackEnabled()
+ *
+ *  This method is used for turning loading the textures from
+ *  the asset pack on or off.  When it is off, the textures
+ *  are always loaded from the loose image files.  It must be
+ *  called before the scene textures are loaded.
+ ***********************************************************/
+void SceneManager::SetAssetPackEnabled(bool bEnabled)
+{
+	m_bUseAssetPack = bEnabled;
+	if (bEnabled == false)
+	{
+		m_pAssetPack->Close();
+	}
+}
+
+/***********************************************************
+ *  BuildAssetPack()
+ *
+ *  This method is used for decoding the scene textures,
+ *  computing their mip chains, and writing them to the asset
+ *  pack that later runs map instead of loading the loose
+ *  image files.  The pack must be built again after an image
+ *  file is edited.
+ ***********************************************************/
+bool SceneManager::BuildAssetPack()
+{
+	std::vector<std::string> filenames;
+	std::vector<std::string> tags;
+
+	for (int i = 0; i < SCENE_TEXTURE_COUNT; i++)
+	{
+		filenames.push_back(g_SceneTextures[i].filename);
+		tags.push_back(g_SceneTextures[i].tag);
+	}
+
+	// a mapped pack cannot be replaced on Windows
+	m_pAssetPack->Close();
+
+	if (AssetPack::WriteTexturePack(g_AssetPackName, filenames, tags) == false)
+	{
+		std::cout << "Could not build asset pack:" << g_AssetPackName << std::endl;
+		return(false);
+	}
+
+	std::cout << "Built asset pack:" << g_AssetPackName << std::endl;
+	return(true);
+}
+
+/***********************************************************
+ *  CompileMaterialLibrary()
+ *
+ *  This method is used for validating the material library
+ *  source and writing its compiled form.  It needs no OpenGL
+ *  context, so the build runs it to catch errors in the
+ *  materials before the application is launched.
+ ***********************************************************/
+bool SceneManager::CompileMaterialLibrary()
+{
+	return(MaterialLibrary::Compile(g_MaterialSourceName, g_MaterialLibraryName));
+}
+
+/***********************************************************
+ *  SetTextureMemoryBudget()
+ *
+ *  This method is used for setting how many bytes of video
+ *  memory the textures may hold.  Past the budget, textures
+ *  that have not been drawn recently are evicted down to their
+ *  low mip levels.  Zero turns the budget off.
+ ***********************************************************/
+void SceneManager::SetTextureMemoryBudget(size_t budgetBytes)
+{
+	m_pTextureResidency->SetBudget(budgetBytes);
+}
+
+/***********************************************************
+ *  UpdateTextures()
+ *
+ *  This method is used for the per-frame texture work - the
+ *  images the worker threads finished decoding are collected,
+ *  the next streamed mip levels are uploaded, and textures are
+ *  evicted while the texture memory is over budget.  It is
+ *  called once per frame, before the scene is rendered.
+ ***********************************************************/
+void SceneManager::UpdateTextures()
+{
+	int textureSlot = -1;
+
+	m_pTextureResidency->BeginFrame();
+
+	// take the decoded images without waiting on the workers
+	if (NULL != m_pTextureDecoder)
+	{
+		TextureDecoder::DECODED_IMAGE image;
+		while (m_pTextureDecoder->TryGetImage(image))
+		{
+			AddDecodedImage(image);
+		}
+	}
+
+	UpdateTextureStreaming();
+
+	while (m_pTextureResidency->NextEviction(textureSlot))
+	{
+		EvictGLTexture(textureSlot);
+	}
+
+	EndTextureUploadFrame();
+}
+
+/***********************************************************
+ *  ReloadTextureFile()
+ *
+ *  This method is used for decoding a changed image file again
+ *  on the worker threads for every texture loaded from it.
+ *  The decoded images are collected by UpdateTextures() at the
+ *  start of a later frame and put in place of the textures
+ *  before anything is drawn, so a frame never waits on the
+ *  disk or the decode.  Returns false when no texture is
+ *  loaded from the file.
+ ***********************************************************/
+bool SceneManager::ReloadTextureFile(const std::string& filename)
+{
+	bool bReloading = false;
+
+	for (int i = 0; i < (int)m_textureIDs.size(); i++)
+	{
+		if (m_textureIDs[i].filename != filename)
+		{
+			continue;
+		}
+
+		std::cout << "Reloading image:" << filename << std::endl;
+
+		// the asset pack still holds the old image
+		m_stalePackedTextures.insert(ResourceTag(m_textureIDs[i].tag).GetHash());
+
+		StartTextureDecoder();
+		m_pTextureDecoder->QueueImage(filename.c_str(), m_textureIDs[i].tag);
+		bReloading = true;
+	}
+
+	return(bReloading);
+}
+
+/***********************************************************
+ *  ApplyShaderSettings()
+ *
+ *  This method is used for setting the scene's uniforms that
+ *  are only set once, after the shaders have been reloaded
+ *  into a new program - the uniform handles, the texture
+ *  samplers, the material block and the lights.
+ *  The per-draw uniforms are set again as the scene is drawn,
+ *  and the shader variants are built again from the new
+ *  sources as the draws need them.
+ ***********************************************************/
+void SceneManager::ApplyShaderSettings()
+{
+	ReleaseShaderVariants();
+	m_programUniforms.clear();
+	m_baseProgram = m_pShaderUniforms->GetProgram();
+	m_currentProgram = m_baseProgram;
+
+	ResolveShaderUniforms();
+	BindGLTextures();
+	BindUniformBlocks();
+	SetupSceneLights();
+}
+
+/***********************************************************
+ *  PrintTextureResidencyStats()
+ *
+ *  This method is used for printing how much video memory the
+ *  textures hold, the most they ever held, and how often they
+ *  were evicted and loaded again, for sizing the budget.
+ ***********************************************************/
+void SceneManager::PrintTextureResidencyStats()
+{
+	const double megabyte = 1024.0 * 1024.0;
+	TextureResidency::RESIDENCY_STATS stats = m_pTextureResidency->GetStats();
+
+	std::cout << "INFO: texture memory: " << stats.residentBytes / megabyte << " MB resident, "
+		<< stats.peakResidentBytes / megabyte << " MB peak, "
+		<< stats.fullBytes / megabyte << " MB with no eviction, budget ";
+	if (stats.budgetBytes == 0)
+		std::cout << "none" << std::endl;
+	else
+		std::cout << stats.budgetBytes / megabyte << " MB" << std::endl;
+	std::cout << "INFO: textures: " << stats.textureCount << " tracked, "
+		<< stats.evictedTextures << " evicted now, "
+		<< stats.evictionCount << " evictions, "
+		<< stats.restoreCount << " restores" << std::endl;
+}
+
+/***********************************************************
+ *  PrintTextureUploadStats()
+ *
+ *  This method is used for printing what the texture uploads
+ *  cost on the CPU - the time spent issuing them, in total
+ *  and in the worst frame, and any waits for ring space.
+ ***********************************************************/
+void SceneManager::PrintTextureUploadStats()
+{
+	const double megabyte = 1024.0 * 1024.0;
+	const TEXTURE_UPLOAD_STATS& stats = m_textureUploadStats;
+
+	std::cout << "INFO: texture uploads: " << stats.levels << " mip levels, "
+		<< stats.bytes / megabyte << " MB in " << stats.frames << " frames through "
+		<< ((NULL != m_pUploadRing) ? "the pixel buffer ring" : "client memory") << std::endl;
+	std::cout << "INFO: texture upload time: " << stats.milliseconds << " ms total, "
+		<< stats.worstFrameMilliseconds << " ms worst frame, "
+		<< stats.ringWaits << " ring waits (" << stats.ringWaitMilliseconds << " ms)" << std::endl;
+}
+
+/***********************************************************
+ *  UpdateTextureStreaming()
+ *
+ *  This method is used for uploading the next streamed mip
+ *  levels, up to the per-frame upload budget.  The smallest
+ *  pending level is always uploaded next, so every texture
+ *  gets its coarse levels before any texture gets its fine
+ *  ones.
+ ***********************************************************/
+void SceneManager::UpdateTextureStreaming()
+{
+	size_t uploadedBytes = 0;
+
+	while (m_streamingTextures.size() > 0)
+	{
+		int next = 0;
+		size_t nextBytes = 0;
+		for (int i = 0; i < (int)m_streamingTextures.size(); i++)
+		{
+			const STREAMING_TEXTURE& streaming = m_streamingTextures[i];
+			const size_t levelBytes = (size_t)4 *
+				TextureDecoder::MipDimension(streaming.image.width, streaming.nextLevel) *
+				TextureDecoder::MipDimension(streaming.image.height, streaming.nextLevel);
+			if ((i == 0) || (levelBytes < nextBytes))
+			{
+				next = i;
+				nextBytes = levelBytes;
+			}
+		}
+
+		// one level always goes up, even when it is over budget
+		if ((uploadedBytes > 0) && (uploadedBytes + nextBytes > m_streamingFrameBudget))
+		{
+			break;
+		}
+
+		StreamNextMipLevel(m_streamingTextures[next]);
+		uploadedBytes += nextBytes;
+
+		if (m_streamingTextures[next].nextLevel < 0)
+		{
+			const TextureDecoder::DECODED_IMAGE& image = m_streamingTextures[next].image;
+			std::cout << "Finished streaming image:" << image.filename << std::endl;
+
+			// a fully streamed texture may be evicted like any other
+			const int slot = m_streamingTextures[next].slot;
+			const int evictedLevel = EvictedMipLevel(image.width, image.height);
+			const bool bEvictable = TextureDecoder::CopyMipTail(image, evictedLevel, m_textureIDs[slot].evictedPixels);
+			m_pTextureResidency->SetTexture(slot,
+				TextureBytes(image.width, image.height, 0),
+				TextureBytes(image.width, image.height, evictedLevel),
+				bEvictable);
+
+			TextureDecoder::FreeImage(m_streamingTextures[next].image);
+			m_streamingTextures.erase(m_streamingTextures.begin() + next);
+		}
+	}
+}
+
+/***********************************************************
+ *  BenchmarkTextureLoading()
+ *
+ *  This method is used for timing the scene texture loading
+ *  with the images decoded serially on this thread and in
+ *  parallel on the worker threads.  The texture cache is
+ *  turned off while timing, so every run decodes the image
+ *  files.  An untimed pass is made first so both paths read
+ *  the files from a warm disk cache.
+ ***********************************************************/
+void SceneManager::BenchmarkTextureLoading()
+{
+	const bool bParallelTextureLoading = m_bParallelTextureLoading;
+	const bool bUseTextureCache = (NULL != m_pTextureCache);
+	double serialMilliseconds = 0.0;
+	double parallelMilliseconds = 0.0;
+
+	// the cache would upload the decoded textures it holds
+	SetTextureCacheEnabled(false);
+
+	// untimed pass to warm the operating system's file cache
+	m_bParallelTextureLoading = false;
+	LoadSceneTextures();
+	DestroyGLTextures();
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		double totalMilliseconds = 0.0;
+
+		m_bParallelTextureLoading = (pass == 1);
+		for (int run = 0; run < TEXTURE_BENCHMARK_RUNS; run++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			LoadSceneTextures();
+			// wait for the driver to finish the uploads
+			glFinish();
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			totalMilliseconds += elapsed.count();
+
+			DestroyGLTextures();
+		}
+
+		if (pass == 0)
+			serialMilliseconds = totalMilliseconds / TEXTURE_BENCHMARK_RUNS;
+		else
+			parallelMilliseconds = totalMilliseconds / TEXTURE_BENCHMARK_RUNS;
+	}
+
+	m_bParallelTextureLoading = bParallelTextureLoading;
+	SetTextureCacheEnabled(bUseTextureCache);
+
+	std::cout << "BENCHMARK: serial texture loading: " << serialMilliseconds << " ms" << std::endl;
+	std::cout << "BENCHMARK: parallel texture loading: " << parallelMilliseconds << " ms" << std::endl;
+	if (parallelMilliseconds > 0.0)
+	{
+		std::cout << "BENCHMARK: speedup: " << serialMilliseconds / parallelMilliseconds << "x" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  BenchmarkTextureCache()
+ *
+ *  This method is used for timing the scene texture loading
+ *  with a cold texture cache, where every image is decoded,
+ *  mipmapped and written to the cache, against a warm cache,
+ *  where every texture is uploaded straight from the cache.
+ ***********************************************************/
+void SceneManager::BenchmarkTextureCache()
+{
+	if (NULL == m_pTextureCache)
+	{
+		std::cout << "BENCHMARK: the texture cache is turned off" << std::endl;
+		return;
+	}
+
+	double coldMilliseconds = 0.0;
+	double warmMilliseconds = 0.0;
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		double totalMilliseconds = 0.0;
+
+		// the cold pass ignores and rewrites every cache entry
+		m_pTextureCache->SetReadEnabled(pass == 1);
+		for (int run = 0; run < TEXTURE_BENCHMARK_RUNS; run++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			LoadSceneTextures();
+			// wait for the driver to finish the uploads
+			glFinish();
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			totalMilliseconds += elapsed.count();
+
+			DestroyGLTextures();
+		}
+
+		if (pass == 0)
+			coldMilliseconds = totalMilliseconds / TEXTURE_BENCHMARK_RUNS;
+		else
+			warmMilliseconds = totalMilliseconds / TEXTURE_BENCHMARK_RUNS;
+	}
+
+	m_pTextureCache->SetReadEnabled(true);
+
+	std::cout << "BENCHMARK: cold texture cache startup: " << coldMilliseconds << " ms" << std::endl;
+	std::cout << "BENCHMARK: warm texture cache startup: " << warmMilliseconds << " ms" << std::endl;
+	if (warmMilliseconds > 0.0)
+	{
+		std::cout << "BENCHMARK: speedup: " << coldMilliseconds / warmMilliseconds << "x" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  BenchmarkAssetPack()
+ *
+ *  This method is used for timing the scene texture loading
+ *  from the mapped asset pack against the loose image files,
+ *  and for measuring how much the resident memory of the
+ *  process grows with each.  The pack is loaded first, since
+ *  heap memory freed after the loose files are loaded would
+ *  hide the growth of the later runs.  The loose files go
+ *  through the texture cache unless it is turned off.
+ ***********************************************************/
+void SceneManager::BenchmarkAssetPack()
+{
+	const bool bUseAssetPack = m_bUseAssetPack;
+	double packMilliseconds = 0.0;
+	double looseMilliseconds = 0.0;
+	size_t packResidentBytes = 0;
+	size_t looseResidentBytes = 0;
+
+	m_bUseAssetPack = true;
+	OpenAssetPack();
+	if (m_pAssetPack->IsOpen() == false)
+	{
+		std::cout << "BENCHMARK: no asset pack - run with --pack first" << std::endl;
+		m_bUseAssetPack = bUseAssetPack;
+		return;
+	}
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		double totalMilliseconds = 0.0;
+		size_t mostResidentBytes = 0;
+
+		// the loose pass leaves the pack mapped but unused
+		m_bUseAssetPack = (pass == 0);
+		for (int run = 0; run < TEXTURE_BENCHMARK_RUNS; run++)
+		{
+			const size_t residentBytes = AssetPack::GetResidentMemoryBytes();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			LoadSceneTextures();
+			// wait for the driver to finish the uploads
+			glFinish();
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			totalMilliseconds += elapsed.count();
+
+			const size_t loadedResidentBytes = AssetPack::GetResidentMemoryBytes();
+			if (loadedResidentBytes > residentBytes + mostResidentBytes)
+			{
+				mostResidentBytes = loadedResidentBytes - residentBytes;
+			}
+
+			DestroyGLTextures();
+		}
+
+		if (pass == 0)
+		{
+			packMilliseconds = totalMilliseconds / TEXTURE_BENCHMARK_RUNS;
+			packResidentBytes = mostResidentBytes;
+		}
+		else
+		{
+			looseMilliseconds = totalMilliseconds / TEXTURE_BENCHMARK_RUNS;
+			looseResidentBytes = mostResidentBytes;
+		}
+	}
+
+	m_bUseAssetPack = bUseAssetPack;
+	if (m_bUseAssetPack == false)
+	{
+		m_pAssetPack->Close();
+	}
+
+	std::cout << "BENCHMARK: asset pack startup: " << packMilliseconds << " ms, resident memory growth: "
+		<< packResidentBytes / 1024 << " KB (" << m_pAssetPack->GetMappedBytes() / 1024 << " KB mapped)" << std::endl;
+	std::cout << "BENCHMARK: loose file startup: " << looseMilliseconds << " ms, resident memory growth: "
+		<< looseResidentBytes / 1024 << " KB" << std::endl;
+	if (packMilliseconds > 0.0)
+	{
+		std::cout << "BENCHMARK: speedup: " << looseMilliseconds / packMilliseconds << "x" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  BenchmarkUniforms()
+ *
+ *  This method is used for timing the uniforms a draw sets -
+ *  the model matrix, color, texture switch, UV scale and
+ *  material index - by name through the shader manager, which
+ *  looks up each location, against the reflected handles.
+ *  The values passed to the driver are the same for the first
+ *  two, so the difference is the cost of the name lookups.
+ *  The last pass also drops the sets that change nothing, as
+ *  the scene does - the texture switch and UV scale never
+ *  change here, and the color and material half the time.
+ ***********************************************************/
+void SceneManager::BenchmarkUniforms()
+{
+	const glm::vec2 uvScale(1.0f, 1.0f);
+	double milliseconds[3] = { 0.0, 0.0, 0.0 };
+
+	// the first pass sets by name, the second through handles,
+	// and the third through handles with redundant sets dropped
+	for (int pass = 0; pass < 3; pass++)
+	{
+		m_pShaderUniforms->SetFilteringEnabled(pass == 2);
+		m_pShaderUniforms->InvalidateValues();
+
+		for (int run = 0; run < TEXTURE_BENCHMARK_RUNS; run++)
+		{
+			glFinish();
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			for (int draw = 0; draw < UNIFORM_BENCHMARK_DRAWS; draw++)
+			{
+				const glm::mat4 model = glm::translate(glm::vec3((float)draw, 0.0f, 0.0f));
+				const glm::vec4 color(1.0f, 1.0f, 1.0f, ((draw >> 1) & 1) ? 1.0f : 0.5f);
+				const int materialIndex = (draw >> 1) & 1;
+
+				if (pass == 0)
+				{
+					m_pShaderManager->setMat4Value(g_ModelName, model);
+					m_pShaderManager->setIntValue(g_UseTextureName, false);
+					m_pShaderManager->setVec4Value(g_ColorValueName, color);
+					m_pShaderManager->setVec2Value(g_UVScaleName, uvScale);
+					m_pShaderManager->setIntValue(g_MaterialIndexName, materialIndex);
+				}
+				else
+				{
+					m_pShaderUniforms->Set(m_uniforms.model, model);
+					m_pShaderUniforms->Set(m_uniforms.useTexture, false);
+					m_pShaderUniforms->Set(m_uniforms.objectColor, color);
+					m_pShaderUniforms->Set(m_uniforms.UVscale, uvScale);
+					m_pShaderUniforms->Set(m_uniforms.materialIndex, materialIndex);
+				}
+			}
+
+			// wait for the driver to take every value
+			glFinish();
+
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			milliseconds[pass] += elapsed.count() / TEXTURE_BENCHMARK_RUNS;
+		}
+	}
+
+	m_pShaderUniforms->SetFilteringEnabled(true);
+	m_pShaderUniforms->InvalidateValues();
+
+	const double nameNanoseconds = milliseconds[0] * 1000000.0 / UNIFORM_BENCHMARK_DRAWS;
+	const double handleNanoseconds = milliseconds[1] * 1000000.0 / UNIFORM_BENCHMARK_DRAWS;
+	const double filteredNanoseconds = milliseconds[2] * 1000000.0 / UNIFORM_BENCHMARK_DRAWS;
+
+	std::cout << "BENCHMARK: " << m_pShaderUniforms->GetUniformCount() << " uniforms reflected, "
+		<< UNIFORM_BENCHMARK_UNIFORMS << " set per draw, " << UNIFORM_BENCHMARK_DRAWS << " draws" << std::endl;
+	std::cout << "BENCHMARK: uniforms by name: " << nameNanoseconds << " ns per draw, "
+		<< nameNanoseconds / UNIFORM_BENCHMARK_UNIFORMS << " ns per uniform" << std::endl;
+	std::cout << "BENCHMARK: uniforms by handle: " << handleNanoseconds << " ns per draw, "
+		<< handleNanoseconds / UNIFORM_BENCHMARK_UNIFORMS << " ns per uniform" << std::endl;
+	std::cout << "BENCHMARK: uniforms by handle, redundant sets dropped: " << filteredNanoseconds << " ns per draw" << std::endl;
+	if ((handleNanoseconds > 0.0) && (filteredNanoseconds > 0.0))
+	{
+		std::cout << "BENCHMARK: speedup: " << nameNanoseconds / handleNanoseconds << "x by handle, "
+			<< nameNanoseconds / filteredNanoseconds << "x with redundant sets dropped" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  BenchmarkShaderVariants()
+ *
+ *  This method is used for timing the GPU work of drawing the
+ *  prepared scene with the program that branches at runtime,
+ *  and then with the shader variants.  Each frame is timed
+ *  with a GL_TIME_ELAPSED query, and the first frames of each
+ *  pass are left untimed while the variants are built and the
+ *  driver settles.
+ ***********************************************************/
+void SceneManager::BenchmarkShaderVariants(const UniformBlocks::FRAME_DATA& frameData)
+{
+	if ((NULL == m_pShaderVariants) || (NULL == m_pUniformBlocks))
+	{
+		std::cout << "BENCHMARK: the shader variants are turned off" << std::endl;
+		return;
+	}
+
+	GLuint queries[SHADER_BENCHMARK_FRAMES];
+	double gpuMilliseconds[2] = { 0.0, 0.0 };
+
+	glGenQueries(SHADER_BENCHMARK_FRAMES, queries);
+	EnableDepthTest();
+
+	// pass 0 draws with the runtime branches, pass 1 with the variants
+	for (int pass = 0; pass < 2; pass++)
+	{
+		SetShaderVariantsEnabled(pass == 1);
+
+		for (int frame = 0; frame < SHADER_BENCHMARK_WARMUP_FRAMES + SHADER_BENCHMARK_FRAMES; frame++)
+		{
+			const int timedFrame = frame - SHADER_BENCHMARK_WARMUP_FRAMES;
+
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			m_pUniformBlocks->SetFrameData(frameData);
+			if (timedFrame >= 0)
+			{
+				glBeginQuery(GL_TIME_ELAPSED, queries[timedFrame]);
+			}
+			RenderScene();
+			if (timedFrame >= 0)
+			{
+				glEndQuery(GL_TIME_ELAPSED);
+			}
+			m_pUniformBlocks->EndFrame();
+		}
+
+		GLuint64 totalNanoseconds = 0;
+		for (int i = 0; i < SHADER_BENCHMARK_FRAMES; i++)
+		{
+			GLuint64 elapsedNanoseconds = 0;
+			glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsedNanoseconds);
+			totalNanoseconds += elapsedNanoseconds;
+		}
+		gpuMilliseconds[pass] = (double)totalNanoseconds / 1000000.0 / SHADER_BENCHMARK_FRAMES;
+	}
+
+	glDeleteQueries(SHADER_BENCHMARK_FRAMES, queries);
+	SetShaderVariantsEnabled(true);
+
+	std::cout << "BENCHMARK: " << SHADER_BENCHMARK_FRAMES << " frames of the scene, "
+		<< m_activePointLights << " point lights on, " << m_pShaderVariants->GetVariantCount() << " variants built" << std::endl;
+	std::cout << "BENCHMARK: runtime-branching shader: " << gpuMilliseconds[0] << " ms GPU per frame" << std::endl;
+	std::cout << "BENCHMARK: shader variants: " << gpuMilliseconds[1] << " ms GPU per frame" << std::endl;
+	if (gpuMilliseconds[1] > 0.0)
+	{
+		std::cout << "BENCHMARK: speedup: " << gpuMilliseconds[0] / gpuMilliseconds[1] << "x" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  BenchmarkDrawList()
+ *
+ *  This method is used for timing the CPU work of drawing the
+ *  prepared scene through the RenderXxx() methods, and then
+ *  by submitting the retained draw list.  Only the calls of
+ *  the scene are timed, and the GPU is waited on between
+ *  frames so its work does not show in the CPU time.
+ ***********************************************************/
+void SceneManager::BenchmarkDrawList(const UniformBlocks::FRAME_DATA& frameData)
+{
+	if (NULL == m_pUniformBlocks)
+	{
+		return;
+	}
+
+	double milliseconds[2] = { 0.0, 0.0 };
+
+	EnableDepthTest();
+
+	// pass 0 runs the RenderXxx() methods, pass 1 the draw list
+	for (int pass = 0; pass < 2; pass++)
+	{
+		SetDrawListEnabled(pass == 1);
+
+		for (int frame = 0; frame < DRAW_LIST_BENCHMARK_FRAMES; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			m_pUniformBlocks->SetFrameData(frameData);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			RenderScene();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			milliseconds[pass] += elapsed.count();
+
+			m_pUniformBlocks->EndFrame();
+			glFinish();
+		}
+		milliseconds[pass] /= DRAW_LIST_BENCHMARK_FRAMES;
+	}
+
+	SetDrawListEnabled(true);
+
+	std::cout << "BENCHMARK: " << DRAW_LIST_BENCHMARK_FRAMES << " frames of the scene, "
+		<< m_drawList.size() << " draws in the draw list" << std::endl;
+	std::cout << "BENCHMARK: RenderXxx() methods: " << milliseconds[0] << " ms CPU per frame" << std::endl;
+	std::cout << "BENCHMARK: retained draw list: " << milliseconds[1] << " ms CPU per frame" << std::endl;
+	if (milliseconds[1] > 0.0)
+	{
+		std::cout << "BENCHMARK: speedup: " << milliseconds[0] / milliseconds[1] << "x" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  BenchmarkTransforms()
+ *
+ *  This method is used for timing the composition of random
+ *  transforms at counts from the objects of the scene up to a
+ *  million.  Each object gets a model matrix, a normal matrix
+ *  and a model-view-projection matrix, first one at a time
+ *  with glm the way SetTransformations() works, then in a
+ *  batch with each kernel the processor runs.  The largest
+ *  difference of a kernel's model matrices from glm is shown
+ *  next to its time.
+ ***********************************************************/
+void SceneManager::BenchmarkTransforms(const UniformBlocks::FRAME_DATA& frameData)
+{
+	const glm::mat4 viewProjection = frameData.projection * frameData.view;
+	const int counts = (int)(sizeof(TRANSFORM_BENCHMARK_COUNTS) / sizeof(TRANSFORM_BENCHMARK_COUNTS[0]));
+	const TransformBatch::KERNEL bestKernel = TransformBatch::BestKernel();
+
+	std::cout << "BENCHMARK: composing transforms, widest kernel "
+		<< TransformBatch::KernelName(bestKernel) << std::endl;
+
+	// the same seed gives the same transforms every run
+	std::mt19937 random(330);
+	std::uniform_real_distribution<float> scaleRange(0.1f, 4.0f);
+	std::uniform_real_distribution<float> angleRange(-360.0f, 360.0f);
+	std::uniform_real_distribution<float> positionRange(-20.0f, 20.0f);
+
+	for (int countIndex = 0; countIndex < counts; countIndex++)
+	{
+		const int count = TRANSFORM_BENCHMARK_COUNTS[countIndex];
+		const int runs = std::max(1, TRANSFORM_BENCHMARK_OBJECTS / count);
+
+		std::vector<glm::vec3> scales(count);
+		std::vector<glm::vec3> rotations(count);
+		std::vector<glm::vec3> positions(count);
+		TransformBatch batch;
+		for (int i = 0; i < count; i++)
+		{
+			scales[i] = glm::vec3(scaleRange(random), scaleRange(random), scaleRange(random));
+			rotations[i] = glm::vec3(angleRange(random), angleRange(random), angleRange(random));
+			positions[i] = glm::vec3(positionRange(random), positionRange(random), positionRange(random));
+			batch.Add(scales[i], rotations[i].x, rotations[i].y, rotations[i].z, positions[i]);
+		}
+
+		// the sum of the matrices keeps the glm work from being
+		// optimized away
+		float checksum = 0.0f;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; run++)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				glm::mat4 model = TransformBatch::ComposeReference(
+					scales[i], rotations[i].x, rotations[i].y, rotations[i].z, positions[i]);
+				glm::mat3 normal = glm::transpose(glm::inverse(glm::mat3(model)));
+				glm::mat4 mvp = viewProjection * model;
+				checksum += normal[0][0] + mvp[3][3];
+			}
+		}
+		std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << "BENCHMARK: " << count << " objects, glm one at a time: "
+			<< elapsed.count() / ((double)runs * count) << " ns per object (checksum "
+			<< checksum << ")" << std::endl;
+
+		for (int kernel = TransformBatch::KERNEL_SCALAR; kernel <= bestKernel; kernel++)
+		{
+			start = std::chrono::steady_clock::now();
+			for (int run = 0; run < runs; run++)
+			{
+				batch.Compose((TransformBatch::KERNEL)kernel, true, &viewProjection);
+			}
+			elapsed = std::chrono::steady_clock::now() - start;
+
+			float maxError = 0.0f;
+			const glm::mat4* pModelMatrices = batch.GetModelMatrices();
+			for (int i = 0; i < count; i++)
+			{
+				glm::mat4 model = TransformBatch::ComposeReference(
+					scales[i], rotations[i].x, rotations[i].y, rotations[i].z, positions[i]);
+				for (int column = 0; column < 4; column++)
+				{
+					for (int row = 0; row < 4; row++)
+					{
+						maxError = std::max(maxError, fabsf(pModelMatrices[i][column][row] - model[column][row]));
+					}
+				}
+			}
+
+			std::cout << "BENCHMARK: " << count << " objects, "
+				<< TransformBatch::KernelName((TransformBatch::KERNEL)kernel) << " batch: "
+				<< elapsed.count() / ((double)runs * count) << " ns per object (largest error "
+				<< maxError << ")" << std::endl;
+		}
+	}
+}
+
+/***********************************************************
+ *  BenchmarkInstancing()
+ *
+ *  This method is used for timing the CPU work of drawing a
+ *  shelf of copies of the scene, set out in rows, first a
+ *  record at a time, then a batch at a time with instanced
+ *  draws, and then from the draw command buffer when the
+ *  driver can.  The draw list of the scene is put back
+ *  afterwards.
+ ***********************************************************/
+void SceneManager::BenchmarkInstancing(const UniformBlocks::FRAME_DATA& frameData)
+{
+	if ((NULL == m_pUniformBlocks) || (m_bUseShaderVariants == false))
+	{
+		std::cout << "BENCHMARK: instanced draws need the shader variants" << std::endl;
+		return;
+	}
+
+	const bool bUseInstancing = m_bUseInstancing;
+	const bool bUseIndirectDraws = m_bUseIndirectDraws;
+	std::vector<DRAW_RECORD> sceneDraws = m_drawList;
+	if (m_pInstancedMeshes->IsCreated() == false)
+	{
+		m_pInstancedMeshes->Create();
+	}
+
+	m_drawList.clear();
+	m_bDrawOrderReady = false;
+	for (int copy = 0; copy < INSTANCING_BENCHMARK_COPIES; copy++)
+	{
+		const glm::vec3 offset(
+			(copy % INSTANCING_BENCHMARK_ROW) * INSTANCING_BENCHMARK_SPACING,
+			0.0f,
+			-(copy / INSTANCING_BENCHMARK_ROW) * INSTANCING_BENCHMARK_SPACING);
+		const glm::mat4 translation = glm::translate(offset);
+
+		for (size_t i = 0; i < sceneDraws.size(); i++)
+		{
+			DRAW_RECORD draw = sceneDraws[i];
+			draw.modelMatrix = translation * draw.modelMatrix;
+			m_drawList.push_back(draw);
+		}
+	}
+	BuildInstanceBatches();
+
+	double milliseconds[3] = { 0.0, 0.0, 0.0 };
+	const int passCount = (m_bIndirectReady == true) ? 3 : 2;
+
+	EnableDepthTest();
+
+	// pass 0 draws a record at a time, pass 1 a batch at a time
+	// and pass 2 indirectly, each after one untimed frame that
+	// builds the variants it uses
+	for (int pass = 0; pass < passCount; pass++)
+	{
+		SetInstancingEnabled(pass == 1);
+		SetIndirectDrawsEnabled(pass == 2);
+
+		for (int frame = -1; frame < INSTANCING_BENCHMARK_FRAMES; frame++)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			m_pUniformBlocks->SetFrameData(frameData);
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			RenderScene();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			if (frame >= 0)
+			{
+				milliseconds[pass] += elapsed.count();
+			}
+
+			m_pUniformBlocks->EndFrame();
+			glFinish();
+		}
+		milliseconds[pass] /= INSTANCING_BENCHMARK_FRAMES;
+	}
+
+	std::cout << "BENCHMARK: " << INSTANCING_BENCHMARK_FRAMES << " frames of " << INSTANCING_BENCHMARK_COPIES
+		<< " copies of the scene, " << m_drawList.size() << " draws in " << m_instanceBatches.size()
+		<< " batches" << std::endl;
+	std::cout << "BENCHMARK: a draw per record: " << milliseconds[0] << " ms CPU per frame" << std::endl;
+	std::cout << "BENCHMARK: an instanced draw per batch: " << milliseconds[1] << " ms CPU per frame" << std::endl;
+	if (milliseconds[1] > 0.0)
+	{
+		std::cout << "BENCHMARK: speedup: " << milliseconds[0] / milliseconds[1] << "x" << std::endl;
+	}
+	if (passCount == 3)
+	{
+		const int indirectCalls = ((m_firstTexturedBatch > 0) ? 1 : 0) +
+			((m_firstTexturedBatch < m_firstBlendedBatch) ? 1 : 0) +
+			((m_firstBlendedBatch < (int)m_instanceBatches.size()) ? 1 : 0);
+		std::cout << "BENCHMARK: " << indirectCalls << " indirect draw calls: " << milliseconds[2]
+			<< " ms CPU per frame" << std::endl;
+		if (milliseconds[2] > 0.0)
+		{
+			std::cout << "BENCHMARK: speedup: " << milliseconds[0] / milliseconds[2] << "x" << std::endl;
+		}
+	}
+	else
+	{
+		std::cout << "INFO: indirect draws are not supported with this driver and texture mode" << std::endl;
+	}
+
+	m_drawList = sceneDraws;
+	m_bDrawOrderReady = false;
+	BuildInstanceBatches();
+	SetInstancingEnabled(bUseInstancing);
+	SetIndirectDrawsEnabled(bUseIndirectDraws);
+}
+
+/***********************************************************
+ *  BenchmarkDrawSort()
+ *
+ *  This method is used for counting the state changes the
+ *  sort saves the draw list from the camera of a frame, and
+ *  timing the radix sort against std::sort on lists of random
+ *  draw keys, from the size of the scene up to a million.
+ ***********************************************************/
+void SceneManager::BenchmarkDrawSort(const UniformBlocks::FRAME_DATA& frameData)
+{
+	if (m_drawList.size() > 0)
+	{
+		std::vector<int> recordedOrder(m_drawList.size());
+		for (size_t i = 0; i < recordedOrder.size(); i++)
+		{
+			recordedOrder[i] = (int)i;
+		}
+		MakeDrawKeys(frameData.viewPosition);
+		m_drawSort.Sort(m_drawKeys, m_drawOrder);
+
+		std::cout << "BENCHMARK: " << m_drawList.size() << " draws of the scene, state changes "
+			<< DrawSort::TotalStateChanges(DrawSort::CountStateChanges(m_drawKeys, recordedOrder))
+			<< " in recorded order, "
+			<< DrawSort::TotalStateChanges(DrawSort::CountStateChanges(m_drawKeys, m_drawOrder))
+			<< " sorted" << std::endl;
+
+		// the order of the next frame is sorted from its own camera
+		m_bDrawOrderReady = false;
+	}
+
+	// the same seed gives the same keys every run
+	std::mt19937 random(330);
+	std::uniform_int_distribution<int> textureRange(0, 40);
+	std::uniform_int_distribution<int> meshRange(0, ShapeGeometry::SHAPE_COUNT - 1);
+	std::uniform_int_distribution<int> materialRange(0, 20);
+	std::uniform_real_distribution<float> depthRange(0.5f, 100.0f);
+	std::uniform_real_distribution<float> transparentRange(0.0f, 1.0f);
+
+	const int counts = (int)(sizeof(DRAW_SORT_BENCHMARK_COUNTS) / sizeof(DRAW_SORT_BENCHMARK_COUNTS[0]));
+	for (int countIndex = 0; countIndex < counts; countIndex++)
+	{
+		const int count = DRAW_SORT_BENCHMARK_COUNTS[countIndex];
+		const int runs = std::max(1, DRAW_SORT_BENCHMARK_KEYS / count);
+
+		std::vector<uint64_t> keys(count);
+		for (int i = 0; i < count; i++)
+		{
+			DrawSort::DRAW_KEY fields;
+			fields.pass = 0;
+			fields.bTransparent = (transparentRange(random) < 0.1f);
+			fields.texture = textureRange(random);
+			fields.variant = (fields.texture > 0) ? 1 : 0;
+			fields.mesh = meshRange(random);
+			fields.material = materialRange(random);
+			fields.depth = depthRange(random);
+			keys[i] = DrawSort::MakeKey(fields);
+		}
+
+		DrawSort sort;
+		std::vector<int> order;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; run++)
+		{
+			sort.Sort(keys, order);
+		}
+		std::chrono::duration<double, std::nano> radixElapsed = std::chrono::steady_clock::now() - start;
+
+		// std::sort orders the indexes by their keys, the way the
+		// radix sort hands them back
+		std::vector<int> compareOrder(count);
+		start = std::chrono::steady_clock::now();
+		for (int run = 0; run < runs; run++)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				compareOrder[i] = i;
+			}
+			std::sort(compareOrder.begin(), compareOrder.end(),
+				[&keys](int first, int second) { return(keys[first] < keys[second]); });
+		}
+		std::chrono::duration<double, std::nano> compareElapsed = std::chrono::steady_clock::now() - start;
+
+		const double radixNanoseconds = radixElapsed.count() / ((double)runs * count);
+		const double compareNanoseconds = compareElapsed.count() / ((double)runs * count);
+		std::cout << "BENCHMARK: " << count << " keys, radix sort: " << radixNanoseconds
+			<< " ns per key, std::sort: " << compareNanoseconds << " ns per key";
+		if (radixNanoseconds > 0.0)
+		{
+			std::cout << ", speedup " << compareNanoseconds / radixNanoseconds << "x";
+		}
+		std::cout << std::endl;
+	}
+}
+
+/**************************************************************/
+/*** STUDENTS CAN MODIFY the code in the methods BELOW for  ***/
+/*** preparing and rendering their own 3D replicated scenes.***/
+/*** Please refer to the code in the OpenGL sample project  ***/
+/*** for assistance.                                        ***/
+/**************************************************************/
+
+/***********************************************************
+ *  LoadSceneTextures()
+ *
+ *  This method is used for preparing the 3D scene by loading
+ *  the shapes, textures in memory to support the 3D scene
+ *  rendering
+ ***********************************************************/
+void SceneManager::LoadSceneTextures()
+{
+	// bindless handles fall back to texture arrays when the
+	// driver does not support them
+	if ((m_textureMode == TEXTURE_MODE_BINDLESS) && (!GLEW_ARB_bindless_texture))
+	{
+		std::cout << "ARB_bindless_texture not supported, using texture arrays" << std::endl;
+		m_textureMode = TEXTURE_MODE_ARRAYS;
+	}
+
+	// streamed textures move their base level as the mip levels
+	// arrive, which neither a bindless handle nor a texture array
+	// shared with other images allows, so each takes a slot
+	if ((m_bStreamTextures == true) && (m_textureMode != TEXTURE_MODE_SLOTS))
+	{
+		std::cout << "Texture streaming uses texture slots" << std::endl;
+		m_textureMode = TEXTURE_MODE_SLOTS;
+	}
+	if (m_bStreamTextures == true)
+	{
+		CreatePlaceholderTexture();
+	}
+
+	// uploads go through a persistently mapped pixel buffer when
+	// the driver supports one
+	if ((NULL == m_pUploadRing) && (MappedRingBuffer::IsSupported()))
+	{
+		m_pUploadRing = new MappedRingBuffer();
+		if (m_pUploadRing->Create(GL_PIXEL_UNPACK_BUFFER, TEXTURE_UPLOAD_RING_SIZE) == false)
+		{
+			delete m_pUploadRing;
+			m_pUploadRing = NULL;
+		}
+	}
+
+	// the texture image files are decoded on worker threads
+	// while the textures are uploaded to OpenGL on this thread
+	// - the image files are listed in g_SceneTextures, which is
+	// also what goes into the asset pack
+	for (int i = 0; i < SCENE_TEXTURE_COUNT; i++)
+	{
+		QueueGLTexture(
+			g_SceneTextures[i].filename,
+			g_SceneTextures[i].tag);
+	}
+
+	// upload the textures as the worker threads finish decoding
+	// them - streamed textures are uploaded over the next frames
+	CreateQueuedGLTextures();
+
+	// after the texture image data is loaded into memory, the
+	// loaded textures or texture arrays need to be bound to
+	// texture slots - bindless textures need no slots
+	BindGLTextures();
+}
+
+void SceneManager::DefineObjectMaterials()
+{
+	// the scene materials are read from the material library,
+	// which is compiled from its text source at build time -
+	// more can be added in code with AddObjectMaterial()
+	if (m_pMaterialLibrary->Load(g_MaterialSourceName, g_MaterialLibraryName) == false)
+	{
+		std::cout << "Could not load the material library:" << g_MaterialLibraryName << std::endl;
+	}
+	else
+	{
+		std::cout << "Loaded " << m_pMaterialLibrary->GetMaterialCount() << " materials:" << g_MaterialLibraryName << std::endl;
+	}
+}
+
+void SceneManager::SetupSceneLights()
+{
+	m_bUseLighting = true;
+	m_pShaderUniforms->Set(m_uniforms.useLighting, m_bUseLighting);
+
+	// the lights are written into the light block each frame,
+	// and the spot light stays off
+	m_lightData = UniformBlocks::LIGHT_DATA();
+
+	// directional light to emulate sunlight coming into scene
+	m_lightData.directionalLight.direction = glm::vec3(-0.05f, -0.3f, -0.1f);
+	m_lightData.directionalLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	m_lightData.directionalLight.diffuse = glm::vec3(0.6f, 0.6f, 0.6f);
+	m_lightData.directionalLight.specular = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_lightData.directionalLight.bActive = 1;
+
+	// point light 1
+	m_lightData.pointLights[0].position = glm::vec3(-4.0f, 8.0f, 0.0f);
+	m_lightData.pointLights[0].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	m_lightData.pointLights[0].diffuse = glm::vec3(0.3f, 0.3f, 0.3f);
+	m_lightData.pointLights[0].specular = glm::vec3(0.1f, 0.1f, 0.1f);
+	m_lightData.pointLights[0].bActive = 1;
+	// point light 2
+	m_lightData.pointLights[1].position = glm::vec3(4.0f, 8.0f, 0.0f);
+	m_lightData.pointLights[1].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	m_lightData.pointLights[1].diffuse = glm::vec3(0.3f, 0.3f, 0.3f);
+	m_lightData.pointLights[1].specular = glm::vec3(0.1f, 0.1f, 0.1f);
+	m_lightData.pointLights[1].bActive = 1;
+	// point light 3
+	m_lightData.pointLights[2].position = glm::vec3(3.8f, 5.5f, 4.0f);
+	m_lightData.pointLights[2].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	m_lightData.pointLights[2].diffuse = glm::vec3(0.2f, 0.2f, 0.2f);
+	m_lightData.pointLights[2].specular = glm::vec3(0.8f, 0.8f, 0.8f);
+	m_lightData.pointLights[2].bActive = 1;
+	// point light 4
+	m_lightData.pointLights[3].position = glm::vec3(5.0f, 6.5f, 6.0f);
+	m_lightData.pointLights[3].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	m_lightData.pointLights[3].diffuse = glm::vec3(0.2f, 0.2f, 0.2f);
+	m_lightData.pointLights[3].specular = glm::vec3(0.8f, 0.8f, 0.8f);
+	m_lightData.pointLights[3].bActive = 1;
+
+	// the shader variants loop over exactly the point lights
+	// that are on, which are moved to the front of the block
+	m_activePointLights = UniformBlocks::PackPointLights(m_lightData);
+}
+
+/***********************************************************
  *  PrepareScene()
  *
  *  This method is used for preparing the 3D scene by loading
@@ -542,9 +4175,16 @@ void SceneManager::PrepareScene()
 	// loaded in memory no matter how many times it is drawn
 	// in the rendered 3D scene
 
+	// the lights decide which shader variants are drawn with,
+	// so they are set up first and the variants compile while
+	// the textures and meshes load
+	SetupSceneLights();
+	PrefetchShaderVariants();
+
+	OpenAssetPack(); // map the packed textures, if built
 	LoadSceneTextures(); // load texture image files to scene
 	DefineObjectMaterials();
-	SetupSceneLights();
+	CreateMaterialBuffer(); // upload the materials to the shader
 
 	m_basicMeshes->LoadPlaneMesh();
 	m_basicMeshes->LoadCylinderMesh();
@@ -552,6 +4192,18 @@ void SceneManager::PrepareScene()
 	m_basicMeshes->LoadTorusMesh();
 	m_basicMeshes->LoadSphereMesh();
 	m_basicMeshes->LoadBoxMesh();
+	// the merged shapes are only uploaded for a list drawn by
+	// batch, the instancing benchmark uploads them itself
+	if ((m_bUseInstancing == true) || (m_bUseIndirectDraws == true))
+	{
+		m_pInstancedMeshes->Create();
+	}
+
+	// the scene is static, so its draws are worked out once
+	BuildDrawList();
+
+	// build the programs and state of the first frame now
+	WarmUpShaders();
 }
 
 /***********************************************************
@@ -561,6 +4213,43 @@ void SceneManager::PrepareScene()
  *  transforming and drawing the basic 3D shapes
  ***********************************************************/
 void SceneManager::RenderScene()
+{
+	// the light block range of an earlier frame may be reused by
+	// now, so the lights are written again every frame
+	if (NULL != m_pUniformBlocks)
+	{
+		m_pUniformBlocks->SetLightData(m_lightData);
+	}
+
+	if ((m_bUseDrawList == true) && (m_drawList.size() > 0))
+	{
+		if ((m_bUseIndirectDraws == true) && (m_bIndirectReady == true) && (m_bUseShaderVariants == true))
+		{
+			SubmitIndirectDraws();
+		}
+		else if ((m_bUseInstancing == true) && (m_bUseShaderVariants == true) && (m_instanceBatches.size() > 0))
+		{
+			SubmitInstanceBatches();
+		}
+		else
+		{
+			SubmitDrawList();
+		}
+	}
+	else
+	{
+		RenderSceneObjects();
+	}
+}
+
+/***********************************************************
+ *  RenderSceneObjects()
+ *
+ *  This method is used for drawing every object of the scene
+ *  through its RenderXxx() method, or recording the draws
+ *  when the draw list is built.
+ ***********************************************************/
+void SceneManager::RenderSceneObjects()
 {
 	RenderBackground();
 	RenderTable();
@@ -606,7 +4295,7 @@ void SceneManager::RenderBackground()
 	SetShaderMaterial("wall");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawPlaneMesh();
+	DrawShape(SHAPE_PLANE);
 }
 
 void SceneManager::RenderTable()
@@ -645,7 +4334,7 @@ void SceneManager::RenderTable()
 	SetShaderMaterial("wood");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawBoxMesh();
+	DrawShape(SHAPE_BOX);
 }
 
 void SceneManager::RenderDraughtLivingDeath()
@@ -685,7 +4374,7 @@ void SceneManager::RenderDraughtLivingDeath()
 	SetShaderMaterial("liquid");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 	/****************************************************************/
 	/*** Adds tapered neck to bottle shape of "Draught of Living Death" potion ***/
 
@@ -712,7 +4401,7 @@ void SceneManager::RenderDraughtLivingDeath()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	DrawShape(SHAPE_TAPERED_CYLINDER);
 	/****************************************************************/
 	/*** Adds main neck shape to "Draught of Living Death" potion ***/
 
@@ -739,7 +4428,7 @@ void SceneManager::RenderDraughtLivingDeath()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 	/****************************************************************/
 	/*** Adds lip to bottle neck of "Draught of Living Death" potion ***/
 
@@ -766,7 +4455,7 @@ void SceneManager::RenderDraughtLivingDeath()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Draught of Living Death" potion ***/
 
@@ -796,7 +4485,7 @@ void SceneManager::RenderDraughtLivingDeath()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Draught of Living Death" potion ***/
 
@@ -826,7 +4515,7 @@ void SceneManager::RenderDraughtLivingDeath()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Draught of Living Death" potion ***/
 
@@ -856,7 +4545,7 @@ void SceneManager::RenderDraughtLivingDeath()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Draught of Living Death" potion ***/
@@ -887,7 +4576,7 @@ void SceneManager::RenderDraughtLivingDeath()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Draught of Living Death" potion ***/
@@ -918,7 +4607,7 @@ void SceneManager::RenderDraughtLivingDeath()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds cork in neck to "Draught of Living Death" potion ***/
@@ -949,7 +4638,7 @@ void SceneManager::RenderDraughtLivingDeath()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 	/****************************************************************/
 }
 
@@ -990,7 +4679,7 @@ void SceneManager::RenderAmortentia()
 	SetShaderMaterial("loveGlow");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds tapered neck to bottle shape of "Amortentia" potion ***/
@@ -1018,7 +4707,7 @@ void SceneManager::RenderAmortentia()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	DrawShape(SHAPE_TAPERED_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds main neck shape to "Amortentia" potion ***/
@@ -1046,7 +4735,7 @@ void SceneManager::RenderAmortentia()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds lip to bottle neck of "Amortentia" potion ***/
@@ -1074,7 +4763,7 @@ void SceneManager::RenderAmortentia()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds cork in neck to "Amortentia" potion ***/
@@ -1104,7 +4793,7 @@ void SceneManager::RenderAmortentia()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Amortentia" potion ***/
@@ -1135,7 +4824,7 @@ void SceneManager::RenderAmortentia()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Amortentia" potion ***/
@@ -1166,7 +4855,7 @@ void SceneManager::RenderAmortentia()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Amortentia" potion ***/
@@ -1197,7 +4886,7 @@ void SceneManager::RenderAmortentia()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Amortentia" potion ***/
@@ -1228,7 +4917,7 @@ void SceneManager::RenderAmortentia()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 }
 
 void SceneManager::RenderThunderbrew() 
@@ -1268,7 +4957,7 @@ void SceneManager::RenderThunderbrew()
 	SetShaderMaterial("liquid");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds tapered neck to bottle shape of "Thunderbew" potion ***/
@@ -1296,7 +4985,7 @@ void SceneManager::RenderThunderbrew()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	DrawShape(SHAPE_TAPERED_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds main neck shape to "Thunderbew" potion ***/
@@ -1324,7 +5013,7 @@ void SceneManager::RenderThunderbrew()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds lip to bottle neck of "Thunderbew" potion ***/
@@ -1352,7 +5041,7 @@ void SceneManager::RenderThunderbrew()
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Thunderbew" potion ***/
@@ -1383,7 +5072,7 @@ void SceneManager::RenderThunderbrew()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Thunderbew" potion ***/
@@ -1414,7 +5103,7 @@ void SceneManager::RenderThunderbrew()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Thunderbew" potion ***/
@@ -1445,7 +5134,7 @@ void SceneManager::RenderThunderbrew()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to bottle neck of "Thunderbew" potion ***/
@@ -1476,7 +5165,7 @@ void SceneManager::RenderThunderbrew()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds cork in neck to "Thunderbew" potion ***/
@@ -1506,7 +5195,7 @@ void SceneManager::RenderThunderbrew()
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 	/****************************************************************/
 }
 
@@ -1546,7 +5235,7 @@ void SceneManager::RenderFelix() {
 	SetShaderMaterial("felixGlow");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawSphereMesh();
+	DrawShape(SHAPE_SPHERE);
 
 	/****************************************************************/
 	/*** Adds main neck shape to "Felix" potion ***/
@@ -1577,7 +5266,7 @@ void SceneManager::RenderFelix() {
 	SetShaderMaterial("felixGlow");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTaperedCylinderMesh();
+	DrawShape(SHAPE_TAPERED_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds main neck shape to "Felix" potion ***/
@@ -1605,7 +5294,7 @@ void SceneManager::RenderFelix() {
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds lip to bottle neck of "Felix" potion ***/
@@ -1633,7 +5322,7 @@ void SceneManager::RenderFelix() {
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds cork in neck to "Felix" potion ***/
@@ -1663,7 +5352,7 @@ void SceneManager::RenderFelix() {
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds handle to "Felix" potion ***/
@@ -1691,7 +5380,7 @@ void SceneManager::RenderFelix() {
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to "Felix" potion ***/
@@ -1722,7 +5411,7 @@ void SceneManager::RenderFelix() {
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to "Felix" potion ***/
@@ -1753,7 +5442,7 @@ void SceneManager::RenderFelix() {
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to "Felix" potion ***/
@@ -1784,7 +5473,7 @@ void SceneManager::RenderFelix() {
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds twine to "Felix" potion ***/
@@ -1815,7 +5504,7 @@ void SceneManager::RenderFelix() {
 	SetShaderMaterial("twine");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 }
 
 void SceneManager::RenderFlooPowder() {
@@ -1851,7 +5540,7 @@ void SceneManager::RenderFlooPowder() {
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 
 	/****************************************************************/
 	/*** Adds lid to Floo Powder ***/
@@ -1879,7 +5568,7 @@ void SceneManager::RenderFlooPowder() {
 	SetShaderMaterial("glass");
 	
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawHalfSphereMesh();
+	DrawShape(SHAPE_HALF_SPHERE);
 
 	/****************************************************************/
 	/*** Adds lid siding to Floo Powder ***/
@@ -1907,7 +5596,7 @@ void SceneManager::RenderFlooPowder() {
 	SetShaderMaterial("glass");
 	
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawTorusMesh();
+	DrawShape(SHAPE_TORUS);
 
 	/****************************************************************/
 	/*** Adds lid handle to Floo Powder ***/
@@ -1935,5 +5624,5 @@ void SceneManager::RenderFlooPowder() {
 	SetShaderMaterial("glass");
 
 	// draw the mesh with transformation values
-	m_basicMeshes->DrawCylinderMesh();
+	DrawShape(SHAPE_CYLINDER);
 }
\ No newline at end of file
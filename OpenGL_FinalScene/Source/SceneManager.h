@@ -11,9 +11,26 @@
 
 #include "ShaderManager.h"
 #include "ShapeMeshes.h"
+#include "TextureDecoder.h"
+#include "TextureCache.h"
+#include "TextureResidency.h"
+#include "ResourceTag.h"
+#include "MappedRingBuffer.h"
+#include "AssetPack.h"
+#include "TextureAtlas.h"
+#include "MaterialLibrary.h"
+#include "ShaderUniforms.h"
+#include "UniformBlocks.h"
+#include "ShaderVariants.h"
+#include "TransformBatch.h"
+#include "InstancedMeshes.h"
+#include "DrawSort.h"
+#include "GLStateCache.h"
 
 #include <string>
 #include <vector>
+#include <unordered_map>
+#include <unordered_set>
 
 /***********************************************************
  *  SceneManager
@@ -25,14 +42,80 @@ class SceneManager
 {
 public:
 	// constructor
-	SceneManager(ShaderManager *pShaderManager);
+	SceneManager(ShaderManager *pShaderManager, ShaderUniforms* pShaderUniforms, UniformBlocks* pUniformBlocks, GLStateCache* pStateCache);
 	// destructor
 	~SceneManager();
 
+	// how the loaded textures are handed to the shader
+	enum TEXTURE_MODE
+	{
+		// each texture is bound to its own texture unit
+		TEXTURE_MODE_SLOTS,
+		// same-sized textures are packed into texture array layers
+		TEXTURE_MODE_ARRAYS,
+		// each texture is passed as an ARB_bindless_texture handle
+		TEXTURE_MODE_BINDLESS
+	};
+
 	struct TEXTURE_INFO
 	{
 		std::string tag;
 		uint32_t ID;
+		// image file the texture is loaded from again after eviction
+		std::string filename;
+		// full resolution size of the texture
+		int width;
+		int height;
+		// texture array holding the texture and its layer, or -1
+		int arrayIndex;
+		int layer;
+		// resident bindless texture handle, or 0
+		GLuint64 handle;
+		// slot of the atlas holding the texture, or -1, and the
+		// UV offset (xy) and scale (zw) of the texture within it
+		int atlasSlot;
+		glm::vec4 atlasRect;
+		// RGBA low mip levels the texture is evicted down to, kept
+		// so an eviction reads nothing back from video memory
+		std::vector<unsigned char> evictedPixels;
+	};
+
+	struct TEXTURE_ARRAY
+	{
+		uint32_t ID;
+		int width;
+		int height;
+		int layers;
+	};
+
+	struct STREAMING_TEXTURE
+	{
+		// index of the texture in the loaded textures, which is
+		// also the texture slot it is bound to
+		int slot;
+		// OpenGL texture receiving the mip levels, 0 until the
+		// first level is uploaded
+		uint32_t ID;
+		// decoded RGBA image holding the full mip chain
+		TextureDecoder::DECODED_IMAGE image;
+		// next mip level to upload, counting down to 0
+		int nextLevel;
+	};
+
+	struct TEXTURE_UPLOAD_STATS
+	{
+		// frames that uploaded texture data
+		int frames;
+		// mip levels and bytes uploaded
+		int levels;
+		size_t bytes;
+		// CPU milliseconds spent issuing the uploads, in total
+		// and in the worst frame
+		double milliseconds;
+		double worstFrameMilliseconds;
+		// waits on the GPU for upload ring space, and their time
+		int ringWaits;
+		double ringWaitMilliseconds;
 	};
 
 	struct OBJECT_MATERIAL
@@ -44,28 +127,291 @@ public:
 	};
 
 private:
+	// handles of the uniforms the scene sets for each draw
+	struct SCENE_UNIFORMS
+	{
+		ShaderUniform<glm::mat4> model;
+		ShaderUniform<glm::vec4> objectColor;
+		ShaderUniform<bool> useTexture;
+		ShaderUniform<bool> useTextureArray;
+		ShaderUniform<bool> useTextureAtlas;
+		ShaderUniform<int> objectTexture;
+		ShaderUniform<GLuint64> objectTextureHandle;
+		ShaderUniform<int> objectTextureArray;
+		ShaderUniform<int> objectTextureLayer;
+		ShaderUniform<glm::vec4> objectTextureRect;
+		ShaderUniform<glm::vec2> UVscale;
+		ShaderUniform<int> materialIndex;
+		ShaderUniform<bool> useLighting;
+	};
+
+	// shape meshes an object of the scene is drawn with, in the
+	// order of the shapes the instanced meshes are built from
+	enum SHAPE_MESH
+	{
+		SHAPE_BOX = ShapeGeometry::SHAPE_BOX,
+		SHAPE_PLANE = ShapeGeometry::SHAPE_PLANE,
+		SHAPE_CYLINDER = ShapeGeometry::SHAPE_CYLINDER,
+		SHAPE_TAPERED_CYLINDER = ShapeGeometry::SHAPE_TAPERED_CYLINDER,
+		SHAPE_TORUS = ShapeGeometry::SHAPE_TORUS,
+		SHAPE_SPHERE = ShapeGeometry::SHAPE_SPHERE,
+		SHAPE_HALF_SPHERE = ShapeGeometry::SHAPE_HALF_SPHERE
+	};
+
+	// one draw of the retained draw list, with everything it
+	// sets resolved when the list is built
+	struct DRAW_RECORD
+	{
+		SHAPE_MESH mesh;
+		glm::mat4 modelMatrix;
+		// index of the transform in the batch the model matrices
+		// are composed in, -1 for none set yet
+		int transformIndex;
+		// index into the material block, -1 for none set yet
+		int materialIndex;
+		// true when textured, with the slot of the texture or -1
+		bool bTexture;
+		int textureSlot;
+		glm::vec4 color;
+		glm::vec2 UVscale;
+	};
+
+	// draws of the draw list that share a shape and the state
+	// set for them, drawn together from a range of instances
+	struct INSTANCE_BATCH
+	{
+		SHAPE_MESH mesh;
+		bool bTexture;
+		int textureSlot;
+		glm::vec4 color;
+		glm::vec2 UVscale;
+		int firstInstance;
+		int instanceCount;
+	};
+
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
+	// active uniforms of the current program
+	ShaderUniforms* m_pShaderUniforms;
+	// handles of the uniforms set for each draw
+	SCENE_UNIFORMS m_uniforms;
+	// uniform blocks the scene lights are written into
+	UniformBlocks* m_pUniformBlocks;
+	// shadow of the fixed-function state, shared with the frame loop
+	GLStateCache* m_pStateCache;
+	// scene lights, written into the light block each frame
+	UniformBlocks::LIGHT_DATA m_lightData;
+	// true when the scene is lit, and the number of point lights
+	// that are on, packed at the front of the light block
+	bool m_bUseLighting;
+	int m_activePointLights;
+	// specialized programs for the draws, or NULL to draw every
+	// object with the program that branches at runtime
+	ShaderVariants* m_pShaderVariants;
+	bool m_bUseShaderVariants;
+	// true when PrepareScene() ends with a warm-up draw of the scene
+	bool m_bShaderWarmup;
+	// view of the starting camera the warm-up draws from, and the
+	// color the frame loop clears to
+	UniformBlocks::FRAME_DATA m_warmupFrameData;
+	glm::vec4 m_warmupClearColor;
+	// program loaded by the shader manager, and the one in use
+	GLuint m_baseProgram;
+	GLuint m_currentProgram;
+	// handles of the scene uniforms in each program
+	std::unordered_map<GLuint, SCENE_UNIFORMS> m_programUniforms;
+	// model matrix of the next draw, set again after a switch
+	glm::mat4 m_modelMatrix;
+	// draws of the static scene, recorded once when the scene is
+	// prepared and submitted every frame
+	std::vector<DRAW_RECORD> m_drawList;
+	// true while the draw list is recorded, when the setters
+	// fill in the next record instead of setting the shader
+	bool m_bRecordingDraws;
+	DRAW_RECORD m_pendingDraw;
+	// transforms of the recorded draws, composed in one batch
+	TransformBatch m_drawTransforms;
+	// false to draw through the RenderXxx() methods every frame
+	bool m_bUseDrawList;
+	// state key of each record, and the order the records are
+	// drawn in once the keys are sorted
+	DrawSort m_drawSort;
+	std::vector<uint64_t> m_drawKeys;
+	std::vector<int> m_drawOrder;
+	// false to draw the records in the order they were recorded
+	bool m_bSortDraws;
+	// true once the whole list is sorted, after which only the
+	// blended records at the end of the order are sorted again,
+	// when the camera moves from where they were sorted from
+	bool m_bDrawOrderReady;
+	int m_firstBlendedDraw;
+	std::vector<int> m_blendedDraws;
+	std::vector<uint64_t> m_blendedKeys;
+	std::vector<int> m_blendedOrder;
+	glm::vec3 m_sortViewPosition;
+	// true once the state changes of the sort are printed
+	bool m_bDrawSortReported;
+	// shapes drawn with an instance buffer, the batches of the
+	// draw list, and the draw record of each instance
+	InstancedMeshes* m_pInstancedMeshes;
+	std::vector<INSTANCE_BATCH> m_instanceBatches;
+	std::vector<int> m_instanceDraws;
+	// true when the draw list is drawn a batch at a time
+	bool m_bUseInstancing;
+	// batches are ordered opaque untextured first, textured next
+	// and blended last, so the indirect draws need one call for
+	// each of the three ranges
+	int m_firstTexturedBatch;
+	int m_firstBlendedBatch;
+	// values of each batch in the batch storage buffer
+	std::vector<InstancedMeshes::BATCH_DATA> m_batchData;
+	// true when the batches are drawn from the draw command
+	// buffer, and when the driver and textures allow it
+	bool m_bUseIndirectDraws;
+	bool m_bIndirectReady;
 	// pointer to basic shapes object
 	ShapeMeshes* m_basicMeshes;
-	// total number of loaded textures
-	int m_loadedTextures;
 	// loaded textures info
-	TEXTURE_INFO m_textureIDs[16];
-	// defined object materials
+	std::vector<TEXTURE_INFO> m_textureIDs;
+	// slot of each loaded texture by the hash of its tag
+	std::unordered_map<uint32_t, int> m_textureSlots;
+	// texture arrays holding the loaded textures in array mode
+	std::vector<TEXTURE_ARRAY> m_textureArrays;
+	// decoded images waiting to be packed into texture arrays
+	std::vector<TextureDecoder::DECODED_IMAGE> m_arrayImages;
+	// true when small textures are packed into shared atlases
+	bool m_bUseTextureAtlas;
+	// decoded small images waiting to be packed into atlases
+	std::vector<TextureDecoder::DECODED_IMAGE> m_atlasImages;
+	// how the loaded textures are handed to the shader
+	TEXTURE_MODE m_textureMode;
+	// texture units a fragment shader can sample, queried once
+	GLint m_maxTextureUnits;
+	// materials loaded from the compiled material library
+	MaterialLibrary* m_pMaterialLibrary;
+	// materials defined in code, after those of the library
 	std::vector<OBJECT_MATERIAL> m_objectMaterials;
+	// index of each material defined in code by the hash of its tag
+	std::unordered_map<uint32_t, int> m_materialIndices;
+	// uniform buffer holding every defined material, or 0
+	GLuint m_materialBufferID;
+	// worker threads for decoding texture image files
+	TextureDecoder* m_pTextureDecoder;
+	// true when texture images are decoded on the worker threads
+	bool m_bParallelTextureLoading;
+	// on-disk cache of decoded images with mip chains, or NULL
+	TextureCache* m_pTextureCache;
+	// true when mip levels are streamed in over several frames
+	bool m_bStreamTextures;
+	// most bytes of mip levels uploaded in one frame
+	size_t m_streamingFrameBudget;
+	// streamed textures that still have mip levels to upload
+	std::vector<STREAMING_TEXTURE> m_streamingTextures;
+	// texture shown until a streamed texture has its first level
+	uint32_t m_placeholderTextureID;
+	// texture memory budget and least recently used order
+	TextureResidency* m_pTextureResidency;
+	// persistently mapped pixel buffer the uploads go through,
+	// or NULL when the driver cannot map buffers persistently
+	MappedRingBuffer* m_pUploadRing;
+	// texture uploads in the current frame and in total
+	TEXTURE_UPLOAD_STATS m_frameUploadStats;
+	TEXTURE_UPLOAD_STATS m_textureUploadStats;
+	// memory-mapped pack of GPU-ready textures
+	AssetPack* m_pAssetPack;
+	// true when textures are loaded from the asset pack if built
+	bool m_bUseAssetPack;
+	// tag hashes of the textures the asset pack is out of date for
+	std::unordered_set<uint32_t> m_stalePackedTextures;
 
 	// load texture images and convert to OpenGL texture data
 	bool CreateGLTexture(const char* filename, std::string tag);
+	// convert decoded image data to OpenGL texture data, in a new
+	// texture slot or in place of the texture in a given slot
+	bool UploadGLTexture(const TextureDecoder::DECODED_IMAGE& image, int textureSlot = -1);
+	// add a loaded texture to the next texture slot
+	int RegisterTexture(const TEXTURE_INFO& texture);
+	// allocate every mip level of the bound texture
+	void AllocateTextureStorage(GLenum target, int mipLevels, int width, int height, int layers);
+	// upload one RGBA mip level of the bound texture
+	void UploadTextureLevel(GLenum target, int level, int layer, int width, int height, const unsigned char* pixels);
+	// upload a rectangle of one mip level of the bound texture
+	void UploadTextureRegion(GLenum target, int level, int layer, int x, int y, int width, int height, const unsigned char* pixels);
+	// fence the frame's uploads and add them to the statistics
+	void EndTextureUploadFrame();
+	// put a new OpenGL texture in place of the one in a slot
+	void ReplaceGLTexture(int textureSlot, uint32_t textureID);
+	// create the worker threads for decoding texture images
+	void StartTextureDecoder();
+	// queue a texture image to be decoded and loaded
+	void QueueGLTexture(const char* filename, std::string tag);
+	// upload the queued texture images as they finish decoding
+	void CreateQueuedGLTextures();
+	// upload a decoded image, or hold it for a texture array
+	bool AddDecodedImage(TextureDecoder::DECODED_IMAGE& image);
+	// pack the held small images into texture atlases
+	void BuildGLTextureAtlases();
+	// pack the held images into same-sized texture arrays
+	void BuildGLTextureArrays();
+	// create the texture shown while a streamed texture loads
+	void CreatePlaceholderTexture();
+	// hold a decoded image until its mip levels are streamed in
+	bool StartTextureStreaming(TextureDecoder::DECODED_IMAGE& image);
+	// upload the next mip level of a streamed texture
+	void StreamNextMipLevel(STREAMING_TEXTURE& streaming);
+	// upload the next streamed mip levels within the frame budget
+	void UpdateTextureStreaming();
+	// replace a texture with a copy of its low mip levels
+	void EvictGLTexture(int textureSlot);
+	// load the full image of an evicted texture again
+	void RestoreGLTexture(int textureSlot);
+	// map the asset pack, if it has been built
+	void OpenAssetPack();
+	// load a texture straight from the mapped asset pack
+	bool LoadPackedTexture(const char* filename, std::string tag);
+	// put an image in place of the texture loaded for its tag
+	bool ReloadGLTexture(TextureDecoder::DECODED_IMAGE& image, int textureSlot);
+	// put an image into its cell of a texture atlas
+	bool ReloadAtlasTexture(TextureDecoder::DECODED_IMAGE& image, int textureSlot);
 	// bind loaded OpenGL textures to slots in memory
 	void BindGLTextures();
 	// free the loaded OpenGL textures
 	void DestroyGLTextures();
 	// find a loaded texture by tag
-	int FindTextureID(std::string tag);
-	int FindTextureSlot(std::string tag);
-	// find a defined material by tag
-	bool FindMaterial(std::string tag, OBJECT_MATERIAL& material);
+	int FindTextureID(ResourceTag tag);
+	int FindTextureSlot(ResourceTag tag);
+	// add a material defined in code to the library materials
+	void AddObjectMaterial(const OBJECT_MATERIAL& material);
+	// find the index of a defined material by tag
+	int FindMaterialIndex(ResourceTag tag);
+	// upload the defined materials into the material buffer
+	void CreateMaterialBuffer();
+	// connect the uniform blocks to the current program
+	void BindUniformBlocks();
+	// find the handles of the scene uniforms in the program
+	void ResolveShaderUniforms();
+	// point the samplers of the current program at their units
+	void SetTextureSamplers();
+	// features of the shader variant a draw needs
+	ShaderVariants::VARIANT_KEY MakeVariantKey(bool bTexture, bool bInstanced = false, bool bIndirect = false) const;
+	// start building the variants the scene draws with
+	void PrefetchShaderVariants();
+	// draw the scene once offscreen so the driver builds its
+	// programs and state before the first frame
+	void WarmUpShaders();
+	// switch to the shader variant for the next draw, returning
+	// false when the draw is left on the program that branches
+	bool SelectShaderVariant(bool bTexture, bool bInstanced = false, bool bIndirect = false);
+	// set the uniforms of a newly built variant that stay fixed
+	void PrepareVariantProgram(GLuint program);
+	// put a program in use for the next draw
+	void UseProgram(GLuint program);
+	// delete the variant programs and their uniform handles
+	void ReleaseShaderVariants();
+	// turn the depth test on through the state cache
+	void EnableDepthTest();
+	// clear the bound framebuffer to the frame loop's color
+	void ClearFrame();
 
 	// set the transformation values 
 	// into the transform buffer
@@ -85,7 +431,7 @@ private:
 
 	// set the texture data into the shader
 	void SetShaderTexture(
-		std::string textureTag);
+		ResourceTag textureTag);
 
 	// set the UV scale for the texture mapping
 	void SetTextureUVScale(
@@ -93,7 +439,47 @@ private:
 
 	// set the object material into the shader
 	void SetShaderMaterial(
-		std::string materialTag);
+		ResourceTag materialTag);
+	// set the uniforms that draw from a loaded texture
+	void BindTextureSlot(int textureSlot);
+	// draw a shape mesh, or record the draw while recording
+	void DrawShape(SHAPE_MESH mesh);
+	// issue the draw of a shape mesh
+	void DrawShapeMesh(SHAPE_MESH mesh);
+	// draw every object through its RenderXxx() method
+	void RenderSceneObjects();
+	// record the draws of the static scene into the draw list
+	void BuildDrawList();
+	// draw the recorded draw list
+	void SubmitDrawList();
+	// pack the state of a record, seen from a position, into
+	// its key
+	uint64_t MakeDrawKey(const DRAW_RECORD& draw, const glm::vec3& viewPosition);
+	// key every record of the draw list
+	void MakeDrawKeys(const glm::vec3& viewPosition);
+	// sort the draw list by its keys for the current view
+	void SortDrawList();
+	// print the state changes of the draw list before and after
+	// it is sorted
+	void ReportDrawSort();
+	// set the values of a draw record and draw it
+	void SubmitDraw(const DRAW_RECORD& draw);
+	// true when a record is drawn blended
+	static bool IsBlendedDraw(const DRAW_RECORD& draw);
+	// group the draw list into batches and upload their instances
+	void BuildInstanceBatches();
+	// draw the batches with one instanced draw each
+	void SubmitInstanceBatches();
+	// set the values of a batch and draw its instances
+	void SubmitInstanceBatch(const INSTANCE_BATCH& batch);
+	// upload the draw commands and values of the batches
+	void BuildIndirectDraws();
+	// fill in the texture of a batch in its batch values
+	void ResolveBatchTexture(const INSTANCE_BATCH& batch, InstancedMeshes::BATCH_DATA& data);
+	// keep the batch textures resident and their handles current
+	bool UpdateIndirectTextures();
+	// draw every batch from the draw command buffer
+	void SubmitIndirectDraws();
 
 public:
 
@@ -105,6 +491,78 @@ public:
 	void DefineObjectMaterials();
 	void SetupSceneLights();
 
+	// select how the loaded textures are handed to the shader
+	void SetTextureMode(TEXTURE_MODE textureMode);
+
+	// turn the on-disk texture cache on or off
+	void SetTextureCacheEnabled(bool bEnabled);
+
+	// turn packing small textures into atlases on or off
+	void SetTextureAtlasEnabled(bool bEnabled);
+
+	// turn the progressive mip streaming on or off
+	void SetTextureStreamingEnabled(bool bEnabled);
+	// draw with specialized shader variants, NULL for none
+	void SetShaderVariants(ShaderVariants* pShaderVariants);
+	// switch between the variants and the runtime branches
+	void SetShaderVariantsEnabled(bool bEnabled);
+	// turn the warm-up draw at the end of PrepareScene() on or off
+	void SetShaderWarmupEnabled(bool bEnabled);
+	// set the view of the starting camera and the clear color of
+	// the frame loop for the warm-up draw
+	void SetShaderWarmupView(const UniformBlocks::FRAME_DATA& frameData, const glm::vec4& clearColor);
+	// switch between the retained draw list and the RenderXxx()
+	// methods every frame
+	void SetDrawListEnabled(bool bEnabled);
+	// switch between drawing the draw list a batch at a time and
+	// a record at a time
+	void SetInstancingEnabled(bool bEnabled);
+	// switch drawing the batches from a draw command buffer, in
+	// one or two calls a frame, on or off
+	void SetIndirectDrawsEnabled(bool bEnabled);
+	// switch sorting the draw list by state each frame on or off
+	void SetDrawSortEnabled(bool bEnabled);
+	// turn loading the textures from the asset pack on or off
+	void SetAssetPackEnabled(bool bEnabled);
+	// write the scene textures to the asset pack
+	bool BuildAssetPack();
+	// validate the material library source and compile it
+	static bool CompileMaterialLibrary();
+	// set the texture memory budget in bytes, 0 for no limit
+	void SetTextureMemoryBudget(size_t budgetBytes);
+	// stream, restore and evict textures, once per frame
+	void UpdateTextures();
+	// decode a changed image file again for the textures using it
+	bool ReloadTextureFile(const std::string& filename);
+	// set the shader uniforms again after the shaders are reloaded
+	void ApplyShaderSettings();
+	// print how much texture memory is and was in use
+	void PrintTextureResidencyStats();
+	// print what the texture uploads cost
+	void PrintTextureUploadStats();
+
+	// time the serial and parallel texture loading paths
+	void BenchmarkTextureLoading();
+	// time the texture loading with a cold and a warm cache
+	void BenchmarkTextureCache();
+	// compare loading from the asset pack with loose files
+	void BenchmarkAssetPack();
+	// compare setting the per-draw uniforms by name and by handle
+	void BenchmarkUniforms();
+	// compare the GPU time of the scene with and without variants
+	void BenchmarkShaderVariants(const UniformBlocks::FRAME_DATA& frameData);
+	// compare the CPU time of a frame with and without the draw list
+	void BenchmarkDrawList(const UniformBlocks::FRAME_DATA& frameData);
+	// compare composing the transforms one at a time with glm and
+	// in batches with each SIMD kernel
+	void BenchmarkTransforms(const UniformBlocks::FRAME_DATA& frameData);
+	// compare the CPU time of a shelf of scene copies drawn a
+	// record at a time, a batch at a time and indirectly
+	void BenchmarkInstancing(const UniformBlocks::FRAME_DATA& frameData);
+	// compare sorting the draw keys with the radix sort and with
+	// std::sort, and the state changes the sort saves
+	void BenchmarkDrawSort(const UniformBlocks::FRAME_DATA& frameData);
+
 	// methods for rendering the various objects in the scene
 	void RenderTable();
 	void RenderBackground();
@@ -0,0 +1,347 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadercompiler.cpp
+// ============
+// build shader programs in the background while the scene loads
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderCompiler.h"
+
+#include <chrono>
+#include <iostream>
+
+/***********************************************************
+ *  ShaderCompiler()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderCompiler::ShaderCompiler(ProgramCache* pProgramCache)
+{
+	m_pProgramCache = pProgramCache;
+	m_mode = COMPILE_SERIAL;
+	m_pWorkerWindow = NULL;
+	m_bShutdown = false;
+}
+
+/***********************************************************
+ *  ~ShaderCompiler()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderCompiler::~ShaderCompiler()
+{
+	// tell the worker thread to exit and wait for it
+	if (m_worker.joinable() == true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_jobMutex);
+			m_bShutdown = true;
+		}
+		m_requestCondition.notify_all();
+		m_worker.join();
+	}
+	if (NULL != m_pWorkerWindow)
+	{
+		glfwDestroyWindow(m_pWorkerWindow);
+		m_pWorkerWindow = NULL;
+	}
+
+	// delete the programs and shaders of builds never collected
+	for (size_t i = 0; i < m_jobs.size(); i++)
+	{
+		COMPILE_JOB& job = m_jobs[i];
+		if (job.bCollected == true)
+		{
+			continue;
+		}
+		if (job.build.vertexShader != 0)
+		{
+			glDeleteShader(job.build.vertexShader);
+		}
+		if (job.build.fragmentShader != 0)
+		{
+			glDeleteShader(job.build.fragmentShader);
+		}
+		if (job.build.program != 0)
+		{
+			glDeleteProgram(job.build.program);
+		}
+	}
+	m_jobs.clear();
+}
+
+/***********************************************************
+ *  ModeName()
+ *
+ *  This method is used for getting a readable name of a mode.
+ ***********************************************************/
+const char* ShaderCompiler::ModeName(COMPILE_MODE mode)
+{
+	switch (mode)
+	{
+	case COMPILE_PARALLEL_EXTENSION:
+		return("parallel driver compile");
+	case COMPILE_WORKER_THREAD:
+		return("shared context worker thread");
+	default:
+		return("serial");
+	}
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for picking how programs are built.
+ *  The driver threads of GL_KHR_parallel_shader_compile are
+ *  used when there are any.  Otherwise a hidden window is
+ *  created that shares objects with the main one, since GLFW
+ *  only creates windows on the main thread, and its context
+ *  is made current on the worker thread.  The window hints
+ *  of the main window are still set, so both contexts match.
+ ***********************************************************/
+void ShaderCompiler::Start(GLFWwindow* pSharedWindow, bool bAsync)
+{
+	if ((m_mode != COMPILE_SERIAL) || (bAsync == false))
+	{
+		return;
+	}
+
+	if (GLEW_KHR_parallel_shader_compile)
+	{
+		// let the driver pick the number of compiler threads
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		m_mode = COMPILE_PARALLEL_EXTENSION;
+	}
+	else if (NULL != pSharedWindow)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		m_pWorkerWindow = glfwCreateWindow(1, 1, "", NULL, pSharedWindow);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+		if (NULL != m_pWorkerWindow)
+		{
+			m_bShutdown = false;
+			m_worker = std::thread(&ShaderCompiler::WorkerThread, this);
+			m_mode = COMPILE_WORKER_THREAD;
+		}
+		else
+		{
+			std::cout << "Could not create the shader compile context, building shaders serially" << std::endl;
+		}
+	}
+
+	std::cout << "INFO: shader programs are built with " << ModeName(m_mode) << std::endl;
+}
+
+/***********************************************************
+ *  Submit()
+ *
+ *  This method is used for queueing a program build.  In the
+ *  parallel mode the build is handed to the driver right
+ *  away, which returns before compiling, and in the worker
+ *  mode it is queued for the worker thread.  In the serial
+ *  mode the build is left to Finish().
+ ***********************************************************/
+int ShaderCompiler::Submit(const std::string& name, const std::string& vertexShaderFile,
+	const std::string& fragmentShaderFile, const std::string& defines)
+{
+	int ticket = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+
+		ticket = (int)m_jobs.size();
+		m_jobs.push_back(COMPILE_JOB());
+		COMPILE_JOB& job = m_jobs.back();
+		job.name = name;
+		job.vertexShaderFile = vertexShaderFile;
+		job.fragmentShaderFile = fragmentShaderFile;
+		job.defines = defines;
+		job.bStarted = false;
+		job.bDone = false;
+		job.bCollected = false;
+		job.program = 0;
+		job.build.vertexShader = 0;
+		job.build.fragmentShader = 0;
+		job.build.program = 0;
+
+		if (m_mode == COMPILE_WORKER_THREAD)
+		{
+			m_requests.push_back(ticket);
+		}
+	}
+
+	if (m_mode == COMPILE_WORKER_THREAD)
+	{
+		m_requestCondition.notify_one();
+	}
+	else if (m_mode == COMPILE_PARALLEL_EXTENSION)
+	{
+		COMPILE_JOB& job = m_jobs[ticket];
+		job.bStarted = m_pProgramCache->BeginProgram(
+			job.vertexShaderFile.c_str(),
+			job.fragmentShaderFile.c_str(),
+			job.defines,
+			job.build);
+	}
+
+	return(ticket);
+}
+
+/***********************************************************
+ *  IsReady()
+ *
+ *  This method is used for asking whether a build has
+ *  finished, without waiting for it.  A serial build is
+ *  always ready, since collecting it builds it.
+ ***********************************************************/
+bool ShaderCompiler::IsReady(int ticket)
+{
+	if ((ticket < 0) || (ticket >= (int)m_jobs.size()))
+	{
+		return(false);
+	}
+
+	if (m_mode == COMPILE_WORKER_THREAD)
+	{
+		std::lock_guard<std::mutex> lock(m_jobMutex);
+		return(m_jobs[ticket].bDone);
+	}
+
+	COMPILE_JOB& job = m_jobs[ticket];
+	if ((m_mode == COMPILE_PARALLEL_EXTENSION) && (job.bStarted == true))
+	{
+		return(ProgramCache::IsBuildComplete(job.build));
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Finish()
+ *
+ *  This method is used for collecting the program of a build,
+ *  waiting for it when it is still running.  Each program can
+ *  be collected once, and the caller then owns it.  Returns 0
+ *  when the sources do not compile or link.
+ ***********************************************************/
+GLuint ShaderCompiler::Finish(int ticket)
+{
+	if ((ticket < 0) || (ticket >= (int)m_jobs.size()))
+	{
+		return(0);
+	}
+
+	std::chrono::steady_clock::time_point waitStart = std::chrono::steady_clock::now();
+	COMPILE_JOB& job = m_jobs[ticket];
+
+	if (m_mode == COMPILE_WORKER_THREAD)
+	{
+		std::unique_lock<std::mutex> lock(m_jobMutex);
+		m_doneCondition.wait(lock, [&job] { return(job.bDone); });
+	}
+	else if (job.bCollected == false)
+	{
+		if (m_mode == COMPILE_SERIAL)
+		{
+			job.bStarted = m_pProgramCache->BeginProgram(
+				job.vertexShaderFile.c_str(),
+				job.fragmentShaderFile.c_str(),
+				job.defines,
+				job.build);
+		}
+		if (job.bStarted == true)
+		{
+			job.program = m_pProgramCache->FinishProgram(job.build);
+		}
+	}
+
+	if (job.bCollected == true)
+	{
+		return(0);
+	}
+	job.bCollected = true;
+
+	std::chrono::duration<double, std::milli> waited = std::chrono::steady_clock::now() - waitStart;
+	ReportProgram(job, waited.count());
+
+	return(job.program);
+}
+
+/***********************************************************
+ *  ReportProgram()
+ *
+ *  This method is used for printing the time a program took
+ *  to build, from when it was submitted, and the time that
+ *  collecting it held up the caller.
+ ***********************************************************/
+void ShaderCompiler::ReportProgram(const COMPILE_JOB& job, double waitMilliseconds) const
+{
+	if (job.program == 0)
+	{
+		std::cout << "INFO: shader program " << job.name << " failed to build" << std::endl;
+		return;
+	}
+
+	std::cout << "INFO: shader program " << job.name;
+	if (job.build.bCached == true)
+	{
+		std::cout << " loaded from the program cache in " << job.build.buildMilliseconds << " ms";
+	}
+	else
+	{
+		std::cout << " built from source in " << job.build.buildMilliseconds << " ms";
+	}
+	std::cout << ", collecting it waited " << waitMilliseconds << " ms" << std::endl;
+}
+
+/***********************************************************
+ *  WorkerThread()
+ *
+ *  This method is used for building the queued programs with
+ *  the shared context.  The build is followed by glFinish(),
+ *  so the program is complete before the main context is
+ *  told it can use it.
+ ***********************************************************/
+void ShaderCompiler::WorkerThread()
+{
+	glfwMakeContextCurrent(m_pWorkerWindow);
+
+	while (true)
+	{
+		COMPILE_JOB* pJob = NULL;
+		{
+			std::unique_lock<std::mutex> lock(m_jobMutex);
+			m_requestCondition.wait(lock, [this] { return((m_bShutdown == true) || (m_requests.size() > 0)); });
+			if (m_bShutdown == true)
+			{
+				break;
+			}
+			// the job stays in place as more are submitted, and
+			// only this thread touches it until it is marked done
+			pJob = &m_jobs[m_requests.front()];
+			m_requests.pop_front();
+		}
+
+		COMPILE_JOB& job = *pJob;
+		GLuint program = 0;
+		job.bStarted = m_pProgramCache->BeginProgram(
+			job.vertexShaderFile.c_str(),
+			job.fragmentShaderFile.c_str(),
+			job.defines,
+			job.build);
+		if (job.bStarted == true)
+		{
+			program = m_pProgramCache->FinishProgram(job.build);
+		}
+		glFinish();
+
+		{
+			std::lock_guard<std::mutex> lock(m_jobMutex);
+			job.program = program;
+			job.bDone = true;
+		}
+		m_doneCondition.notify_all();
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
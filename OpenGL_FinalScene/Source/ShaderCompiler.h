@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadercompiler.h
+// ============
+// build shader programs in the background while the scene loads
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ProgramCache.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/***********************************************************
+ *  ShaderCompiler
+ *
+ *  This class builds shader programs through the program
+ *  cache without holding up the caller.  A program is
+ *  submitted for a ticket and collected with Finish(), which
+ *  only waits when the build is still running.  When the
+ *  driver offers parallel compilation the compile and link
+ *  are handed to its own threads, otherwise they run on a
+ *  worker thread with a hidden context that shares objects
+ *  with the main window.  Without either, the build is done
+ *  when the program is collected.  The time each program
+ *  took, and how long collecting it waited, is printed.
+ ***********************************************************/
+class ShaderCompiler
+{
+public:
+	// constructor
+	ShaderCompiler(ProgramCache* pProgramCache);
+	// destructor
+	~ShaderCompiler();
+
+	// where the submitted programs are built
+	enum COMPILE_MODE
+	{
+		COMPILE_SERIAL = 0,
+		COMPILE_PARALLEL_EXTENSION,
+		COMPILE_WORKER_THREAD
+	};
+
+	// pick how programs are built - the worker thread shares
+	// objects with the given window, and must be started from
+	// the thread that created the window
+	void Start(GLFWwindow* pSharedWindow, bool bAsync = true);
+	// how programs are being built
+	COMPILE_MODE GetMode() const { return(m_mode); }
+	// readable name of a mode
+	static const char* ModeName(COMPILE_MODE mode);
+
+	// queue a program build, returning the ticket to collect it
+	int Submit(const std::string& name, const std::string& vertexShaderFile,
+		const std::string& fragmentShaderFile, const std::string& defines);
+	// true when a build has finished, without waiting for it
+	bool IsReady(int ticket);
+	// collect the program of a build, waiting for it if needed,
+	// returning 0 when it does not compile or link
+	GLuint Finish(int ticket);
+
+private:
+	struct COMPILE_JOB
+	{
+		std::string name;
+		std::string vertexShaderFile;
+		std::string fragmentShaderFile;
+		std::string defines;
+		ProgramCache::PROGRAM_BUILD build;
+		// false when a source could not be read
+		bool bStarted;
+		// true when the worker thread has finished the build
+		bool bDone;
+		// true when the program has been collected
+		bool bCollected;
+		GLuint program;
+	};
+
+	// builds the programs and keeps their binaries
+	ProgramCache* m_pProgramCache;
+	// how programs are being built
+	COMPILE_MODE m_mode;
+	// hidden window whose context the worker thread builds with
+	GLFWwindow* m_pWorkerWindow;
+	// builds the queued programs in the worker mode
+	std::thread m_worker;
+	// guards the jobs and the request queue
+	std::mutex m_jobMutex;
+	// signaled when a build is queued or shutdown begins
+	std::condition_variable m_requestCondition;
+	// signaled when the worker thread finishes a build
+	std::condition_variable m_doneCondition;
+	// every submitted build, by ticket - a deque keeps the jobs
+	// in place as more are submitted
+	std::deque<COMPILE_JOB> m_jobs;
+	// tickets waiting for the worker thread
+	std::deque<int> m_requests;
+	// true when the worker thread should exit
+	bool m_bShutdown;
+
+	// build queued programs until shutdown
+	void WorkerThread();
+	// print the times of a collected program
+	void ReportProgram(const COMPILE_JOB& job, double waitMilliseconds) const;
+};
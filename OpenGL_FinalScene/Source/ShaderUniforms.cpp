@@ -0,0 +1,290 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderuniforms.cpp
+// ============
+// reflect the active uniforms of a shader program into typed handles
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderUniforms.h"
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+/***********************************************************
+ *  ShaderUniforms()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderUniforms::ShaderUniforms()
+{
+	m_program = 0;
+	m_pTable = NULL;
+	m_bFiltering = true;
+	m_frameStats.issued = 0;
+	m_frameStats.elided = 0;
+	m_lastFrameStats = m_frameStats;
+	m_totalStats = m_frameStats;
+}
+
+/***********************************************************
+ *  ~ShaderUniforms()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderUniforms::~ShaderUniforms()
+{
+}
+
+/***********************************************************
+ *  Reflect()
+ *
+ *  This method is used for reading the name, type and
+ *  location of every active uniform of a linked program.
+ *  Each element of a uniform array is added under its own
+ *  name, and the first also under the bare array name, as
+ *  glGetUniformLocation would find them.  Uniforms inside a
+ *  uniform block have no location and are left out.  The new
+ *  program starts with no known values, and is selected.
+ ***********************************************************/
+void ShaderUniforms::Reflect(GLuint program)
+{
+	GLint uniformCount = 0;
+	GLint maxNameLength = 0;
+
+	// a new program may reuse the name of a deleted one
+	m_program = program;
+	m_pTable = &m_programs[program];
+	m_pTable->uniforms.clear();
+	m_pTable->values.clear();
+
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+
+	std::vector<char> nameBuffer((size_t)maxNameLength + 1, 0);
+	for (GLint i = 0; i < uniformCount; i++)
+	{
+		GLsizei nameLength = 0;
+		GLint arraySize = 0;
+		GLenum type = GL_NONE;
+		glGetActiveUniform(program, (GLuint)i, (GLsizei)nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+
+		std::string name(nameBuffer.data(), (size_t)nameLength);
+
+		// arrays are reported by their first element, as "name[0]"
+		std::string baseName = name;
+		if ((name.size() > 3) && (name.compare(name.size() - 3, 3, "[0]") == 0))
+		{
+			baseName = name.substr(0, name.size() - 3);
+		}
+
+		for (GLint element = 0; element < arraySize; element++)
+		{
+			std::string elementName = name;
+			if (element > 0)
+			{
+				std::ostringstream elementStream;
+				elementStream << baseName << "[" << element << "]";
+				elementName = elementStream.str();
+			}
+
+			UNIFORM_INFO info;
+			info.location = glGetUniformLocation(program, elementName.c_str());
+			info.type = type;
+			info.name = elementName;
+			info.slot = (int)m_pTable->values.size();
+			if (info.location < 0)
+			{
+				continue;
+			}
+
+			std::pair<std::unordered_map<uint32_t, UNIFORM_INFO>::iterator, bool> result =
+				m_pTable->uniforms.insert(std::make_pair(ResourceTag(elementName).GetHash(), info));
+			if (result.second == false)
+			{
+				if (result.first->second.name != elementName)
+				{
+					std::cout << "Uniform " << elementName << " has the same hash as " << result.first->second.name << std::endl;
+				}
+				continue;
+			}
+			m_pTable->values.push_back(UNIFORM_VALUE());
+			m_pTable->values.back().bSet = false;
+			if ((element == 0) && (baseName != name))
+			{
+				info.name = baseName;
+				m_pTable->uniforms.insert(std::make_pair(ResourceTag(baseName).GetHash(), info));
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  Select()
+ *
+ *  This method is used for sending the handles and sets to
+ *  the table of a reflected program, once the program is put
+ *  in use.  Returns false when the program was not reflected.
+ ***********************************************************/
+bool ShaderUniforms::Select(GLuint program)
+{
+	if (program == m_program)
+	{
+		return(NULL != m_pTable);
+	}
+
+	std::unordered_map<GLuint, PROGRAM_TABLE>::iterator found = m_programs.find(program);
+	if (found == m_programs.end())
+	{
+		return(false);
+	}
+
+	m_program = program;
+	m_pTable = &found->second;
+	return(true);
+}
+
+/***********************************************************
+ *  Forget()
+ *
+ *  This method is used for dropping the table of a program
+ *  before it is deleted, since OpenGL may give its name to
+ *  a later program.
+ ***********************************************************/
+void ShaderUniforms::Forget(GLuint program)
+{
+	m_programs.erase(program);
+	if (program == m_program)
+	{
+		m_program = 0;
+		m_pTable = NULL;
+	}
+}
+
+/***********************************************************
+ *  SetFilteringEnabled()
+ *
+ *  This method is used for turning the dropping of sets that
+ *  change nothing on or off, to measure what it saves.  The
+ *  sets are still counted when it is off.
+ ***********************************************************/
+void ShaderUniforms::SetFilteringEnabled(bool bEnabled)
+{
+	m_bFiltering = bEnabled;
+}
+
+/***********************************************************
+ *  InvalidateValues()
+ *
+ *  This method is used for forgetting the last values set,
+ *  so the next set of every uniform of every program reaches
+ *  the driver.  It must be called after the uniforms of a
+ *  program are set without going through this class.
+ ***********************************************************/
+void ShaderUniforms::InvalidateValues()
+{
+	std::unordered_map<GLuint, PROGRAM_TABLE>::iterator program;
+	for (program = m_programs.begin(); program != m_programs.end(); ++program)
+	{
+		for (size_t i = 0; i < program->second.values.size(); i++)
+		{
+			program->second.values[i].bSet = false;
+		}
+	}
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for keeping the counts of the frame
+ *  that just finished and adding them to the totals.
+ ***********************************************************/
+void ShaderUniforms::EndFrame()
+{
+	m_lastFrameStats = m_frameStats;
+	m_totalStats.issued += m_frameStats.issued;
+	m_totalStats.elided += m_frameStats.elided;
+	m_frameStats.issued = 0;
+	m_frameStats.elided = 0;
+}
+
+/***********************************************************
+ *  FindInfo()
+ *
+ *  This method is used for finding a uniform in the table by
+ *  the hash of its name.
+ ***********************************************************/
+const ShaderUniforms::UNIFORM_INFO* ShaderUniforms::FindInfo(ResourceTag name) const
+{
+	if (NULL == m_pTable)
+	{
+		return(NULL);
+	}
+
+	std::unordered_map<uint32_t, UNIFORM_INFO>::const_iterator found = m_pTable->uniforms.find(name.GetHash());
+	if (found == m_pTable->uniforms.end())
+	{
+		return(NULL);
+	}
+	return(&found->second);
+}
+
+/***********************************************************
+ *  ReportTypeMismatch()
+ *
+ *  This method is used for reporting a handle that was asked
+ *  for with a type that cannot set the uniform.
+ ***********************************************************/
+void ShaderUniforms::ReportTypeMismatch(const UNIFORM_INFO& info)
+{
+	std::cout << "Uniform " << info.name << " of type 0x" << std::hex << info.type << std::dec
+		<< " cannot be set through a handle of this type" << std::endl;
+}
+
+/***********************************************************
+ *  IsCompatible()
+ *
+ *  These methods are used for checking that a value of the
+ *  handle type can set a uniform of the given OpenGL type.
+ *  Booleans may be set as integers, and samplers take the
+ *  texture unit as an integer or a bindless texture handle.
+ ***********************************************************/
+bool ShaderUniforms::IsCompatible(GLenum type, const bool*)
+{
+	return((type == GL_BOOL) || (type == GL_INT));
+}
+
+bool ShaderUniforms::IsCompatible(GLenum type, const int*)
+{
+	return((type == GL_INT) || (type == GL_BOOL) ||
+		(type == GL_SAMPLER_2D) || (type == GL_SAMPLER_2D_ARRAY));
+}
+
+bool ShaderUniforms::IsCompatible(GLenum type, const float*)
+{
+	return(type == GL_FLOAT);
+}
+
+bool ShaderUniforms::IsCompatible(GLenum type, const glm::vec2*)
+{
+	return(type == GL_FLOAT_VEC2);
+}
+
+bool ShaderUniforms::IsCompatible(GLenum type, const glm::vec3*)
+{
+	return(type == GL_FLOAT_VEC3);
+}
+
+bool ShaderUniforms::IsCompatible(GLenum type, const glm::vec4*)
+{
+	return(type == GL_FLOAT_VEC4);
+}
+
+bool ShaderUniforms::IsCompatible(GLenum type, const glm::mat4*)
+{
+	return(type == GL_FLOAT_MAT4);
+}
+
+bool ShaderUniforms::IsCompatible(GLenum type, const GLuint64*)
+{
+	return((type == GL_SAMPLER_2D) || (type == GL_SAMPLER_2D_ARRAY));
+}
@@ -0,0 +1,237 @@
+///////////////////////////////////////////////////////////////////////////////
+// shaderuniforms.h
+// ============
+// reflect the active uniforms of a shader program into typed handles
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ResourceTag.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************
+ *  ShaderUniform
+ *
+ *  This class is a typed handle to one uniform of a program.
+ *  It holds the uniform location and the slot of its last
+ *  value, so setting a value through it needs no name lookup.
+ *  A default handle, or one for a uniform that is not active,
+ *  sets nothing.
+ ***********************************************************/
+template <typename T>
+class ShaderUniform
+{
+public:
+	ShaderUniform() : m_location(-1), m_slot(-1) {}
+	ShaderUniform(GLint location, int slot) : m_location(location), m_slot(slot) {}
+
+	// location of the uniform, -1 when it is not active
+	GLint GetLocation() const { return(m_location); }
+	// slot of the last value set, -1 when it is not active
+	int GetSlot() const { return(m_slot); }
+	// true when the uniform is active in the program
+	bool IsValid() const { return(m_location >= 0); }
+
+private:
+	GLint m_location;
+	int m_slot;
+};
+
+/***********************************************************
+ *  ShaderUniforms
+ *
+ *  This class reads the active uniforms of a linked program
+ *  once, with their types and locations, into a table keyed
+ *  by the hash of their names.  Handles are found in the table
+ *  when a program is loaded, and a handle is only given out
+ *  when its type matches the uniform, so a per-draw set never
+ *  asks the driver for a location or builds a string.  The
+ *  last value set for each uniform is kept, and a set that
+ *  would not change it is dropped before it reaches the
+ *  driver.  Each reflected program has its own table, and the
+ *  handles and sets go to the selected one, which must be the
+ *  program in use.  The handles must be found again after
+ *  Reflect() is called for a new program.
+ ***********************************************************/
+class ShaderUniforms
+{
+public:
+	// constructor
+	ShaderUniforms();
+	// destructor
+	~ShaderUniforms();
+
+	struct UNIFORM_INFO
+	{
+		GLint location;
+		GLenum type;
+		std::string name;
+		// slot of the last value set for the uniform
+		int slot;
+	};
+
+	// uniform sets passed to the driver and dropped as redundant
+	struct CALL_STATS
+	{
+		long long issued;
+		long long elided;
+	};
+
+	// read the active uniforms of a linked program and select it
+	void Reflect(GLuint program);
+	// select a reflected program, after it is put in use
+	bool Select(GLuint program);
+	// drop the table of a program that is being deleted
+	void Forget(GLuint program);
+	// selected program, or 0
+	GLuint GetProgram() const { return(m_program); }
+	// number of uniform names in the selected table
+	int GetUniformCount() const { return((NULL != m_pTable) ? (int)m_pTable->uniforms.size() : 0); }
+
+	// turn dropping the sets that change nothing on or off
+	void SetFilteringEnabled(bool bEnabled);
+	// forget the last values, after the uniforms are set by
+	// other code such as the shader manager
+	void InvalidateValues();
+	// fold the calls of the frame into the totals
+	void EndFrame();
+	// calls in the last finished frame and in all frames
+	CALL_STATS GetFrameStats() const { return(m_lastFrameStats); }
+	CALL_STATS GetTotalStats() const { return(m_totalStats); }
+
+	// find the handle of a uniform by name, checking its type
+	template <typename T>
+	ShaderUniform<T> Find(ResourceTag name) const
+	{
+		const UNIFORM_INFO* pInfo = FindInfo(name);
+		if (NULL == pInfo)
+		{
+			return(ShaderUniform<T>());
+		}
+		if (IsCompatible(pInfo->type, (const T*)NULL) == false)
+		{
+			ReportTypeMismatch(*pInfo);
+			return(ShaderUniform<T>());
+		}
+		return(ShaderUniform<T>(pInfo->location, pInfo->slot));
+	}
+
+	// set a uniform of the current program through its handle,
+	// unless it already holds the value
+	void Set(ShaderUniform<bool> uniform, bool value)
+	{
+		const GLint intValue = value ? 1 : 0;
+		if (IsNewValue(uniform.GetSlot(), &intValue, sizeof(intValue))) glUniform1i(uniform.GetLocation(), intValue);
+	}
+	void Set(ShaderUniform<int> uniform, int value)
+	{
+		if (IsNewValue(uniform.GetSlot(), &value, sizeof(value))) glUniform1i(uniform.GetLocation(), value);
+	}
+	void Set(ShaderUniform<float> uniform, float value)
+	{
+		if (IsNewValue(uniform.GetSlot(), &value, sizeof(value))) glUniform1f(uniform.GetLocation(), value);
+	}
+	void Set(ShaderUniform<glm::vec2> uniform, const glm::vec2& value)
+	{
+		if (IsNewValue(uniform.GetSlot(), &value, sizeof(value))) glUniform2f(uniform.GetLocation(), value.x, value.y);
+	}
+	void Set(ShaderUniform<glm::vec3> uniform, const glm::vec3& value)
+	{
+		if (IsNewValue(uniform.GetSlot(), &value, sizeof(value))) glUniform3f(uniform.GetLocation(), value.x, value.y, value.z);
+	}
+	void Set(ShaderUniform<glm::vec4> uniform, const glm::vec4& value)
+	{
+		if (IsNewValue(uniform.GetSlot(), &value, sizeof(value))) glUniform4f(uniform.GetLocation(), value.x, value.y, value.z, value.w);
+	}
+	void Set(ShaderUniform<glm::mat4> uniform, const glm::mat4& value)
+	{
+		if (IsNewValue(uniform.GetSlot(), &value, sizeof(value))) glUniformMatrix4fv(uniform.GetLocation(), 1, GL_FALSE, &value[0][0]);
+	}
+	void Set(ShaderUniform<GLuint64> uniform, GLuint64 value)
+	{
+		if (IsNewValue(uniform.GetSlot(), &value, sizeof(value))) glUniformHandleui64ARB(uniform.GetLocation(), value);
+	}
+
+	// set a uniform by name through the table, for values that
+	// are only set when a program is loaded
+	void Set(ResourceTag name, bool value) { Set(Find<bool>(name), value); }
+	void Set(ResourceTag name, int value) { Set(Find<int>(name), value); }
+	void Set(ResourceTag name, float value) { Set(Find<float>(name), value); }
+	void Set(ResourceTag name, const glm::vec2& value) { Set(Find<glm::vec2>(name), value); }
+	void Set(ResourceTag name, const glm::vec3& value) { Set(Find<glm::vec3>(name), value); }
+	void Set(ResourceTag name, const glm::vec4& value) { Set(Find<glm::vec4>(name), value); }
+	void Set(ResourceTag name, const glm::mat4& value) { Set(Find<glm::mat4>(name), value); }
+
+private:
+	// last value set for a uniform, large enough for a mat4
+	struct UNIFORM_VALUE
+	{
+		bool bSet;
+		unsigned char bytes[sizeof(glm::mat4)];
+	};
+
+	// uniforms read from one program
+	struct PROGRAM_TABLE
+	{
+		// location and type of each uniform by the hash of its name
+		std::unordered_map<uint32_t, UNIFORM_INFO> uniforms;
+		// last value set for each uniform, by slot
+		std::vector<UNIFORM_VALUE> values;
+	};
+
+	// selected program and its table, or 0 and NULL
+	GLuint m_program;
+	PROGRAM_TABLE* m_pTable;
+	// table of each reflected program
+	std::unordered_map<GLuint, PROGRAM_TABLE> m_programs;
+	// true when the sets that change nothing are dropped
+	bool m_bFiltering;
+	// calls in the current frame, the last frame and all frames
+	CALL_STATS m_frameStats;
+	CALL_STATS m_lastFrameStats;
+	CALL_STATS m_totalStats;
+
+	// true when a value differs from the last one set in the
+	// slot, which then remembers it
+	bool IsNewValue(int slot, const void* pValue, size_t size)
+	{
+		if ((slot < 0) || (NULL == m_pTable))
+		{
+			return(false);
+		}
+		UNIFORM_VALUE& last = m_pTable->values[slot];
+		if ((m_bFiltering == true) && (last.bSet == true) && (memcmp(last.bytes, pValue, size) == 0))
+		{
+			m_frameStats.elided++;
+			return(false);
+		}
+		memcpy(last.bytes, pValue, size);
+		last.bSet = true;
+		m_frameStats.issued++;
+		return(true);
+	}
+
+	// find a uniform in the table, NULL when it is not active
+	const UNIFORM_INFO* FindInfo(ResourceTag name) const;
+	// report a handle asked for with the wrong type
+	static void ReportTypeMismatch(const UNIFORM_INFO& info);
+
+	// true when a value of the handle type can set a uniform of
+	// the given OpenGL type
+	static bool IsCompatible(GLenum type, const bool*);
+	static bool IsCompatible(GLenum type, const int*);
+	static bool IsCompatible(GLenum type, const float*);
+	static bool IsCompatible(GLenum type, const glm::vec2*);
+	static bool IsCompatible(GLenum type, const glm::vec3*);
+	static bool IsCompatible(GLenum type, const glm::vec4*);
+	static bool IsCompatible(GLenum type, const glm::mat4*);
+	static bool IsCompatible(GLenum type, const GLuint64*);
+};
@@ -0,0 +1,214 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadervariants.cpp
+// ============
+// shader programs specialized at compile time for the features a draw uses
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShaderVariants.h"
+
+#include <iostream>
+#include <sstream>
+
+/***********************************************************
+ *  ShaderVariants()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+ShaderVariants::ShaderVariants(
+	ShaderCompiler* pShaderCompiler,
+	const char* vertexShaderFile,
+	const char* fragmentShaderFile)
+{
+	m_pShaderCompiler = pShaderCompiler;
+	m_vertexShaderFile = vertexShaderFile;
+	m_fragmentShaderFile = fragmentShaderFile;
+}
+
+/***********************************************************
+ *  ~ShaderVariants()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+ShaderVariants::~ShaderVariants()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  PackKey()
+ *
+ *  This method is used for packing the features of a variant
+ *  into one number for the program table.
+ ***********************************************************/
+uint32_t ShaderVariants::PackKey(const VARIANT_KEY& key)
+{
+	uint32_t packed = (uint32_t)key.pointLights << 6;
+
+	packed |= key.bTexture ? 0x1 : 0;
+	packed |= key.bLighting ? 0x2 : 0;
+	packed |= key.bDirectionalLight ? 0x4 : 0;
+	packed |= key.bSpotLight ? 0x8 : 0;
+	packed |= key.bInstanced ? 0x10 : 0;
+	packed |= key.bIndirect ? 0x20 : 0;
+
+	return(packed);
+}
+
+/***********************************************************
+ *  VariantName()
+ *
+ *  This method is used for naming a variant by its packed key
+ *  in the compile report.
+ ***********************************************************/
+std::string ShaderVariants::VariantName(uint32_t packedKey)
+{
+	std::ostringstream name;
+
+	name << "variant 0x" << std::hex << packedKey;
+
+	return(name.str());
+}
+
+/***********************************************************
+ *  VariantDefines()
+ *
+ *  This method is used for writing the #define lines that
+ *  select a variant in the shaders.
+ ***********************************************************/
+std::string ShaderVariants::VariantDefines(const VARIANT_KEY& key)
+{
+	std::ostringstream defines;
+
+	defines << "#define SHADER_VARIANT 1\n";
+	defines << "#define VARIANT_TEXTURE " << (key.bTexture ? 1 : 0) << "\n";
+	defines << "#define VARIANT_LIGHTING " << (key.bLighting ? 1 : 0) << "\n";
+	defines << "#define VARIANT_DIRECTIONAL_LIGHT " << (key.bDirectionalLight ? 1 : 0) << "\n";
+	defines << "#define VARIANT_SPOT_LIGHT " << (key.bSpotLight ? 1 : 0) << "\n";
+	defines << "#define VARIANT_POINT_LIGHTS " << key.pointLights << "\n";
+	defines << "#define VARIANT_INSTANCED " << (key.bInstanced ? 1 : 0) << "\n";
+	defines << "#define VARIANT_INDIRECT " << (key.bIndirect ? 1 : 0) << "\n";
+
+	return(defines.str());
+}
+
+/***********************************************************
+ *  Prefetch()
+ *
+ *  This method is used for submitting the build of a variant
+ *  before any draw asks for it.  A variant that is already
+ *  built or being built is not submitted again.
+ ***********************************************************/
+void ShaderVariants::Prefetch(const VARIANT_KEY& key)
+{
+	const uint32_t packedKey = PackKey(key);
+
+	if ((m_programs.find(packedKey) != m_programs.end()) ||
+		(m_pending.find(packedKey) != m_pending.end()))
+	{
+		return;
+	}
+
+	m_pending[packedKey] = m_pShaderCompiler->Submit(
+		VariantName(packedKey),
+		m_vertexShaderFile,
+		m_fragmentShaderFile,
+		VariantDefines(key));
+}
+
+/***********************************************************
+ *  GetProgram()
+ *
+ *  This method is used for getting the program of a variant,
+ *  building it the first time it is asked for, or collecting
+ *  it from the compiler when it was prefetched.  A variant
+ *  that fails to build is remembered, so it is not compiled
+ *  again for every draw.  Returns 0 for such a variant.
+ ***********************************************************/
+GLuint ShaderVariants::GetProgram(const VARIANT_KEY& key, bool& bBuilt)
+{
+	const uint32_t packedKey = PackKey(key);
+
+	bBuilt = false;
+	std::unordered_map<uint32_t, GLuint>::const_iterator found = m_programs.find(packedKey);
+	if (found != m_programs.end())
+	{
+		return(found->second);
+	}
+
+	int ticket = 0;
+	std::unordered_map<uint32_t, int>::iterator pending = m_pending.find(packedKey);
+	if (pending != m_pending.end())
+	{
+		ticket = pending->second;
+		m_pending.erase(pending);
+	}
+	else
+	{
+		ticket = m_pShaderCompiler->Submit(
+			VariantName(packedKey),
+			m_vertexShaderFile,
+			m_fragmentShaderFile,
+			VariantDefines(key));
+	}
+
+	GLuint program = m_pShaderCompiler->Finish(ticket);
+	if (program == 0)
+	{
+		std::cout << "Could not build shader variant 0x" << std::hex << packedKey << std::dec << std::endl;
+	}
+
+	m_programs[packedKey] = program;
+	bBuilt = (program != 0);
+
+	return(program);
+}
+
+/***********************************************************
+ *  GetPrograms()
+ *
+ *  This method is used for listing the programs of the
+ *  variants that have been built.
+ ***********************************************************/
+void ShaderVariants::GetPrograms(std::vector<GLuint>& programs) const
+{
+	std::unordered_map<uint32_t, GLuint>::const_iterator variant;
+	for (variant = m_programs.begin(); variant != m_programs.end(); ++variant)
+	{
+		if (variant->second != 0)
+		{
+			programs.push_back(variant->second);
+		}
+	}
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for deleting the programs of every
+ *  variant, so they are built again from the current shader
+ *  sources when next asked for.  Prefetched variants still
+ *  building are collected first, so their programs are freed.
+ ***********************************************************/
+void ShaderVariants::Destroy()
+{
+	std::unordered_map<uint32_t, int>::iterator pending;
+	for (pending = m_pending.begin(); pending != m_pending.end(); ++pending)
+	{
+		GLuint program = m_pShaderCompiler->Finish(pending->second);
+		if (program != 0)
+		{
+			glDeleteProgram(program);
+		}
+	}
+	m_pending.clear();
+
+	std::unordered_map<uint32_t, GLuint>::iterator variant;
+	for (variant = m_programs.begin(); variant != m_programs.end(); ++variant)
+	{
+		if (variant->second != 0)
+		{
+			glDeleteProgram(variant->second);
+		}
+	}
+	m_programs.clear();
+}
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+// shadervariants.h
+// ============
+// shader programs specialized at compile time for the features a draw uses
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ShaderCompiler.h"
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/***********************************************************
+ *  ShaderVariants
+ *
+ *  This class builds the scene shaders into one program per
+ *  combination of features a draw can use - textured or not,
+ *  lit or not, and exactly which lights are on.  Each variant
+ *  is compiled with #define lines that turn the runtime
+ *  branches of the shader into constants, so the compiler
+ *  drops the paths the draw does not take and unrolls the
+ *  light loop to the number of lights.  A variant is built
+ *  through the shader compiler the first time it is asked
+ *  for, or ahead of that when it is prefetched, so it can
+ *  compile in the background while the scene loads.
+ ***********************************************************/
+class ShaderVariants
+{
+public:
+	// constructor
+	ShaderVariants(
+		ShaderCompiler* pShaderCompiler,
+		const char* vertexShaderFile,
+		const char* fragmentShaderFile);
+	// destructor
+	~ShaderVariants();
+
+	// features a variant is specialized for
+	struct VARIANT_KEY
+	{
+		bool bTexture;
+		bool bLighting;
+		bool bDirectionalLight;
+		bool bSpotLight;
+		// the first pointLights point lights are on
+		int pointLights;
+		// true to read the model matrix and material of each
+		// instance from the instance buffer
+		bool bInstanced;
+		// true to also read the values of each batch from the
+		// batch storage buffer, for indirect draws
+		bool bIndirect;
+	};
+
+	// start building a variant in the background, ahead of the
+	// first draw that asks for it
+	void Prefetch(const VARIANT_KEY& key);
+	// program of a variant, built when it is first asked for -
+	// bBuilt is set when it was built by this call, and 0 is
+	// returned when the variant does not build
+	GLuint GetProgram(const VARIANT_KEY& key, bool& bBuilt);
+	// programs of the variants built so far
+	void GetPrograms(std::vector<GLuint>& programs) const;
+	// number of variants built so far
+	int GetVariantCount() const { return((int)m_programs.size()); }
+	// delete the programs of every variant
+	void Destroy();
+
+	// the #define lines that select a variant in the shaders
+	static std::string VariantDefines(const VARIANT_KEY& key);
+
+private:
+	// builds the variant programs in the background
+	ShaderCompiler* m_pShaderCompiler;
+	// GLSL source files of the shaders
+	std::string m_vertexShaderFile;
+	std::string m_fragmentShaderFile;
+	// program of each variant by its packed key, 0 when the
+	// variant did not build
+	std::unordered_map<uint32_t, GLuint> m_programs;
+	// compiler ticket of each prefetched variant that has not
+	// been collected, by its packed key
+	std::unordered_map<uint32_t, int> m_pending;
+
+	// pack the features of a variant into one number
+	static uint32_t PackKey(const VARIANT_KEY& key);
+	// readable name of a variant for the compile report
+	static std::string VariantName(uint32_t packedKey);
+};
@@ -0,0 +1,263 @@
+///////////////////////////////////////////////////////////////////////////////
+// shapegeometry.cpp
+// ============
+// vertices and indices of the basic shapes the scene is built from
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShapeGeometry.h"
+
+#include <cmath>
+
+// declaration of global variables
+namespace
+{
+	const float PI = 3.14159265358979f;
+
+	// segments around the round shapes, and rows from the top
+	// to the bottom of a sphere
+	const int ROUND_SEGMENTS = 36;
+	const int SPHERE_STACKS = 18;
+	const int TORUS_TUBE_SEGMENTS = 18;
+
+	// radius of the torus tube, the default of ShapeMeshes
+	const float TORUS_THICKNESS = 0.1f;
+
+	// add a vertex to a mesh, returning its index
+	GLuint AddVertex(ShapeGeometry::MESH_DATA& mesh, const glm::vec3& position, const glm::vec3& normal, const glm::vec2& textureCoordinate)
+	{
+		ShapeGeometry::VERTEX vertex;
+		vertex.position = position;
+		vertex.normal = normal;
+		vertex.textureCoordinate = textureCoordinate;
+		mesh.vertices.push_back(vertex);
+
+		return((GLuint)mesh.vertices.size() - 1);
+	}
+
+	// add a triangle, wound counterclockwise seen from outside
+	void AddTriangle(ShapeGeometry::MESH_DATA& mesh, GLuint first, GLuint second, GLuint third)
+	{
+		mesh.indices.push_back(first);
+		mesh.indices.push_back(second);
+		mesh.indices.push_back(third);
+	}
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for building the vertices and indices
+ *  of a shape into a mesh, replacing what it held.
+ ***********************************************************/
+void ShapeGeometry::Build(SHAPE shape, MESH_DATA& mesh)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	switch (shape)
+	{
+	case SHAPE_BOX:
+		AddQuad(mesh, glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -0.5f), glm::vec3(0.0f, 0.5f, 0.0f));
+		AddQuad(mesh, glm::vec3(-0.5f, 0.0f, 0.0f), glm::vec3(-1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.5f), glm::vec3(0.0f, 0.5f, 0.0f));
+		AddQuad(mesh, glm::vec3(0.0f, 0.5f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -0.5f));
+		AddQuad(mesh, glm::vec3(0.0f, -0.5f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.5f));
+		AddQuad(mesh, glm::vec3(0.0f, 0.0f, 0.5f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.5f, 0.0f));
+		AddQuad(mesh, glm::vec3(0.0f, 0.0f, -0.5f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(-0.5f, 0.0f, 0.0f), glm::vec3(0.0f, 0.5f, 0.0f));
+		break;
+	case SHAPE_PLANE:
+		AddQuad(mesh, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f));
+		break;
+	case SHAPE_CYLINDER:
+		AddDisc(mesh, 1.0f, 0.0f, false);
+		AddDisc(mesh, 1.0f, 1.0f, true);
+		AddCylinderSide(mesh, 1.0f, 1.0f);
+		break;
+	case SHAPE_TAPERED_CYLINDER:
+		AddDisc(mesh, 1.0f, 0.0f, false);
+		AddDisc(mesh, 0.5f, 1.0f, true);
+		AddCylinderSide(mesh, 1.0f, 0.5f);
+		break;
+	case SHAPE_TORUS:
+		AddTorus(mesh, 1.0f, TORUS_THICKNESS);
+		break;
+	case SHAPE_SPHERE:
+		AddSphereBand(mesh, 0.0f, PI, SPHERE_STACKS);
+		break;
+	case SHAPE_HALF_SPHERE:
+		AddSphereBand(mesh, 0.0f, PI * 0.5f, SPHERE_STACKS / 2);
+		AddDisc(mesh, 1.0f, 0.0f, false);
+		break;
+	default:
+		break;
+	}
+}
+
+/***********************************************************
+ *  AddQuad()
+ *
+ *  This method is used for adding a quad of two triangles,
+ *  with the texture stretched once across it.  The right and
+ *  up directions are half the size of the quad, and right
+ *  crossed with up must point along the normal.
+ ***********************************************************/
+void ShapeGeometry::AddQuad(MESH_DATA& mesh, const glm::vec3& center, const glm::vec3& normal,
+	const glm::vec3& right, const glm::vec3& up)
+{
+	const GLuint first = AddVertex(mesh, center - right - up, normal, glm::vec2(0.0f, 0.0f));
+	AddVertex(mesh, center + right - up, normal, glm::vec2(1.0f, 0.0f));
+	AddVertex(mesh, center + right + up, normal, glm::vec2(1.0f, 1.0f));
+	AddVertex(mesh, center - right + up, normal, glm::vec2(0.0f, 1.0f));
+
+	AddTriangle(mesh, first, first + 1, first + 2);
+	AddTriangle(mesh, first, first + 2, first + 3);
+}
+
+/***********************************************************
+ *  AddDisc()
+ *
+ *  This method is used for adding the cap of a cylinder, a
+ *  fan of triangles around its center, with the texture
+ *  mapped flat across it.
+ ***********************************************************/
+void ShapeGeometry::AddDisc(MESH_DATA& mesh, float radius, float height, bool bFacingUp)
+{
+	const glm::vec3 normal(0.0f, bFacingUp ? 1.0f : -1.0f, 0.0f);
+	const GLuint center = AddVertex(mesh, glm::vec3(0.0f, height, 0.0f), normal, glm::vec2(0.5f, 0.5f));
+
+	for (int i = 0; i <= ROUND_SEGMENTS; i++)
+	{
+		const float angle = 2.0f * PI * i / ROUND_SEGMENTS;
+		AddVertex(mesh,
+			glm::vec3(radius * cosf(angle), height, radius * sinf(angle)),
+			normal,
+			glm::vec2(0.5f + 0.5f * cosf(angle), 0.5f + 0.5f * sinf(angle)));
+	}
+
+	for (int i = 0; i < ROUND_SEGMENTS; i++)
+	{
+		const GLuint edge = center + 1 + i;
+		if (bFacingUp == true)
+		{
+			AddTriangle(mesh, center, edge + 1, edge);
+		}
+		else
+		{
+			AddTriangle(mesh, center, edge, edge + 1);
+		}
+	}
+}
+
+/***********************************************************
+ *  AddCylinderSide()
+ *
+ *  This method is used for adding the side of a cylinder 1
+ *  unit high, which tapers when the radii differ.  The normals
+ *  lean up by the slope of the side, and the texture wraps
+ *  around it once.
+ ***********************************************************/
+void ShapeGeometry::AddCylinderSide(MESH_DATA& mesh, float bottomRadius, float topRadius)
+{
+	const GLuint first = (GLuint)mesh.vertices.size();
+
+	for (int i = 0; i <= ROUND_SEGMENTS; i++)
+	{
+		const float angle = 2.0f * PI * i / ROUND_SEGMENTS;
+		const float x = cosf(angle);
+		const float z = sinf(angle);
+		const glm::vec3 normal = glm::normalize(glm::vec3(x, bottomRadius - topRadius, z));
+		const float u = (float)i / ROUND_SEGMENTS;
+
+		AddVertex(mesh, glm::vec3(bottomRadius * x, 0.0f, bottomRadius * z), normal, glm::vec2(u, 0.0f));
+		AddVertex(mesh, glm::vec3(topRadius * x, 1.0f, topRadius * z), normal, glm::vec2(u, 1.0f));
+	}
+
+	for (int i = 0; i < ROUND_SEGMENTS; i++)
+	{
+		const GLuint bottom = first + 2 * i;
+		AddTriangle(mesh, bottom, bottom + 1, bottom + 2);
+		AddTriangle(mesh, bottom + 2, bottom + 1, bottom + 3);
+	}
+}
+
+/***********************************************************
+ *  AddSphereBand()
+ *
+ *  This method is used for adding the part of a sphere of
+ *  radius 1 between two angles measured down from its top,
+ *  in rows of quads.  The whole sphere runs from 0 to pi and
+ *  the upper half from 0 to pi/2.
+ ***********************************************************/
+void ShapeGeometry::AddSphereBand(MESH_DATA& mesh, float firstAngle, float lastAngle, int stacks)
+{
+	const GLuint first = (GLuint)mesh.vertices.size();
+	const GLuint rowSize = ROUND_SEGMENTS + 1;
+
+	for (int stack = 0; stack <= stacks; stack++)
+	{
+		const float polar = firstAngle + (lastAngle - firstAngle) * stack / stacks;
+		for (int i = 0; i <= ROUND_SEGMENTS; i++)
+		{
+			const float angle = 2.0f * PI * i / ROUND_SEGMENTS;
+			const glm::vec3 position(sinf(polar) * cosf(angle), cosf(polar), sinf(polar) * sinf(angle));
+			AddVertex(mesh, position, position,
+				glm::vec2((float)i / ROUND_SEGMENTS, 1.0f - polar / PI));
+		}
+	}
+
+	for (int stack = 0; stack < stacks; stack++)
+	{
+		for (int i = 0; i < ROUND_SEGMENTS; i++)
+		{
+			// the rows at the poles are a single point, so half of
+			// the quads touching them have no area
+			const GLuint upper = first + stack * rowSize + i;
+			const GLuint lower = upper + rowSize;
+			if ((stack > 0) || (firstAngle > 0.0f))
+			{
+				AddTriangle(mesh, upper, upper + 1, lower + 1);
+			}
+			if ((stack < stacks - 1) || (lastAngle < PI))
+			{
+				AddTriangle(mesh, upper, lower + 1, lower);
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  AddTorus()
+ *
+ *  This method is used for adding a torus whose ring runs
+ *  around the Z axis, with the texture wrapped once around
+ *  the ring and once around the tube.
+ ***********************************************************/
+void ShapeGeometry::AddTorus(MESH_DATA& mesh, float mainRadius, float tubeRadius)
+{
+	const GLuint first = (GLuint)mesh.vertices.size();
+	const GLuint rowSize = TORUS_TUBE_SEGMENTS + 1;
+
+	for (int i = 0; i <= ROUND_SEGMENTS; i++)
+	{
+		const float ringAngle = 2.0f * PI * i / ROUND_SEGMENTS;
+		const glm::vec3 ringDirection(cosf(ringAngle), sinf(ringAngle), 0.0f);
+
+		for (int j = 0; j <= TORUS_TUBE_SEGMENTS; j++)
+		{
+			const float tubeAngle = 2.0f * PI * j / TORUS_TUBE_SEGMENTS;
+			const glm::vec3 normal = ringDirection * cosf(tubeAngle) + glm::vec3(0.0f, 0.0f, sinf(tubeAngle));
+			AddVertex(mesh, ringDirection * mainRadius + normal * tubeRadius, normal,
+				glm::vec2((float)i / ROUND_SEGMENTS, (float)j / TORUS_TUBE_SEGMENTS));
+		}
+	}
+
+	for (int i = 0; i < ROUND_SEGMENTS; i++)
+	{
+		for (int j = 0; j < TORUS_TUBE_SEGMENTS; j++)
+		{
+			const GLuint corner = first + i * rowSize + j;
+			const GLuint next = corner + rowSize;
+			AddTriangle(mesh, corner, next, next + 1);
+			AddTriangle(mesh, corner, next + 1, corner + 1);
+		}
+	}
+}
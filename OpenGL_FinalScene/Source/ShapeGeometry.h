@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////
+// shapegeometry.h
+// ============
+// vertices and indices of the basic shapes the scene is built from
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+/***********************************************************
+ *  ShapeGeometry
+ *
+ *  This class builds the vertices and triangle indices of the
+ *  basic shapes in memory, in the sizes ShapeMeshes loads them
+ *  - a unit box and a 2 x 2 plane centered on the origin, a
+ *  cylinder and a tapered cylinder of radius 1 standing on
+ *  the origin 1 unit high, a torus of radius 1 around the Z
+ *  axis, and a sphere and a half sphere of radius 1.  Each
+ *  vertex has the position, normal and texture coordinate the
+ *  scene shaders read at locations 0, 1 and 2.
+ ***********************************************************/
+class ShapeGeometry
+{
+public:
+	// shapes that can be built
+	enum SHAPE
+	{
+		SHAPE_BOX = 0,
+		SHAPE_PLANE,
+		SHAPE_CYLINDER,
+		SHAPE_TAPERED_CYLINDER,
+		SHAPE_TORUS,
+		SHAPE_SPHERE,
+		SHAPE_HALF_SPHERE,
+		SHAPE_COUNT
+	};
+
+	// attribute locations of the vertex values
+	enum VERTEX_LOCATION
+	{
+		LOCATION_POSITION = 0,
+		LOCATION_NORMAL = 1,
+		LOCATION_TEXTURE_COORDINATE = 2
+	};
+
+	struct VERTEX
+	{
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoordinate;
+	};
+
+	struct MESH_DATA
+	{
+		std::vector<VERTEX> vertices;
+		std::vector<GLuint> indices;
+	};
+
+	// build the vertices and indices of a shape
+	static void Build(SHAPE shape, MESH_DATA& mesh);
+
+private:
+	// add a quad facing along a normal, from its center and the
+	// half extents along its right and up directions
+	static void AddQuad(MESH_DATA& mesh, const glm::vec3& center, const glm::vec3& normal,
+		const glm::vec3& right, const glm::vec3& up);
+	// add a disc of a radius at a height, facing up or down
+	static void AddDisc(MESH_DATA& mesh, float radius, float height, bool bFacingUp);
+	// add the side of a cylinder that tapers between two radii
+	static void AddCylinderSide(MESH_DATA& mesh, float bottomRadius, float topRadius);
+	// add a band of a sphere between two angles from the top
+	static void AddSphereBand(MESH_DATA& mesh, float firstAngle, float lastAngle, int stacks);
+	// add a torus around the Z axis
+	static void AddTorus(MESH_DATA& mesh, float mainRadius, float tubeRadius);
+};
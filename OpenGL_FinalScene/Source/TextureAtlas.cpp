@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureatlas.cpp
+// ============
+// pack small texture images into a shared atlas image
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureAtlas.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// declaration of the atlas helpers
+namespace
+{
+	// round up to the next cell boundary
+	int AlignToCell(int value)
+	{
+		return((value + TextureAtlas::CELL_ALIGNMENT - 1) / TextureAtlas::CELL_ALIGNMENT * TextureAtlas::CELL_ALIGNMENT);
+	}
+}
+
+/***********************************************************
+ *  TextureAtlas()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureAtlas::TextureAtlas(int size)
+{
+	m_size = size;
+	m_shelfY = 0;
+	m_shelfHeight = 0;
+	m_shelfX = 0;
+}
+
+/***********************************************************
+ *  ~TextureAtlas()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureAtlas::~TextureAtlas()
+{
+}
+
+/***********************************************************
+ *  Accepts()
+ *
+ *  This method is used for checking whether an image is small
+ *  enough to share an atlas.  Only RGBA images with their full
+ *  mip chain are accepted.
+ ***********************************************************/
+bool TextureAtlas::Accepts(const TextureDecoder::DECODED_IMAGE& image)
+{
+	return((NULL != image.pixels) &&
+		(image.colorChannels == 4) &&
+		(image.width <= MAX_IMAGE_SIZE) &&
+		(image.height <= MAX_IMAGE_SIZE) &&
+		(TextureDecoder::MipDimension(image.width, image.mipLevels - 1) == 1) &&
+		(TextureDecoder::MipDimension(image.height, image.mipLevels - 1) == 1));
+}
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method is used for placing an image on the current
+ *  shelf, or on a new shelf below it when the current one is
+ *  full.  Images packed tallest first waste the least room.
+ ***********************************************************/
+bool TextureAtlas::Add(const TextureDecoder::DECODED_IMAGE& image)
+{
+	if (Accepts(image) == false)
+	{
+		return(false);
+	}
+
+	const int cellWidth = AlignToCell(image.width + BORDER * 2);
+	const int cellHeight = AlignToCell(image.height + BORDER * 2);
+
+	// start a new shelf when the image does not fit on this one
+	if (m_shelfX + cellWidth > m_size)
+	{
+		m_shelfY += m_shelfHeight;
+		m_shelfHeight = 0;
+		m_shelfX = 0;
+	}
+	if ((cellWidth > m_size) || (m_shelfY + cellHeight > m_size))
+	{
+		return(false);
+	}
+
+	ATLAS_ENTRY entry;
+	entry.tag = image.tag;
+	entry.filename = image.filename;
+	entry.width = image.width;
+	entry.height = image.height;
+	entry.x = m_shelfX + BORDER;
+	entry.y = m_shelfY + BORDER;
+	entry.rect = glm::vec4(
+		(float)entry.x / m_size,
+		(float)entry.y / m_size,
+		(float)entry.width / m_size,
+		(float)entry.height / m_size);
+
+	m_entries.push_back(entry);
+	m_images.push_back(&image);
+
+	m_shelfX += cellWidth;
+	if (cellHeight > m_shelfHeight)
+	{
+		m_shelfHeight = cellHeight;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  ExactMipLevels()
+ *
+ *  This method is used for getting the number of mip levels
+ *  that keep exact cells - log2 of the cell alignment, plus
+ *  the full resolution level.
+ ***********************************************************/
+int TextureAtlas::ExactMipLevels()
+{
+	int levels = 1;
+	while ((CELL_ALIGNMENT >> levels) > 0)
+	{
+		levels++;
+	}
+	return(levels);
+}
+
+/***********************************************************
+ *  ComposeCell()
+ *
+ *  This method is used for copying one mip level of an image
+ *  into its cell, surrounded by a border of texels wrapped
+ *  around from the opposite edges, so a repeating image
+ *  filters across its edges as if it were not in an atlas.
+ ***********************************************************/
+void TextureAtlas::ComposeCell(const TextureDecoder::DECODED_IMAGE& image, int level, unsigned char* target, int targetWidth)
+{
+	const int border = BORDER >> level;
+	const int imageWidth = TextureDecoder::MipDimension(image.width, level);
+	const int imageHeight = TextureDecoder::MipDimension(image.height, level);
+	const unsigned char* source = image.pixels + image.mipOffsets[level];
+
+	for (int y = 0; y < imageHeight + border * 2; y++)
+	{
+		const int sourceY = (y - border + imageHeight * border) % imageHeight;
+		for (int x = 0; x < imageWidth + border * 2; x++)
+		{
+			const int sourceX = (x - border + imageWidth * border) % imageWidth;
+			memcpy(target + ((size_t)y * targetWidth + x) * 4,
+				source + ((size_t)sourceY * imageWidth + sourceX) * 4, 4);
+		}
+	}
+}
+
+/***********************************************************
+ *  Build()
+ *
+ *  This method is used for composing the atlas image with its
+ *  full mip chain.  The levels that keep exact cells are
+ *  copied from each image's own mip chain, with the border
+ *  filled by wrapping around the image, and the smaller levels
+ *  are filtered down from the level above with a 2 x 2 box.
+ ***********************************************************/
+bool TextureAtlas::Build(TextureDecoder::DECODED_IMAGE& atlas)
+{
+	atlas.width = m_size;
+	atlas.height = m_size;
+	atlas.colorChannels = 4;
+	atlas.bStbiPixels = false;
+	atlas.bMappedPixels = false;
+	atlas.mipLevels = 0;
+
+	size_t totalBytes = 0;
+	while (atlas.mipLevels < TextureDecoder::MAX_MIP_LEVELS)
+	{
+		const int mipSize = TextureDecoder::MipDimension(m_size, atlas.mipLevels);
+		atlas.mipOffsets[atlas.mipLevels] = totalBytes;
+		totalBytes += (size_t)mipSize * mipSize * 4;
+		atlas.mipLevels++;
+		if (mipSize == 1)
+		{
+			break;
+		}
+	}
+
+	// the unused room is left transparent black
+	atlas.pixels = (unsigned char*)calloc(totalBytes, 1);
+	if (NULL == atlas.pixels)
+	{
+		atlas.mipLevels = 1;
+		return(false);
+	}
+
+	const int exactLevels = ExactMipLevels();
+	for (int level = 0; level < atlas.mipLevels; level++)
+	{
+		const int mipSize = TextureDecoder::MipDimension(m_size, level);
+		unsigned char* target = atlas.pixels + atlas.mipOffsets[level];
+
+		if (level < exactLevels)
+		{
+			const int border = BORDER >> level;
+			for (size_t i = 0; i < m_entries.size(); i++)
+			{
+				const int cellX = (m_entries[i].x >> level) - border;
+				const int cellY = (m_entries[i].y >> level) - border;
+				ComposeCell(*m_images[i], level, target + ((size_t)cellY * mipSize + cellX) * 4, mipSize);
+			}
+			continue;
+		}
+
+		// the cells no longer line up, so filter the atlas itself
+		const int sourceSize = TextureDecoder::MipDimension(m_size, level - 1);
+		const unsigned char* source = atlas.pixels + atlas.mipOffsets[level - 1];
+		for (int y = 0; y < mipSize; y++)
+		{
+			for (int x = 0; x < mipSize; x++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = source[((size_t)(y * 2) * sourceSize + x * 2) * 4 + c] +
+						source[((size_t)(y * 2) * sourceSize + x * 2 + 1) * 4 + c] +
+						source[((size_t)(y * 2 + 1) * sourceSize + x * 2) * 4 + c] +
+						source[((size_t)(y * 2 + 1) * sourceSize + x * 2 + 1) * 4 + c];
+					target[((size_t)y * mipSize + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+
+	return(true);
+}
@@ -0,0 +1,85 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureatlas.h
+// ============
+// pack small texture images into a shared atlas image
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureDecoder.h"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+/***********************************************************
+ *  TextureAtlas
+ *
+ *  This class packs small RGBA images into one square atlas
+ *  image on shelves.  Every image sits in a cell with a border
+ *  of its own wrapped texels, so it can still repeat without
+ *  picking up its neighbours, and the cells are aligned so the
+ *  first mip levels of each image line up exactly with the
+ *  atlas texels.  Those levels are copied from each image's own
+ *  mip chain, border and all, rather than filtered across the
+ *  cells.
+ ***********************************************************/
+class TextureAtlas
+{
+public:
+	// constructor
+	TextureAtlas(int size);
+	// destructor
+	~TextureAtlas();
+
+	// largest width or height of an image that goes into an atlas
+	static const int MAX_IMAGE_SIZE = 512;
+	// texels of wrapped border around each image at level 0
+	static const int BORDER = 16;
+	// cells start on multiples of this many texels, so levels
+	// up to log2 of it keep exact cells with at least one texel
+	// of border
+	static const int CELL_ALIGNMENT = 16;
+
+	struct ATLAS_ENTRY
+	{
+		std::string tag;
+		std::string filename;
+		int width;
+		int height;
+		// texel position of the image in the atlas
+		int x;
+		int y;
+		// UV offset in xy and UV scale in zw
+		glm::vec4 rect;
+	};
+
+	// true when an image is small enough for an atlas
+	static bool Accepts(const TextureDecoder::DECODED_IMAGE& image);
+	// place an image, false when there is no room left for it -
+	// the image must stay valid until Build() is called
+	bool Add(const TextureDecoder::DECODED_IMAGE& image);
+	// compose the atlas image and its full mip chain
+	bool Build(TextureDecoder::DECODED_IMAGE& atlas);
+	// the images placed in the atlas
+	const std::vector<ATLAS_ENTRY>& GetEntries() const { return(m_entries); }
+
+	// number of mip levels in which the cells line up exactly
+	static int ExactMipLevels();
+	// copy a mip level of an image with its wrapped border, to
+	// the top left corner of its cell in the target pixels
+	static void ComposeCell(const TextureDecoder::DECODED_IMAGE& image, int level, unsigned char* target, int targetWidth);
+
+private:
+	// width and height of the atlas
+	int m_size;
+	// top of the current shelf, its height, and the next free
+	// position along it
+	int m_shelfY;
+	int m_shelfHeight;
+	int m_shelfX;
+	// placed images and their pixels
+	std::vector<ATLAS_ENTRY> m_entries;
+	std::vector<const TextureDecoder::DECODED_IMAGE*> m_images;
+};
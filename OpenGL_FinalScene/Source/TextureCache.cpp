@@ -0,0 +1,291 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.cpp
+// ============
+// on-disk cache of decoded texture images with precomputed mip chains
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureCache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// declaration of the cache file layout
+namespace
+{
+	// DDS header flags for an uncompressed texture with mipmaps
+	const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+	const uint32_t DDSD_CAPS = 0x1;
+	const uint32_t DDSD_HEIGHT = 0x2;
+	const uint32_t DDSD_WIDTH = 0x4;
+	const uint32_t DDSD_PITCH = 0x8;
+	const uint32_t DDSD_PIXELFORMAT = 0x1000;
+	const uint32_t DDSD_MIPMAPCOUNT = 0x20000;
+	const uint32_t DDPF_ALPHAPIXELS = 0x1;
+	const uint32_t DDPF_RGB = 0x40;
+	const uint32_t DDSCAPS_COMPLEX = 0x8;
+	const uint32_t DDSCAPS_TEXTURE = 0x1000;
+	const uint32_t DDSCAPS_MIPMAP = 0x400000;
+
+	// written into the reserved header words to tell our entries
+	// apart from other DDS files - bump it when the layout or the
+	// decode settings (such as the vertical flip) change
+	const uint32_t CACHE_VERSION = 0x31435854; // "TXC1"
+
+	struct DDS_PIXELFORMAT
+	{
+		uint32_t size;
+		uint32_t flags;
+		uint32_t fourCC;
+		uint32_t RGBBitCount;
+		uint32_t RBitMask;
+		uint32_t GBitMask;
+		uint32_t BBitMask;
+		uint32_t ABitMask;
+	};
+
+	struct DDS_HEADER
+	{
+		uint32_t magic;
+		uint32_t size;
+		uint32_t flags;
+		uint32_t height;
+		uint32_t width;
+		uint32_t pitchOrLinearSize;
+		uint32_t depth;
+		uint32_t mipMapCount;
+		// [0] cache version, [1] and [2] source hash
+		uint32_t reserved1[11];
+		DDS_PIXELFORMAT pixelFormat;
+		uint32_t caps;
+		uint32_t caps2;
+		uint32_t caps3;
+		uint32_t caps4;
+		uint32_t reserved2;
+	};
+}
+
+/***********************************************************
+ *  TextureCache()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureCache::TextureCache(const char* directory)
+{
+	m_directory = directory;
+	m_bReadEnabled = true;
+}
+
+/***********************************************************
+ *  ~TextureCache()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureCache::~TextureCache()
+{
+}
+
+/***********************************************************
+ *  SetReadEnabled()
+ *
+ *  This method is used for allowing or ignoring the cached
+ *  entries.  It must not be changed while images are being
+ *  decoded.
+ ***********************************************************/
+void TextureCache::SetReadEnabled(bool bReadEnabled)
+{
+	m_bReadEnabled = bReadEnabled;
+}
+
+/***********************************************************
+ *  HashFile()
+ *
+ *  This method is used for computing a 64-bit FNV-1a hash of
+ *  the contents of a file.
+ ***********************************************************/
+bool TextureCache::HashFile(const char* filename, uint64_t& hash)
+{
+	std::ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		return(false);
+	}
+
+	char buffer[65536];
+
+	hash = 14695981039346656037ULL;
+	while (file)
+	{
+		file.read(buffer, sizeof(buffer));
+		const std::streamsize bytesRead = file.gcount();
+		for (std::streamsize i = 0; i < bytesRead; i++)
+		{
+			hash ^= (unsigned char)buffer[i];
+			hash *= 1099511628211ULL;
+		}
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  EntryPath()
+ *
+ *  This method is used for getting the path of the cache
+ *  entry for a source file hash.
+ ***********************************************************/
+std::string TextureCache::EntryPath(uint64_t sourceHash)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.dds", (unsigned long long)sourceHash);
+	return(m_directory + "/" + name);
+}
+
+/***********************************************************
+ *  Load()
+ *
+ *  This method is used for reading the cached RGBA image and
+ *  its mip chain for a source file hash.  Returns false when
+ *  there is no valid entry.
+ ***********************************************************/
+bool TextureCache::Load(uint64_t sourceHash, TextureDecoder::DECODED_IMAGE& image)
+{
+	if (m_bReadEnabled == false)
+	{
+		return(false);
+	}
+
+	std::string path = EntryPath(sourceHash);
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file)
+	{
+		return(false);
+	}
+
+	DDS_HEADER header;
+	if ((!file.read((char*)&header, sizeof(header))) ||
+		(header.magic != DDS_MAGIC) ||
+		(header.size != sizeof(DDS_HEADER) - sizeof(uint32_t)) ||
+		(header.reserved1[0] != CACHE_VERSION) ||
+		(header.reserved1[1] != (uint32_t)(sourceHash & 0xFFFFFFFF)) ||
+		(header.reserved1[2] != (uint32_t)(sourceHash >> 32)) ||
+		(header.pixelFormat.RGBBitCount != 32) ||
+		(header.width == 0) || (header.height == 0) ||
+		(header.mipMapCount == 0) ||
+		(header.mipMapCount > TextureDecoder::MAX_MIP_LEVELS))
+	{
+		return(false);
+	}
+
+	image.width = (int)header.width;
+	image.height = (int)header.height;
+	image.colorChannels = 4;
+	image.mipLevels = (int)header.mipMapCount;
+
+	size_t totalBytes = 0;
+	for (int level = 0; level < image.mipLevels; level++)
+	{
+		image.mipOffsets[level] = totalBytes;
+		totalBytes += (size_t)TextureDecoder::MipDimension(image.width, level) *
+			TextureDecoder::MipDimension(image.height, level) * 4;
+	}
+
+	image.pixels = (unsigned char*)malloc(totalBytes);
+	image.bStbiPixels = false;
+	if ((NULL == image.pixels) || (!file.read((char*)image.pixels, totalBytes)))
+	{
+		TextureDecoder::FreeImage(image);
+		image.mipLevels = 1;
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  Store()
+ *
+ *  This method is used for writing an RGBA image and its mip
+ *  chain to the cache.  The entry is written to a temporary
+ *  file first and then renamed, so another thread or process
+ *  never reads a partly written entry.
+ ***********************************************************/
+bool TextureCache::Store(uint64_t sourceHash, const TextureDecoder::DECODED_IMAGE& image)
+{
+	if ((image.colorChannels != 4) || (NULL == image.pixels))
+	{
+		return(false);
+	}
+
+	// create the cache directory the first time it is needed
+#ifdef _WIN32
+	_mkdir(m_directory.c_str());
+#else
+	mkdir(m_directory.c_str(), 0755);
+#endif
+
+	DDS_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = DDS_MAGIC;
+	header.size = sizeof(DDS_HEADER) - sizeof(uint32_t);
+	header.flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PITCH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+	header.height = (uint32_t)image.height;
+	header.width = (uint32_t)image.width;
+	header.pitchOrLinearSize = (uint32_t)image.width * 4;
+	header.mipMapCount = (uint32_t)image.mipLevels;
+	header.reserved1[0] = CACHE_VERSION;
+	header.reserved1[1] = (uint32_t)(sourceHash & 0xFFFFFFFF);
+	header.reserved1[2] = (uint32_t)(sourceHash >> 32);
+	header.pixelFormat.size = sizeof(DDS_PIXELFORMAT);
+	header.pixelFormat.flags = DDPF_RGB | DDPF_ALPHAPIXELS;
+	header.pixelFormat.RGBBitCount = 32;
+	header.pixelFormat.RBitMask = 0x000000FF;
+	header.pixelFormat.GBitMask = 0x0000FF00;
+	header.pixelFormat.BBitMask = 0x00FF0000;
+	header.pixelFormat.ABitMask = 0xFF000000;
+	header.caps = DDSCAPS_TEXTURE | DDSCAPS_MIPMAP | DDSCAPS_COMPLEX;
+
+	const int lastLevel = image.mipLevels - 1;
+	const size_t totalBytes = image.mipOffsets[lastLevel] +
+		(size_t)TextureDecoder::MipDimension(image.width, lastLevel) *
+		TextureDecoder::MipDimension(image.height, lastLevel) * 4;
+
+	std::string path = EntryPath(sourceHash);
+	std::ostringstream temporaryPath;
+	temporaryPath << path << "." << std::this_thread::get_id() << ".tmp";
+
+	std::ofstream file(temporaryPath.str().c_str(), std::ios::binary);
+	if (!file)
+	{
+		std::cout << "Could not write texture cache entry:" << path << std::endl;
+		return(false);
+	}
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)image.pixels, totalBytes);
+	file.close();
+	bool bReturn = !file.fail();
+
+	if (bReturn == true)
+	{
+		// rename does not replace an existing file on Windows
+		remove(path.c_str());
+		bReturn = (rename(temporaryPath.str().c_str(), path.c_str()) == 0);
+	}
+	if (bReturn == false)
+	{
+		remove(temporaryPath.str().c_str());
+	}
+
+	return(bReturn);
+}
@@ -0,0 +1,51 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturecache.h
+// ============
+// on-disk cache of decoded texture images with precomputed mip chains
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "TextureDecoder.h"
+
+#include <cstdint>
+#include <string>
+
+/***********************************************************
+ *  TextureCache
+ *
+ *  This class keeps GPU-ready copies of the texture images in
+ *  a cache directory.  Each entry is an uncompressed RGBA8 DDS
+ *  file holding the full mip chain, named after a content hash
+ *  of the source image file, so an edited image simply misses
+ *  the cache.  Load and Store may be called from any thread.
+ ***********************************************************/
+class TextureCache
+{
+public:
+	// constructor
+	TextureCache(const char* directory);
+	// destructor
+	~TextureCache();
+
+	// allow cached entries to be read - when off, every image is
+	// decoded again and its cache entry is rewritten
+	void SetReadEnabled(bool bReadEnabled);
+
+	// hash the contents of a source image file
+	static bool HashFile(const char* filename, uint64_t& hash);
+
+	// read the cached image for a source file hash
+	bool Load(uint64_t sourceHash, TextureDecoder::DECODED_IMAGE& image);
+	// write an RGBA image with its mip chain for a source file hash
+	bool Store(uint64_t sourceHash, const TextureDecoder::DECODED_IMAGE& image);
+
+private:
+	// directory holding the cache entries
+	std::string m_directory;
+	// false when cached entries should be ignored
+	bool m_bReadEnabled;
+
+	// path of the cache entry for a source file hash
+	std::string EntryPath(uint64_t sourceHash);
+};
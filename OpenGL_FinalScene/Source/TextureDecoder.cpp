@@ -0,0 +1,528 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturedecoder.cpp
+// ============
+// decode texture image files on a pool of worker threads
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureDecoder.h"
+#include "TextureCache.h"
+
+#include "stb_image.h"
+
+#include <cstdlib>
+
+// declaration of the mip filter
+namespace
+{
+	/***********************************************************
+	 *  FilterMipLevel()
+	 *
+	 *  This function is used for filtering an RGBA mip level
+	 *  down from the one above it with a 2 x 2 box filter.
+	 ***********************************************************/
+	void FilterMipLevel(
+		const unsigned char* source,
+		int sourceWidth,
+		int sourceHeight,
+		unsigned char* target,
+		int mipWidth,
+		int mipHeight)
+	{
+		for (int y = 0; y < mipHeight; y++)
+		{
+			// odd sizes repeat the last row or column
+			const int y0 = y * 2;
+			const int y1 = (y0 + 1 < sourceHeight) ? y0 + 1 : y0;
+			for (int x = 0; x < mipWidth; x++)
+			{
+				const int x0 = x * 2;
+				const int x1 = (x0 + 1 < sourceWidth) ? x0 + 1 : x0;
+				for (int c = 0; c < 4; c++)
+				{
+					int sum = source[((size_t)y0 * sourceWidth + x0) * 4 + c] +
+						source[((size_t)y0 * sourceWidth + x1) * 4 + c] +
+						source[((size_t)y1 * sourceWidth + x0) * 4 + c] +
+						source[((size_t)y1 * sourceWidth + x1) * 4 + c];
+					target[((size_t)y * mipWidth + x) * 4 + c] = (unsigned char)((sum + 2) / 4);
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************
+ *  TextureDecoder()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureDecoder::TextureDecoder()
+{
+	m_outstandingImages = 0;
+	m_bShutdown = false;
+	m_pTextureCache = NULL;
+	m_bBuildMipChains = false;
+}
+
+/***********************************************************
+ *  ~TextureDecoder()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureDecoder::~TextureDecoder()
+{
+	// tell the worker threads to exit and wait for them
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_bShutdown = true;
+	}
+	m_requestCondition.notify_all();
+
+	for (size_t i = 0; i < m_workers.size(); i++)
+	{
+		m_workers[i].join();
+	}
+	m_workers.clear();
+
+	// free any decoded images that were never collected
+	while (m_decodedImages.size() > 0)
+	{
+		FreeImage(m_decodedImages.front());
+		m_decodedImages.pop_front();
+	}
+}
+
+/***********************************************************
+ *  SetTextureCache()
+ *
+ *  This method is used for setting the on-disk cache that the
+ *  worker threads read decoded images from and write them to.
+ *  It must be set before the worker threads are started.
+ ***********************************************************/
+void TextureDecoder::SetTextureCache(TextureCache* pTextureCache)
+{
+	m_pTextureCache = pTextureCache;
+}
+
+/***********************************************************
+ *  SetBuildMipChains()
+ *
+ *  This method is used for having the worker threads compute
+ *  the mip chain of every image, which cached images always
+ *  have.  It must be set before the worker threads are started.
+ ***********************************************************/
+void TextureDecoder::SetBuildMipChains(bool bBuildMipChains)
+{
+	m_bBuildMipChains = bBuildMipChains;
+}
+
+/***********************************************************
+ *  Start()
+ *
+ *  This method is used for starting the worker threads.  The
+ *  images are flipped vertically when decoded, and since that
+ *  setting is shared by all threads it is set before any of
+ *  the workers are running.
+ ***********************************************************/
+void TextureDecoder::Start(int threadCount)
+{
+	if (m_workers.size() > 0)
+	{
+		return;
+	}
+
+	if (threadCount <= 0)
+	{
+		// leave one hardware thread for the OpenGL uploads
+		threadCount = (int)std::thread::hardware_concurrency() - 1;
+		if (threadCount < 1)
+		{
+			threadCount = 1;
+		}
+	}
+
+	// indicate to always flip images vertically when loaded
+	stbi_set_flip_vertically_on_load(true);
+
+	for (int i = 0; i < threadCount; i++)
+	{
+		m_workers.push_back(std::thread(&TextureDecoder::WorkerThread, this));
+	}
+}
+
+/***********************************************************
+ *  QueueImage()
+ *
+ *  This method is used for queueing an image file to be
+ *  decoded by the next available worker thread.
+ ***********************************************************/
+void TextureDecoder::QueueImage(const char* filename, std::string tag)
+{
+	DECODE_REQUEST request;
+	request.filename = filename;
+	request.tag = tag;
+
+	{
+		std::lock_guard<std::mutex> lock(m_queueMutex);
+		m_requests.push_back(request);
+		m_outstandingImages++;
+	}
+	m_requestCondition.notify_one();
+}
+
+/***********************************************************
+ *  WaitForImage()
+ *
+ *  This method is used for waiting on the next decoded image.
+ *  Images are returned in the order they finish decoding, and
+ *  an image that failed to decode is returned with no pixels.
+ *  Returns false once every queued image has been returned.
+ ***********************************************************/
+bool TextureDecoder::WaitForImage(DECODED_IMAGE& image)
+{
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+
+	if (m_outstandingImages == 0)
+	{
+		return(false);
+	}
+
+	m_decodedCondition.wait(lock, [this] { return(m_decodedImages.size() > 0); });
+
+	image = m_decodedImages.front();
+	m_decodedImages.pop_front();
+	m_outstandingImages--;
+
+	return(true);
+}
+
+/***********************************************************
+ *  TryGetImage()
+ *
+ *  This method is used for taking the next decoded image when
+ *  one is ready.  It never waits, so it can be polled once per
+ *  frame while the worker threads keep decoding.
+ ***********************************************************/
+bool TextureDecoder::TryGetImage(DECODED_IMAGE& image)
+{
+	std::lock_guard<std::mutex> lock(m_queueMutex);
+
+	if (m_decodedImages.size() == 0)
+	{
+		return(false);
+	}
+
+	image = m_decodedImages.front();
+	m_decodedImages.pop_front();
+	m_outstandingImages--;
+
+	return(true);
+}
+
+/***********************************************************
+ *  DecodeImage()
+ *
+ *  This method is used for parsing the image data from the
+ *  specified image file on the calling thread.  When a texture
+ *  cache is given, a cached copy of the image with its full mip
+ *  chain is used if there is one, otherwise the image is decoded,
+ *  its mip chain is computed, and the result is cached.  RGB
+ *  images always come back padded to RGBA, so the upload is a
+ *  straight copy with no swizzle in the driver.
+ ***********************************************************/
+bool TextureDecoder::DecodeImage(const char* filename, DECODED_IMAGE& image, TextureCache* pTextureCache, bool bBuildMipChain)
+{
+	image.filename = filename;
+	image.width = 0;
+	image.height = 0;
+	image.colorChannels = 0;
+	image.pixels = NULL;
+	image.bStbiPixels = false;
+	image.bMappedPixels = false;
+	image.mipLevels = 1;
+	image.mipOffsets[0] = 0;
+
+	// the cache entry is keyed by the contents of the image file
+	uint64_t sourceHash = 0;
+	if ((NULL != pTextureCache) && (TextureCache::HashFile(filename, sourceHash) == false))
+	{
+		pTextureCache = NULL;
+	}
+
+	// a warm cache needs no decoding or mip generation at all
+	if ((NULL != pTextureCache) && (pTextureCache->Load(sourceHash, image)))
+	{
+		return(true);
+	}
+
+	// try to parse the image data from the specified image file
+	image.pixels = stbi_load(
+		filename,
+		&image.width,
+		&image.height,
+		&image.colorChannels,
+		0);
+	image.bStbiPixels = true;
+
+	if (NULL == image.pixels)
+	{
+		return(false);
+	}
+
+	if (NULL != pTextureCache)
+	{
+		if (BuildMipChain(image))
+		{
+			pTextureCache->Store(sourceHash, image);
+		}
+	}
+	else if (bBuildMipChain == true)
+	{
+		BuildMipChain(image);
+	}
+
+	if (image.colorChannels == 3)
+	{
+		ExpandToRGBA(image);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  MipDimension()
+ *
+ *  This method is used for getting the width or height of a
+ *  mip level, which halves per level down to a single pixel.
+ ***********************************************************/
+int TextureDecoder::MipDimension(int dimension, int level)
+{
+	dimension = dimension >> level;
+	if (dimension < 1)
+	{
+		dimension = 1;
+	}
+	return(dimension);
+}
+
+/***********************************************************
+ *  BuildMipChain()
+ *
+ *  This method is used for expanding the decoded image to
+ *  RGBA and computing every mip level down to 1 x 1 with a
+ *  2 x 2 box filter.  The levels are stored one after another
+ *  in a single allocation that replaces the decoded pixels.
+ ***********************************************************/
+bool TextureDecoder::BuildMipChain(DECODED_IMAGE& image)
+{
+	if ((image.colorChannels != 3) && (image.colorChannels != 4))
+	{
+		return(false);
+	}
+
+	// count the levels and their offsets
+	size_t totalBytes = 0;
+	int mipLevels = 0;
+	while (mipLevels < MAX_MIP_LEVELS)
+	{
+		int mipWidth = MipDimension(image.width, mipLevels);
+		int mipHeight = MipDimension(image.height, mipLevels);
+
+		image.mipOffsets[mipLevels] = totalBytes;
+		totalBytes += (size_t)mipWidth * mipHeight * 4;
+		mipLevels++;
+
+		if ((mipWidth == 1) && (mipHeight == 1))
+		{
+			break;
+		}
+	}
+
+	unsigned char* pixels = (unsigned char*)malloc(totalBytes);
+	if (NULL == pixels)
+	{
+		return(false);
+	}
+
+	// expand the full resolution level to RGBA
+	const size_t pixelCount = (size_t)image.width * image.height;
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		const unsigned char* source = image.pixels + i * image.colorChannels;
+		unsigned char* target = pixels + i * 4;
+		target[0] = source[0];
+		target[1] = source[1];
+		target[2] = source[2];
+		target[3] = (image.colorChannels == 4) ? source[3] : 255;
+	}
+
+	// filter each level down from the one above it
+	for (int level = 1; level < mipLevels; level++)
+	{
+		const int sourceWidth = MipDimension(image.width, level - 1);
+		const int sourceHeight = MipDimension(image.height, level - 1);
+		const int mipWidth = MipDimension(image.width, level);
+		const int mipHeight = MipDimension(image.height, level);
+		FilterMipLevel(pixels + image.mipOffsets[level - 1], sourceWidth, sourceHeight,
+			pixels + image.mipOffsets[level], mipWidth, mipHeight);
+	}
+
+	FreeImage(image);
+	image.pixels = pixels;
+	image.bStbiPixels = false;
+	image.colorChannels = 4;
+	image.mipLevels = mipLevels;
+
+	return(true);
+}
+
+/***********************************************************
+ *  CopyMipTail()
+ *
+ *  This method is used for copying the low mip levels of an
+ *  RGBA image, from a level down to 1 x 1, one after another
+ *  into a buffer.  The levels the image came with are copied
+ *  as they are, and the rest are filtered down from the
+ *  smallest level it has, holding only one level at a time.
+ ***********************************************************/
+bool TextureDecoder::CopyMipTail(const DECODED_IMAGE& image, int firstLevel, std::vector<unsigned char>& pixels)
+{
+	pixels.clear();
+	if ((NULL == image.pixels) || (image.colorChannels != 4) || (image.mipLevels < 1))
+	{
+		return(false);
+	}
+
+	// start from the level the tail begins at, or the smallest
+	// level the image has above it
+	int level = (firstLevel < image.mipLevels) ? firstLevel : image.mipLevels - 1;
+	int width = MipDimension(image.width, level);
+	int height = MipDimension(image.height, level);
+	std::vector<unsigned char> current(
+		image.pixels + image.mipOffsets[level],
+		image.pixels + image.mipOffsets[level] + (size_t)width * height * 4);
+	std::vector<unsigned char> next;
+
+	while (true)
+	{
+		if (level >= firstLevel)
+		{
+			pixels.insert(pixels.end(), current.begin(), current.end());
+		}
+		if ((width == 1) && (height == 1))
+		{
+			break;
+		}
+
+		const int mipWidth = MipDimension(image.width, level + 1);
+		const int mipHeight = MipDimension(image.height, level + 1);
+		const size_t mipBytes = (size_t)mipWidth * mipHeight * 4;
+		if (level + 1 < image.mipLevels)
+		{
+			const unsigned char* source = image.pixels + image.mipOffsets[level + 1];
+			current.assign(source, source + mipBytes);
+		}
+		else
+		{
+			next.resize(mipBytes);
+			FilterMipLevel(current.data(), width, height, next.data(), mipWidth, mipHeight);
+			current.swap(next);
+		}
+		level++;
+		width = mipWidth;
+		height = mipHeight;
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  ExpandToRGBA()
+ *
+ *  This method is used for padding the pixels of an RGB image
+ *  with an opaque alpha channel.  It runs on the worker thread
+ *  that decoded the image.
+ ***********************************************************/
+bool TextureDecoder::ExpandToRGBA(DECODED_IMAGE& image)
+{
+	if ((image.colorChannels != 3) || (image.mipLevels != 1))
+	{
+		return(false);
+	}
+
+	const size_t pixelCount = (size_t)image.width * image.height;
+	unsigned char* pixels = (unsigned char*)malloc(pixelCount * 4);
+	if (NULL == pixels)
+	{
+		return(false);
+	}
+
+	for (size_t i = 0; i < pixelCount; i++)
+	{
+		pixels[i * 4 + 0] = image.pixels[i * 3 + 0];
+		pixels[i * 4 + 1] = image.pixels[i * 3 + 1];
+		pixels[i * 4 + 2] = image.pixels[i * 3 + 2];
+		pixels[i * 4 + 3] = 255;
+	}
+
+	FreeImage(image);
+	image.pixels = pixels;
+	image.bStbiPixels = false;
+	image.colorChannels = 4;
+
+	return(true);
+}
+
+/***********************************************************
+ *  FreeImage()
+ *
+ *  This method is used for freeing the decoded pixel data.
+ ***********************************************************/
+void TextureDecoder::FreeImage(DECODED_IMAGE& image)
+{
+	if (NULL != image.pixels)
+	{
+		if (image.bMappedPixels == true)
+			image.bMappedPixels = false;
+		else if (image.bStbiPixels == true)
+			stbi_image_free(image.pixels);
+		else
+			free(image.pixels);
+		image.pixels = NULL;
+	}
+}
+
+/***********************************************************
+ *  WorkerThread()
+ *
+ *  This method runs on each worker thread, decoding queued
+ *  image files until the decoder is shut down.
+ ***********************************************************/
+void TextureDecoder::WorkerThread()
+{
+	while (true)
+	{
+		DECODE_REQUEST request;
+
+		{
+			std::unique_lock<std::mutex> lock(m_queueMutex);
+			m_requestCondition.wait(lock, [this] { return(m_bShutdown || m_requests.size() > 0); });
+			if (m_bShutdown)
+			{
+				return;
+			}
+			request = m_requests.front();
+			m_requests.pop_front();
+		}
+
+		// decode outside of the lock so the workers run in parallel
+		DECODED_IMAGE image;
+		DecodeImage(request.filename.c_str(), image, m_pTextureCache, m_bBuildMipChains);
+		image.tag = request.tag;
+
+		{
+			std::lock_guard<std::mutex> lock(m_queueMutex);
+			m_decodedImages.push_back(image);
+		}
+		m_decodedCondition.notify_one();
+	}
+}
@@ -0,0 +1,114 @@
+///////////////////////////////////////////////////////////////////////////////
+// texturedecoder.h
+// ============
+// decode texture image files on a pool of worker threads
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+class TextureCache;
+
+/***********************************************************
+ *  TextureDecoder
+ *
+ *  This class decodes texture image files into pixel data
+ *  on a pool of worker threads.  Decoded images are placed
+ *  into a queue that the OpenGL thread drains for upload.
+ ***********************************************************/
+class TextureDecoder
+{
+public:
+	// constructor
+	TextureDecoder();
+	// destructor
+	~TextureDecoder();
+
+	// enough mip levels for a 32768 x 32768 image
+	static const int MAX_MIP_LEVELS = 16;
+
+	struct DECODED_IMAGE
+	{
+		std::string filename;
+		std::string tag;
+		int width;
+		int height;
+		int colorChannels;
+		unsigned char* pixels;
+		// true when the pixels were allocated by stb_image
+		bool bStbiPixels;
+		// true when the pixels point into a mapped asset pack and
+		// are not freed
+		bool bMappedPixels;
+		// number of mip levels in the pixels, 1 when only the
+		// full resolution image is present
+		int mipLevels;
+		// byte offset of each mip level within the pixels
+		size_t mipOffsets[MAX_MIP_LEVELS];
+	};
+
+	// read and write decoded images through an on-disk cache
+	void SetTextureCache(TextureCache* pTextureCache);
+	// compute the mip chain of every decoded image
+	void SetBuildMipChains(bool bBuildMipChains);
+	// start the worker threads - zero picks a count from the hardware
+	void Start(int threadCount = 0);
+	// queue an image file to be decoded by the worker threads
+	void QueueImage(const char* filename, std::string tag);
+	// wait for the next decoded image, false when none are outstanding
+	bool WaitForImage(DECODED_IMAGE& image);
+	// take the next decoded image if one is ready, without waiting
+	bool TryGetImage(DECODED_IMAGE& image);
+
+	// decode an image file on the calling thread, through the
+	// texture cache when one is given
+	static bool DecodeImage(const char* filename, DECODED_IMAGE& image, TextureCache* pTextureCache = NULL, bool bBuildMipChain = false);
+	// expand the image to RGBA and compute its full mip chain
+	static bool BuildMipChain(DECODED_IMAGE& image);
+	// copy the RGBA mip levels from a level down to 1 x 1 into
+	// one buffer, filtering the ones the image does not have
+	static bool CopyMipTail(const DECODED_IMAGE& image, int firstLevel, std::vector<unsigned char>& pixels);
+	// expand an RGB image to RGBA
+	static bool ExpandToRGBA(DECODED_IMAGE& image);
+	// width or height of a mip level
+	static int MipDimension(int dimension, int level);
+	// free the pixel data of a decoded image
+	static void FreeImage(DECODED_IMAGE& image);
+
+private:
+	struct DECODE_REQUEST
+	{
+		std::string filename;
+		std::string tag;
+	};
+
+	// worker threads decoding the queued image files
+	std::vector<std::thread> m_workers;
+	// guards the request and decoded image queues
+	std::mutex m_queueMutex;
+	// signaled when a request is queued or shutdown begins
+	std::condition_variable m_requestCondition;
+	// signaled when a decoded image is ready
+	std::condition_variable m_decodedCondition;
+	// image files waiting to be decoded
+	std::deque<DECODE_REQUEST> m_requests;
+	// decoded images waiting to be uploaded
+	std::deque<DECODED_IMAGE> m_decodedImages;
+	// queued images that have not been handed back yet
+	int m_outstandingImages;
+	// on-disk cache of decoded images with mip chains, or NULL
+	TextureCache* m_pTextureCache;
+	// true when mip chains are computed even without a cache
+	bool m_bBuildMipChains;
+	// true when the worker threads should exit
+	bool m_bShutdown;
+
+	// decode queued image files until shutdown
+	void WorkerThread();
+};
@@ -0,0 +1,336 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureresidency.cpp
+// ============
+// track texture memory against a budget and pick textures to evict
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TextureResidency.h"
+
+/***********************************************************
+ *  TextureResidency()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TextureResidency::TextureResidency()
+{
+	m_budgetBytes = 0;
+	m_residentBytes = 0;
+	m_peakResidentBytes = 0;
+	m_evictionCount = 0;
+	m_restoreCount = 0;
+	m_frame = 0;
+	m_leastRecent = -1;
+	m_mostRecent = -1;
+}
+
+/***********************************************************
+ *  ~TextureResidency()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TextureResidency::~TextureResidency()
+{
+}
+
+/***********************************************************
+ *  SetBudget()
+ *
+ *  This method is used for setting how many bytes of video
+ *  memory the textures may hold.  Zero turns the budget off,
+ *  so the textures are only tracked.
+ ***********************************************************/
+void TextureResidency::SetBudget(size_t budgetBytes)
+{
+	m_budgetBytes = budgetBytes;
+}
+
+/***********************************************************
+ *  ResidentBytes()
+ *
+ *  This method is used for getting the bytes a texture holds
+ *  in video memory in its current state.
+ ***********************************************************/
+size_t TextureResidency::ResidentBytes(const TEXTURE_RESIDENCY& texture)
+{
+	if (texture.state == RESIDENCY_RESIDENT)
+	{
+		return(texture.fullBytes);
+	}
+	return(texture.evictedBytes);
+}
+
+/***********************************************************
+ *  LinkTexture()
+ *
+ *  This method is used for adding a texture at the most
+ *  recently used end of the LRU list.
+ ***********************************************************/
+void TextureResidency::LinkTexture(int slot)
+{
+	TEXTURE_RESIDENCY& texture = m_textures[slot];
+	texture.previous = m_mostRecent;
+	texture.next = -1;
+	texture.bListed = true;
+
+	if (m_mostRecent >= 0)
+	{
+		m_textures[m_mostRecent].next = slot;
+	}
+	else
+	{
+		m_leastRecent = slot;
+	}
+	m_mostRecent = slot;
+}
+
+/***********************************************************
+ *  UnlinkTexture()
+ *
+ *  This method is used for taking a texture out of the LRU
+ *  list, if it is in it.
+ ***********************************************************/
+void TextureResidency::UnlinkTexture(int slot)
+{
+	TEXTURE_RESIDENCY& texture = m_textures[slot];
+	if (texture.bListed == false)
+	{
+		return;
+	}
+
+	if (texture.previous >= 0)
+	{
+		m_textures[texture.previous].next = texture.next;
+	}
+	else
+	{
+		m_leastRecent = texture.next;
+	}
+	if (texture.next >= 0)
+	{
+		m_textures[texture.next].previous = texture.previous;
+	}
+	else
+	{
+		m_mostRecent = texture.previous;
+	}
+
+	texture.previous = -1;
+	texture.next = -1;
+	texture.bListed = false;
+}
+
+/***********************************************************
+ *  SetTexture()
+ *
+ *  This method is used for tracking a texture that was just
+ *  loaded with all of its mip levels, including an evicted
+ *  texture that has been restored.  A texture that cannot be
+ *  evicted still counts against the budget.
+ ***********************************************************/
+void TextureResidency::SetTexture(int slot, size_t fullBytes, size_t evictedBytes, bool bEvictable)
+{
+	if (slot < 0)
+	{
+		return;
+	}
+
+	if (slot >= (int)m_textures.size())
+	{
+		TEXTURE_RESIDENCY empty;
+		empty.fullBytes = 0;
+		empty.evictedBytes = 0;
+		empty.bEvictable = false;
+		empty.state = RESIDENCY_RESIDENT;
+		empty.lastUsedFrame = m_frame;
+		empty.previous = -1;
+		empty.next = -1;
+		empty.bListed = false;
+		m_textures.resize(slot + 1, empty);
+	}
+
+	TEXTURE_RESIDENCY& texture = m_textures[slot];
+	if (texture.state == RESIDENCY_RESTORING)
+	{
+		m_restoreCount++;
+	}
+
+	m_residentBytes -= ResidentBytes(texture);
+	UnlinkTexture(slot);
+
+	texture.fullBytes = fullBytes;
+	texture.evictedBytes = evictedBytes;
+	// evicting a texture that is already small frees nothing
+	texture.bEvictable = bEvictable && (evictedBytes < fullBytes);
+	texture.state = RESIDENCY_RESIDENT;
+	texture.lastUsedFrame = m_frame;
+	if (texture.bEvictable == true)
+	{
+		LinkTexture(slot);
+	}
+
+	m_residentBytes += ResidentBytes(texture);
+	if (m_residentBytes > m_peakResidentBytes)
+	{
+		m_peakResidentBytes = m_residentBytes;
+	}
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for forgetting every texture once the
+ *  textures have been freed.  The peak stays, so it covers the
+ *  whole run.
+ ***********************************************************/
+void TextureResidency::Clear()
+{
+	m_textures.clear();
+	m_residentBytes = 0;
+	m_leastRecent = -1;
+	m_mostRecent = -1;
+}
+
+/***********************************************************
+ *  BeginFrame()
+ *
+ *  This method is used for starting a new frame in the LRU
+ *  order.  It is called once per frame before any drawing.
+ ***********************************************************/
+void TextureResidency::BeginFrame()
+{
+	m_frame++;
+}
+
+/***********************************************************
+ *  MarkUsed()
+ *
+ *  This method is used for noting that a texture is drawn in
+ *  the current frame, moving it to the most recently used end
+ *  of the LRU list.  A texture already drawn this frame stays
+ *  where it is, since the textures after it were too.
+ ***********************************************************/
+void TextureResidency::MarkUsed(int slot)
+{
+	if ((slot < 0) || (slot >= (int)m_textures.size()) ||
+		(m_textures[slot].lastUsedFrame == m_frame))
+	{
+		return;
+	}
+
+	m_textures[slot].lastUsedFrame = m_frame;
+	if (m_textures[slot].bListed == true)
+	{
+		UnlinkTexture(slot);
+		LinkTexture(slot);
+	}
+}
+
+/***********************************************************
+ *  NextEviction()
+ *
+ *  This method is used for picking the texture to evict next
+ *  while the resident bytes are over the budget.  The least
+ *  recently used resident texture, at the front of the LRU
+ *  list, is picked, but never one drawn in the last frame,
+ *  since it would only have to be loaded again right away.
+ *  Returns false when under budget or when nothing can be
+ *  evicted.
+ ***********************************************************/
+bool TextureResidency::NextEviction(int& slot)
+{
+	if ((m_budgetBytes == 0) || (m_residentBytes <= m_budgetBytes))
+	{
+		return(false);
+	}
+
+	slot = m_leastRecent;
+	if ((slot < 0) || (m_textures[slot].lastUsedFrame + 1 >= m_frame))
+	{
+		slot = -1;
+		return(false);
+	}
+
+	return(true);
+}
+
+/***********************************************************
+ *  SetEvicted()
+ *
+ *  This method is used for recording that a texture now holds
+ *  only its low mip levels.
+ ***********************************************************/
+void TextureResidency::SetEvicted(int slot)
+{
+	if ((slot < 0) || (slot >= (int)m_textures.size()))
+	{
+		return;
+	}
+
+	TEXTURE_RESIDENCY& texture = m_textures[slot];
+	m_residentBytes -= ResidentBytes(texture);
+	UnlinkTexture(slot);
+	texture.state = RESIDENCY_EVICTED;
+	m_residentBytes += ResidentBytes(texture);
+	m_evictionCount++;
+}
+
+/***********************************************************
+ *  SetRestoring()
+ *
+ *  This method is used for recording that the full image of
+ *  an evicted texture is being loaded again, so it is only
+ *  requested once.
+ ***********************************************************/
+void TextureResidency::SetRestoring(int slot)
+{
+	if ((slot >= 0) && (slot < (int)m_textures.size()) &&
+		(m_textures[slot].state == RESIDENCY_EVICTED))
+	{
+		m_textures[slot].state = RESIDENCY_RESTORING;
+	}
+}
+
+/***********************************************************
+ *  GetState()
+ *
+ *  This method is used for getting the residency state of a
+ *  texture.  Untracked textures count as resident.
+ ***********************************************************/
+TextureResidency::RESIDENCY_STATE TextureResidency::GetState(int slot)
+{
+	if ((slot < 0) || (slot >= (int)m_textures.size()))
+	{
+		return(RESIDENCY_RESIDENT);
+	}
+	return(m_textures[slot].state);
+}
+
+/***********************************************************
+ *  GetStats()
+ *
+ *  This method is used for getting the residency statistics,
+ *  for sizing the budget to the video memory at hand.
+ ***********************************************************/
+TextureResidency::RESIDENCY_STATS TextureResidency::GetStats()
+{
+	RESIDENCY_STATS stats;
+	stats.budgetBytes = m_budgetBytes;
+	stats.residentBytes = m_residentBytes;
+	stats.peakResidentBytes = m_peakResidentBytes;
+	stats.fullBytes = 0;
+	stats.textureCount = (int)m_textures.size();
+	stats.evictedTextures = 0;
+	stats.evictionCount = m_evictionCount;
+	stats.restoreCount = m_restoreCount;
+
+	for (int i = 0; i < (int)m_textures.size(); i++)
+	{
+		stats.fullBytes += m_textures[i].fullBytes;
+		if (m_textures[i].state != RESIDENCY_RESIDENT)
+		{
+			stats.evictedTextures++;
+		}
+	}
+
+	return(stats);
+}
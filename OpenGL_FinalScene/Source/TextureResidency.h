@@ -0,0 +1,119 @@
+///////////////////////////////////////////////////////////////////////////////
+// textureresidency.h
+// ============
+// track texture memory against a budget and pick textures to evict
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  TextureResidency
+ *
+ *  This class keeps the books for the loaded textures - the
+ *  bytes each one holds in video memory, the frame it was last
+ *  drawn in, and whether it has been evicted down to its low
+ *  mip levels.  It makes no OpenGL calls; the scene manager
+ *  asks it which texture to evict next and reports back what
+ *  it did.  Textures are identified by their slot index.  The
+ *  textures that can be evicted are kept in a list from least
+ *  to most recently used, so picking one takes no search.
+ ***********************************************************/
+class TextureResidency
+{
+public:
+	// constructor
+	TextureResidency();
+	// destructor
+	~TextureResidency();
+
+	enum RESIDENCY_STATE
+	{
+		// every mip level is in video memory
+		RESIDENCY_RESIDENT,
+		// only the low mip levels are in video memory
+		RESIDENCY_EVICTED,
+		// evicted, with the full image being loaded again
+		RESIDENCY_RESTORING
+	};
+
+	struct RESIDENCY_STATS
+	{
+		// bytes allowed in video memory, 0 for no limit
+		size_t budgetBytes;
+		// bytes held in video memory now, and the most ever held
+		size_t residentBytes;
+		size_t peakResidentBytes;
+		// bytes the textures would hold with no eviction
+		size_t fullBytes;
+		// tracked textures, and how many are evicted now
+		int textureCount;
+		int evictedTextures;
+		// evictions and restores since the textures were loaded
+		int evictionCount;
+		int restoreCount;
+	};
+
+	// set the video memory budget in bytes, 0 for no limit
+	void SetBudget(size_t budgetBytes);
+	// start tracking a texture, or update a restored one
+	void SetTexture(int slot, size_t fullBytes, size_t evictedBytes, bool bEvictable);
+	// stop tracking every texture
+	void Clear();
+	// advance the frame counter used for the LRU order
+	void BeginFrame();
+	// note that a texture is drawn in the current frame
+	void MarkUsed(int slot);
+	// pick the least recently used texture to evict, if the
+	// budget is exceeded and a texture can be evicted
+	bool NextEviction(int& slot);
+	// record that a texture was evicted to its low mip levels
+	void SetEvicted(int slot);
+	// record that an evicted texture is being loaded again
+	void SetRestoring(int slot);
+	// residency state of a texture
+	RESIDENCY_STATE GetState(int slot);
+	// current residency statistics
+	RESIDENCY_STATS GetStats();
+
+private:
+	struct TEXTURE_RESIDENCY
+	{
+		size_t fullBytes;
+		size_t evictedBytes;
+		bool bEvictable;
+		RESIDENCY_STATE state;
+		unsigned int lastUsedFrame;
+		// neighbours in the LRU list, -1 at either end, and true
+		// while the texture is in the list
+		int previous;
+		int next;
+		bool bListed;
+	};
+
+	// tracked textures indexed by slot
+	std::vector<TEXTURE_RESIDENCY> m_textures;
+	// bytes allowed in video memory, 0 for no limit
+	size_t m_budgetBytes;
+	// bytes held in video memory now, and the most ever held
+	size_t m_residentBytes;
+	size_t m_peakResidentBytes;
+	// evictions and restores since the textures were loaded
+	int m_evictionCount;
+	int m_restoreCount;
+	// frame counter for the LRU order
+	unsigned int m_frame;
+	// ends of the list of resident textures that can be evicted,
+	// least recently used first, -1 when empty
+	int m_leastRecent;
+	int m_mostRecent;
+
+	// bytes a texture holds in its current state
+	size_t ResidentBytes(const TEXTURE_RESIDENCY& texture);
+	// add a texture at the most recently used end of the list
+	void LinkTexture(int slot);
+	// take a texture out of the list
+	void UnlinkTexture(int slot);
+};
@@ -0,0 +1,695 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformbatch.cpp
+// ============
+// compose batches of object transforms with SIMD kernels
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TransformBatch.h"
+
+#include <glm/gtx/transform.hpp>
+
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define TRANSFORM_BATCH_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// GCC and Clang compile a function for AVX2 only when told to,
+// while MSVC takes the intrinsics in any function
+#if defined(__GNUC__)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSE2
+#define TARGET_AVX2
+#endif
+
+// declaration of the kernel helpers
+namespace
+{
+	const float DEGREES_TO_RADIANS = 0.0174532925f;
+
+	// pi/2 split into three parts, so an angle is reduced into
+	// [-pi/4, pi/4] without losing precision
+	const float HALF_PI_PART1 = 1.5703125f;
+	const float HALF_PI_PART2 = 4.837512969970703125e-4f;
+	const float HALF_PI_PART3 = 7.54978995489188216e-8f;
+	const float TWO_OVER_PI = 0.636619772f;
+
+	// polynomials of the sine and cosine on [-pi/4, pi/4]
+	const float SIN_COEFFICIENT1 = -1.6666654611e-1f;
+	const float SIN_COEFFICIENT2 = 8.3321608736e-3f;
+	const float SIN_COEFFICIENT3 = -1.9515295891e-4f;
+	const float COS_COEFFICIENT1 = 4.166664568298827e-2f;
+	const float COS_COEFFICIENT2 = -1.388731625493765e-3f;
+	const float COS_COEFFICIENT3 = 2.443315711809948e-5f;
+
+	// compose the matrices of one transform in closed form
+	void ComposeTransform(
+		float scaleX, float scaleY, float scaleZ,
+		float rotationX, float rotationY, float rotationZ,
+		float positionX, float positionY, float positionZ,
+		glm::mat4& modelMatrix, glm::mat4* pNormalMatrix,
+		const glm::mat4* pViewProjection, glm::mat4* pMVPMatrix)
+	{
+		const float sinX = sinf(rotationX * DEGREES_TO_RADIANS);
+		const float cosX = cosf(rotationX * DEGREES_TO_RADIANS);
+		const float sinY = sinf(rotationY * DEGREES_TO_RADIANS);
+		const float cosY = cosf(rotationY * DEGREES_TO_RADIANS);
+		const float sinZ = sinf(rotationZ * DEGREES_TO_RADIANS);
+		const float cosZ = cosf(rotationZ * DEGREES_TO_RADIANS);
+
+		// rotation Z * Y * X, by column
+		const glm::vec3 rotation[3] =
+		{
+			glm::vec3(cosZ * cosY, sinZ * cosY, -sinY),
+			glm::vec3(cosZ * sinY * sinX - sinZ * cosX, sinZ * sinY * sinX + cosZ * cosX, cosY * sinX),
+			glm::vec3(cosZ * sinY * cosX + sinZ * sinX, sinZ * sinY * cosX - cosZ * sinX, cosY * cosX)
+		};
+		const float scale[3] = { scaleX, scaleY, scaleZ };
+
+		for (int column = 0; column < 3; column++)
+		{
+			modelMatrix[column] = glm::vec4(rotation[column] * scale[column], 0.0f);
+		}
+		modelMatrix[3] = glm::vec4(positionX, positionY, positionZ, 1.0f);
+
+		if (NULL != pNormalMatrix)
+		{
+			// the inverse transpose of rotation * scale is
+			// rotation / scale
+			for (int column = 0; column < 3; column++)
+			{
+				(*pNormalMatrix)[column] = glm::vec4(rotation[column] * (1.0f / scale[column]), 0.0f);
+			}
+			(*pNormalMatrix)[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		}
+		if ((NULL != pViewProjection) && (NULL != pMVPMatrix))
+		{
+			*pMVPMatrix = (*pViewProjection) * modelMatrix;
+		}
+	}
+
+#ifdef TRANSFORM_BATCH_X86
+	// run cpuid for a leaf and subleaf
+	void CpuId(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+	{
+#ifdef _MSC_VER
+		int values[4];
+		__cpuidex(values, (int)leaf, (int)subleaf);
+		for (int i = 0; i < 4; i++)
+		{
+			registers[i] = (unsigned int)values[i];
+		}
+#else
+		__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+	}
+
+	// register states the operating system saves on a switch
+	unsigned long long ReadXCR0()
+	{
+#ifdef _MSC_VER
+		return(_xgetbv(0));
+#else
+		unsigned int low = 0;
+		unsigned int high = 0;
+		__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+		return(((unsigned long long)high << 32) | low);
+#endif
+	}
+
+	// widest kernel the processor and operating system support
+	TransformBatch::KERNEL DetectKernel()
+	{
+		unsigned int registers[4];
+
+		CpuId(0, 0, registers);
+		const unsigned int maximumLeaf = registers[0];
+
+		CpuId(1, 0, registers);
+		const bool bSSE2 = (registers[3] & (1u << 26)) != 0;
+		const bool bOSXSAVE = (registers[2] & (1u << 27)) != 0;
+		const bool bAVX = (registers[2] & (1u << 28)) != 0;
+		if (bSSE2 == false)
+		{
+			return(TransformBatch::KERNEL_SCALAR);
+		}
+
+		// the YMM registers are only usable when the operating
+		// system saves them
+		if ((bOSXSAVE == true) && (bAVX == true) && ((ReadXCR0() & 0x6) == 0x6) && (maximumLeaf >= 7))
+		{
+			CpuId(7, 0, registers);
+			if ((registers[1] & (1u << 5)) != 0)
+			{
+				return(TransformBatch::KERNEL_AVX2);
+			}
+		}
+
+		return(TransformBatch::KERNEL_SSE2);
+	}
+
+	// sine and cosine of 4 angles in radians
+	TARGET_SSE2 inline void SinCos4(__m128 angle, __m128& sine, __m128& cosine)
+	{
+		// reduce the angle by the nearest multiple of pi/2
+		const __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(angle, _mm_set1_ps(TWO_OVER_PI)));
+		const __m128 multiple = _mm_cvtepi32_ps(quadrant);
+		__m128 x = _mm_sub_ps(angle, _mm_mul_ps(multiple, _mm_set1_ps(HALF_PI_PART1)));
+		x = _mm_sub_ps(x, _mm_mul_ps(multiple, _mm_set1_ps(HALF_PI_PART2)));
+		x = _mm_sub_ps(x, _mm_mul_ps(multiple, _mm_set1_ps(HALF_PI_PART3)));
+		const __m128 x2 = _mm_mul_ps(x, x);
+
+		__m128 s = _mm_add_ps(_mm_mul_ps(x2, _mm_set1_ps(SIN_COEFFICIENT3)), _mm_set1_ps(SIN_COEFFICIENT2));
+		s = _mm_add_ps(_mm_mul_ps(s, x2), _mm_set1_ps(SIN_COEFFICIENT1));
+		s = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(s, x2), x), x);
+
+		__m128 c = _mm_add_ps(_mm_mul_ps(x2, _mm_set1_ps(COS_COEFFICIENT3)), _mm_set1_ps(COS_COEFFICIENT2));
+		c = _mm_add_ps(_mm_mul_ps(c, x2), _mm_set1_ps(COS_COEFFICIENT1));
+		c = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(c, x2), x2), _mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(x2, _mm_set1_ps(0.5f))));
+
+		// odd quadrants swap the sine and cosine, and the sine is
+		// negated in quadrants 2 and 3, the cosine in 1 and 2
+		const __m128i one = _mm_set1_epi32(1);
+		const __m128i two = _mm_set1_epi32(2);
+		const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+		const __m128 sineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+		const __m128 cosineSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+
+		sine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, c), _mm_andnot_ps(swap, s)), sineSign);
+		cosine = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, s), _mm_andnot_ps(swap, c)), cosineSign);
+	}
+
+	// write 4 matrices from their elements, given a lane per
+	// matrix as elements[column][row]
+	TARGET_SSE2 inline void StoreMatrices4(glm::mat4* pMatrices, __m128 elements[4][4])
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			_MM_TRANSPOSE4_PS(elements[column][0], elements[column][1], elements[column][2], elements[column][3]);
+			for (int matrix = 0; matrix < 4; matrix++)
+			{
+				_mm_storeu_ps(&pMatrices[matrix][column][0], elements[column][matrix]);
+			}
+		}
+	}
+
+	// sine and cosine of 8 angles in radians
+	TARGET_AVX2 inline void SinCos8(__m256 angle, __m256& sine, __m256& cosine)
+	{
+		const __m256i quadrant = _mm256_cvtps_epi32(_mm256_mul_ps(angle, _mm256_set1_ps(TWO_OVER_PI)));
+		const __m256 multiple = _mm256_cvtepi32_ps(quadrant);
+		__m256 x = _mm256_sub_ps(angle, _mm256_mul_ps(multiple, _mm256_set1_ps(HALF_PI_PART1)));
+		x = _mm256_sub_ps(x, _mm256_mul_ps(multiple, _mm256_set1_ps(HALF_PI_PART2)));
+		x = _mm256_sub_ps(x, _mm256_mul_ps(multiple, _mm256_set1_ps(HALF_PI_PART3)));
+		const __m256 x2 = _mm256_mul_ps(x, x);
+
+		__m256 s = _mm256_add_ps(_mm256_mul_ps(x2, _mm256_set1_ps(SIN_COEFFICIENT3)), _mm256_set1_ps(SIN_COEFFICIENT2));
+		s = _mm256_add_ps(_mm256_mul_ps(s, x2), _mm256_set1_ps(SIN_COEFFICIENT1));
+		s = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(s, x2), x), x);
+
+		__m256 c = _mm256_add_ps(_mm256_mul_ps(x2, _mm256_set1_ps(COS_COEFFICIENT3)), _mm256_set1_ps(COS_COEFFICIENT2));
+		c = _mm256_add_ps(_mm256_mul_ps(c, x2), _mm256_set1_ps(COS_COEFFICIENT1));
+		c = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(c, x2), x2), _mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(x2, _mm256_set1_ps(0.5f))));
+
+		const __m256i one = _mm256_set1_epi32(1);
+		const __m256i two = _mm256_set1_epi32(2);
+		const __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(quadrant, one), one));
+		const __m256 sineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(quadrant, two), 30));
+		const __m256 cosineSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(_mm256_add_epi32(quadrant, one), two), 30));
+
+		sine = _mm256_xor_ps(_mm256_blendv_ps(s, c, swap), sineSign);
+		cosine = _mm256_xor_ps(_mm256_blendv_ps(c, s, swap), cosineSign);
+	}
+
+	// write 8 matrices from their elements, given a lane per
+	// matrix as elements[column][row] - each 128-bit half is
+	// transposed on its own, so the low half holds matrices 0-3
+	// and the high half matrices 4-7, and two columns of a
+	// matrix are written with each store
+	TARGET_AVX2 inline void StoreMatrices8(glm::mat4* pMatrices, __m256 elements[4][4])
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			const __m256 low01 = _mm256_unpacklo_ps(elements[column][0], elements[column][1]);
+			const __m256 high01 = _mm256_unpackhi_ps(elements[column][0], elements[column][1]);
+			const __m256 low23 = _mm256_unpacklo_ps(elements[column][2], elements[column][3]);
+			const __m256 high23 = _mm256_unpackhi_ps(elements[column][2], elements[column][3]);
+			elements[column][0] = _mm256_shuffle_ps(low01, low23, _MM_SHUFFLE(1, 0, 1, 0));
+			elements[column][1] = _mm256_shuffle_ps(low01, low23, _MM_SHUFFLE(3, 2, 3, 2));
+			elements[column][2] = _mm256_shuffle_ps(high01, high23, _MM_SHUFFLE(1, 0, 1, 0));
+			elements[column][3] = _mm256_shuffle_ps(high01, high23, _MM_SHUFFLE(3, 2, 3, 2));
+		}
+
+		for (int column = 0; column < 4; column += 2)
+		{
+			for (int matrix = 0; matrix < 4; matrix++)
+			{
+				const __m256 first = elements[column][matrix];
+				const __m256 second = elements[column + 1][matrix];
+				_mm256_storeu_ps(&pMatrices[matrix][column][0], _mm256_permute2f128_ps(first, second, 0x20));
+				_mm256_storeu_ps(&pMatrices[matrix + 4][column][0], _mm256_permute2f128_ps(first, second, 0x31));
+			}
+		}
+	}
+#endif
+}
+
+/***********************************************************
+ *  TransformBatch()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+TransformBatch::TransformBatch()
+{
+}
+
+/***********************************************************
+ *  ~TransformBatch()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+TransformBatch::~TransformBatch()
+{
+}
+
+/***********************************************************
+ *  Add()
+ *
+ *  This method is used for adding the transform of an object,
+ *  with the same values SetTransformations() takes.
+ ***********************************************************/
+int TransformBatch::Add(
+	const glm::vec3& scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	const glm::vec3& positionXYZ)
+{
+	m_scaleX.push_back(scaleXYZ.x);
+	m_scaleY.push_back(scaleXYZ.y);
+	m_scaleZ.push_back(scaleXYZ.z);
+	m_rotationX.push_back(XrotationDegrees);
+	m_rotationY.push_back(YrotationDegrees);
+	m_rotationZ.push_back(ZrotationDegrees);
+	m_positionX.push_back(positionXYZ.x);
+	m_positionY.push_back(positionXYZ.y);
+	m_positionZ.push_back(positionXYZ.z);
+
+	return((int)m_positionX.size() - 1);
+}
+
+/***********************************************************
+ *  Clear()
+ *
+ *  This method is used for removing every transform and the
+ *  composed matrices.
+ ***********************************************************/
+void TransformBatch::Clear()
+{
+	m_scaleX.clear();
+	m_scaleY.clear();
+	m_scaleZ.clear();
+	m_rotationX.clear();
+	m_rotationY.clear();
+	m_rotationZ.clear();
+	m_positionX.clear();
+	m_positionY.clear();
+	m_positionZ.clear();
+	m_modelMatrices.clear();
+	m_normalMatrices.clear();
+	m_mvpMatrices.clear();
+}
+
+/***********************************************************
+ *  BestKernel()
+ *
+ *  This method is used for finding the widest kernel that the
+ *  processor runs.  AVX2 also needs the operating system to
+ *  save the YMM registers.  The answer is found once.
+ ***********************************************************/
+TransformBatch::KERNEL TransformBatch::BestKernel()
+{
+#ifdef TRANSFORM_BATCH_X86
+	static const KERNEL bestKernel = DetectKernel();
+	return(bestKernel);
+#else
+	return(KERNEL_SCALAR);
+#endif
+}
+
+/***********************************************************
+ *  KernelName()
+ *
+ *  This method is used for getting a readable name of a
+ *  kernel.
+ ***********************************************************/
+const char* TransformBatch::KernelName(KERNEL kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SSE2:
+		return("SSE2");
+	case KERNEL_AVX2:
+		return("AVX2");
+	default:
+		return("scalar");
+	}
+}
+
+/***********************************************************
+ *  ComposeReference()
+ *
+ *  This method is used for composing a model matrix from five
+ *  glm matrices and four multiplies, the way
+ *  SetTransformations() does, to check and time the kernels
+ *  against.
+ ***********************************************************/
+glm::mat4 TransformBatch::ComposeReference(
+	const glm::vec3& scaleXYZ,
+	float XrotationDegrees,
+	float YrotationDegrees,
+	float ZrotationDegrees,
+	const glm::vec3& positionXYZ)
+{
+	glm::mat4 scale = glm::scale(scaleXYZ);
+	glm::mat4 rotationX = glm::rotate(glm::radians(XrotationDegrees), glm::vec3(1.0f, 0.0f, 0.0f));
+	glm::mat4 rotationY = glm::rotate(glm::radians(YrotationDegrees), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 rotationZ = glm::rotate(glm::radians(ZrotationDegrees), glm::vec3(0.0f, 0.0f, 1.0f));
+	glm::mat4 translation = glm::translate(positionXYZ);
+
+	return(translation * rotationZ * rotationY * rotationX * scale);
+}
+
+/***********************************************************
+ *  Compose()
+ *
+ *  This method is used for composing the matrices of every
+ *  transform with a kernel, which falls back to the widest
+ *  one the processor runs.  The transforms left over after
+ *  the last full group of lanes are composed one at a time.
+ ***********************************************************/
+void TransformBatch::Compose(KERNEL kernel, bool bNormalMatrices, const glm::mat4* pViewProjection)
+{
+	const size_t count = GetCount();
+
+	m_modelMatrices.resize(count);
+	m_normalMatrices.resize(bNormalMatrices ? count : 0);
+	m_mvpMatrices.resize((NULL != pViewProjection) ? count : 0);
+
+	if (kernel > BestKernel())
+	{
+		kernel = BestKernel();
+	}
+
+	size_t composed = 0;
+	if (kernel == KERNEL_AVX2)
+	{
+		composed = ComposeAVX2(count, bNormalMatrices, pViewProjection);
+	}
+	else if (kernel == KERNEL_SSE2)
+	{
+		composed = ComposeSSE2(count, bNormalMatrices, pViewProjection);
+	}
+
+	ComposeScalar(composed, count - composed, bNormalMatrices, pViewProjection);
+}
+
+/***********************************************************
+ *  ComposeScalar()
+ *
+ *  This method is used for composing a range of transforms
+ *  one at a time, in the same closed form as the kernels.
+ ***********************************************************/
+void TransformBatch::ComposeScalar(size_t first, size_t count, bool bNormalMatrices, const glm::mat4* pViewProjection)
+{
+	for (size_t i = first; i < first + count; i++)
+	{
+		ComposeTransform(
+			m_scaleX[i], m_scaleY[i], m_scaleZ[i],
+			m_rotationX[i], m_rotationY[i], m_rotationZ[i],
+			m_positionX[i], m_positionY[i], m_positionZ[i],
+			m_modelMatrices[i],
+			bNormalMatrices ? &m_normalMatrices[i] : NULL,
+			pViewProjection,
+			(NULL != pViewProjection) ? &m_mvpMatrices[i] : NULL);
+	}
+}
+
+/***********************************************************
+ *  ComposeSSE2()
+ *
+ *  This method is used for composing the transforms 4 at a
+ *  time with SSE2, a lane per transform.  Returns the number
+ *  composed, which leaves out the last count % 4.
+ ***********************************************************/
+#ifdef TRANSFORM_BATCH_X86
+TARGET_SSE2 size_t TransformBatch::ComposeSSE2(size_t count, bool bNormalMatrices, const glm::mat4* pViewProjection)
+{
+	const size_t batchCount = count & ~(size_t)3;
+	const __m128 toRadians = _mm_set1_ps(DEGREES_TO_RADIANS);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	__m128 viewProjection[4][4];
+	if (NULL != pViewProjection)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				viewProjection[column][row] = _mm_set1_ps((*pViewProjection)[column][row]);
+			}
+		}
+	}
+
+	__m128 rotation[3][3];
+	__m128 model[4][4];
+	__m128 elements[4][4];
+	for (size_t i = 0; i < batchCount; i += 4)
+	{
+		const __m128 scale[3] = { _mm_loadu_ps(&m_scaleX[i]), _mm_loadu_ps(&m_scaleY[i]), _mm_loadu_ps(&m_scaleZ[i]) };
+		__m128 sinX, cosX, sinY, cosY, sinZ, cosZ;
+		SinCos4(_mm_mul_ps(_mm_loadu_ps(&m_rotationX[i]), toRadians), sinX, cosX);
+		SinCos4(_mm_mul_ps(_mm_loadu_ps(&m_rotationY[i]), toRadians), sinY, cosY);
+		SinCos4(_mm_mul_ps(_mm_loadu_ps(&m_rotationZ[i]), toRadians), sinZ, cosZ);
+
+		// rotation Z * Y * X, by column
+		const __m128 sinYsinX = _mm_mul_ps(sinY, sinX);
+		const __m128 sinYcosX = _mm_mul_ps(sinY, cosX);
+		rotation[0][0] = _mm_mul_ps(cosZ, cosY);
+		rotation[0][1] = _mm_mul_ps(sinZ, cosY);
+		rotation[0][2] = _mm_sub_ps(zero, sinY);
+		rotation[1][0] = _mm_sub_ps(_mm_mul_ps(cosZ, sinYsinX), _mm_mul_ps(sinZ, cosX));
+		rotation[1][1] = _mm_add_ps(_mm_mul_ps(sinZ, sinYsinX), _mm_mul_ps(cosZ, cosX));
+		rotation[1][2] = _mm_mul_ps(cosY, sinX);
+		rotation[2][0] = _mm_add_ps(_mm_mul_ps(cosZ, sinYcosX), _mm_mul_ps(sinZ, sinX));
+		rotation[2][1] = _mm_sub_ps(_mm_mul_ps(sinZ, sinYcosX), _mm_mul_ps(cosZ, sinX));
+		rotation[2][2] = _mm_mul_ps(cosY, cosX);
+
+		for (int column = 0; column < 3; column++)
+		{
+			for (int row = 0; row < 3; row++)
+			{
+				model[column][row] = _mm_mul_ps(rotation[column][row], scale[column]);
+			}
+			model[column][3] = zero;
+		}
+		model[3][0] = _mm_loadu_ps(&m_positionX[i]);
+		model[3][1] = _mm_loadu_ps(&m_positionY[i]);
+		model[3][2] = _mm_loadu_ps(&m_positionZ[i]);
+		model[3][3] = one;
+
+		// storing transposes the matrices in place, so the model
+		// matrices are copied first only when the MVP needs them
+		if (NULL != pViewProjection)
+		{
+			memcpy(elements, model, sizeof(elements));
+			StoreMatrices4(&m_modelMatrices[i], elements);
+		}
+		else
+		{
+			StoreMatrices4(&m_modelMatrices[i], model);
+		}
+
+		if (bNormalMatrices == true)
+		{
+			// the inverse transpose of rotation * scale is
+			// rotation / scale
+			for (int column = 0; column < 3; column++)
+			{
+				const __m128 inverseScale = _mm_div_ps(one, scale[column]);
+				for (int row = 0; row < 3; row++)
+				{
+					elements[column][row] = _mm_mul_ps(rotation[column][row], inverseScale);
+				}
+				elements[column][3] = zero;
+			}
+			elements[3][0] = zero;
+			elements[3][1] = zero;
+			elements[3][2] = zero;
+			elements[3][3] = one;
+			StoreMatrices4(&m_normalMatrices[i], elements);
+		}
+
+		if (NULL != pViewProjection)
+		{
+			// the bottom row of the model matrix is 0 0 0 1
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					__m128 sum = _mm_mul_ps(viewProjection[0][row], model[column][0]);
+					sum = _mm_add_ps(sum, _mm_mul_ps(viewProjection[1][row], model[column][1]));
+					sum = _mm_add_ps(sum, _mm_mul_ps(viewProjection[2][row], model[column][2]));
+					if (column == 3)
+					{
+						sum = _mm_add_ps(sum, viewProjection[3][row]);
+					}
+					elements[column][row] = sum;
+				}
+			}
+			StoreMatrices4(&m_mvpMatrices[i], elements);
+		}
+	}
+
+	return(batchCount);
+}
+
+/***********************************************************
+ *  ComposeAVX2()
+ *
+ *  This method is used for composing the transforms 8 at a
+ *  time with AVX2, a lane per transform.  Returns the number
+ *  composed, which leaves out the last count % 8.
+ ***********************************************************/
+TARGET_AVX2 size_t TransformBatch::ComposeAVX2(size_t count, bool bNormalMatrices, const glm::mat4* pViewProjection)
+{
+	const size_t batchCount = count & ~(size_t)7;
+	const __m256 toRadians = _mm256_set1_ps(DEGREES_TO_RADIANS);
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+
+	__m256 viewProjection[4][4];
+	if (NULL != pViewProjection)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			for (int row = 0; row < 4; row++)
+			{
+				viewProjection[column][row] = _mm256_set1_ps((*pViewProjection)[column][row]);
+			}
+		}
+	}
+
+	__m256 rotation[3][3];
+	__m256 model[4][4];
+	__m256 elements[4][4];
+	for (size_t i = 0; i < batchCount; i += 8)
+	{
+		const __m256 scale[3] = { _mm256_loadu_ps(&m_scaleX[i]), _mm256_loadu_ps(&m_scaleY[i]), _mm256_loadu_ps(&m_scaleZ[i]) };
+		__m256 sinX, cosX, sinY, cosY, sinZ, cosZ;
+		SinCos8(_mm256_mul_ps(_mm256_loadu_ps(&m_rotationX[i]), toRadians), sinX, cosX);
+		SinCos8(_mm256_mul_ps(_mm256_loadu_ps(&m_rotationY[i]), toRadians), sinY, cosY);
+		SinCos8(_mm256_mul_ps(_mm256_loadu_ps(&m_rotationZ[i]), toRadians), sinZ, cosZ);
+
+		// rotation Z * Y * X, by column
+		const __m256 sinYsinX = _mm256_mul_ps(sinY, sinX);
+		const __m256 sinYcosX = _mm256_mul_ps(sinY, cosX);
+		rotation[0][0] = _mm256_mul_ps(cosZ, cosY);
+		rotation[0][1] = _mm256_mul_ps(sinZ, cosY);
+		rotation[0][2] = _mm256_sub_ps(zero, sinY);
+		rotation[1][0] = _mm256_sub_ps(_mm256_mul_ps(cosZ, sinYsinX), _mm256_mul_ps(sinZ, cosX));
+		rotation[1][1] = _mm256_add_ps(_mm256_mul_ps(sinZ, sinYsinX), _mm256_mul_ps(cosZ, cosX));
+		rotation[1][2] = _mm256_mul_ps(cosY, sinX);
+		rotation[2][0] = _mm256_add_ps(_mm256_mul_ps(cosZ, sinYcosX), _mm256_mul_ps(sinZ, sinX));
+		rotation[2][1] = _mm256_sub_ps(_mm256_mul_ps(sinZ, sinYcosX), _mm256_mul_ps(cosZ, sinX));
+		rotation[2][2] = _mm256_mul_ps(cosY, cosX);
+
+		for (int column = 0; column < 3; column++)
+		{
+			for (int row = 0; row < 3; row++)
+			{
+				model[column][row] = _mm256_mul_ps(rotation[column][row], scale[column]);
+			}
+			model[column][3] = zero;
+		}
+		model[3][0] = _mm256_loadu_ps(&m_positionX[i]);
+		model[3][1] = _mm256_loadu_ps(&m_positionY[i]);
+		model[3][2] = _mm256_loadu_ps(&m_positionZ[i]);
+		model[3][3] = one;
+
+		// storing transposes the matrices in place, so the model
+		// matrices are copied first only when the MVP needs them
+		if (NULL != pViewProjection)
+		{
+			memcpy(elements, model, sizeof(elements));
+			StoreMatrices8(&m_modelMatrices[i], elements);
+		}
+		else
+		{
+			StoreMatrices8(&m_modelMatrices[i], model);
+		}
+
+		if (bNormalMatrices == true)
+		{
+			for (int column = 0; column < 3; column++)
+			{
+				const __m256 inverseScale = _mm256_div_ps(one, scale[column]);
+				for (int row = 0; row < 3; row++)
+				{
+					elements[column][row] = _mm256_mul_ps(rotation[column][row], inverseScale);
+				}
+				elements[column][3] = zero;
+			}
+			elements[3][0] = zero;
+			elements[3][1] = zero;
+			elements[3][2] = zero;
+			elements[3][3] = one;
+			StoreMatrices8(&m_normalMatrices[i], elements);
+		}
+
+		if (NULL != pViewProjection)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				for (int row = 0; row < 4; row++)
+				{
+					__m256 sum = _mm256_mul_ps(viewProjection[0][row], model[column][0]);
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(viewProjection[1][row], model[column][1]));
+					sum = _mm256_add_ps(sum, _mm256_mul_ps(viewProjection[2][row], model[column][2]));
+					if (column == 3)
+					{
+						sum = _mm256_add_ps(sum, viewProjection[3][row]);
+					}
+					elements[column][row] = sum;
+				}
+			}
+			StoreMatrices8(&m_mvpMatrices[i], elements);
+		}
+	}
+
+	// leave the upper halves clear for the SSE code that follows
+	_mm256_zeroupper();
+
+	return(batchCount);
+}
+#else
+size_t TransformBatch::ComposeSSE2(size_t count, bool bNormalMatrices, const glm::mat4* pViewProjection)
+{
+	return(0);
+}
+
+size_t TransformBatch::ComposeAVX2(size_t count, bool bNormalMatrices, const glm::mat4* pViewProjection)
+{
+	return(0);
+}
+#endif
@@ -0,0 +1,106 @@
+///////////////////////////////////////////////////////////////////////////////
+// transformbatch.h
+// ============
+// compose batches of object transforms with SIMD kernels
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+/***********************************************************
+ *  TransformBatch
+ *
+ *  This class composes the model matrices of many objects at
+ *  once.  The scale, rotation and position of each object are
+ *  kept in separate arrays, so a kernel loads one value for 4
+ *  or 8 objects with each instruction and works the matrices
+ *  out a lane per object.  The rotation is written out in
+ *  closed form instead of multiplying five matrices, and the
+ *  result matches SetTransformations() - translation, then Z,
+ *  Y and X rotation, then scale.  The normal matrices and the
+ *  model-view-projection matrices can be composed in the same
+ *  pass.  The widest kernel the processor runs is picked at
+ *  runtime.
+ ***********************************************************/
+class TransformBatch
+{
+public:
+	// constructor
+	TransformBatch();
+	// destructor
+	~TransformBatch();
+
+	// instruction sets the batch can be composed with
+	enum KERNEL
+	{
+		KERNEL_SCALAR = 0,
+		KERNEL_SSE2,
+		KERNEL_AVX2
+	};
+
+	// add the transform of an object, returning its index
+	int Add(
+		const glm::vec3& scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		const glm::vec3& positionXYZ);
+	// remove every transform
+	void Clear();
+	// number of transforms in the batch
+	size_t GetCount() const { return(m_positionX.size()); }
+
+	// compose the model matrix of every transform, along with
+	// the normal matrices when asked for, and the matrices
+	// multiplied by a view-projection matrix when one is given
+	void Compose(KERNEL kernel, bool bNormalMatrices = false, const glm::mat4* pViewProjection = NULL);
+
+	// matrices of the last Compose() - a normal matrix is kept
+	// in the upper 3x3 of a mat4, laid out the way std140 pads
+	// a mat3
+	const glm::mat4* GetModelMatrices() const { return(m_modelMatrices.data()); }
+	const glm::mat4* GetNormalMatrices() const { return(m_normalMatrices.data()); }
+	const glm::mat4* GetMVPMatrices() const { return(m_mvpMatrices.data()); }
+
+	// widest kernel the processor and operating system support
+	static KERNEL BestKernel();
+	// readable name of a kernel
+	static const char* KernelName(KERNEL kernel);
+	// compose one model matrix from five glm matrices, the way
+	// SetTransformations() does
+	static glm::mat4 ComposeReference(
+		const glm::vec3& scaleXYZ,
+		float XrotationDegrees,
+		float YrotationDegrees,
+		float ZrotationDegrees,
+		const glm::vec3& positionXYZ);
+
+private:
+	// transforms, one array per component
+	std::vector<float> m_scaleX;
+	std::vector<float> m_scaleY;
+	std::vector<float> m_scaleZ;
+	std::vector<float> m_rotationX;
+	std::vector<float> m_rotationY;
+	std::vector<float> m_rotationZ;
+	std::vector<float> m_positionX;
+	std::vector<float> m_positionY;
+	std::vector<float> m_positionZ;
+	// composed matrices, one per transform
+	std::vector<glm::mat4> m_modelMatrices;
+	std::vector<glm::mat4> m_normalMatrices;
+	std::vector<glm::mat4> m_mvpMatrices;
+
+	// compose a range of transforms one at a time
+	void ComposeScalar(size_t first, size_t count, bool bNormalMatrices, const glm::mat4* pViewProjection);
+	// compose a range of transforms 4 at a time, returning how
+	// many were composed
+	size_t ComposeSSE2(size_t count, bool bNormalMatrices, const glm::mat4* pViewProjection);
+	// compose a range of transforms 8 at a time, returning how
+	// many were composed
+	size_t ComposeAVX2(size_t count, bool bNormalMatrices, const glm::mat4* pViewProjection);
+};
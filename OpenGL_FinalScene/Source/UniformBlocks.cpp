@@ -0,0 +1,234 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformblocks.cpp
+// ============
+// per-frame and per-scene uniform blocks shared by the shader programs
+///////////////////////////////////////////////////////////////////////////////
+
+#include "UniformBlocks.h"
+
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+// declaration of global variables
+namespace
+{
+	// block names in the shaders, by binding point
+	const char* g_BlockNames[UniformBlocks::BLOCK_BINDING_COUNT] =
+	{
+		"MaterialBlock",
+		"FrameData",
+		"LightData"
+	};
+
+	static_assert(sizeof(UniformBlocks::DIRECTIONAL_LIGHT) == 64, "std140 DirectionalLight is 64 bytes");
+	static_assert(sizeof(UniformBlocks::POINT_LIGHT) == 64, "std140 PointLight is 64 bytes");
+	static_assert(sizeof(UniformBlocks::SPOT_LIGHT) == 96, "std140 SpotLight is 96 bytes");
+	static_assert(sizeof(UniformBlocks::FRAME_DATA) == 144, "std140 FrameData is 144 bytes");
+	static_assert(sizeof(UniformBlocks::LIGHT_DATA) == 480, "std140 LightData is 480 bytes");
+
+	// round a size up to a multiple of an alignment
+	size_t AlignUp(size_t size, size_t alignment)
+	{
+		return((size + alignment - 1) / alignment * alignment);
+	}
+}
+
+/***********************************************************
+ *  UniformBlocks()
+ *
+ *  The constructor for the class
+ ***********************************************************/
+UniformBlocks::UniformBlocks()
+{
+	m_pRing = NULL;
+	m_offsetAlignment = 256;
+	for (int i = 0; i < BLOCK_BINDING_COUNT; i++)
+	{
+		m_blockBuffers[i] = 0;
+	}
+	m_frameData = FRAME_DATA();
+}
+
+/***********************************************************
+ *  ~UniformBlocks()
+ *
+ *  The destructor for the class
+ ***********************************************************/
+UniformBlocks::~UniformBlocks()
+{
+	Destroy();
+}
+
+/***********************************************************
+ *  Create()
+ *
+ *  This method is used for creating a persistently mapped
+ *  ring large enough for the per-frame blocks of several
+ *  frames.  Without persistent mapping the blocks are written
+ *  into their own buffers instead.
+ ***********************************************************/
+void UniformBlocks::Create()
+{
+	GLint offsetAlignment = 0;
+
+	Destroy();
+
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+	if (offsetAlignment > 0)
+	{
+		m_offsetAlignment = (size_t)offsetAlignment;
+	}
+
+	const size_t frameBytes = AlignUp(sizeof(FRAME_DATA), m_offsetAlignment) +
+		AlignUp(sizeof(LIGHT_DATA), m_offsetAlignment);
+
+	m_pRing = new MappedRingBuffer();
+	if (m_pRing->Create(GL_UNIFORM_BUFFER, frameBytes * FRAMES_IN_FLIGHT) == false)
+	{
+		delete m_pRing;
+		m_pRing = NULL;
+		std::cout << "Uniform blocks are not persistently mapped - buffer storage is not supported" << std::endl;
+	}
+}
+
+/***********************************************************
+ *  Destroy()
+ *
+ *  This method is used for freeing the ring or the block
+ *  buffers.
+ ***********************************************************/
+void UniformBlocks::Destroy()
+{
+	if (NULL != m_pRing)
+	{
+		delete m_pRing;
+		m_pRing = NULL;
+	}
+	for (int i = 0; i < BLOCK_BINDING_COUNT; i++)
+	{
+		if (m_blockBuffers[i] != 0)
+		{
+			glDeleteBuffers(1, &m_blockBuffers[i]);
+			m_blockBuffers[i] = 0;
+		}
+	}
+}
+
+/***********************************************************
+ *  WriteBlock()
+ *
+ *  This method is used for copying a block into the next
+ *  range of the ring and binding that range.  Without the
+ *  ring, the block buffer is orphaned and written again, so
+ *  the write does not wait on draws still reading it.
+ ***********************************************************/
+void UniformBlocks::WriteBlock(BLOCK_BINDING binding, const void* pData, size_t bytes)
+{
+	if (NULL != m_pRing)
+	{
+		size_t offset = 0;
+		unsigned char* pMapped = m_pRing->Allocate(bytes, m_offsetAlignment, offset);
+		if (NULL != pMapped)
+		{
+			memcpy(pMapped, pData, bytes);
+			glBindBufferRange(GL_UNIFORM_BUFFER, binding, m_pRing->GetBuffer(), (GLintptr)offset, (GLsizeiptr)bytes);
+			return;
+		}
+	}
+
+	if (m_blockBuffers[binding] == 0)
+	{
+		glGenBuffers(1, &m_blockBuffers[binding]);
+	}
+	glBindBuffer(GL_UNIFORM_BUFFER, m_blockBuffers[binding]);
+	glBufferData(GL_UNIFORM_BUFFER, (GLsizeiptr)bytes, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, (GLsizeiptr)bytes, pData);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_blockBuffers[binding]);
+}
+
+/***********************************************************
+ *  SetFrameData()
+ *
+ *  This method is used for writing the view, projection and
+ *  camera position of the frame into the FrameData block.
+ *  A copy is kept for the code that orders the draws.
+ ***********************************************************/
+void UniformBlocks::SetFrameData(const FRAME_DATA& frameData)
+{
+	m_frameData = frameData;
+	WriteBlock(FRAME_DATA_BINDING, &frameData, sizeof(frameData));
+}
+
+/***********************************************************
+ *  SetLightData()
+ *
+ *  This method is used for writing the scene lights into the
+ *  LightData block.
+ ***********************************************************/
+void UniformBlocks::SetLightData(const LIGHT_DATA& lightData)
+{
+	WriteBlock(LIGHT_DATA_BINDING, &lightData, sizeof(lightData));
+}
+
+/***********************************************************
+ *  EndFrame()
+ *
+ *  This method is used for fencing the blocks written in the
+ *  frame, after its draws have been issued.
+ ***********************************************************/
+void UniformBlocks::EndFrame()
+{
+	if (NULL != m_pRing)
+	{
+		m_pRing->Fence();
+	}
+}
+
+/***********************************************************
+ *  BindProgram()
+ *
+ *  This method is used for pointing each block a program
+ *  declares at its binding point.  Blocks the program does
+ *  not declare are skipped.
+ ***********************************************************/
+void UniformBlocks::BindProgram(GLuint program)
+{
+	for (int i = 0; i < BLOCK_BINDING_COUNT; i++)
+	{
+		const GLuint blockIndex = glGetUniformBlockIndex(program, g_BlockNames[i]);
+		if (blockIndex != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(program, blockIndex, (GLuint)i);
+		}
+	}
+}
+
+/***********************************************************
+ *  PackPointLights()
+ *
+ *  This method is used for moving the point lights that are
+ *  on to the front of the block, keeping their order, so a
+ *  shader can loop over exactly that many.  The lights are
+ *  summed, so their order does not change the result.
+ *  Returns the number of point lights that are on.
+ ***********************************************************/
+int UniformBlocks::PackPointLights(LIGHT_DATA& lightData)
+{
+	int activeCount = 0;
+
+	for (int i = 0; i < TOTAL_POINT_LIGHTS; i++)
+	{
+		if (lightData.pointLights[i].bActive != 0)
+		{
+			if (i != activeCount)
+			{
+				std::swap(lightData.pointLights[i], lightData.pointLights[activeCount]);
+			}
+			activeCount++;
+		}
+	}
+
+	return(activeCount);
+}
@@ -0,0 +1,146 @@
+///////////////////////////////////////////////////////////////////////////////
+// uniformblocks.h
+// ============
+// per-frame and per-scene uniform blocks shared by the shader programs
+///////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "MappedRingBuffer.h"
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+/***********************************************************
+ *  UniformBlocks
+ *
+ *  This class holds the std140 layouts of the uniform blocks
+ *  the shaders share, and writes the per-frame ones into a
+ *  persistently mapped ring with room for several frames.
+ *  Updating a block is a single copy into the mapping and a
+ *  binding of its range, and a range is only written again
+ *  once the GPU has passed the fence of the frame that read
+ *  it.  Without persistent mapping, each block is written
+ *  into its own buffer instead.  Every program that declares
+ *  the blocks is pointed at the same binding points, so any
+ *  program can read them.
+ ***********************************************************/
+class UniformBlocks
+{
+public:
+	// constructor
+	UniformBlocks();
+	// destructor
+	~UniformBlocks();
+
+	// uniform buffer binding point of each block
+	enum BLOCK_BINDING
+	{
+		MATERIAL_BINDING = 0,
+		FRAME_DATA_BINDING = 1,
+		LIGHT_DATA_BINDING = 2,
+		BLOCK_BINDING_COUNT = 3
+	};
+
+	// frames whose blocks may be in flight at once
+	static const int FRAMES_IN_FLIGHT = 3;
+	// TOTAL_POINT_LIGHTS in the shader
+	static const int TOTAL_POINT_LIGHTS = 5;
+
+	// the lights laid out by the std140 rules - each vec3 starts
+	// on 16 bytes, and a following scalar packs in after it
+	struct DIRECTIONAL_LIGHT
+	{
+		glm::vec3 direction;
+		float padding0;
+		glm::vec3 ambient;
+		float padding1;
+		glm::vec3 diffuse;
+		float padding2;
+		glm::vec3 specular;
+		int32_t bActive;
+	};
+
+	struct POINT_LIGHT
+	{
+		glm::vec3 position;
+		float padding0;
+		glm::vec3 ambient;
+		float padding1;
+		glm::vec3 diffuse;
+		float padding2;
+		glm::vec3 specular;
+		int32_t bActive;
+	};
+
+	struct SPOT_LIGHT
+	{
+		glm::vec3 position;
+		float padding0;
+		glm::vec3 direction;
+		float cutOff;
+		float outerCutOff;
+		float constant;
+		float linear;
+		float quadratic;
+		glm::vec3 ambient;
+		float padding1;
+		glm::vec3 diffuse;
+		float padding2;
+		glm::vec3 specular;
+		int32_t bActive;
+	};
+
+	// FrameData block, written once a frame
+	struct FRAME_DATA
+	{
+		glm::mat4 view;
+		glm::mat4 projection;
+		glm::vec3 viewPosition;
+		float padding;
+	};
+
+	// LightData block, written once a frame from the scene lights
+	struct LIGHT_DATA
+	{
+		DIRECTIONAL_LIGHT directionalLight;
+		POINT_LIGHT pointLights[TOTAL_POINT_LIGHTS];
+		SPOT_LIGHT spotLight;
+	};
+
+	// create the ring, persistently mapped when supported
+	void Create();
+	// free the ring or the block buffers
+	void Destroy();
+	// write the blocks of the frame and bind them
+	void SetFrameData(const FRAME_DATA& frameData);
+	void SetLightData(const LIGHT_DATA& lightData);
+	// view of the last frame written
+	const FRAME_DATA& GetFrameData() const { return(m_frameData); }
+	// fence the blocks written this frame
+	void EndFrame();
+	// true when the blocks go through the persistent mapping
+	bool IsPersistent() const { return(NULL != m_pRing); }
+
+	// point the blocks a program declares at their bindings
+	static void BindProgram(GLuint program);
+	// move the point lights that are on to the front, and
+	// return how many there are
+	static int PackPointLights(LIGHT_DATA& lightData);
+
+private:
+	// persistently mapped ring of block ranges, or NULL
+	MappedRingBuffer* m_pRing;
+	// alignment of a bound range within a uniform buffer
+	size_t m_offsetAlignment;
+	// buffer of each block when there is no ring
+	GLuint m_blockBuffers[BLOCK_BINDING_COUNT];
+	// copy of the last FrameData block written
+	FRAME_DATA m_frameData;
+
+	// copy a block into the ring or its buffer and bind it
+	void WriteBlock(BLOCK_BINDING binding, const void* pData, size_t bytes);
+};
@@ -20,8 +20,6 @@ namespace
 	// Variables for window width and height
 	const int WINDOW_WIDTH = 1000;
 	const int WINDOW_HEIGHT = 800;
-	const char* g_ViewName = "view";
-	const char* g_ProjectionName = "projection";
 
 	// camera object used for viewing and interacting with
 	// the 3D scene
@@ -47,10 +45,13 @@ namespace
  *  The constructor for the class
  ***********************************************************/
 ViewManager::ViewManager(
-	ShaderManager *pShaderManager)
+	ShaderManager *pShaderManager,
+	UniformBlocks *pUniformBlocks)
 {
 	// initialize the member variables
 	m_pShaderManager = pShaderManager;
+	m_pUniformBlocks = pUniformBlocks;
+	m_frameData = UniformBlocks::FRAME_DATA();
 	m_pWindow = NULL;
 	g_pCamera = new Camera();
 	// default camera view parameters
@@ -234,9 +235,6 @@ void ViewManager::ProcessKeyboardEvents()
  ***********************************************************/
 void ViewManager::PrepareSceneView()
 {
-	glm::mat4 view;
-	glm::mat4 projection;
-
 	// per-frame timing
 	float currentFrame = glfwGetTime();
 	gDeltaTime = currentFrame - gLastFrame;
@@ -246,6 +244,28 @@ void ViewManager::PrepareSceneView()
 	// event queue
 	ProcessKeyboardEvents();
 
+	// write the view, projection and camera position of the frame
+	// into the FrameData block every program reads them from
+	m_frameData = MakeFrameData();
+	if (NULL != m_pUniformBlocks)
+	{
+		m_pUniformBlocks->SetFrameData(m_frameData);
+	}
+}
+
+/***********************************************************
+ *  MakeFrameData()
+ *
+ *  This method is used for working out the view, projection
+ *  and position of the camera as it is now, without moving
+ *  it or writing them anywhere.
+ ***********************************************************/
+UniformBlocks::FRAME_DATA ViewManager::MakeFrameData() const
+{
+	UniformBlocks::FRAME_DATA frameData;
+	glm::mat4 view;
+	glm::mat4 projection;
+
 	// get the current view matrix from the camera
 	view = g_pCamera->GetViewMatrix();
 
@@ -274,14 +294,10 @@ void ViewManager::PrepareSceneView()
 		}
 	}
 
-	// if the shader manager object is valid
-	if (NULL != m_pShaderManager)
-	{
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ViewName, view);
-		// set the view matrix into the shader for proper rendering
-		m_pShaderManager->setMat4Value(g_ProjectionName, projection);
-		// set the view position of the camera into the shader for proper rendering
-		m_pShaderManager->setVec3Value("viewPosition", g_pCamera->Position);
-	}
+	frameData.view = view;
+	frameData.projection = projection;
+	frameData.viewPosition = g_pCamera->Position;
+	frameData.padding = 0.0f;
+
+	return(frameData);
 }
\ No newline at end of file
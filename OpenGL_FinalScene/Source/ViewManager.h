@@ -10,6 +10,7 @@
 #pragma once
 
 #include "ShaderManager.h"
+#include "UniformBlocks.h"
 #include "camera.h"
 
 // GLFW library
@@ -20,7 +21,8 @@ class ViewManager
 public:
 	// constructor
 	ViewManager(
-		ShaderManager* pShaderManager);
+		ShaderManager* pShaderManager,
+		UniformBlocks* pUniformBlocks);
 	// destructor
 	~ViewManager();
 
@@ -33,6 +35,10 @@ public:
 private:
 	// pointer to shader manager object
 	ShaderManager* m_pShaderManager;
+	// uniform blocks the view of each frame is written into
+	UniformBlocks* m_pUniformBlocks;
+	// view of the last prepared frame
+	UniformBlocks::FRAME_DATA m_frameData;
 	// active OpenGL display window
 	GLFWwindow* m_pWindow;
 
@@ -45,4 +51,8 @@ public:
 	
 	// prepare the conversion from 3D object display to 2D scene display
 	void PrepareSceneView();
+	// view of the last prepared frame
+	const UniformBlocks::FRAME_DATA& GetFrameData() const { return(m_frameData); }
+	// view of the camera as it is now
+	UniformBlocks::FRAME_DATA MakeFrameData() const;
 };
\ No newline at end of file
@@ -1,4 +1,25 @@
 #version 330 core
+// a SPIR-V build cannot bind the blocks by name, so it gives
+// them the bindings of UniformBlocks::BLOCK_BINDING
+#ifdef GL_SPIRV
+#extension GL_ARB_shading_language_420pack : enable
+#define BLOCK_LAYOUT(index) layout(std140, binding = index)
+#else
+#define BLOCK_LAYOUT(index) layout(std140)
+#endif
+// lets the objectTexture sampler take a bindless texture handle
+#ifdef GL_ARB_bindless_texture
+#extension GL_ARB_bindless_texture : enable
+#endif
+// an indirect variant reads the values of its batches from a
+// storage buffer at an explicit binding
+#ifdef SHADER_VARIANT
+#if VARIANT_INDIRECT
+#define INDIRECT_DRAW
+#extension GL_ARB_shader_storage_buffer_object : require
+#extension GL_ARB_shading_language_420pack : require
+#endif
+#endif
 out vec4 fragmentColor;
 
 in vec3 fragmentPosition;
@@ -52,24 +73,118 @@ struct SpotLight {
 
 uniform bool bUseTexture=false;
 uniform bool bUseLighting=false;
+#ifndef INDIRECT_DRAW
 uniform vec4 objectColor = vec4(1.0f);
-uniform vec3 viewPosition;
-uniform DirectionalLight directionalLight;
-uniform PointLight pointLights[TOTAL_POINT_LIGHTS];
-uniform SpotLight spotLight;
-uniform Material material;
+#endif
+// the view of the frame, shared by every program
+BLOCK_LAYOUT(1) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+};
+// the scene lights, rewritten once a frame
+BLOCK_LAYOUT(2) uniform LightData
+{
+    DirectionalLight directionalLight;
+    PointLight pointLights[TOTAL_POINT_LIGHTS];
+    SpotLight spotLight;
+};
+// every material of the scene, uploaded once, and the index of
+// the one this draw uses
+#define MAX_MATERIALS 512
+BLOCK_LAYOUT(0) uniform MaterialBlock
+{
+    Material materials[MAX_MATERIALS];
+};
+#ifdef SHADER_VARIANT
+#if VARIANT_INSTANCED
+#define INSTANCED_DRAW
+#endif
+#endif
+// an instanced draw passes the material of each instance on
+// from the vertex shader
+#ifdef INSTANCED_DRAW
+flat in int fragmentMaterialIndex;
+#define MATERIAL_INDEX fragmentMaterialIndex
+#else
+uniform int materialIndex = 0;
+#define MATERIAL_INDEX materialIndex
+#endif
+// the material of this draw, read from the block once in main()
+Material material;
 uniform sampler2D objectTexture;
+uniform bool bUseTextureArray = false;
+uniform sampler2DArray objectTextureArray;
+uniform int objectTextureLayer = 0;
+#ifdef INDIRECT_DRAW
+// values shared by the instances of each batch, laid out as
+// InstancedMeshes::BATCH_DATA and bound at BINDING_BATCH_DATA -
+// the texture is a bindless handle, which differs between the
+// batches of one draw call
+struct BatchData {
+    vec4 color;
+    vec4 textureRect;
+    vec2 UVscale;
+    int bUseTextureAtlas;
+    uvec2 textureHandle;
+};
+layout(std430, binding = 0) readonly buffer BatchBlock
+{
+    BatchData batches[];
+};
+flat in int fragmentBatchIndex;
+#define OBJECT_COLOR batches[fragmentBatchIndex].color
+#define UV_SCALE batches[fragmentBatchIndex].UVscale
+#else
 uniform vec2 UVscale = vec2(1.0f, 1.0f);
+uniform bool bUseTextureAtlas = false;
+uniform vec4 objectTextureRect = vec4(0.0f, 0.0f, 1.0f, 1.0f);
+#define OBJECT_COLOR objectColor
+#define UV_SCALE UVscale
+#endif
+
+// a shader variant is compiled with SHADER_VARIANT defined and
+// the features of its draws in the VARIANT_ defines, which turns
+// the branches below into constants the compiler folds away and
+// unrolls the light loop to the lights that are on.  Built without
+// them, the shader branches on the uniforms for every fragment.
+#ifdef SHADER_VARIANT
+#define USE_TEXTURE (VARIANT_TEXTURE != 0)
+#define USE_LIGHTING (VARIANT_LIGHTING != 0)
+#define DIRECTIONAL_LIGHT_ON (VARIANT_DIRECTIONAL_LIGHT != 0)
+#define SPOT_LIGHT_ON (VARIANT_SPOT_LIGHT != 0)
+#define ACTIVE_POINT_LIGHTS VARIANT_POINT_LIGHTS
+#define POINT_LIGHT_ON(i) true
+#else
+#define USE_TEXTURE bUseTexture
+#define USE_LIGHTING bUseLighting
+#define DIRECTIONAL_LIGHT_ON directionalLight.bActive
+#define SPOT_LIGHT_ON spotLight.bActive
+#define ACTIVE_POINT_LIGHTS TOTAL_POINT_LIGHTS
+#define POINT_LIGHT_ON(i) pointLights[i].bActive
+#endif
 
 // function prototypes
-vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir);
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
+vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 surfaceColor);
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 surfaceColor);
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 surfaceColor);
+vec4 SampleObjectTexture(vec2 textureCoordinate);
 
 void main()
 {    
-    if(bUseLighting == true)
+    material = materials[MATERIAL_INDEX];
+
+    if(USE_LIGHTING)
     {
+        // the texture is sampled once, and every light shades the
+        // same surface color
+        vec4 surfaceColor = OBJECT_COLOR;
+        if(USE_TEXTURE)
+        {
+            surfaceColor = SampleObjectTexture(fragmentTextureCoordinate);
+        }
+
         vec3 phongResult = vec3(0.0f);
         // properties
         vec3 norm = normalize(fragmentVertexNormal);
@@ -82,53 +197,90 @@ void main()
         // up for this fragment's final color.
         // == =====================================================
         // phase 1: directional lighting
-        if(directionalLight.bActive == true)
+        if(DIRECTIONAL_LIGHT_ON)
         {
-            phongResult += CalcDirectionalLight(directionalLight, norm, viewDir);
+            phongResult += CalcDirectionalLight(directionalLight, norm, viewDir, surfaceColor.rgb);
         }
         // phase 2: point lights
-        for(int i = 0; i < TOTAL_POINT_LIGHTS; i++)
+        for(int i = 0; i < ACTIVE_POINT_LIGHTS; i++)
         {
-	    if(pointLights[i].bActive == true)
+            if(POINT_LIGHT_ON(i))
             {
-                phongResult += CalcPointLight(pointLights[i], norm, fragmentPosition, viewDir);   
+                phongResult += CalcPointLight(pointLights[i], norm, fragmentPosition, viewDir, surfaceColor.rgb);
             }
         } 
         // phase 3: spot light
-        if(spotLight.bActive == true)
+        if(SPOT_LIGHT_ON)
         {
-            phongResult += CalcSpotLight(spotLight, norm, fragmentPosition, viewDir);    
+            phongResult += CalcSpotLight(spotLight, norm, fragmentPosition, viewDir, surfaceColor.rgb);
         }
     
-        if(bUseTexture == true)
+        fragmentColor = vec4(phongResult, surfaceColor.a);
+    }
+    else
+    {
+        if(USE_TEXTURE)
         {
-            fragmentColor = vec4(phongResult, (texture(objectTexture, fragmentTextureCoordinate)).a);
+            fragmentColor = SampleObjectTexture(fragmentTextureCoordinate * UV_SCALE);
         }
         else
         {
-            fragmentColor = vec4(phongResult, objectColor.a);
+            fragmentColor = OBJECT_COLOR;
         }
     }
-    else
+}
+
+#ifdef INDIRECT_DRAW
+// samples the texture of the batch, from its own texture or from
+// its rectangle of an atlas.  Without bindless textures only the
+// untextured batches are drawn indirectly, so the variant still
+// builds and never samples.
+vec4 SampleObjectTexture(vec2 textureCoordinate)
+{
+#ifdef GL_ARB_bindless_texture
+    BatchData batch = batches[fragmentBatchIndex];
+    sampler2D batchTexture = sampler2D(batch.textureHandle);
+    if(batch.bUseTextureAtlas != 0)
     {
-        if(bUseTexture == true)
-        {
-            fragmentColor = texture(objectTexture, fragmentTextureCoordinate * UVscale);
-        }
-        else
+        vec2 atlasCoordinate = batch.textureRect.xy + fract(textureCoordinate) * batch.textureRect.zw;
+        vec2 dx = dFdx(textureCoordinate) * batch.textureRect.zw;
+        vec2 dy = dFdy(textureCoordinate) * batch.textureRect.zw;
+        return textureGrad(batchTexture, atlasCoordinate, dx, dy);
+    }
+    return texture(batchTexture, textureCoordinate);
+#else
+    return OBJECT_COLOR;
+#endif
+}
+#else
+// samples the object texture from its own texture or from its texture array layer
+vec4 SampleObjectTexture(vec2 textureCoordinate)
+{
+    // a texture in an atlas repeats within its own rectangle - the
+    // gradients are taken before fract() so the wrap seam does not
+    // jump to the smallest mip level
+    if(bUseTextureAtlas == true)
+    {
+        vec2 atlasCoordinate = objectTextureRect.xy + fract(textureCoordinate) * objectTextureRect.zw;
+        vec2 dx = dFdx(textureCoordinate) * objectTextureRect.zw;
+        vec2 dy = dFdy(textureCoordinate) * objectTextureRect.zw;
+        if(bUseTextureArray == true)
         {
-            fragmentColor = objectColor;
+            return textureGrad(objectTextureArray, vec3(atlasCoordinate, objectTextureLayer), dx, dy);
         }
+        return textureGrad(objectTexture, atlasCoordinate, dx, dy);
+    }
+    if(bUseTextureArray == true)
+    {
+        return texture(objectTextureArray, vec3(textureCoordinate, objectTextureLayer));
     }
+    return texture(objectTexture, textureCoordinate);
 }
+#endif
 
 // calculates the color when using a directional light.
-vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir)
+vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir, vec3 surfaceColor)
 {
-    vec3 ambient = vec3(0.0f);
-    vec3 diffuse = vec3(0.0f);
-    vec3 specular = vec3(0.0f);
-
     vec3 lightDirection = normalize(-light.direction);
     // diffuse shading
     float diff = max(dot(normal, lightDirection), 0.0);
@@ -136,29 +288,16 @@ vec3 CalcDirectionalLight(DirectionalLight light, vec3 normal, vec3 viewDir)
     vec3 reflectDir = reflect(-lightDirection, normal);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
     // combine results
-    if(bUseTexture == true)
-    {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * spec * material.specularColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-    }
-    else
-    {
-        ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * spec * material.specularColor * vec3(objectColor);
-    }
+    vec3 ambient = light.ambient * surfaceColor;
+    vec3 diffuse = light.diffuse * diff * material.diffuseColor * surfaceColor;
+    vec3 specular = light.specular * spec * material.specularColor * surfaceColor;
     
     return (ambient + diffuse + specular);
 }
 
 // calculates the color when using a point light.
-vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 surfaceColor)
 {
-    vec3 ambient = vec3(0.0f);
-    vec3 diffuse = vec3(0.0f);
-    vec3 specular= vec3(0.0f);
-
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
@@ -168,29 +307,16 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
    
     // combine results
-    if(bUseTexture == true)
-    {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * specularComponent * material.specularColor;
-    }
-    else
-    {
-        ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * specularComponent * material.specularColor;
-    }
+    vec3 ambient = light.ambient * surfaceColor;
+    vec3 diffuse = light.diffuse * diff * material.diffuseColor * surfaceColor;
+    vec3 specular = light.specular * specularComponent * material.specularColor;
     
     return (ambient + diffuse + specular);
 }
 
 // calculates the color when using a spot light.
-vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
+vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 surfaceColor)
 {
-    vec3 ambient = vec3(0.0f);
-    vec3 diffuse = vec3(0.0f);
-    vec3 specular = vec3(0.0f);
-
     vec3 lightDir = normalize(light.position - fragPos);
     // diffuse shading
     float diff = max(dot(normal, lightDir), 0.0);
@@ -205,18 +331,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    if(bUseTexture == true)
-    {
-        ambient = light.ambient * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-        specular = light.specular * spec * material.specularColor * vec3(texture(objectTexture, fragmentTextureCoordinate));
-    }
-    else
-    {
-        ambient = light.ambient * vec3(objectColor);
-        diffuse = light.diffuse * diff * material.diffuseColor * vec3(objectColor);
-        specular = light.specular * spec * material.specularColor * vec3(objectColor);
-    }
+    vec3 ambient = light.ambient * surfaceColor;
+    vec3 diffuse = light.diffuse * diff * material.diffuseColor * surfaceColor;
+    vec3 specular = light.specular * spec * material.specularColor * surfaceColor;
     
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
@@ -1,4 +1,12 @@
 #version 330 core
+// a SPIR-V build cannot bind the blocks by name, so it gives
+// them the bindings of UniformBlocks::BLOCK_BINDING
+#ifdef GL_SPIRV
+#extension GL_ARB_shading_language_420pack : enable
+#define BLOCK_LAYOUT(index) layout(std140, binding = index)
+#else
+#define BLOCK_LAYOUT(index) layout(std140)
+#endif
 layout (location = 0) in vec3 inVertexPosition;
 layout (location = 1) in vec3 inVertexNormal;
 layout (location = 2) in vec2 inTextureCoordinate;
@@ -7,14 +15,52 @@ out vec3 fragmentPosition;
 out vec3 fragmentVertexNormal;
 out vec2 fragmentTextureCoordinate;
 
+// an instanced variant reads the model matrix and material of
+// each instance from the instance buffer, InstancedMeshes::
+// INSTANCE_LOCATION, instead of from uniforms set per draw
+#ifdef SHADER_VARIANT
+#if VARIANT_INSTANCED
+#define INSTANCED_DRAW
+#endif
+#if VARIANT_INDIRECT
+#define INDIRECT_DRAW
+#endif
+#endif
+#ifdef INSTANCED_DRAW
+layout (location = 3) in mat4 instanceModel;
+layout (location = 7) in int instanceMaterialIndex;
+flat out int fragmentMaterialIndex;
+#endif
+// an indirect variant also passes on the batch of each instance,
+// which the fragment shader reads the batch values with
+#ifdef INDIRECT_DRAW
+layout (location = 8) in int instanceBatchIndex;
+flat out int fragmentBatchIndex;
+#endif
+#ifdef INSTANCED_DRAW
+#define MODEL_MATRIX instanceModel
+#else
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#define MODEL_MATRIX model
+#endif
+// the view of the frame, shared by every program
+BLOCK_LAYOUT(1) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    vec3 viewPosition;
+};
 
 void main()
 {
-   fragmentPosition = vec3(model * vec4(inVertexPosition, 1.0));
-   gl_Position = projection * view * model * vec4(inVertexPosition, 1.0f);
+   fragmentPosition = vec3(MODEL_MATRIX * vec4(inVertexPosition, 1.0));
+   gl_Position = projection * view * MODEL_MATRIX * vec4(inVertexPosition, 1.0f);
+#ifdef INSTANCED_DRAW
+   fragmentMaterialIndex = instanceMaterialIndex;
+#endif
+#ifdef INDIRECT_DRAW
+   fragmentBatchIndex = instanceBatchIndex;
+#endif
    fragmentVertexNormal = inVertexNormal;
    fragmentTextureCoordinate = inTextureCoordinate;
 }
\ No newline at end of file